@@ -0,0 +1,324 @@
+// Benchmark for the MCP HTTP/SSE endpoint. Run it against a server started
+// with --http-backend httplib and again with --http-backend asio:
+//
+//   http_bench --port 52080 --connections 5000 --hold 20 --requests 1000
+//
+// Phase 1 (capacity) opens N SSE streams at once and counts how many get
+// their endpoint event within --timeout, then holds them for --hold seconds
+// and counts how many are still open. Phase 2 (latency) keeps those streams
+// open and times sequential JSON-RPC pings on one more session: POST until
+// 202, and POST until the response arrives on the SSE stream. Plain HTTP
+// only.
+
+#include <asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using asio::ip::tcp;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "52080";
+    size_t connections = 1000;
+    int hold_seconds = 10;
+    int timeout_seconds = 10;
+    size_t requests = 500;
+};
+
+struct CapacityStats {
+    std::atomic<size_t> established{0};
+    std::atomic<size_t> failed{0};     // Connect/write/read error before the endpoint event
+    std::atomic<size_t> closed{0};     // Closed by the server after the endpoint event
+    std::vector<double> setup_ms;      // Guarded by the io thread (single-threaded)
+};
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+void print_latency(const char* label, const std::vector<double>& ms) {
+    std::printf("  %-24s n=%zu p50=%.2fms p90=%.2fms p99=%.2fms max=%.2fms\n", label, ms.size(),
+                percentile(ms, 0.50), percentile(ms, 0.90), percentile(ms, 0.99), percentile(ms, 1.0));
+}
+
+std::string sse_request(const Options& options) {
+    return "GET / HTTP/1.1\r\nHost: " + options.host + ":" + options.port +
+           "\r\nAccept: text/event-stream\r\n\r\n";
+}
+
+// One idle SSE stream: connect, wait for the endpoint event, then park a
+// read that completes only when the server closes the stream
+class SseStream : public std::enable_shared_from_this<SseStream> {
+public:
+    SseStream(asio::io_context& io, const tcp::resolver::results_type& endpoints,
+              const std::string& request, CapacityStats& stats)
+        : socket_(io), endpoints_(endpoints), request_(request), stats_(stats) {}
+
+    void start() {
+        auto self = shared_from_this();
+        started_ = Clock::now();
+        asio::async_connect(socket_, endpoints_, [this, self](const asio::error_code& ec, const tcp::endpoint&) {
+            if (ec) return fail();
+            asio::async_write(socket_, asio::buffer(request_), [this, self](const asio::error_code& ec, size_t) {
+                if (ec) return fail();
+                asio::async_read_until(socket_, buffer_, "session_id=",
+                    [this, self](const asio::error_code& ec, size_t) {
+                        if (ec) return fail();
+                        stats_.established++;
+                        stats_.setup_ms.push_back(ms_since(started_));
+                        park();
+                    });
+            });
+        });
+    }
+
+    void close() {
+        asio::error_code ec;
+        socket_.close(ec);
+    }
+
+private:
+    void fail() {
+        stats_.failed++;
+        close();
+    }
+
+    void park() {
+        auto self = shared_from_this();
+        buffer_.consume(buffer_.size());
+        socket_.async_read_some(asio::buffer(discard_), [this, self](const asio::error_code& ec, size_t) {
+            if (ec) {
+                if (ec != asio::error::operation_aborted) stats_.closed++;
+                return;
+            }
+            park();   // Pings and other events
+        });
+    }
+
+    tcp::socket socket_;
+    tcp::resolver::results_type endpoints_;
+    const std::string& request_;
+    CapacityStats& stats_;
+    asio::streambuf buffer_;
+    Clock::time_point started_;
+    char discard_[512];
+};
+
+// Blocking client for the latency phase
+class LatencyClient {
+public:
+    LatencyClient(asio::io_context& io, const tcp::resolver::results_type& endpoints, const Options& options)
+        : sse_(io), post_(io), endpoints_(endpoints), options_(options) {}
+
+    void run(std::vector<double>& accept_ms, std::vector<double>& round_trip_ms) {
+        asio::connect(sse_, endpoints_);
+        asio::write(sse_, asio::buffer(sse_request(options_)));
+        asio::read_until(sse_, sse_buffer_, "session_id=");
+        asio::read_until(sse_, sse_buffer_, "\n\n");
+        std::string head(asio::buffers_begin(sse_buffer_.data()), asio::buffers_end(sse_buffer_.data()));
+        size_t at = head.find("session_id=") + 11;
+        session_id_ = head.substr(at, head.find('\n', at) - at);
+        sse_buffer_.consume(sse_buffer_.size());
+
+        asio::connect(post_, endpoints_);
+        for (size_t i = 0; i < options_.requests; i++) {
+            std::string body = "{\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(i + 1) + ",\"method\":\"ping\"}";
+            std::string request = "POST /messages?session_id=" + session_id_ + " HTTP/1.1\r\nHost: " +
+                                  options_.host + "\r\nContent-Type: application/json\r\nContent-Length: " +
+                                  std::to_string(body.size()) + "\r\n\r\n" + body;
+
+            auto start = Clock::now();
+            asio::write(post_, asio::buffer(request));
+            read_response();
+            accept_ms.push_back(ms_since(start));
+
+            // The answer is the next message event on the stream
+            asio::read_until(sse_, sse_buffer_, "event: message");
+            asio::read_until(sse_, sse_buffer_, "\n\n");
+            round_trip_ms.push_back(ms_since(start));
+            sse_buffer_.consume(sse_buffer_.size());
+        }
+    }
+
+private:
+    // Read one Content-Length response from the POST connection
+    void read_response() {
+        size_t n = asio::read_until(post_, post_buffer_, "\r\n\r\n");
+        std::string head(asio::buffers_begin(post_buffer_.data()),
+                         asio::buffers_begin(post_buffer_.data()) + static_cast<std::ptrdiff_t>(n));
+        post_buffer_.consume(n);
+
+        size_t length = 0;
+        for (const char* name : {"Content-Length: ", "content-length: "}) {
+            size_t at = head.find(name);
+            if (at != std::string::npos) length = std::stoul(head.substr(at + 16));
+        }
+        if (post_buffer_.size() < length) {
+            asio::read(post_, post_buffer_, asio::transfer_exactly(length - post_buffer_.size()));
+        }
+        post_buffer_.consume(length);
+        if (head.compare(0, 12, "HTTP/1.1 202") != 0) {
+            throw std::runtime_error("Unexpected response: " + head.substr(0, head.find('\r')));
+        }
+    }
+
+    tcp::socket sse_;
+    tcp::socket post_;
+    tcp::resolver::results_type endpoints_;
+    const Options& options_;
+    asio::streambuf sse_buffer_;
+    asio::streambuf post_buffer_;
+    std::string session_id_;
+};
+
+void raise_fd_limit(size_t wanted) {
+#ifndef _WIN32
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return;
+    if (limit.rlim_cur >= wanted) return;
+    limit.rlim_cur = std::min<rlim_t>(wanted, limit.rlim_max);
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < wanted) {
+        std::fprintf(stderr, "Warning: descriptor limit %llu is below %zu; raise ulimit -n\n",
+                     static_cast<unsigned long long>(limit.rlim_cur), wanted);
+    }
+#else
+    (void)wanted;
+#endif
+}
+
+void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n\n";
+    std::cout << "  --host HOST         Server host (default: 127.0.0.1)\n";
+    std::cout << "  --port PORT         Server HTTP port (default: 52080)\n";
+    std::cout << "  --connections N     Idle SSE streams to open (default: 1000)\n";
+    std::cout << "  --hold S            Seconds to hold them open (default: 10)\n";
+    std::cout << "  --timeout S         Seconds a stream may take to get its endpoint event (default: 10)\n";
+    std::cout << "  --requests N        Ping round trips in the latency phase (default: 500)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--host" && i + 1 < argc) {
+            options.host = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            options.port = argv[++i];
+        } else if (arg == "--connections" && i + 1 < argc) {
+            options.connections = std::stoul(argv[++i]);
+        } else if (arg == "--hold" && i + 1 < argc) {
+            options.hold_seconds = std::stoi(argv[++i]);
+        } else if (arg == "--timeout" && i + 1 < argc) {
+            options.timeout_seconds = std::stoi(argv[++i]);
+        } else if (arg == "--requests" && i + 1 < argc) {
+            options.requests = std::stoul(argv[++i]);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    raise_fd_limit(options.connections + 64);
+
+    try {
+        asio::io_context io;
+        tcp::resolver resolver(io);
+        auto endpoints = resolver.resolve(options.host, options.port);
+        std::string request = sse_request(options);
+
+        // Phase 1: capacity
+        CapacityStats stats;
+        std::vector<std::shared_ptr<SseStream>> streams;
+        streams.reserve(options.connections);
+        auto start = Clock::now();
+        for (size_t i = 0; i < options.connections; i++) {
+            streams.push_back(std::make_shared<SseStream>(io, endpoints, request, stats));
+            streams.back()->start();
+        }
+        auto work = asio::make_work_guard(io);
+        std::thread io_thread([&io] { io.run(); });
+
+        auto deadline = start + std::chrono::seconds(options.timeout_seconds);
+        while (stats.established + stats.failed < options.connections && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        double setup_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        size_t established = stats.established;
+        size_t failed = stats.failed;
+
+        std::this_thread::sleep_for(std::chrono::seconds(options.hold_seconds));
+        size_t open = stats.established - stats.closed;
+
+        // Phase 2: latency with the idle streams still open
+        std::vector<double> accept_ms;
+        std::vector<double> round_trip_ms;
+        std::string latency_error;
+        if (established + failed < options.connections) {
+            // A saturated server would queue the latency client forever too
+            latency_error = "skipped, server stopped accepting streams";
+        } else try {
+            asio::io_context latency_io;
+            LatencyClient client(latency_io, endpoints, options);
+            client.run(accept_ms, round_trip_ms);
+        } catch (const std::exception& e) {
+            latency_error = e.what();
+        }
+
+        // Setup times are written by the io thread; read them once it's done
+        asio::post(io, [&streams] {
+            for (auto& stream : streams) stream->close();
+        });
+        work.reset();
+        io_thread.join();
+
+        std::printf("Capacity (%zu SSE streams to %s:%s)\n", options.connections,
+                    options.host.c_str(), options.port.c_str());
+        std::printf("  established              %zu in %.2fs\n", established, setup_seconds);
+        std::printf("  failed                   %zu\n", failed);
+        std::printf("  stalled                  %zu (no endpoint event within %ds)\n",
+                    options.connections - established - failed, options.timeout_seconds);
+        std::printf("  open after %3ds hold     %zu\n", options.hold_seconds, open);
+        print_latency("stream setup", stats.setup_ms);
+
+        std::printf("Latency (%zu ping round trips, %zu idle streams open)\n", options.requests, open);
+        if (!latency_error.empty()) {
+            std::printf("  %s (%zu round trips completed)\n", latency_error.c_str(), round_trip_ms.size());
+        }
+        print_latency("POST -> 202", accept_ms);
+        print_latency("POST -> SSE response", round_trip_ms);
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+// Replays a datagram capture (mcp_log_server --capture FILE) to a server's
+// UDP port, keeping the recorded gaps between datagrams:
+//
+//   replay session.cap --port 52099 --speed 1      as recorded
+//   replay session.cap --speed 10                  ten times faster
+//   replay session.cap --speed max --loop 5        back to back, five passes
+//
+// The capture is loaded into memory first, so disk reads don't disturb the
+// timing. Datagrams go out in capture order from one socket; the report
+// shows how far sends fell behind schedule (at high speeds, the sender
+// itself can be the limit).
+
+#include "datagram_capture.hpp"
+#include <asio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using mcp_logs::CaptureReader;
+using mcp_logs::CapturedDatagram;
+
+struct Options {
+    std::string file;
+    std::string host = "127.0.0.1";
+    std::string port = "52099";
+    double speed = 1.0;    // 0: as fast as possible
+    size_t loops = 1;
+};
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " FILE [options]\n\n";
+    std::cout << "  --host HOST         Server host (default: 127.0.0.1)\n";
+    std::cout << "  --port PORT         Server UDP port (default: 52099)\n";
+    std::cout << "  --speed N|max       Playback speed multiplier, or max for no delays (default: 1)\n";
+    std::cout << "  --loop N            Play the capture N times back to back (default: 1)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--host" && i + 1 < argc) {
+            options.host = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            options.port = argv[++i];
+        } else if (arg == "--speed" && i + 1 < argc) {
+            std::string speed = argv[++i];
+            options.speed = speed == "max" ? 0.0 : std::stod(speed);
+            if (options.speed < 0.0 || (speed != "max" && options.speed == 0.0)) {
+                std::cerr << "Error: --speed must be positive or max\n";
+                return 1;
+            }
+        } else if (arg == "--loop" && i + 1 < argc) {
+            options.loops = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (options.file.empty() && arg.rfind("--", 0) != 0) {
+            options.file = arg;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.file.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        std::vector<CapturedDatagram> datagrams;
+        CaptureReader reader(options.file);
+        CapturedDatagram datagram;
+        while (reader.next(datagram)) datagrams.push_back(std::move(datagram));
+        if (datagrams.empty()) {
+            std::cerr << "Error: " << options.file << " holds no datagrams\n";
+            return 1;
+        }
+        auto capture_length = datagrams.back().offset;
+
+        asio::io_context io;
+        asio::ip::udp::resolver resolver(io);
+        asio::ip::udp::endpoint target = *resolver.resolve(asio::ip::udp::v4(), options.host, options.port).begin();
+        asio::ip::udp::socket socket(io, asio::ip::udp::v4());
+
+        size_t sent = 0;
+        size_t failed = 0;     // Usually ENOBUFS when sending flat out
+        uint64_t bytes = 0;
+        std::vector<double> lag_ms;
+        lag_ms.reserve(options.speed > 0.0 ? datagrams.size() * options.loops : 0);
+
+        auto start = Clock::now();
+        for (size_t loop = 0; loop < options.loops; loop++) {
+            auto pass_offset = capture_length * static_cast<int64_t>(loop);
+            for (const auto& d : datagrams) {
+                if (options.speed > 0.0) {
+                    auto due = start + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double, std::micro>((pass_offset + d.offset).count() / options.speed));
+                    std::this_thread::sleep_until(due);
+                    lag_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - due).count());
+                }
+                asio::error_code ec;
+                socket.send_to(asio::buffer(d.data), target, 0, ec);
+                if (ec) {
+                    failed++;
+                    continue;
+                }
+                sent++;
+                bytes += d.data.size();
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::printf("Replayed %s to %s:%s (%zu datagrams x %zu, captured over %.2fs)\n", options.file.c_str(),
+                    options.host.c_str(), options.port.c_str(), datagrams.size(), options.loops,
+                    std::chrono::duration<double>(capture_length).count());
+        if (options.speed > 0.0) {
+            std::printf("  speed                    %gx\n", options.speed);
+        } else {
+            std::printf("  speed                    max\n");
+        }
+        std::printf("  sent                     %zu datagrams, %.2f MB in %.2fs\n", sent,
+                    static_cast<double>(bytes) / 1e6, seconds);
+        std::printf("  rate                     %.0f datagrams/s, %.2f MB/s\n",
+                    seconds > 0 ? static_cast<double>(sent) / seconds : 0.0,
+                    seconds > 0 ? static_cast<double>(bytes) / 1e6 / seconds : 0.0);
+        std::printf("  send errors              %zu\n", failed);
+        if (!lag_ms.empty()) {
+            std::printf("  behind schedule          p50=%.3fms p99=%.3fms max=%.3fms\n",
+                        percentile(lag_ms, 0.50), percentile(lag_ms, 0.99), percentile(lag_ms, 1.0));
+        }
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include "alloc_tracker.hpp"
+#include "metrics.hpp"
+#include "storage_tuning.hpp"
+#include "thread_placement.hpp"
+#include <atomic>
+
+#ifdef MCP_LOGS_ALLOC_TRACKING
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace mcp_logs {
+
+namespace {
+
+constexpr size_t kSubsystems = static_cast<size_t>(AllocSubsystem::Count);
+constexpr const char* kSubsystemNames[kSubsystems] = {
+    "ingest", "tailer", "query", "http", "ui", "json", "results", "sse", "ui_buffer", "other"
+};
+static_assert(static_cast<size_t>(ThreadRole::Count) == 5 &&
+              static_cast<int>(AllocSubsystem::Ui) == static_cast<int>(ThreadRole::Ui),
+              "The first subsystems mirror ThreadRole");
+
+// One cache line per subsystem, so threads in different subsystems don't
+// contend on the counters
+struct alignas(64) Counters {
+    std::atomic<int64_t> live_bytes{0};
+    std::atomic<uint64_t> allocated_bytes{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> frees{0};
+};
+
+Counters g_counters[kSubsystems];
+std::atomic<uint64_t> g_rows{0};
+thread_local int t_scope = -1;   // AllocScope override; plain int, so usable inside operator new
+
+} // namespace
+
+const char* alloc_subsystem_name(AllocSubsystem subsystem) {
+    size_t index = static_cast<size_t>(subsystem);
+    return index < kSubsystems ? kSubsystemNames[index] : "unknown";
+}
+
+int AllocTracker::swap_scope(int subsystem) noexcept {
+    int previous = t_scope;
+    t_scope = subsystem;
+    return previous;
+}
+
+void AllocTracker::add_rows(size_t rows) {
+    g_rows.fetch_add(rows, std::memory_order_relaxed);
+}
+
+uint64_t AllocTracker::rows_ingested() {
+    return g_rows.load(std::memory_order_relaxed);
+}
+
+std::vector<AllocStats> AllocTracker::report() {
+    std::vector<AllocStats> out;
+    if (!enabled()) return out;
+
+    double rows = static_cast<double>(rows_ingested());
+    for (size_t i = 0; i < kSubsystems; i++) {
+        const Counters& c = g_counters[i];
+        AllocStats stats;
+        stats.subsystem = kSubsystemNames[i];
+        stats.live_bytes = c.live_bytes.load(std::memory_order_relaxed);
+        stats.allocated_bytes = c.allocated_bytes.load(std::memory_order_relaxed);
+        stats.allocations = c.allocations.load(std::memory_order_relaxed);
+        stats.frees = c.frees.load(std::memory_order_relaxed);
+        if (rows > 0) {
+            stats.allocations_per_row = static_cast<double>(stats.allocations) / rows;
+            stats.bytes_per_row = static_cast<double>(stats.allocated_bytes) / rows;
+        }
+        out.push_back(std::move(stats));
+    }
+    return out;
+}
+
+void AllocTracker::publish_metrics() {
+    for (const auto& stats : report()) {
+        Metrics::Labels labels = {{"subsystem", stats.subsystem}};
+        Metrics::set_gauge("alloc_live_bytes", static_cast<double>(stats.live_bytes), labels);
+        Metrics::set_gauge("alloc_bytes", static_cast<double>(stats.allocated_bytes), labels);
+        Metrics::set_gauge("alloc_count", static_cast<double>(stats.allocations), labels);
+        Metrics::set_gauge("alloc_per_row", stats.allocations_per_row, labels);
+    }
+
+    SqliteMemoryStats sqlite = sqlite_memory_stats();
+    Metrics::set_gauge("sqlite_memory_bytes", static_cast<double>(sqlite.memory_used), {{"kind", "used"}});
+    Metrics::set_gauge("sqlite_memory_bytes", static_cast<double>(sqlite.memory_highwater), {{"kind", "highwater"}});
+    Metrics::set_gauge("sqlite_memory_bytes", static_cast<double>(sqlite.pagecache_overflow_bytes),
+                       {{"kind", "pagecache_overflow"}});
+    Metrics::set_gauge("sqlite_allocations", static_cast<double>(sqlite.allocations));
+}
+
+#ifdef MCP_LOGS_ALLOC_TRACKING
+
+namespace {
+
+// Sits immediately before the pointer handed out. `offset` is the distance
+// back to what malloc returned (more than the header for over-aligned news).
+struct Header {
+    uint64_t size;
+    uint32_t subsystem;
+    uint32_t offset;
+};
+constexpr size_t kHeaderBytes = 16;
+static_assert(sizeof(Header) == kHeaderBytes, "Header must keep the default alignment");
+
+int current_subsystem() noexcept {
+    if (t_scope >= 0) return t_scope;
+    auto role = ThreadPlacement::current_role();
+    return role ? static_cast<int>(*role) : static_cast<int>(AllocSubsystem::Other);
+}
+
+void* tracked_alloc(size_t size, size_t alignment) noexcept {
+    size_t padding = alignment > kHeaderBytes ? alignment : 0;
+    if (size > SIZE_MAX - kHeaderBytes - padding) return nullptr;
+    char* raw = static_cast<char*>(std::malloc(size + kHeaderBytes + padding));
+    if (!raw) return nullptr;
+
+    char* user = raw + kHeaderBytes;
+    if (padding) {
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(user) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        user = reinterpret_cast<char*>(aligned);
+    }
+
+    int subsystem = current_subsystem();
+    auto* header = reinterpret_cast<Header*>(user - kHeaderBytes);
+    header->size = size;
+    header->subsystem = static_cast<uint32_t>(subsystem);
+    header->offset = static_cast<uint32_t>(user - raw);
+
+    Counters& c = g_counters[subsystem];
+    c.live_bytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    c.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+    return user;
+}
+
+void tracked_free(void* ptr) noexcept {
+    if (!ptr) return;
+    char* user = static_cast<char*>(ptr);
+    auto* header = reinterpret_cast<Header*>(user - kHeaderBytes);
+
+    Counters& c = g_counters[header->subsystem];
+    c.live_bytes.fetch_sub(static_cast<int64_t>(header->size), std::memory_order_relaxed);
+    c.frees.fetch_add(1, std::memory_order_relaxed);
+    std::free(user - header->offset);
+}
+
+void* allocate_or_throw(size_t size, size_t alignment) {
+    for (;;) {
+        if (void* ptr = tracked_alloc(size, alignment)) return ptr;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+} // namespace
+
+#endif
+
+} // namespace mcp_logs
+
+#ifdef MCP_LOGS_ALLOC_TRACKING
+
+// Replacements for every global allocation function, so nothing allocated
+// through one can be freed through an untracked one
+using mcp_logs::allocate_or_throw;
+using mcp_logs::tracked_alloc;
+using mcp_logs::tracked_free;
+
+void* operator new(size_t size) { return allocate_or_throw(size, 0); }
+void* operator new[](size_t size) { return allocate_or_throw(size, 0); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return tracked_alloc(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return tracked_alloc(size, 0); }
+void* operator new(size_t size, std::align_val_t align) { return allocate_or_throw(size, static_cast<size_t>(align)); }
+void* operator new[](size_t size, std::align_val_t align) { return allocate_or_throw(size, static_cast<size_t>(align)); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return tracked_alloc(size, static_cast<size_t>(align));
+}
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return tracked_alloc(size, static_cast<size_t>(align));
+}
+
+void operator delete(void* ptr) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr) noexcept { tracked_free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { tracked_free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { tracked_free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { tracked_free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { tracked_free(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { tracked_free(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { tracked_free(ptr); }
+
+#endif
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mcp_logs {
+
+// Where heap memory goes. A thread's allocations count under its
+// ThreadPlacement role (the first five) unless an AllocScope says otherwise.
+enum class AllocSubsystem {
+    Ingest,
+    Tailer,
+    Query,
+    Http,
+    Ui,
+    Json,       // MCP request/response DOMs
+    Results,    // LogStore read results (entry vectors, scans, stats)
+    Sse,        // Queued SSE events and write buffers
+    UiBuffer,   // TUI log panes (LogBuffer)
+    Other,      // Threads without a role
+    Count
+};
+
+const char* alloc_subsystem_name(AllocSubsystem subsystem);
+
+struct AllocStats {
+    std::string subsystem;
+    int64_t live_bytes = 0;          // Allocated here and not yet freed
+    uint64_t allocated_bytes = 0;    // Since startup
+    uint64_t allocations = 0;
+    uint64_t frees = 0;              // Of blocks allocated here, wherever freed
+    double allocations_per_row = 0.0;   // Per ingested row
+    double bytes_per_row = 0.0;
+};
+
+// Heap accounting by subsystem. Built with ENABLE_ALLOC_TRACKING, global
+// operator new/delete put a 16-byte header on every block recording its
+// size and subsystem, so frees are charged back to whoever allocated. In
+// other builds there are no hooks, AllocScope is empty and report() is
+// empty. SQLite's own allocations bypass operator new; see
+// sqlite_memory_stats() for those.
+class AllocTracker {
+public:
+    static constexpr bool enabled() {
+#ifdef MCP_LOGS_ALLOC_TRACKING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Rows written to the store, the denominator of the per-row figures
+    static void note_rows_ingested(size_t rows) {
+#ifdef MCP_LOGS_ALLOC_TRACKING
+        add_rows(rows);
+#else
+        (void)rows;
+#endif
+    }
+    static uint64_t rows_ingested();
+
+    // Every subsystem, in enum order
+    static std::vector<AllocStats> report();
+
+    // alloc_live_bytes, alloc_bytes, alloc_count and alloc_per_row gauges by
+    // subsystem, plus SQLite's process-wide sqlite_memory_bytes{kind}
+    static void publish_metrics();
+
+    // Used by AllocScope: set the calling thread's subsystem override (-1:
+    // none) and return the previous one
+    static int swap_scope(int subsystem) noexcept;
+
+private:
+    static void add_rows(size_t rows);
+};
+
+// Tag this thread's allocations with a subsystem until the scope ends.
+// Scopes nest.
+class AllocScope {
+public:
+    explicit AllocScope(AllocSubsystem subsystem) noexcept {
+#ifdef MCP_LOGS_ALLOC_TRACKING
+        previous_ = AllocTracker::swap_scope(static_cast<int>(subsystem));
+#else
+        (void)subsystem;
+#endif
+    }
+    ~AllocScope() {
+#ifdef MCP_LOGS_ALLOC_TRACKING
+        AllocTracker::swap_scope(previous_);
+#endif
+    }
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+private:
+#ifdef MCP_LOGS_ALLOC_TRACKING
+    int previous_;
+#endif
+};
+
+} // namespace mcp_logs
@@ -0,0 +1,314 @@
+#include "anomaly_detector.hpp"
+#include "log_store.hpp"
+#include "message_template.hpp"
+#include "server_log.hpp"
+#include "thread_placement.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace mcp_logs {
+
+namespace {
+
+// Empty buckets folded in per gap; after this many the EWMA is ~0 anyway
+constexpr int64_t kMaxGapBuckets = 64;
+
+std::string format_number(double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.1f", value);
+    return buf;
+}
+
+} // namespace
+
+nlohmann::json Anomaly::to_json() const {
+    nlohmann::json j = {
+        {"id", id},
+        {"type", type},
+        {"detected_at", detected_at},
+        {"category", category},
+        {"instance_id", instance_id},
+        {"session_id", session_id},
+        {"observed", observed},
+        {"expected", expected},
+        {"score", score},
+        {"detail", detail}
+    };
+    if (type != "quiet_instance") j["verbosity"] = verbosity_to_string(verbosity);
+    if (example_id) j["example_id"] = example_id;
+    return j;
+}
+
+void AnomalyDetector::Ewma::add(double x, double alpha) {
+    if (samples == 0) {
+        mean = x;
+        var = 0.0;
+    } else {
+        double diff = x - mean;
+        double incr = alpha * diff;
+        mean += incr;
+        var = (1.0 - alpha) * (var + diff * incr);
+    }
+    samples++;
+}
+
+double AnomalyDetector::Ewma::stddev() const {
+    // Never tighter than Poisson noise, so a perfectly steady series still
+    // tolerates ordinary jitter
+    return std::max({std::sqrt(var), std::sqrt(mean), 1.0});
+}
+
+bool AnomalyDetector::BucketRate::advance(int64_t to_bucket, double alpha) {
+    if (to_bucket <= bucket) return false;  // Same bucket, or an out-of-order receive time
+
+    rate.add(static_cast<double>(count), alpha);
+    int64_t gap = std::min(to_bucket - bucket - 1, kMaxGapBuckets);
+    for (int64_t i = 0; i < gap; i++) {
+        rate.add(0.0, alpha);
+    }
+    bucket = to_bucket;
+    count = 0;
+    return true;
+}
+
+AnomalyDetector::AnomalyDetector(LogStore& store, AnomalyOptions options)
+    : options_(options)
+{
+    store.subscribe([this](const LogEntry& entry) {
+        observe(entry);
+    });
+}
+
+AnomalyDetector::~AnomalyDetector() {
+    stop_ticking();
+}
+
+void AnomalyDetector::start_ticking(std::chrono::milliseconds interval, std::function<double()> clock) {
+    std::lock_guard<std::mutex> lock(ticker_mutex_);
+    if (ticking_) return;
+    ticking_ = true;
+
+    if (interval.count() <= 0) {
+        interval = std::chrono::milliseconds(static_cast<int64_t>(options_.bucket_seconds * 1000.0));
+    }
+    if (!clock) {
+        clock = [] {
+            return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        };
+    }
+    ticker_ = std::thread([this, interval, clock = std::move(clock)] {
+        ThreadPlacement::adopt(ThreadRole::Query);
+        std::unique_lock<std::mutex> lock(ticker_mutex_);
+        while (!ticker_wake_.wait_for(lock, interval, [this] { return !ticking_; })) {
+            lock.unlock();
+            tick(clock());
+            lock.lock();
+        }
+    });
+}
+
+void AnomalyDetector::stop_ticking() {
+    {
+        std::lock_guard<std::mutex> lock(ticker_mutex_);
+        if (!ticking_) return;
+        ticking_ = false;
+    }
+    ticker_wake_.notify_all();
+    if (ticker_.joinable()) ticker_.join();
+}
+
+void AnomalyDetector::observe(const LogEntry& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    int64_t bucket = static_cast<int64_t>(std::floor(entry.received_at / options_.bucket_seconds));
+    observe_rate(entry, bucket);
+    observe_instance(entry, bucket);
+    if (entry.verbosity <= Verbosity::Error && entry.verbosity != Verbosity::NoLogging) {
+        observe_error_template(entry);
+    }
+
+    if (entry.received_at - last_quiet_check_ >= options_.bucket_seconds) {
+        last_quiet_check_ = entry.received_at;
+        check_quiet(entry.received_at);
+    }
+}
+
+void AnomalyDetector::tick(double now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    check_quiet(now);
+}
+
+void AnomalyDetector::observe_rate(const LogEntry& entry, int64_t bucket) {
+    std::string key = entry.category + '\x1f' + entry.instance_id + '\x1f' +
+                      std::to_string(static_cast<int>(entry.verbosity));
+
+    auto it = series_.find(key);
+    if (it == series_.end()) {
+        if (series_.size() >= options_.max_series) evict_oldest(series_);
+        Series series;
+        series.category = entry.category;
+        series.instance_id = entry.instance_id;
+        series.verbosity = entry.verbosity;
+        series.rate.bucket = bucket;
+        it = series_.emplace(std::move(key), std::move(series)).first;
+    }
+
+    Series& s = it->second;
+    if (s.rate.advance(bucket, options_.alpha)) s.flagged = false;
+    s.rate.count++;
+    s.last_seen = std::max(s.last_seen, entry.received_at);
+
+    // Flag as soon as the open bucket crosses the threshold, once per bucket
+    const Ewma& baseline = s.rate.rate;
+    if (s.flagged || baseline.samples < options_.warmup_buckets ||
+        s.rate.count < options_.min_spike_count) {
+        return;
+    }
+    double sd = baseline.stddev();
+    if (s.rate.count <= baseline.mean + options_.spike_sigma * sd) return;
+
+    s.flagged = true;
+    Anomaly a;
+    a.type = "spike";
+    a.detected_at = entry.received_at;
+    a.category = s.category;
+    a.instance_id = s.instance_id;
+    a.session_id = entry.session_id;
+    a.verbosity = s.verbosity;
+    a.observed = static_cast<double>(s.rate.count);
+    a.expected = baseline.mean;
+    a.score = (a.observed - baseline.mean) / sd;
+    a.example_id = entry.id;
+    a.detail = "Spike: " + s.category + "/" + s.instance_id + " " + verbosity_to_string(s.verbosity) +
+               " at " + std::to_string(s.rate.count) + " logs per " +
+               format_number(options_.bucket_seconds) + "s (baseline " + format_number(baseline.mean) + ")";
+    record(std::move(a));
+}
+
+void AnomalyDetector::observe_instance(const LogEntry& entry, int64_t bucket) {
+    auto it = instances_.find(entry.instance_id);
+    if (it == instances_.end()) {
+        if (instances_.size() >= options_.max_instances) evict_oldest(instances_);
+        Instance inst;
+        inst.rate.bucket = bucket;
+        it = instances_.emplace(entry.instance_id, std::move(inst)).first;
+    }
+
+    Instance& inst = it->second;
+    inst.rate.advance(bucket, options_.alpha);
+    inst.rate.count++;
+    inst.last_seen = std::max(inst.last_seen, entry.received_at);
+    inst.session_id = entry.session_id;
+    inst.quiet = false;
+}
+
+void AnomalyDetector::observe_error_template(const LogEntry& entry) {
+    std::string text = normalize_message(entry.message);
+    uint64_t hash = template_hash(text);
+    if (!error_templates_.insert(hash).second) return;
+
+    error_template_order_.push_back(hash);
+    if (error_template_order_.size() > options_.max_error_templates) {
+        error_templates_.erase(error_template_order_.front());
+        error_template_order_.pop_front();
+    }
+
+    Anomaly a;
+    a.type = "new_error_template";
+    a.detected_at = entry.received_at;
+    a.category = entry.category;
+    a.instance_id = entry.instance_id;
+    a.session_id = entry.session_id;
+    a.verbosity = entry.verbosity;
+    a.observed = 1.0;
+    a.example_id = entry.id;
+    a.detail = "New error template in " + entry.category + "/" + entry.instance_id + ": " + text;
+    record(std::move(a));
+}
+
+void AnomalyDetector::check_quiet(double now) {
+    for (auto& [instance_id, inst] : instances_) {
+        if (inst.quiet) continue;
+
+        // Only instances with an established, meaningful rate can go quiet
+        const Ewma& baseline = inst.rate.rate;
+        if (baseline.samples < options_.warmup_buckets || baseline.mean < options_.min_quiet_rate) {
+            continue;
+        }
+
+        double expected_gap = options_.bucket_seconds / baseline.mean;
+        double silence = now - inst.last_seen;
+        if (silence < std::max(options_.quiet_seconds, 10.0 * expected_gap)) continue;
+
+        inst.quiet = true;
+        Anomaly a;
+        a.type = "quiet_instance";
+        a.detected_at = now;
+        a.instance_id = instance_id;
+        a.session_id = inst.session_id;
+        a.observed = silence;
+        a.expected = expected_gap;
+        a.detail = "Instance " + instance_id + " quiet for " + format_number(silence) +
+                   "s (usually a log every " + format_number(expected_gap) + "s)";
+        record(std::move(a));
+    }
+}
+
+void AnomalyDetector::record(Anomaly anomaly) {
+    anomaly.id = next_id_++;
+    ServerLog::log("Anomaly", anomaly.detail);
+
+    anomalies_.push_back(std::move(anomaly));
+    while (anomalies_.size() > options_.max_anomalies) {
+        anomalies_.pop_front();
+    }
+}
+
+template <typename Map>
+void AnomalyDetector::evict_oldest(Map& map) {
+    // Drop the least recently seen eighth in one pass so eviction stays
+    // amortized O(1) per new key
+    std::vector<double> seen;
+    seen.reserve(map.size());
+    for (const auto& [key, value] : map) seen.push_back(value.last_seen);
+    if (seen.empty()) return;
+
+    size_t drop = std::max<size_t>(1, seen.size() / 8);
+    std::nth_element(seen.begin(), seen.begin() + (drop - 1), seen.end());
+    double cutoff = seen[drop - 1];
+
+    for (auto it = map.begin(); it != map.end() && drop > 0;) {
+        if (it->second.last_seen <= cutoff) {
+            it = map.erase(it);
+            drop--;
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::vector<Anomaly> AnomalyDetector::get(int64_t since_id, const std::string& type, size_t limit) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<Anomaly> result;
+    for (auto it = anomalies_.rbegin(); it != anomalies_.rend() && result.size() < limit; ++it) {
+        if (it->id <= since_id) break;
+        if (!type.empty() && it->type != type) continue;
+        result.push_back(*it);
+    }
+    return result;
+}
+
+int64_t AnomalyDetector::total() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return next_id_ - 1;
+}
+
+std::optional<Anomaly> AnomalyDetector::latest() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (anomalies_.empty()) return std::nullopt;
+    return anomalies_.back();
+}
+
+} // namespace mcp_logs
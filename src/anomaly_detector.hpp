@@ -0,0 +1,149 @@
+#pragma once
+
+#include "log_entry.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace mcp_logs {
+
+class LogStore;
+
+struct AnomalyOptions {
+    double bucket_seconds = 10.0;     // Rate resolution, on the received_at clock
+    double alpha = 0.1;               // EWMA weight of the newest bucket
+    double spike_sigma = 4.0;         // Spike when count > mean + sigma * stddev
+    int64_t min_spike_count = 20;     // Ignore "spikes" smaller than this per bucket
+    int warmup_buckets = 6;           // Buckets of history before a series can spike
+    double quiet_seconds = 60.0;      // Minimum silence before an instance is flagged
+    double min_quiet_rate = 1.0;      // Instances averaging fewer logs per bucket are never "quiet"
+    size_t max_series = 4096;         // (category, instance, verbosity) rate series kept
+    size_t max_instances = 1024;
+    size_t max_error_templates = 20000;
+    size_t max_anomalies = 500;       // Ring of detected anomalies
+};
+
+struct Anomaly {
+    int64_t id = 0;                   // Increasing, for paging with since_id
+    std::string type;                 // "spike", "new_error_template" or "quiet_instance"
+    double detected_at = 0.0;         // received_at clock
+    std::string category;
+    std::string instance_id;
+    std::string session_id;
+    Verbosity verbosity = Verbosity::Log;
+    double observed = 0.0;            // Logs in the bucket (spike) or seconds silent (quiet)
+    double expected = 0.0;            // Baseline logs per bucket, or expected gap in seconds
+    double score = 0.0;               // Standard deviations above the baseline (spike)
+    std::string detail;               // Human-readable summary or the error template
+    int64_t example_id = 0;           // Log that triggered it (0 for quiet instances)
+
+    nlohmann::json to_json() const;
+};
+
+// Online detector fed from LogStore::subscribe. Keeps an EWMA mean and
+// variance of the per-bucket rate of every (category, instance, verbosity)
+// series, a bounded set of error templates seen since startup and the
+// rate/last-seen time of every instance. Memory is fixed by the caps in
+// AnomalyOptions; nothing here touches SQLite.
+class AnomalyDetector {
+public:
+    explicit AnomalyDetector(LogStore& store, AnomalyOptions options = {});
+    ~AnomalyDetector();
+
+    AnomalyDetector(const AnomalyDetector&) = delete;
+    AnomalyDetector& operator=(const AnomalyDetector&) = delete;
+
+    // Called for every inserted log (normally via the store subscription)
+    void observe(const LogEntry& entry);
+
+    // Check for quiet instances as of `now`; also runs from observe()
+    void tick(double now);
+
+    // Call tick() every interval (0: bucket_seconds) from a background
+    // thread, so instances are flagged quiet even when nothing else logs.
+    // `clock` gives the received_at time; wall-clock seconds by default.
+    void start_ticking(std::chrono::milliseconds interval = std::chrono::milliseconds(0),
+                       std::function<double()> clock = nullptr);
+    void stop_ticking();
+
+    // Newest first. Empty type matches all.
+    std::vector<Anomaly> get(int64_t since_id, const std::string& type, size_t limit) const;
+
+    int64_t total() const;
+    std::optional<Anomaly> latest() const;
+
+private:
+    struct Ewma {
+        double mean = 0.0;
+        double var = 0.0;
+        int samples = 0;
+
+        void add(double x, double alpha);
+        double stddev() const;
+    };
+
+    // Count for the open bucket plus the EWMA of closed ones
+    struct BucketRate {
+        int64_t bucket = 0;
+        int64_t count = 0;
+        Ewma rate;
+
+        // Fold finished buckets (and empty ones in a gap) into the EWMA.
+        // Returns true when a new bucket was opened.
+        bool advance(int64_t to_bucket, double alpha);
+    };
+
+    struct Series {
+        std::string category;
+        std::string instance_id;
+        Verbosity verbosity = Verbosity::Log;
+        BucketRate rate;
+        bool flagged = false;         // Already reported a spike for the open bucket
+        double last_seen = 0.0;
+    };
+
+    struct Instance {
+        BucketRate rate;
+        std::string session_id;
+        bool quiet = false;           // Already reported; cleared by the next log
+        double last_seen = 0.0;
+    };
+
+    // (mutex_ must be held)
+    void observe_rate(const LogEntry& entry, int64_t bucket);
+    void observe_instance(const LogEntry& entry, int64_t bucket);
+    void observe_error_template(const LogEntry& entry);
+    void check_quiet(double now);
+    void record(Anomaly anomaly);
+    template <typename Map> void evict_oldest(Map& map);
+
+    AnomalyOptions options_;
+    mutable std::mutex mutex_;
+
+    std::unordered_map<std::string, Series> series_;
+    std::unordered_map<std::string, Instance> instances_;
+    std::unordered_set<uint64_t> error_templates_;
+    std::deque<uint64_t> error_template_order_;   // FIFO eviction
+
+    std::deque<Anomaly> anomalies_;
+    int64_t next_id_ = 1;
+    double last_quiet_check_ = 0.0;
+
+    // start_ticking() timer
+    std::thread ticker_;
+    std::mutex ticker_mutex_;
+    std::condition_variable ticker_wake_;
+    bool ticking_ = false;        // (ticker_mutex_)
+};
+
+} // namespace mcp_logs
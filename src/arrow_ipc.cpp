@@ -0,0 +1,540 @@
+#include "arrow_ipc.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace mcp_logs {
+
+namespace {
+
+// Minimal FlatBuffers encoder, enough for Arrow's Schema, Message and
+// Footer tables. Like the reference implementation it builds back to
+// front: children are finished before the tables that point at them, and
+// an Offset is an object's distance from the end of the buffer.
+class FlatBuilder {
+public:
+    using Offset = uint32_t;
+
+    template <typename T>
+    void push(T value) {
+        align(sizeof(T), sizeof(T));
+        prepend(&value, sizeof(T));
+    }
+
+    Offset create_string(std::string_view s) {
+        align(s.size() + 1, 4);
+        prepend("", 1);
+        prepend(s.data(), s.size());
+        push<uint32_t>(static_cast<uint32_t>(s.size()));
+        return size_;
+    }
+
+    // Vector of structs already laid out little-endian in `bytes`
+    Offset create_struct_vector(const std::string& bytes, size_t count, size_t alignment) {
+        align(bytes.size(), std::max<size_t>(alignment, 4));
+        prepend(bytes.data(), bytes.size());
+        push<uint32_t>(static_cast<uint32_t>(count));
+        return size_;
+    }
+
+    Offset create_offset_vector(const std::vector<Offset>& offsets) {
+        align(offsets.size() * 4, 4);
+        for (auto it = offsets.rbegin(); it != offsets.rend(); ++it) push_offset(*it);
+        push<uint32_t>(static_cast<uint32_t>(offsets.size()));
+        return size_;
+    }
+
+    void start_table() {
+        fields_.clear();
+        table_end_ = size_;
+    }
+
+    template <typename T>
+    void add_scalar(int slot, T value) {
+        push(value);
+        fields_.push_back({slot, size_});
+    }
+
+    void add_offset(int slot, Offset offset) {
+        push_offset(offset);
+        fields_.push_back({slot, size_});
+    }
+
+    Offset end_table() {
+        push<int32_t>(0);   // vtable soffset, patched below
+        Offset table = size_;
+
+        int slots = 0;
+        for (const auto& f : fields_) slots = std::max(slots, f.slot + 1);
+        std::vector<uint16_t> vtable(static_cast<size_t>(2 + slots), 0);
+        vtable[0] = static_cast<uint16_t>(vtable.size() * 2);
+        vtable[1] = static_cast<uint16_t>(table - table_end_);
+        for (const auto& f : fields_) vtable[static_cast<size_t>(2 + f.slot)] = static_cast<uint16_t>(table - f.offset);
+        for (auto it = vtable.rbegin(); it != vtable.rend(); ++it) push(*it);
+
+        int32_t soffset = static_cast<int32_t>(size_ - table);   // The vtable sits just before the table
+        std::memcpy(at(table), &soffset, sizeof(soffset));
+        fields_.clear();
+        return table;
+    }
+
+    // The finished buffer, root table first
+    std::string finish(Offset root) {
+        align(4, min_align_);
+        push_offset(root);
+        return std::string(reinterpret_cast<const char*>(at(size_)), size_);
+    }
+
+private:
+    struct Field {
+        int slot;
+        Offset offset;
+    };
+
+    uint8_t* at(Offset offset) { return buffer_.data() + buffer_.size() - offset; }
+
+    void push_offset(Offset target) {
+        align(4, 4);
+        uint32_t relative = size_ + 4 - target;   // Forward distance from the field to the target
+        prepend(&relative, 4);
+    }
+
+    // Zero-pad so that `length` more bytes end on an `alignment` boundary
+    void align(size_t length, size_t alignment) {
+        min_align_ = std::max(min_align_, alignment);
+        size_t padding = (alignment - ((size_ + length) % alignment)) % alignment;
+        static const char kZeros[8] = {};
+        prepend(kZeros, padding);
+    }
+
+    void prepend(const void* data, size_t length) {
+        if (size_ + length > buffer_.size()) {
+            std::vector<uint8_t> grown(std::max<size_t>({buffer_.size() * 2, size_ + length, 256}));
+            std::memcpy(grown.data() + grown.size() - size_, at(size_), size_);
+            buffer_.swap(grown);
+        }
+        size_ += static_cast<Offset>(length);
+        if (length) std::memcpy(at(size_), data, length);
+    }
+
+    std::vector<uint8_t> buffer_;
+    Offset size_ = 0;
+    size_t min_align_ = 1;
+    Offset table_end_ = 0;
+    std::vector<Field> fields_;
+};
+
+using Offset = FlatBuilder::Offset;
+
+// Values from Arrow's Schema.fbs, Message.fbs and File.fbs
+constexpr int16_t kMetadataV5 = 4;
+constexpr uint8_t kHeaderSchema = 1;
+constexpr uint8_t kHeaderDictionaryBatch = 2;
+constexpr uint8_t kHeaderRecordBatch = 3;
+constexpr uint8_t kTypeInt = 2;
+constexpr uint8_t kTypeUtf8 = 5;
+constexpr uint8_t kTypeTimestamp = 10;
+constexpr int16_t kTimeUnitMicrosecond = 2;
+constexpr int8_t kCompressionZstd = 1;
+
+// "ARROW1"; the file starts with it padded to 8 bytes and ends with it bare
+constexpr char kMagic[8] = {'A', 'R', 'R', 'O', 'W', '1', '\0', '\0'};
+constexpr size_t kMagicLength = 6;
+constexpr uint32_t kContinuation = 0xFFFFFFFF;
+
+enum class ColumnType { Int64, Int32, Timestamp, Utf8, Dictionary };
+
+struct FieldSpec {
+    const char* name;
+    ColumnType type;
+    bool nullable;
+    int dictionary;   // Dictionary id, for ColumnType::Dictionary
+};
+
+// In ArrowLogWriter::add order
+constexpr FieldSpec kFields[] = {
+    {"id", ColumnType::Int64, false, -1},
+    {"source", ColumnType::Dictionary, false, 0},
+    {"category", ColumnType::Dictionary, false, 1},
+    {"verbosity", ColumnType::Dictionary, false, 2},
+    {"message", ColumnType::Utf8, false, -1},
+    {"timestamp", ColumnType::Timestamp, false, -1},
+    {"frame", ColumnType::Int64, true, -1},
+    {"file", ColumnType::Dictionary, true, 3},
+    {"line", ColumnType::Int32, true, -1},
+    {"received_at", ColumnType::Timestamp, false, -1},
+    {"session_id", ColumnType::Dictionary, false, 4},
+    {"instance_id", ColumnType::Dictionary, false, 5},
+    {"seq", ColumnType::Int64, true, -1},
+    {"attrs", ColumnType::Utf8, true, -1},
+    {"template_id", ColumnType::Int64, false, -1},
+    {"norm_time", ColumnType::Timestamp, false, -1},
+};
+constexpr size_t kDictionaries = 6;
+
+void put_i64(std::string& out, int64_t value) {
+    char bytes[8];
+    std::memcpy(bytes, &value, 8);
+    out.append(bytes, 8);
+}
+
+void pad8(std::string& out) {
+    out.append((8 - out.size() % 8) % 8, '\0');
+}
+
+Offset int_type(FlatBuilder& b, int32_t bit_width) {
+    b.start_table();
+    b.add_scalar<int32_t>(0, bit_width);
+    b.add_scalar<uint8_t>(1, 1);   // is_signed
+    return b.end_table();
+}
+
+// BodyCompression{codec: ZSTD, method: BUFFER}, or 0 for none
+Offset body_compression(FlatBuilder& b, bool compressed) {
+    if (!compressed) return 0;
+    b.start_table();
+    b.add_scalar<int8_t>(0, kCompressionZstd);
+    return b.end_table();
+}
+
+Offset record_batch(FlatBuilder& b, int64_t length, const std::string& nodes, size_t node_count,
+                    const std::string& buffers, size_t buffer_count, bool compressed) {
+    Offset nodes_vec = b.create_struct_vector(nodes, node_count, 8);
+    Offset buffers_vec = b.create_struct_vector(buffers, buffer_count, 8);
+    Offset compression = body_compression(b, compressed);
+    b.start_table();
+    b.add_scalar<int64_t>(0, length);
+    b.add_offset(1, nodes_vec);
+    b.add_offset(2, buffers_vec);
+    if (compression) b.add_offset(3, compression);
+    return b.end_table();
+}
+
+std::string message(FlatBuilder& b, uint8_t header_type, Offset header, int64_t body_length) {
+    b.start_table();
+    b.add_scalar<int64_t>(3, body_length);
+    b.add_offset(2, header);
+    b.add_scalar<int16_t>(0, kMetadataV5);
+    b.add_scalar<uint8_t>(1, header_type);
+    return b.finish(b.end_table());
+}
+
+// Schema table, for the schema message and again in the footer
+Offset build_schema(FlatBuilder& b) {
+    std::vector<Offset> fields;
+    for (const auto& column : kFields) {
+        Offset name = b.create_string(column.name);
+        Offset children = b.create_offset_vector({});
+        Offset type;
+        uint8_t type_id;
+        switch (column.type) {
+            case ColumnType::Int64:
+                type = int_type(b, 64);
+                type_id = kTypeInt;
+                break;
+            case ColumnType::Int32:
+                type = int_type(b, 32);
+                type_id = kTypeInt;
+                break;
+            case ColumnType::Timestamp: {
+                Offset timezone = b.create_string("UTC");
+                b.start_table();
+                b.add_offset(1, timezone);
+                b.add_scalar<int16_t>(0, kTimeUnitMicrosecond);
+                type = b.end_table();
+                type_id = kTypeTimestamp;
+                break;
+            }
+            default:
+                b.start_table();
+                type = b.end_table();
+                type_id = kTypeUtf8;
+                break;
+        }
+        Offset encoding_table = 0;
+        if (column.type == ColumnType::Dictionary) {
+            Offset index_type = int_type(b, 32);
+            b.start_table();
+            b.add_scalar<int64_t>(0, column.dictionary);
+            b.add_offset(1, index_type);
+            encoding_table = b.end_table();
+        }
+
+        b.start_table();
+        b.add_offset(0, name);
+        b.add_offset(3, type);
+        if (encoding_table) b.add_offset(4, encoding_table);
+        b.add_offset(5, children);
+        b.add_scalar<uint8_t>(1, column.nullable ? 1 : 0);
+        b.add_scalar<uint8_t>(2, type_id);
+        fields.push_back(b.end_table());
+    }
+    Offset fields_vec = b.create_offset_vector(fields);
+    b.start_table();
+    b.add_offset(1, fields_vec);
+    return b.end_table();
+}
+
+} // namespace
+
+struct ArrowLogWriter::Column {
+    ColumnType type;
+    int dictionary;                // Index into dictionaries_, for ColumnType::Dictionary
+
+    std::string validity;          // One bit per row, set when valid
+    int64_t nulls = 0;
+    std::string values;            // Fixed-width values, or Utf8 bytes
+    std::string offsets;           // Utf8: int32 offset per row, plus one
+
+    Column(ColumnType column_type, int dictionary_index) : type(column_type), dictionary(dictionary_index) { clear(); }
+
+    void start_row(size_t row, bool valid) {
+        if (row % 8 == 0) validity += '\0';
+        if (valid) {
+            validity.back() = static_cast<char>(validity.back() | (1 << (row % 8)));
+        } else {
+            nulls++;
+        }
+    }
+
+    template <typename T>
+    void append(size_t row, T value, bool valid = true) {
+        start_row(row, valid);
+        values.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void append_string(size_t row, std::string_view s, bool valid = true) {
+        start_row(row, valid);
+        values.append(s);
+        int32_t end = static_cast<int32_t>(values.size());
+        offsets.append(reinterpret_cast<const char*>(&end), 4);
+    }
+
+    void clear() {
+        validity.clear();
+        nulls = 0;
+        values.clear();
+        offsets.clear();
+        if (type == ColumnType::Utf8) offsets.append(4, '\0');
+    }
+};
+
+struct ArrowLogWriter::Dictionary {
+    std::unordered_map<std::string, int32_t> ids;
+    std::vector<const std::string*> values;   // Keys of ids, in id order
+    size_t written = 0;                       // Values already in the file
+    bool defined = false;                     // First (non-delta) batch written
+
+    int32_t id_of(const std::string& value) {
+        auto [it, inserted] = ids.try_emplace(value, static_cast<int32_t>(values.size()));
+        if (inserted) values.push_back(&it->first);
+        return it->second;
+    }
+};
+
+ArrowLogWriter::ArrowLogWriter(std::ostream& out, ContentEncoding encoding, size_t batch_rows)
+    : out_(out)
+    , batch_rows_(std::max<size_t>(batch_rows, 1))
+{
+    if (encoding == ContentEncoding::Zstd) {
+        compressor_ = std::make_unique<Compressor>(encoding);   // Throws without zstd support
+    } else if (encoding != ContentEncoding::Identity) {
+        throw std::runtime_error(std::string("Arrow IPC can't use ") + encoding_name(encoding) + " compression");
+    }
+
+    for (const auto& field : kFields) columns_.emplace_back(field.type, field.dictionary);
+    dictionaries_.resize(kDictionaries);
+
+    // File magic, then the schema message
+    write_bytes(kMagic, sizeof(kMagic));
+
+    FlatBuilder b;
+    Offset schema = build_schema(b);
+    write_message(message(b, kHeaderSchema, schema, 0), "");
+}
+
+ArrowLogWriter::~ArrowLogWriter() = default;
+
+void ArrowLogWriter::add(const LogEntry& entry) {
+    if (finished_) throw std::runtime_error("ArrowLogWriter: add after finish");
+
+    size_t row = pending_;
+    auto dict = [&](size_t column, const std::string& value) {
+        Column& c = columns_[column];
+        c.append<int32_t>(row, dictionaries_[static_cast<size_t>(c.dictionary)].id_of(value));
+    };
+    auto micros = [](double seconds) { return static_cast<int64_t>(std::llround(seconds * 1e6)); };
+
+    columns_[0].append<int64_t>(row, entry.id);
+    dict(1, entry.source);
+    dict(2, entry.category);
+    dict(3, verbosity_to_string(entry.verbosity));
+    columns_[4].append_string(row, entry.message);
+    columns_[5].append<int64_t>(row, micros(entry.timestamp));
+    columns_[6].append<int64_t>(row, entry.frame.value_or(0), entry.frame.has_value());
+    if (entry.file) {
+        dict(7, *entry.file);
+    } else {
+        columns_[7].append<int32_t>(row, 0, false);
+    }
+    columns_[8].append<int32_t>(row, entry.line.value_or(0), entry.line.has_value());
+    columns_[9].append<int64_t>(row, micros(entry.received_at));
+    dict(10, entry.session_id);
+    dict(11, entry.instance_id);
+    columns_[12].append<int64_t>(row, entry.seq.value_or(0), entry.seq.has_value());
+    columns_[13].append_string(row, entry.attrs ? *entry.attrs : std::string_view(), entry.attrs.has_value());
+    columns_[14].append<int64_t>(row, entry.template_id);
+    columns_[15].append<int64_t>(row, micros(entry.norm_time));
+
+    pending_++;
+    pending_bytes_ += entry.message.size();
+    rows_++;
+    if (pending_ >= batch_rows_ || pending_bytes_ >= kMaxBatchBytes) write_batch();
+}
+
+void ArrowLogWriter::finish() {
+    if (finished_) return;
+    if (pending_) write_batch();
+    finished_ = true;
+
+    uint32_t end_of_stream[2] = {kContinuation, 0};
+    write_bytes(reinterpret_cast<const char*>(end_of_stream), sizeof(end_of_stream));
+
+    // Footer: the schema again, and where every message starts
+    FlatBuilder b;
+    auto blocks = [&b](const std::vector<Block>& list) {
+        std::string bytes;
+        for (const auto& block : list) {
+            put_i64(bytes, block.offset);
+            bytes.append(reinterpret_cast<const char*>(&block.metadata_length), 4);
+            bytes.append(4, '\0');
+            put_i64(bytes, block.body_length);
+        }
+        return b.create_struct_vector(bytes, list.size(), 8);
+    };
+    Offset dictionaries = blocks(dictionary_blocks_);
+    Offset batches = blocks(batch_blocks_);
+    Offset schema = build_schema(b);
+    b.start_table();
+    b.add_offset(1, schema);
+    b.add_offset(2, dictionaries);
+    b.add_offset(3, batches);
+    b.add_scalar<int16_t>(0, kMetadataV5);
+    std::string footer = b.finish(b.end_table());
+
+    write_bytes(footer.data(), footer.size());
+    uint32_t footer_length = static_cast<uint32_t>(footer.size());
+    write_bytes(reinterpret_cast<const char*>(&footer_length), 4);
+    write_bytes(kMagic, kMagicLength);
+    out_.flush();
+    if (!out_) throw std::runtime_error("Failed to write Arrow file");
+}
+
+void ArrowLogWriter::write_batch() {
+    bool compressed = compressor_ != nullptr;
+    auto add_buffer = [this](std::string& body, std::string& buffers, std::string_view data) {
+        std::string encoded = encode_buffer(data);
+        put_i64(buffers, static_cast<int64_t>(body.size()));
+        put_i64(buffers, static_cast<int64_t>(encoded.size()));
+        body += encoded;
+        pad8(body);
+    };
+
+    // New dictionary values first: a batch may only use ids already defined
+    for (size_t id = 0; id < dictionaries_.size(); id++) {
+        Dictionary& d = dictionaries_[id];
+        if (d.defined && d.written == d.values.size()) continue;
+
+        std::string offsets(4, '\0');
+        std::string data;
+        for (size_t i = d.written; i < d.values.size(); i++) {
+            data += *d.values[i];
+            int32_t end = static_cast<int32_t>(data.size());
+            offsets.append(reinterpret_cast<const char*>(&end), 4);
+        }
+        int64_t count = static_cast<int64_t>(d.values.size() - d.written);
+
+        std::string body, buffers, nodes;
+        put_i64(nodes, count);
+        put_i64(nodes, 0);
+        add_buffer(body, buffers, {});
+        add_buffer(body, buffers, offsets);
+        add_buffer(body, buffers, data);
+
+        FlatBuilder b;
+        Offset batch = record_batch(b, count, nodes, 1, buffers, 3, compressed);
+        b.start_table();
+        b.add_scalar<int64_t>(0, static_cast<int64_t>(id));
+        b.add_offset(1, batch);
+        if (d.defined) b.add_scalar<uint8_t>(2, 1);   // isDelta: appends to the values so far
+        Offset header = b.end_table();
+        dictionary_blocks_.push_back(write_message(message(b, kHeaderDictionaryBatch, header,
+                                                           static_cast<int64_t>(body.size())), body));
+        d.written = d.values.size();
+        d.defined = true;
+    }
+
+    std::string body, buffers, nodes;
+    size_t buffer_count = 0;
+    for (auto& column : columns_) {
+        put_i64(nodes, static_cast<int64_t>(pending_));
+        put_i64(nodes, column.nulls);
+        add_buffer(body, buffers, column.nulls ? std::string_view(column.validity) : std::string_view());
+        if (column.type == ColumnType::Utf8) {
+            add_buffer(body, buffers, column.offsets);
+            buffer_count++;
+        }
+        add_buffer(body, buffers, column.values);
+        buffer_count += 2;
+        column.clear();
+    }
+
+    FlatBuilder b;
+    Offset batch = record_batch(b, static_cast<int64_t>(pending_), nodes, columns_.size(), buffers, buffer_count,
+                                compressed);
+    batch_blocks_.push_back(write_message(message(b, kHeaderRecordBatch, batch, static_cast<int64_t>(body.size())),
+                                          body));
+    pending_ = 0;
+    pending_bytes_ = 0;
+}
+
+// Encapsulated message: continuation marker, metadata length, flatbuffer
+// padded to 8 bytes, then the body
+ArrowLogWriter::Block ArrowLogWriter::write_message(const std::string& metadata, const std::string& body) {
+    Block block{static_cast<int64_t>(position_), 0, static_cast<int64_t>(body.size())};
+    std::string padded = metadata;
+    pad8(padded);
+    uint32_t prefix[2] = {kContinuation, static_cast<uint32_t>(padded.size())};
+    write_bytes(reinterpret_cast<const char*>(prefix), sizeof(prefix));
+    write_bytes(padded.data(), padded.size());
+    write_bytes(body.data(), body.size());
+    block.metadata_length = static_cast<int32_t>(sizeof(prefix) + padded.size());
+    return block;
+}
+
+void ArrowLogWriter::write_bytes(const char* data, size_t size) {
+    out_.write(data, static_cast<std::streamsize>(size));
+    if (!out_) throw std::runtime_error("Failed to write Arrow file");
+    position_ += size;
+}
+
+// Compressed buffers are prefixed with their uncompressed length; -1 marks
+// one stored as-is because compression didn't shrink it. Empty buffers stay
+// empty.
+std::string ArrowLogWriter::encode_buffer(std::string_view data) {
+    if (!compressor_ || data.empty()) return std::string(data);
+    std::string out;
+    std::string compressed = compressor_->compress(data);
+    if (compressed.size() < data.size()) {
+        put_i64(out, static_cast<int64_t>(data.size()));
+        out += compressed;
+    } else {
+        put_i64(out, -1);
+        out.append(data);
+    }
+    return out;
+}
+
+} // namespace mcp_logs
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "compression.hpp"
+#include "log_entry.hpp"
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mcp_logs {
+
+// Writes log rows as an Apache Arrow IPC file (Feather v2), readable by
+// pyarrow.ipc.open_file, pandas.read_feather, polars.read_ipc and DuckDB.
+// Self-contained: the flatbuffer metadata is encoded here, so there is no
+// Arrow dependency. Columns:
+//
+//   id int64, source, category, verbosity dictionary<int32, utf8>,
+//   message utf8, timestamp timestamp[us, UTC], frame int64 (nullable),
+//   file dictionary<int32, utf8> (nullable), line int32 (nullable),
+//   received_at timestamp[us, UTC], session_id, instance_id dictionary<int32, utf8>,
+//   seq int64 (nullable), attrs utf8 (nullable, JSON text), template_id int64,
+//   norm_time timestamp[us, UTC]
+//
+// Rows are buffered and written as a record batch every batch_rows rows (or
+// kMaxBatchBytes of message text), so memory stays bounded however many
+// rows pass through. Dictionaries grow as new values appear: each batch is
+// preceded by delta dictionary batches holding only the new values. With
+// ContentEncoding::Zstd (zstd builds) every column buffer is compressed.
+class ArrowLogWriter {
+public:
+    static constexpr size_t kDefaultBatchRows = 65536;
+    static constexpr size_t kMaxBatchBytes = 64 << 20;
+
+    // Writes the file header and schema. encoding is Identity or Zstd; throws
+    // std::runtime_error for anything else or if out fails.
+    ArrowLogWriter(std::ostream& out, ContentEncoding encoding = ContentEncoding::Identity,
+                   size_t batch_rows = kDefaultBatchRows);
+    ~ArrowLogWriter();
+
+    ArrowLogWriter(const ArrowLogWriter&) = delete;
+    ArrowLogWriter& operator=(const ArrowLogWriter&) = delete;
+
+    void add(const LogEntry& entry);
+
+    // Write any buffered rows, then the footer. The file is unreadable
+    // until this is called.
+    void finish();
+
+    int64_t rows() const { return rows_; }
+    int64_t batches() const { return static_cast<int64_t>(batch_blocks_.size()); }
+    uint64_t bytes_written() const { return position_; }
+
+private:
+    // Offset, metadata size and body size of one message, for the footer
+    struct Block {
+        int64_t offset;
+        int32_t metadata_length;
+        int64_t body_length;
+    };
+
+    struct Column;
+    struct Dictionary;
+
+    void write_batch();
+    Block write_message(const std::string& metadata, const std::string& body);
+    void write_bytes(const char* data, size_t size);
+    std::string encode_buffer(std::string_view data);
+
+    std::ostream& out_;
+    size_t batch_rows_;
+    std::unique_ptr<Compressor> compressor_;   // Null: uncompressed buffers
+
+    std::vector<Column> columns_;
+    std::vector<Dictionary> dictionaries_;
+    size_t pending_ = 0;                       // Rows buffered for the next batch
+    size_t pending_bytes_ = 0;
+
+    uint64_t position_ = 0;
+    int64_t rows_ = 0;
+    std::vector<Block> dictionary_blocks_;
+    std::vector<Block> batch_blocks_;
+    bool finished_ = false;
+};
+
+} // namespace mcp_logs
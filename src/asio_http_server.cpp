@@ -0,0 +1,697 @@
+#include "asio_http_server.hpp"
+#include "alloc_tracker.hpp"
+#include "cpu_profiler.hpp"
+#include "server_log.hpp"
+#include "metrics.hpp"
+#include "thread_placement.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+namespace mcp_logs {
+
+namespace {
+
+constexpr size_t kDefaultIoThreads = 2;
+
+// Closes connections that stall mid-request or sit idle between requests
+constexpr auto kRequestTimeout = std::chrono::seconds(30);
+
+// How long stop() lets connections close cleanly before abandoning them
+constexpr auto kStopGrace = std::chrono::seconds(1);
+
+const char* kCorsHeaders =
+    "Access-Control-Allow-Origin: *\r\n"
+    "Access-Control-Allow-Methods: POST, OPTIONS\r\n"
+    "Access-Control-Allow-Headers: Content-Type\r\n";
+
+bool iequals(const std::string& a, const std::string& b) {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+           });
+}
+
+std::string trim(const std::string& s) {
+    size_t start = s.find_first_not_of(" \t");
+    if (start == std::string::npos) return "";
+    size_t end = s.find_last_not_of(" \t");
+    return s.substr(start, end - start + 1);
+}
+
+// Percent-decoding for query strings ('+' is a space)
+std::string url_decode(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '+') {
+            out += ' ';
+        } else if (s[i] == '%' && i + 2 < s.size() &&
+                   std::isxdigit(static_cast<unsigned char>(s[i + 1])) &&
+                   std::isxdigit(static_cast<unsigned char>(s[i + 2]))) {
+            out += static_cast<char>(std::stoi(s.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+std::string query_param(const std::string& query, const std::string& name) {
+    size_t pos = 0;
+    while (pos <= query.size()) {
+        size_t end = query.find('&', pos);
+        if (end == std::string::npos) end = query.size();
+        std::string pair = query.substr(pos, end - pos);
+        size_t eq = pair.find('=');
+        if (url_decode(pair.substr(0, eq)) == name) {
+            return eq == std::string::npos ? "" : url_decode(pair.substr(eq + 1));
+        }
+        pos = end + 1;
+    }
+    return "";
+}
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string query;                 // Raw, without the '?'
+    int minor_version = 1;             // HTTP/1.x
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    const std::string* header(const std::string& name) const {
+        for (const auto& [key, value] : headers) {
+            if (iequals(key, name)) return &value;
+        }
+        return nullptr;
+    }
+};
+
+// Parse the request line and headers (everything up to the blank line)
+bool parse_request(const std::string& head, HttpRequest& req) {
+    std::istringstream in(head);
+    std::string line;
+    if (!std::getline(in, line)) return false;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.rfind(' ');
+    if (sp1 == std::string::npos || sp2 == sp1) return false;
+
+    req.method = line.substr(0, sp1);
+    std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    std::string version = line.substr(sp2 + 1);
+    if (version == "HTTP/1.1") {
+        req.minor_version = 1;
+    } else if (version == "HTTP/1.0") {
+        req.minor_version = 0;
+    } else {
+        return false;
+    }
+
+    size_t q = target.find('?');
+    req.path = target.substr(0, q);
+    if (q != std::string::npos) req.query = target.substr(q + 1);
+    if (req.path.empty() || req.path[0] != '/') return false;
+
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) break;
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) return false;
+        req.headers.emplace_back(trim(line.substr(0, colon)), trim(line.substr(colon + 1)));
+    }
+    return true;
+}
+
+const char* status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 409: return "Conflict";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 501: return "Not Implemented";
+        default:  return "Internal Server Error";
+    }
+}
+
+// Frame `data` as one chunk of a chunked response body
+void append_chunk(std::string& out, const std::string& data) {
+    char size[24];
+    std::snprintf(size, sizeof(size), "%zx\r\n", data.size());
+    out += size;
+    out += data;
+    out += "\r\n";
+}
+
+} // namespace
+
+// One client connection. Everything runs on the socket's strand, so the
+// members need no locking; pending async operations hold a shared_ptr.
+// After GET / the connection turns into an SSE stream: a parked read
+// detects disconnects, the server's wake callback posts flush(), and the
+// timer sends keep-alive pings. HTTP/1.0 clients get the stream without
+// chunked framing, ended by closing the connection.
+template <typename Stream>
+class AsioHttpServer::Connection : public std::enable_shared_from_this<Connection<Stream>> {
+public:
+    template <typename... Args>
+    explicit Connection(AsioHttpServer& server, Args&&... args)
+        : server_(server)
+        , stream_(std::forward<Args>(args)...)
+        , buffer_(kMaxHeaderBytes)
+        , timer_(stream_.get_executor())
+    {
+        asio::error_code ec;
+        auto endpoint = stream_.lowest_layer().remote_endpoint(ec);
+        if (!ec) {
+            remote_address_ = endpoint.address().to_string();
+            remote_ = remote_address_ + ":" + std::to_string(endpoint.port());
+        }
+    }
+
+    ~Connection() {
+        // Still registered only if the io_context was torn down under us
+        if (client_) server_.remove_sse_client(client_);
+        server_.untrack_connection(id_);
+    }
+
+    void start() {
+        // stop() closes the connection on its strand
+        std::weak_ptr<Connection> weak = this->shared_from_this();
+        auto executor = stream_.get_executor();
+        id_ = server_.track_connection([weak, executor] {
+            asio::post(executor, [weak] {
+                if (auto self = weak.lock()) self->close();
+            });
+        });
+        arm_deadline();
+        begin(stream_);
+    }
+
+private:
+    void begin(asio::ip::tcp::socket&) {
+        read_request();
+    }
+
+    void begin(asio::ssl::stream<asio::ip::tcp::socket>& stream) {
+        auto self = this->shared_from_this();
+        stream.async_handshake(asio::ssl::stream_base::server, [this, self](const asio::error_code& ec) {
+            if (ec) {
+                close();   // Plain HTTP on the TLS port, scanners, ...
+                return;
+            }
+            read_request();
+        });
+    }
+
+    void arm_deadline() {
+        timer_.expires_after(kRequestTimeout);
+        auto self = this->shared_from_this();
+        timer_.async_wait([this, self](const asio::error_code& ec) {
+            if (ec == asio::error::operation_aborted || closed_) return;
+            if (timer_.expiry() > std::chrono::steady_clock::now()) return;   // Re-armed meanwhile
+            close();
+        });
+    }
+
+    void disarm_deadline() {
+        timer_.expires_at(std::chrono::steady_clock::time_point::max());
+    }
+
+    void read_request() {
+        auto self = this->shared_from_this();
+        asio::async_read_until(stream_, buffer_, "\r\n\r\n",
+            [this, self](const asio::error_code& ec, size_t n) {
+                if (ec == asio::error::not_found) {
+                    keep_alive_ = false;
+                    respond(431, "", "");
+                    return;
+                }
+                if (ec) {
+                    close();
+                    return;
+                }
+
+                auto begin = asio::buffers_begin(buffer_.data());
+                std::string head(begin, begin + static_cast<std::ptrdiff_t>(n));
+                buffer_.consume(n);
+
+                request_ = HttpRequest();
+                if (!parse_request(head, request_)) {
+                    keep_alive_ = false;
+                    respond(400, "", "");
+                    return;
+                }
+
+                const std::string* connection = request_.header("Connection");
+                keep_alive_ = request_.minor_version == 1
+                    ? !(connection && iequals(*connection, "close"))
+                    : (connection && iequals(*connection, "keep-alive"));
+
+                // MCP clients send Content-Length; chunked uploads aren't supported
+                if (request_.header("Transfer-Encoding")) {
+                    keep_alive_ = false;
+                    respond(411, "", "");
+                    return;
+                }
+
+                size_t length = 0;
+                if (const std::string* value = request_.header("Content-Length")) {
+                    if (value->empty() || value->find_first_not_of("0123456789") != std::string::npos ||
+                        value->size() > 12) {
+                        keep_alive_ = false;
+                        respond(400, "", "");
+                        return;
+                    }
+                    length = static_cast<size_t>(std::stoull(*value));
+                }
+                if (length > kMaxBodyBytes) {
+                    keep_alive_ = false;
+                    respond(413, "", "");
+                    return;
+                }
+                read_body(length);
+            });
+    }
+
+    void read_body(size_t length) {
+        // Part of the body may have arrived with the headers
+        size_t have = std::min(length, buffer_.size());
+        auto begin = asio::buffers_begin(buffer_.data());
+        body_.assign(begin, begin + static_cast<std::ptrdiff_t>(have));
+        buffer_.consume(have);
+        if (have == length) {
+            route();
+            return;
+        }
+
+        body_.resize(length);
+        auto self = this->shared_from_this();
+        asio::async_read(stream_, asio::buffer(&body_[have], length - have),
+            [this, self](const asio::error_code& ec, size_t) {
+                if (ec) {
+                    close();
+                    return;
+                }
+                route();
+            });
+    }
+
+    void route() {
+        disarm_deadline();
+        const std::string& method = request_.method;
+        const std::string& path = request_.path;
+
+        if (method == "GET" && path == "/health") {
+            respond(200, "application/json", R"({"status":"ok"})");
+        } else if (method == "GET" && path == "/metrics") {
+            ThreadPlacement::publish_metrics();
+            LockProfiler::publish_metrics();
+            AllocTracker::publish_metrics();
+            respond(200, "text/plain; version=0.0.4", Metrics::render());
+        } else if (method == "GET" && path == "/debug/profile") {
+            profile();
+        } else if (method == "GET" && path == "/") {
+            start_sse();
+        } else if (method == "POST" && path == "/messages") {
+            auto result = server_.accept_message(query_param(request_.query, "session_id"), body_);
+            respond(result.status, "application/json", result.body, kCorsHeaders);
+        } else if (method == "OPTIONS" && path == "/messages") {
+            respond(204, "", "", kCorsHeaders);
+        } else {
+            respond(404, "", "");
+        }
+    }
+
+    void respond(int status, const std::string& content_type, std::string body,
+                 const char* extra_headers = "") {
+        if (status >= 400) {
+            // Log 404s and other errors
+            std::string msg = std::to_string(status) + " " + request_.method + " " + request_.path;
+            if (!request_.query.empty()) msg += "?" + request_.query;
+            ServerLog::log("HTTP", msg + " from " + remote_);
+        }
+
+        const std::string* accept = request_.header("Accept-Encoding");
+        ContentEncoding encoding = server_.encode_body(body, accept ? *accept : "", compressor_);
+
+        out_ = "HTTP/1.1 " + std::to_string(status) + " " + status_text(status) + "\r\n";
+        if (!content_type.empty()) out_ += "Content-Type: " + content_type + "\r\n";
+        if (encoding != ContentEncoding::Identity) {
+            out_ += std::string("Content-Encoding: ") + encoding_name(encoding) + "\r\n";
+        }
+        if (!content_type.empty() && server_.compression_enabled()) out_ += "Vary: Accept-Encoding\r\n";
+        if (status != 204) out_ += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        out_ += extra_headers;
+        out_ += keep_alive_ ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+        out_ += body;
+
+        auto self = this->shared_from_this();
+        asio::async_write(stream_, asio::buffer(out_), [this, self](const asio::error_code& ec, size_t) {
+            out_.clear();
+            if (ec || !keep_alive_) {
+                close();
+                return;
+            }
+            arm_deadline();
+            read_request();
+        });
+    }
+
+    // The profile blocks for its duration, so it runs on the server's
+    // profile thread and the response is posted back to this strand
+    void profile() {
+        auto self = this->shared_from_this();
+        auto executor = stream_.get_executor();
+        std::string seconds = query_param(request_.query, "seconds");
+        std::string hz = query_param(request_.query, "hz");
+        bool started = server_.run_profile([self, executor, address = remote_address_, seconds, hz] {
+            auto result = self->server_.debug_profile(address, seconds, hz);
+            asio::post(executor, [self, result = std::move(result)]() mutable {
+                if (!self->closed_) self->respond(result.status, "text/plain; charset=utf-8", std::move(result.body));
+            });
+        });
+        if (!started) respond(409, "text/plain; charset=utf-8", "A profile is already running\n");
+    }
+
+    void start_sse() {
+        std::string session_id = server_.generate_session_id();
+        ServerLog::log("HTTP", "SSE client connected: " + session_id);
+        ServerLog::log("HTTP", "Client address: " + remote_);
+        for (const auto& header : request_.headers) {
+            ServerLog::log("HTTP", "  " + header.first + ": " + header.second);
+        }
+
+        // Queued events reach us as a flush() posted to this strand
+        std::weak_ptr<Connection> weak = this->shared_from_this();
+        auto executor = stream_.get_executor();
+        client_ = server_.add_sse_client(session_id, [weak, executor] {
+            asio::post(executor, [weak] {
+                if (auto self = weak.lock()) self->flush();
+            });
+        });
+
+        // The stream gets its own compression context, flushed after every
+        // event so nothing waits in the compressor
+        const std::string* accept = request_.header("Accept-Encoding");
+        ContentEncoding encoding = server_.stream_encoding(accept ? *accept : "");
+        if (encoding == ContentEncoding::Identity) {
+            compressor_.reset();
+        } else if (!compressor_ || compressor_->encoding() != encoding) {
+            compressor_ = std::make_unique<Compressor>(encoding);
+        }
+
+        // HTTP/1.0 has no chunked encoding: the stream runs until we close it
+        chunked_ = request_.minor_version == 1;
+        out_ = "HTTP/1.1 200 OK\r\n"
+               "Content-Type: text/event-stream\r\n"
+               "Cache-Control: no-cache\r\n"
+               "Access-Control-Allow-Origin: *\r\n";
+        if (compressor_) {
+            out_ += std::string("Content-Encoding: ") + encoding_name(encoding) + "\r\n"
+                    "Vary: Accept-Encoding\r\n";
+        }
+        out_ += chunked_ ? "Connection: keep-alive\r\nTransfer-Encoding: chunked\r\n\r\n"
+                         : "Connection: close\r\n\r\n";
+
+        // Send initial endpoint event per MCP spec
+        append_event(endpoint_event(session_id));
+        ServerLog::log("HTTP", "Sent endpoint event, streaming: " + session_id);
+
+        last_write_ = std::chrono::steady_clock::now();
+        flush();
+        wait_for_disconnect();
+        schedule_ping();
+    }
+
+    // Write everything queued for the stream unless a write is in flight;
+    // its completion calls back here
+    void flush() {
+        if (closed_ || writing_ || !client_) return;
+        AllocScope alloc_scope(AllocSubsystem::Sse);
+        for (const auto& event : server_.take_sse_events(*client_)) {
+            append_event(event);
+        }
+        if (out_.empty()) return;
+
+        writing_ = true;
+        auto self = this->shared_from_this();
+        asio::async_write(stream_, asio::buffer(out_), [this, self](const asio::error_code& ec, size_t) {
+            writing_ = false;
+            out_.clear();
+            if (ec) {
+                close();   // Connection lost
+                return;
+            }
+            last_write_ = std::chrono::steady_clock::now();
+            flush();
+        });
+    }
+
+    // Frame one SSE event (compressed and flushed if negotiated) into out_
+    void append_event(const std::string& event) {
+        std::string data = compressor_ ? server_.encode_stream(*compressor_, event) : event;
+        if (chunked_) {
+            append_chunk(out_, data);
+        } else {
+            out_ += data;
+        }
+    }
+
+    // SSE clients send nothing after the request; a completed read means
+    // they hung up
+    void wait_for_disconnect() {
+        auto self = this->shared_from_this();
+        stream_.async_read_some(asio::buffer(discard_), [this, self](const asio::error_code& ec, size_t) {
+            if (ec) {
+                close();
+                return;
+            }
+            wait_for_disconnect();
+        });
+    }
+
+    // SSE comment as a keep-alive ping after 15s of silence, for remote
+    // connections
+    void schedule_ping() {
+        auto now = std::chrono::steady_clock::now();
+        timer_.expires_at(std::max(last_write_ + kPingInterval, now + std::chrono::seconds(1)));
+        auto self = this->shared_from_this();
+        timer_.async_wait([this, self](const asio::error_code& ec) {
+            if (ec || closed_) return;
+            if (!writing_ && std::chrono::steady_clock::now() - last_write_ >= kPingInterval) {
+                append_event(": ping\n\n");
+                flush();
+            }
+            schedule_ping();
+        });
+    }
+
+    void close() {
+        if (closed_) return;
+        closed_ = true;
+        timer_.cancel();
+        server_.untrack_connection(id_);
+
+        if (client_) {
+            ServerLog::log("HTTP", "SSE client disconnected: " + client_->session_id);
+            server_.remove_sse_client(client_);
+            client_.reset();
+        }
+
+        asio::error_code ec;
+        stream_.lowest_layer().shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+        stream_.lowest_layer().close(ec);
+    }
+
+    AsioHttpServer& server_;
+    uint64_t id_ = 0;                  // track_connection() handle
+    Stream stream_;
+    asio::streambuf buffer_;           // Request head, bounded by kMaxHeaderBytes
+    asio::steady_timer timer_;         // Request deadline, then SSE pings
+    std::string remote_;               // address:port, for logs
+    std::string remote_address_;
+
+    HttpRequest request_;
+    std::string body_;
+    std::string out_;                  // Bytes being written; untouched while writing_
+    bool keep_alive_ = true;
+    std::unique_ptr<Compressor> compressor_;   // Reused for every response on this connection
+
+    std::shared_ptr<SseClient> client_;
+    bool chunked_ = true;              // SSE framing: chunks (HTTP/1.1) or raw until close (HTTP/1.0)
+    std::chrono::steady_clock::time_point last_write_;
+    bool writing_ = false;
+    bool closed_ = false;
+    char discard_[256];
+};
+
+// HTTP constructor
+AsioHttpServer::AsioHttpServer(uint16_t port, size_t io_threads)
+    : HttpServer(port, false)
+    , io_threads_(io_threads ? io_threads : kDefaultIoThreads)
+    , acceptor_(io_)
+    , accept_retry_(io_)
+{
+}
+
+// HTTPS constructor
+AsioHttpServer::AsioHttpServer(uint16_t port, const std::string& cert_path, const std::string& key_path,
+                               size_t io_threads)
+    : HttpServer(port, true)
+    , io_threads_(io_threads ? io_threads : kDefaultIoThreads)
+    , ssl_(std::make_unique<asio::ssl::context>(asio::ssl::context::tls_server))
+    , acceptor_(io_)
+    , accept_retry_(io_)
+{
+    ssl_->set_options(asio::ssl::context::default_workarounds |
+                      asio::ssl::context::no_sslv2 |
+                      asio::ssl::context::no_sslv3 |
+                      asio::ssl::context::no_tlsv1 |
+                      asio::ssl::context::no_tlsv1_1);
+    try {
+        ssl_->use_certificate_chain_file(cert_path);
+        ssl_->use_private_key_file(key_path, asio::ssl::context::pem);
+    } catch (const std::exception& e) {
+        throw std::runtime_error("Failed to load TLS certificate/key: " + std::string(e.what()));
+    }
+}
+
+AsioHttpServer::~AsioHttpServer() {
+    stop();
+}
+
+void AsioHttpServer::start() {
+    if (running_) return;
+
+    try {
+        asio::ip::tcp::endpoint endpoint(asio::ip::tcp::v4(), port_);
+        acceptor_.open(endpoint.protocol());
+        acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+        acceptor_.bind(endpoint);
+        acceptor_.listen(asio::socket_base::max_listen_connections);
+    } catch (const std::exception& e) {
+        asio::error_code ec;
+        acceptor_.close(ec);
+        throw std::runtime_error("Failed to listen on port " + std::to_string(port_) + ": " + e.what());
+    }
+
+    running_ = true;
+    start_executor();
+    ServerLog::log(is_https_ ? "HTTPS" : "HTTP", "Server starting on port " + std::to_string(port_) +
+                   " (asio, " + std::to_string(io_threads_) + " io threads)");
+
+    io_.restart();
+    accept();
+    for (size_t i = 0; i < io_threads_; i++) {
+        threads_.emplace_back([this] {
+            ThreadPlacement::adopt(ThreadRole::Http);
+            // A throwing handler must not take the io thread down with it
+            for (;;) {
+                try {
+                    io_.run();
+                    return;
+                } catch (const std::exception& e) {
+                    ServerLog::error("HTTP", std::string("Handler failed: ") + e.what());
+                }
+            }
+        });
+    }
+}
+
+void AsioHttpServer::stop() {
+    if (!running_) return;
+    running_ = false;   // accept() drops new connections from here on
+
+    // Close open connections (SSE streams included) on their strands, so
+    // clients see them end. Any that haven't closed within kStopGrace are
+    // abandoned with their handlers and closed when io_ is destroyed.
+    CpuProfiler::cancel();
+    std::vector<std::function<void()>> closers;
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        for (const auto& [id, closer] : connections_) closers.push_back(closer);
+    }
+    for (const auto& closer : closers) closer();
+    {
+        std::unique_lock<std::mutex> lock(connections_mutex_);
+        connections_closed_.wait_for(lock, kStopGrace, [this] { return connections_.empty(); });
+    }
+    io_.stop();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+    {
+        std::lock_guard<std::mutex> lock(profile_mutex_);
+        if (profile_thread_.joinable()) profile_thread_.join();
+    }
+
+    asio::error_code ec;
+    acceptor_.close(ec);
+    stop_executor();
+}
+
+uint64_t AsioHttpServer::track_connection(std::function<void()> closer) {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    uint64_t id = ++next_connection_id_;
+    connections_.emplace(id, std::move(closer));
+    return id;
+}
+
+void AsioHttpServer::untrack_connection(uint64_t id) {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    if (connections_.erase(id) && connections_.empty()) connections_closed_.notify_all();
+}
+
+bool AsioHttpServer::run_profile(std::function<void()> job) {
+    std::lock_guard<std::mutex> lock(profile_mutex_);
+    if (profiling_) return false;
+    if (profile_thread_.joinable()) profile_thread_.join();   // Previous profile, finished
+    profiling_ = true;
+    profile_thread_ = std::thread([this, job = std::move(job)] {
+        ThreadPlacement::adopt(ThreadRole::Http);
+        job();
+        profiling_ = false;
+    });
+    return true;
+}
+
+void AsioHttpServer::accept() {
+    acceptor_.async_accept(asio::make_strand(io_),
+        [this](const asio::error_code& ec, asio::ip::tcp::socket socket) {
+            if (ec == asio::error::operation_aborted || !acceptor_.is_open() || !running_) return;
+            if (ec) {
+                // Typically out of descriptors; back off instead of spinning
+                ServerLog::error("HTTP", "Accept failed: " + ec.message());
+                accept_retry_.expires_after(std::chrono::milliseconds(100));
+                accept_retry_.async_wait([this](const asio::error_code& wait_ec) {
+                    if (!wait_ec) accept();
+                });
+                return;
+            }
+
+            asio::error_code opt_ec;
+            socket.set_option(asio::ip::tcp::no_delay(true), opt_ec);
+            if (ssl_) {
+                std::make_shared<Connection<asio::ssl::stream<asio::ip::tcp::socket>>>(
+                    *this, std::move(socket), *ssl_)->start();
+            } else {
+                std::make_shared<Connection<asio::ip::tcp::socket>>(*this, std::move(socket))->start();
+            }
+            accept();
+        });
+}
+
+} // namespace mcp_logs
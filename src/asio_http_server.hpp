@@ -0,0 +1,77 @@
+#pragma once
+
+#include "http_server.hpp"
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mcp_logs {
+
+// asio backend: one io_context run by a few threads, with every connection
+// driven by async reads and writes on its own strand. An idle SSE stream is
+// a socket, a timer and a parked read, so thousands of them cost no
+// threads. Speaks enough HTTP/1.1 for MCP clients: keep-alive,
+// Content-Length request bodies, and chunked SSE responses (close-delimited
+// for HTTP/1.0 clients). TLS via asio::ssl with the same PEM files as the
+// httplib backend. stop() closes open connections, SSE streams included.
+class AsioHttpServer : public HttpServer {
+public:
+    static constexpr size_t kMaxHeaderBytes = 64 * 1024;
+    static constexpr size_t kMaxBodyBytes = 16 * 1024 * 1024;
+
+    // HTTP constructor (0 io_threads: 2)
+    explicit AsioHttpServer(uint16_t port = 8080, size_t io_threads = 0);
+
+    // HTTPS constructor. Throws if the certificate or key can't be loaded.
+    AsioHttpServer(uint16_t port, const std::string& cert_path, const std::string& key_path,
+                   size_t io_threads = 0);
+
+    ~AsioHttpServer() override;
+
+    // Throws std::runtime_error if the port can't be bound
+    void start() override;
+    void stop() override;
+
+private:
+    template <typename Stream> class Connection;
+
+    void accept();
+
+    // Open connections, so stop() can close them. closer posts the
+    // connection's close() to its strand; untrack_connection is idempotent.
+    uint64_t track_connection(std::function<void()> closer);
+    void untrack_connection(uint64_t id);
+
+    // Run a GET /debug/profile job on profile_thread_, off the io threads;
+    // false if one is already running
+    bool run_profile(std::function<void()> job);
+
+    size_t io_threads_;
+
+    // Declared before io_: abandoned connections untrack themselves when
+    // io_ is destroyed
+    std::mutex connections_mutex_;
+    std::condition_variable connections_closed_;   // Signalled when connections_ empties
+    std::map<uint64_t, std::function<void()>> connections_;
+    uint64_t next_connection_id_ = 0;
+
+    std::unique_ptr<asio::ssl::context> ssl_;   // Set for HTTPS; outlives the connections
+    asio::io_context io_;
+    asio::ip::tcp::acceptor acceptor_;
+    asio::steady_timer accept_retry_;           // Backoff when accept fails (e.g. out of descriptors)
+    std::vector<std::thread> threads_;
+
+    std::mutex profile_mutex_;
+    std::thread profile_thread_;
+    std::atomic<bool> profiling_{false};
+};
+
+} // namespace mcp_logs
@@ -0,0 +1,149 @@
+#pragma once
+
+#ifdef MCP_LOGS_COROUTINES
+
+#include <asio.hpp>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace mcp_logs {
+
+// Bounded multi-producer multi-consumer queue for asio coroutines. push()
+// suspends while the queue is full and pop() while it is empty, so a slow
+// stage holds back the stages feeding it. Suspended coroutines resume on
+// their own executor. Threads outside asio can feed the queue with
+// push_blocking(). After close(), pushes fail and pops drain what is left.
+template <typename T>
+class AwaitableQueue {
+public:
+    explicit AwaitableQueue(size_t capacity) : capacity_(capacity ? capacity : 1) {}
+
+    AwaitableQueue(const AwaitableQueue&) = delete;
+    AwaitableQueue& operator=(const AwaitableQueue&) = delete;
+
+    // False if the queue was closed
+    asio::awaitable<bool> push(T value) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (closed_) co_return false;
+                if (items_.size() < capacity_) {
+                    items_.push_back(std::move(value));
+                    resume_one(pop_waiters_, lock);
+                    co_return true;
+                }
+            }
+            co_await wait(push_waiters_, [this] { return items_.size() < capacity_; });
+        }
+    }
+
+    // nullopt once the queue is closed and empty
+    asio::awaitable<std::optional<T>> pop() {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (!items_.empty()) {
+                    std::optional<T> value(std::move(items_.front()));
+                    items_.pop_front();
+                    space_cv_.notify_one();
+                    resume_one(push_waiters_, lock);
+                    co_return value;
+                }
+                if (closed_) co_return std::nullopt;
+            }
+            co_await wait(pop_waiters_, [this] { return !items_.empty(); });
+        }
+    }
+
+    // Take an item if one is ready, without suspending
+    std::optional<T> try_pop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (items_.empty()) return std::nullopt;
+        std::optional<T> value(std::move(items_.front()));
+        items_.pop_front();
+        space_cv_.notify_one();
+        resume_one(push_waiters_, lock);
+        return value;
+    }
+
+    // For producer threads: blocks while the queue is full. False if closed.
+    bool push_blocking(T value) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_cv_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_) return false;
+        items_.push_back(std::move(value));
+        resume_one(pop_waiters_, lock);
+        return true;
+    }
+
+    void close() {
+        std::deque<std::function<void()>> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            waiters.swap(push_waiters_);
+            for (auto& waiter : pop_waiters_) waiters.push_back(std::move(waiter));
+            pop_waiters_.clear();
+        }
+        space_cv_.notify_all();
+        for (auto& resume : waiters) resume();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.size();
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    using Waiters = std::deque<std::function<void()>>;
+
+    // Suspend until ready() holds or the queue closes. The check and the
+    // registration happen under mutex_, so no wakeup is lost in between.
+    template <typename Ready>
+    asio::awaitable<void> wait(Waiters& waiters, Ready ready) {
+        co_await asio::async_initiate<decltype(asio::use_awaitable), void()>(
+            [this, &waiters, ready](auto handler) {
+                auto shared = std::make_shared<decltype(handler)>(std::move(handler));
+                std::function<void()> resume = [shared] {
+                    auto executor = asio::get_associated_executor(*shared);
+                    asio::post(executor, std::move(*shared));
+                };
+
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (closed_ || ready()) {
+                    lock.unlock();
+                    resume();
+                    return;
+                }
+                waiters.push_back(std::move(resume));
+            },
+            asio::use_awaitable);
+    }
+
+    // Wake the first waiter, if any, after releasing the lock
+    static void resume_one(Waiters& waiters, std::unique_lock<std::mutex>& lock) {
+        if (waiters.empty()) return;
+        auto resume = std::move(waiters.front());
+        waiters.pop_front();
+        lock.unlock();
+        resume();
+    }
+
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable space_cv_;   // For push_blocking
+    std::deque<T> items_;
+    Waiters push_waiters_;
+    Waiters pop_waiters_;
+    bool closed_ = false;
+};
+
+} // namespace mcp_logs
+
+#endif // MCP_LOGS_COROUTINES
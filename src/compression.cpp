@@ -0,0 +1,191 @@
+#include "compression.hpp"
+#include <zlib.h>
+#ifdef MCP_LOGS_ZSTD
+#include <zstd.h>
+#endif
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace mcp_logs {
+
+namespace {
+
+constexpr int kGzipLevel = 6;
+constexpr int kZstdLevel = 3;
+constexpr int kZstdWindowLog = 18;    // 256 KiB window keeps per-stream memory bounded
+constexpr size_t kChunkBytes = 16384;
+
+std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+std::string trim(const std::string& s) {
+    size_t start = s.find_first_not_of(" \t");
+    if (start == std::string::npos) return "";
+    size_t end = s.find_last_not_of(" \t");
+    return s.substr(start, end - start + 1);
+}
+
+} // namespace
+
+const char* encoding_name(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Gzip: return "gzip";
+        case ContentEncoding::Zstd: return "zstd";
+        default:                    return "identity";
+    }
+}
+
+bool zstd_supported() {
+#ifdef MCP_LOGS_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+ContentEncoding negotiate_encoding(const std::string& accept_encoding) {
+    // q-value per coding; -1 means not listed
+    double gzip = -1.0;
+    double zstd = -1.0;
+    double any = -1.0;
+
+    size_t pos = 0;
+    while (pos <= accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', pos);
+        if (end == std::string::npos) end = accept_encoding.size();
+        std::string item = accept_encoding.substr(pos, end - pos);
+        pos = end + 1;
+
+        double q = 1.0;
+        size_t semi = item.find(';');
+        if (semi != std::string::npos) {
+            std::string param = lower(trim(item.substr(semi + 1)));
+            if (param.compare(0, 2, "q=") == 0) q = std::strtod(param.c_str() + 2, nullptr);
+            item = item.substr(0, semi);
+        }
+
+        std::string coding = lower(trim(item));
+        if (coding == "gzip" || coding == "x-gzip") {
+            gzip = q;
+        } else if (coding == "zstd") {
+            zstd = q;
+        } else if (coding == "*") {
+            any = q;
+        }
+    }
+    if (gzip < 0) gzip = any;
+    if (zstd < 0) zstd = any;
+
+    if (zstd_supported() && zstd > 0 && zstd >= gzip) return ContentEncoding::Zstd;
+    if (gzip > 0) return ContentEncoding::Gzip;
+    return ContentEncoding::Identity;
+}
+
+struct Compressor::Impl {
+    z_stream zs{};
+    bool zs_ready = false;
+#ifdef MCP_LOGS_ZSTD
+    ZSTD_CCtx* cctx = nullptr;
+#endif
+
+    ~Impl() {
+        if (zs_ready) deflateEnd(&zs);
+#ifdef MCP_LOGS_ZSTD
+        if (cctx) ZSTD_freeCCtx(cctx);
+#endif
+    }
+
+    std::string deflate_data(std::string_view data, int mode) {
+        if (!zs_ready) {
+            // windowBits 15 + 16: gzip wrapper rather than raw zlib
+            if (deflateInit2(&zs, kGzipLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                throw std::runtime_error("deflateInit2 failed");
+            }
+            zs_ready = true;
+        }
+
+        std::string out;
+        char buffer[kChunkBytes];
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        zs.avail_in = static_cast<uInt>(data.size());
+        int rc;
+        do {
+            zs.next_out = reinterpret_cast<Bytef*>(buffer);
+            zs.avail_out = sizeof(buffer);
+            rc = deflate(&zs, mode);
+            if (rc == Z_STREAM_ERROR) throw std::runtime_error("deflate failed");
+            out.append(buffer, sizeof(buffer) - zs.avail_out);
+        } while (mode == Z_FINISH ? rc != Z_STREAM_END : zs.avail_out == 0);
+
+        if (mode == Z_FINISH) deflateReset(&zs);
+        return out;
+    }
+
+#ifdef MCP_LOGS_ZSTD
+    std::string zstd_data(std::string_view data, ZSTD_EndDirective mode) {
+        if (!cctx) {
+            cctx = ZSTD_createCCtx();
+            if (!cctx) throw std::runtime_error("ZSTD_createCCtx failed");
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, kZstdLevel);
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog, kZstdWindowLog);
+        }
+
+        std::string out;
+        char buffer[kChunkBytes];
+        ZSTD_inBuffer in{data.data(), data.size(), 0};
+        size_t remaining;
+        do {
+            ZSTD_outBuffer output{buffer, sizeof(buffer), 0};
+            remaining = ZSTD_compressStream2(cctx, &output, &in, mode);
+            if (ZSTD_isError(remaining)) {
+                throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(remaining));
+            }
+            out.append(buffer, output.pos);
+        } while (remaining != 0 || in.pos < in.size);
+        return out;
+    }
+#endif
+};
+
+Compressor::Compressor(ContentEncoding encoding)
+    : encoding_(encoding)
+    , impl_(std::make_unique<Impl>())
+{
+    if (encoding_ == ContentEncoding::Zstd && !zstd_supported()) {
+        throw std::runtime_error("zstd support not built");
+    }
+}
+
+Compressor::~Compressor() = default;
+
+std::string Compressor::flush(std::string_view data) {
+    switch (encoding_) {
+        case ContentEncoding::Gzip:
+            return impl_->deflate_data(data, Z_SYNC_FLUSH);
+#ifdef MCP_LOGS_ZSTD
+        case ContentEncoding::Zstd:
+            return impl_->zstd_data(data, ZSTD_e_flush);
+#endif
+        default:
+            return std::string(data);
+    }
+}
+
+std::string Compressor::compress(std::string_view data) {
+    switch (encoding_) {
+        case ContentEncoding::Gzip:
+            return impl_->deflate_data(data, Z_FINISH);
+#ifdef MCP_LOGS_ZSTD
+        case ContentEncoding::Zstd:
+            return impl_->zstd_data(data, ZSTD_e_end);
+#endif
+        default:
+            return std::string(data);
+    }
+}
+
+} // namespace mcp_logs
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace mcp_logs {
+
+enum class ContentEncoding { Identity, Gzip, Zstd };
+
+// Content-Encoding token ("identity", "gzip", "zstd")
+const char* encoding_name(ContentEncoding encoding);
+
+// True when built with zstd (MCP_LOGS_ZSTD)
+bool zstd_supported();
+
+// Best encoding an Accept-Encoding header allows: zstd if supported, then
+// gzip, honoring q-values ("gzip;q=0" refuses gzip, "*" accepts either)
+ContentEncoding negotiate_encoding(const std::string& accept_encoding);
+
+// Compression context for one connection or stream, reused between calls.
+// flush() keeps the stream open and makes everything written so far
+// decodable by the peer (one call per SSE event); compress() produces a
+// complete body and resets the context for the next one. Throws
+// std::runtime_error if the codec fails.
+class Compressor {
+public:
+    explicit Compressor(ContentEncoding encoding);
+    ~Compressor();
+
+    Compressor(const Compressor&) = delete;
+    Compressor& operator=(const Compressor&) = delete;
+
+    ContentEncoding encoding() const { return encoding_; }
+
+    std::string flush(std::string_view data);
+    std::string compress(std::string_view data);
+
+private:
+    struct Impl;
+
+    ContentEncoding encoding_;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace mcp_logs
@@ -1,5 +1,7 @@
 #include "console_ui.hpp"
+#include "alloc_tracker.hpp"
 #include "source_manager.hpp"
+#include "thread_placement.hpp"
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/event.hpp>
 #include <ftxui/dom/elements.hpp>
@@ -12,13 +14,35 @@
 
 namespace mcp_logs {
 
+namespace {
+
+constexpr size_t kLockPanelRows = 8;
+
+// "850ns", "12.3us", "4.5ms", "1.20s"
+std::string format_lock_time(double seconds) {
+    std::ostringstream out;
+    out << std::fixed;
+    if (seconds < 1e-6) {
+        out << std::setprecision(0) << seconds * 1e9 << "ns";
+    } else if (seconds < 1e-3) {
+        out << std::setprecision(1) << seconds * 1e6 << "us";
+    } else if (seconds < 1.0) {
+        out << std::setprecision(1) << seconds * 1e3 << "ms";
+    } else {
+        out << std::setprecision(2) << seconds << "s";
+    }
+    return out.str();
+}
+
+} // namespace
+
 // LogBuffer implementation
 template<typename T>
 LogBuffer<T>::LogBuffer(size_t max_lines) : max_lines_(max_lines) {}
 
 template<typename T>
 void LogBuffer<T>::push(T line) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = mutex_.acquire("push");
     lines_.push_back(std::move(line));
     while (lines_.size() > max_lines_) {
         lines_.pop_front();
@@ -27,19 +51,19 @@ void LogBuffer<T>::push(T line) {
 
 template<typename T>
 std::vector<T> LogBuffer<T>::get_lines() const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = mutex_.acquire("get_lines");
     return std::vector<T>(lines_.begin(), lines_.end());
 }
 
 template<typename T>
 size_t LogBuffer<T>::size() const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = mutex_.acquire("size");
     return lines_.size();
 }
 
 template<typename T>
 void LogBuffer<T>::clear() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = mutex_.acquire("clear");
     lines_.clear();
 }
 
@@ -48,10 +72,11 @@ template class LogBuffer<DisplayLogLine>;
 template class LogBuffer<ServerLogLine>;
 
 // ConsoleUI constructor
-ConsoleUI::ConsoleUI(LogStore& store, SourceManager& sources, uint16_t udp_port, uint16_t http_port,
-                     bool is_https, const std::string& db_path)
+ConsoleUI::ConsoleUI(LogStore& store, SourceManager& sources, AnomalyDetector& anomalies,
+                     uint16_t udp_port, uint16_t http_port, bool is_https, const std::string& db_path)
     : store_(store)
     , sources_(sources)
+    , anomalies_(anomalies)
     , udp_logs_(1000)
     , server_logs_(500)
     , udp_port_(udp_port)
@@ -71,6 +96,7 @@ ConsoleUI::~ConsoleUI() = default;
 void ConsoleUI::on_udp_log(const LogEntry& entry) {
     if (paused_) return;
 
+    AllocScope alloc_scope(AllocSubsystem::UiBuffer);   // The line outlives this call in udp_logs_
     DisplayLogLine line;
     line.category = entry.category;
     line.message = entry.message;
@@ -88,6 +114,7 @@ void ConsoleUI::on_udp_log(const LogEntry& entry) {
 
 void ConsoleUI::log_server(const std::string& component,
                             const std::string& message, bool is_error) {
+    AllocScope alloc_scope(AllocSubsystem::UiBuffer);
     ServerLogLine line;
     line.component = component;
     line.message = message;
@@ -138,6 +165,21 @@ void ConsoleUI::update_stats() {
 
         auto db_stats = store_.get_stats();
 
+        // Highlight anomalies from the last minute
+        int64_t anomaly_count = anomalies_.total();
+        std::string last_anomaly;
+        if (auto latest = anomalies_.latest()) {
+            double wall = std::chrono::duration<double>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            if (wall - latest->detected_at < 60.0) last_anomaly = latest->detail;
+        }
+
+        std::vector<LockSiteReport> locks;
+        if (show_locks_) {
+            locks = LockProfiler::report();
+            if (locks.size() > kLockPanelRows) locks.resize(kLockPanelRows);
+        }
+
         std::lock_guard<std::mutex> lock(stats_mutex_);
         stats_.total_logs = db_stats.total_count;
         stats_.error_count = db_stats.error_count;
@@ -145,6 +187,9 @@ void ConsoleUI::update_stats() {
         stats_.session_count = db_stats.session_count;
         stats_.logs_per_second = rate;
         stats_.current_session = db_stats.current_session;
+        stats_.anomaly_count = anomaly_count;
+        stats_.last_anomaly = std::move(last_anomaly);
+        stats_.locks = std::move(locks);
     }
 }
 
@@ -168,6 +213,10 @@ void ConsoleUI::init_commands(std::atomic<bool>& running, ftxui::ScreenInteracti
             ui.udp_logs_.clear();
         }, false},
         {"delete-logs", "Delete all logs from database", [](ConsoleUI& ui, const std::vector<std::string>&) {
+            if (ui.store_.is_follower()) {
+                ui.log_server("DB", "Read-only follower: delete logs on the primary", true);
+                return;
+            }
             int64_t count = ui.store_.clear();
             ui.udp_logs_.clear();
             ui.log_server("DB", "Deleted " + std::to_string(count) + " logs from database", false);
@@ -209,6 +258,13 @@ void ConsoleUI::init_commands(std::atomic<bool>& running, ftxui::ScreenInteracti
                 }
             }
         }, false},
+        {"locks", "Toggle the lock contention panel", [](ConsoleUI& ui, const std::vector<std::string>&) {
+            if (!LockProfiler::enabled()) {
+                ui.log_server("Locks", "Lock profiling is not compiled in (configure with -DENABLE_LOCK_PROFILING=ON)", true);
+                return;
+            }
+            ui.show_locks_ = !ui.show_locks_;
+        }, false},
         {"help", "Show available commands", [](ConsoleUI& ui, const std::vector<std::string>&) {
             ui.log_server("Help", "Available commands:", false);
             ui.log_server("Help", "  /quit, /q        - Exit the application", false);
@@ -218,6 +274,7 @@ void ConsoleUI::init_commands(std::atomic<bool>& running, ftxui::ScreenInteracti
             ui.log_server("Help", "  /tail <path>     - Start tailing a file", false);
             ui.log_server("Help", "  /untail <id>     - Stop tailing a source", false);
             ui.log_server("Help", "  /sources         - List active sources", false);
+            ui.log_server("Help", "  /locks           - Toggle lock contention panel", false);
             ui.log_server("Help", "  /help, /h        - Show this help", false);
         }, false},
         {"h", "Help (alias)", [](ConsoleUI& ui, const std::vector<std::string>&) {
@@ -229,6 +286,7 @@ void ConsoleUI::init_commands(std::atomic<bool>& running, ftxui::ScreenInteracti
             ui.log_server("Help", "  /tail <path>     - Start tailing a file", false);
             ui.log_server("Help", "  /untail <id>     - Stop tailing a source", false);
             ui.log_server("Help", "  /sources         - List active sources", false);
+            ui.log_server("Help", "  /locks           - Toggle lock contention panel", false);
             ui.log_server("Help", "  /help, /h        - Show this help", false);
         }, false},
     };
@@ -317,7 +375,7 @@ void ConsoleUI::update_completion_hint() {
 
     if (command_input_.size() == 1) {
         // Just "/" - show all main commands
-        completion_hint_ = "quit, pause, clear, tail, untail, sources, help";
+        completion_hint_ = "quit, pause, clear, tail, untail, sources, locks, help";
         return;
     }
 
@@ -380,6 +438,7 @@ void ConsoleUI::run(std::atomic<bool>& running) {
     // Stats update thread
     std::atomic<bool> stats_running{true};
     std::thread stats_thread([this, &stats_running]() {
+        ThreadPlacement::adopt(ThreadRole::Ui);
         while (stats_running) {
             update_stats();
             std::this_thread::sleep_for(std::chrono::seconds(1));
@@ -474,6 +533,11 @@ void ConsoleUI::run(std::atomic<bool>& running) {
             text("  "),
             text("⚡ ") | dim,
             text(std::to_string(static_cast<int>(current_stats.logs_per_second)) + "/s"),
+            text("  "),
+            text("🚨 ") | dim,
+            current_stats.last_anomaly.empty()
+                ? text(std::to_string(current_stats.anomaly_count)) | dim
+                : text(std::to_string(current_stats.anomaly_count)) | bold | color(Color::Magenta),
         });
 
         auto info_line = hbox({
@@ -482,10 +546,14 @@ void ConsoleUI::run(std::atomic<bool>& running) {
             text("UDP:" + std::to_string(udp_port_)) | dim,
         });
 
+        // Most recent anomaly, or an empty line for alignment
+        std::string anomaly_text = current_stats.last_anomaly;
+        if (anomaly_text.size() > 60) anomaly_text = anomaly_text.substr(0, 57) + "...";
+
         auto stats_box = vbox({
             stats_line,
             info_line,
-            text("") | dim,  // Empty line for alignment
+            text(anomaly_text) | color(Color::Magenta),
         });
 
         auto top_bar = hbox({
@@ -531,7 +599,9 @@ void ConsoleUI::run(std::atomic<bool>& running) {
             const auto& line = server_lines[i];
             std::string prefix = "[" + line.component + "] ";
             std::string full_msg = prefix + line.message;
-            auto elem = paragraph(full_msg) | (line.is_error ? color(Color::Red) : nothing);
+            auto elem = paragraph(full_msg) | (line.is_error ? color(Color::Red)
+                                             : line.component == "Anomaly" ? color(Color::Magenta)
+                                             : line.component == "Rule" ? color(Color::Yellow) : nothing);
             server_elements.push_back(elem);
         }
 
@@ -551,10 +621,54 @@ void ConsoleUI::run(std::atomic<bool>& running) {
             server_pane | size(WIDTH, EQUAL, 40),
         }) | flex;
 
+        if (!show_locks_) {
+            return vbox({
+                text(""),  // Top spacing
+                top_bar,
+                content,
+            });
+        }
+
+        // Lock contention pane: busiest sites by total wait
+        auto cell = [](const std::string& s, int width) {
+            return text(s) | size(WIDTH, EQUAL, width);
+        };
+        Elements lock_rows;
+        lock_rows.push_back(hbox({
+            cell("Mutex / site", 40), cell("Acquired", 10), cell("Waited", 8),
+            cell("Wait p50", 10), cell("p99", 10), cell("max", 10),
+            cell("Hold p99", 10), cell("max", 10), text("Blocked others"),
+        }) | dim);
+        for (const auto& site : current_stats.locks) {
+            double contended = site.acquisitions
+                ? 100.0 * static_cast<double>(site.contended) / static_cast<double>(site.acquisitions) : 0.0;
+            std::ostringstream pct;
+            pct << std::fixed << std::setprecision(1) << contended << "%";
+            lock_rows.push_back(hbox({
+                cell(site.mutex + "/" + site.site, 40),
+                cell(std::to_string(site.acquisitions), 10),
+                cell(pct.str(), 8) | (contended >= 10.0 ? color(Color::Yellow) : nothing),
+                cell(format_lock_time(site.wait_p50), 10),
+                cell(format_lock_time(site.wait_p99), 10),
+                cell(format_lock_time(site.wait_max), 10),
+                cell(format_lock_time(site.hold_p99), 10),
+                cell(format_lock_time(site.hold_max), 10),
+                text(format_lock_time(site.blocked_others_seconds)),
+            }));
+        }
+        if (current_stats.locks.empty()) lock_rows.push_back(text("No locks taken yet") | dim);
+
+        auto locks_pane = vbox({
+            text(" Locks ") | bold,
+            separator() | color(Color::GrayDark),
+            vbox(std::move(lock_rows)),
+        }) | border | color(Color::GrayDark);
+
         return vbox({
             text(""),  // Top spacing
             top_bar,
             content,
+            locks_pane,
         });
     });
 
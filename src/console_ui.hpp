@@ -1,5 +1,7 @@
 #pragma once
 
+#include "anomaly_detector.hpp"
+#include "lock_profiler.hpp"
 #include "log_store.hpp"
 #include "log_entry.hpp"
 #include <ftxui/component/component.hpp>
@@ -52,7 +54,7 @@ public:
     size_t size() const;
     void clear();
 private:
-    mutable std::mutex mutex_;
+    mutable ProfiledMutex mutex_{"LogBuffer"};
     std::deque<T> lines_;
     size_t max_lines_;
 };
@@ -65,13 +67,16 @@ struct DisplayStats {
     int64_t session_count = 0;
     double logs_per_second = 0.0;
     std::string current_session;
+    int64_t anomaly_count = 0;
+    std::string last_anomaly;       // Empty unless one was detected recently
+    std::vector<LockSiteReport> locks;   // Most contended lock sites, while the locks panel is open
 };
 
 // Main TUI class
 class ConsoleUI {
 public:
-    ConsoleUI(LogStore& store, SourceManager& sources, uint16_t udp_port, uint16_t http_port,
-              bool is_https, const std::string& db_path);
+    ConsoleUI(LogStore& store, SourceManager& sources, AnomalyDetector& anomalies,
+              uint16_t udp_port, uint16_t http_port, bool is_https, const std::string& db_path);
     ~ConsoleUI();
 
     // Start the TUI (blocks until exit)
@@ -98,6 +103,7 @@ private:
     // State
     LogStore& store_;
     SourceManager& sources_;
+    AnomalyDetector& anomalies_;
     LogBuffer<DisplayLogLine> udp_logs_;
     LogBuffer<ServerLogLine> server_logs_;
     DisplayStats stats_;
@@ -105,6 +111,7 @@ private:
 
     // UI state
     std::atomic<bool> paused_{false};
+    std::atomic<bool> show_locks_{false};
 
     // Command input state
     std::string command_input_;
@@ -0,0 +1,383 @@
+#include "cpu_profiler.hpp"
+#include "server_log.hpp"
+#include "thread_placement.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <cxxabi.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#endif
+
+namespace mcp_logs {
+
+namespace {
+
+std::mutex g_mutex;                 // Guards g_running and g_cancelled
+std::condition_variable g_cv;       // Signalled by cancel()
+bool g_running = false;
+bool g_cancelled = false;
+
+// Read by the SIGPROF handler; a plain pointer, so async-signal-safe
+thread_local const char* t_label = nullptr;
+
+} // namespace
+
+void CpuProfiler::cancel() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (!g_running) return;
+    g_cancelled = true;
+    g_cv.notify_all();
+}
+
+bool CpuProfiler::running() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_running;
+}
+
+void CpuProfiler::set_thread_label(const char* label) {
+    t_label = label;
+}
+
+CpuProfiler::LabelScope::LabelScope(const char* label) : previous_(t_label) {
+    t_label = label;
+}
+
+CpuProfiler::LabelScope::~LabelScope() {
+    t_label = previous_;
+}
+
+#ifdef __linux__
+
+namespace {
+
+constexpr int kMaxDepth = 64;
+constexpr size_t kMinSamples = 1000;
+constexpr size_t kMaxSamples = 50000;   // ~27 MB of stacks
+constexpr auto kThreadScanInterval = std::chrono::seconds(1);
+
+struct Sample {
+    std::atomic<bool> ready{false};    // Written completely by the handler
+    const char* label = nullptr;       // set_thread_label / LabelScope
+    int role = -1;                     // ThreadRole, or -1
+    pid_t tid = 0;
+    int depth = 0;
+    void* frames[kMaxDepth];           // Innermost first
+};
+
+// Shared with the SIGPROF handler. g_samples is only touched while
+// g_active is set; profile() clears it and waits for handlers in flight
+// before freeing the buffer.
+std::atomic<bool> g_active{false};
+std::atomic<int> g_in_handler{0};
+Sample* g_samples = nullptr;
+size_t g_capacity = 0;
+std::atomic<size_t> g_next{0};
+
+// Registers of the interrupted code: program counter, stack pointer and
+// frame pointer
+struct Registers {
+    uintptr_t pc = 0;
+    uintptr_t sp = 0;
+    uintptr_t fp = 0;
+};
+
+Registers interrupted_registers(void* context) {
+    auto* uc = static_cast<ucontext_t*>(context);
+    Registers regs;
+#if defined(__x86_64__)
+    regs.pc = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RIP]);
+    regs.sp = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RSP]);
+    regs.fp = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RBP]);
+#elif defined(__aarch64__)
+    regs.pc = static_cast<uintptr_t>(uc->uc_mcontext.pc);
+    regs.sp = static_cast<uintptr_t>(uc->uc_mcontext.sp);
+    regs.fp = static_cast<uintptr_t>(uc->uc_mcontext.regs[29]);
+#else
+    (void)uc;
+#endif
+    return regs;
+}
+
+constexpr uintptr_t kMaxFrameSize = 1 << 20;   // A larger step means we've left the stack
+
+// Copies the frame record at `fp` ({caller's fp, return address} on both
+// x86-64 and AArch64). A syscall, so an unmapped address fails with EFAULT
+// rather than SIGSEGV.
+bool read_frame(uintptr_t fp, uintptr_t (&record)[2]) {
+    iovec local {record, sizeof(record)};
+    iovec remote {reinterpret_cast<void*>(fp), sizeof(record)};
+    return process_vm_readv(getpid(), &local, 1, &remote, 1, 0) == static_cast<ssize_t>(sizeof(record));
+}
+
+// Innermost first: the interrupted pc, then return addresses up the frame
+// pointer chain. Each frame must sit above the last, within kMaxFrameSize,
+// and be aligned, or the walk stops.
+int walk_stack(const Registers& regs, void** frames, int max_depth) {
+    if (regs.pc == 0) return 0;
+    int depth = 0;
+    frames[depth++] = reinterpret_cast<void*>(regs.pc);
+
+    uintptr_t fp = regs.fp;
+    uintptr_t floor = regs.sp;
+    while (depth < max_depth) {
+        if (fp < floor || fp - floor > kMaxFrameSize || fp % sizeof(void*) != 0) break;
+        uintptr_t record[2];
+        if (!read_frame(fp, record) || record[1] == 0) break;
+        frames[depth++] = reinterpret_cast<void*>(record[1]);
+        floor = fp + sizeof(record);
+        fp = record[0];
+    }
+    return depth;
+}
+
+void on_sigprof(int, siginfo_t*, void* context) {
+    int saved_errno = errno;
+    g_in_handler.fetch_add(1);
+    if (g_active.load()) {
+        size_t slot = g_next.fetch_add(1, std::memory_order_relaxed);
+        if (slot < g_capacity) {
+            Sample& sample = g_samples[slot];
+            sample.depth = walk_stack(interrupted_registers(context), sample.frames, kMaxDepth);
+            sample.label = t_label;
+            auto role = ThreadPlacement::current_role();
+            sample.role = role ? static_cast<int>(*role) : -1;
+            sample.tid = static_cast<pid_t>(syscall(SYS_gettid));
+            sample.ready.store(true, std::memory_order_release);
+        }
+    }
+    g_in_handler.fetch_sub(1);
+    errno = saved_errno;
+}
+
+// Installed once and left in place: a SIGPROF still queued when a profile
+// ends must not reach the default action, which kills the process
+void install_handler() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        struct sigaction action {};
+        action.sa_sigaction = on_sigprof;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(SIGPROF, &action, nullptr) != 0) {
+            throw std::runtime_error(std::string("Failed to install SIGPROF handler: ") + std::strerror(errno));
+        }
+    });
+}
+
+std::vector<pid_t> list_threads() {
+    std::vector<pid_t> tids;
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) return tids;
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] >= '0' && entry->d_name[0] <= '9') tids.push_back(std::atoi(entry->d_name));
+    }
+    closedir(dir);
+    return tids;
+}
+
+std::string thread_name(pid_t tid) {
+    std::ifstream file("/proc/self/task/" + std::to_string(tid) + "/comm");
+    std::string name;
+    std::getline(file, name);
+    return name;
+}
+
+// The kernel's CPU clock id for one thread, as glibc's MAKE_THREAD_CPUCLOCK
+// builds it: pthread_getcpuclockid() needs a pthread_t, and we only have tids
+clockid_t thread_cpu_clock(pid_t tid) {
+    constexpr unsigned kPerThreadSched = 6;   // CPUCLOCK_PERTHREAD_MASK | CPUCLOCK_SCHED
+    return static_cast<clockid_t>((~static_cast<unsigned>(tid) << 3) | kPerThreadSched);
+}
+
+bool arm_timer(pid_t tid, long interval_ns, timer_t& timer) {
+    sigevent event {};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+#ifdef sigev_notify_thread_id
+    event.sigev_notify_thread_id = tid;
+#else
+    event._sigev_un._tid = tid;
+#endif
+    if (timer_create(thread_cpu_clock(tid), &event, &timer) != 0) return false;   // Thread already gone
+
+    itimerspec spec {};
+    spec.it_interval.tv_sec = interval_ns / 1000000000L;
+    spec.it_interval.tv_nsec = interval_ns % 1000000000L;
+    spec.it_value = spec.it_interval;
+    if (timer_settime(timer, 0, &spec, nullptr) != 0) {
+        timer_delete(timer);
+        return false;
+    }
+    return true;
+}
+
+// Flame graph tools split frames on ';' and the count on the last space
+std::string clean_frame(std::string name) {
+    std::replace(name.begin(), name.end(), ';', ':');
+    std::replace(name.begin(), name.end(), '\n', ' ');
+    return name;
+}
+
+std::string symbolize(void* pc, bool innermost) {
+    // Outer frames hold return addresses, which can point past the end of
+    // the calling function; look up the call instruction instead
+    const char* lookup = static_cast<const char*>(pc) - (innermost ? 0 : 1);
+
+    std::ostringstream out;
+    Dl_info info {};
+    if (dladdr(lookup, &info) && info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+        std::free(demangled);
+        return clean_frame(name);
+    }
+    if (info.dli_fname && info.dli_fbase) {
+        std::string module = info.dli_fname;
+        module = module.substr(module.find_last_of('/') + 1);
+        out << module << "+0x" << std::hex << static_cast<uintptr_t>(lookup - static_cast<const char*>(info.dli_fbase));
+        return clean_frame(out.str());
+    }
+    out << "0x" << std::hex << reinterpret_cast<uintptr_t>(lookup);
+    return out.str();
+}
+
+} // namespace
+
+std::optional<std::string> CpuProfiler::profile(std::chrono::milliseconds duration, int hz) {
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (g_running) return std::nullopt;
+        g_running = true;
+        g_cancelled = false;
+    }
+    struct Finish {
+        ~Finish() {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_running = false;
+        }
+    } finish;
+
+    duration = std::clamp<std::chrono::milliseconds>(duration, std::chrono::milliseconds(1), kMaxDuration);
+    hz = std::clamp(hz, 1, kMaxHz);
+    install_handler();
+
+    // Room for every thread sampled flat out, within bounds
+    auto threads = list_threads();
+    double seconds = std::chrono::duration<double>(duration).count();
+    size_t wanted = static_cast<size_t>(hz * seconds + 1) * std::max<size_t>(1, threads.size());
+    size_t capacity = std::clamp(wanted, kMinSamples, kMaxSamples);
+    std::unique_ptr<Sample[]> samples(new Sample[capacity]);
+
+    g_samples = samples.get();
+    g_capacity = capacity;
+    g_next = 0;
+    g_active = true;
+
+    struct ThreadTimer {
+        timer_t timer;
+        std::string name;
+    };
+    std::map<pid_t, ThreadTimer> timers;
+    long interval_ns = 1000000000L / hz;
+    auto add_threads = [&] {
+        for (pid_t tid : list_threads()) {
+            if (timers.count(tid)) continue;
+            timer_t timer;
+            if (arm_timer(tid, interval_ns, timer)) timers[tid] = {timer, thread_name(tid)};
+        }
+    };
+
+    // Threads started during the profile get a timer at the next scan
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    add_threads();
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        while (!g_cancelled && std::chrono::steady_clock::now() < deadline) {
+            g_cv.wait_until(lock, std::min(deadline, std::chrono::steady_clock::now() + kThreadScanInterval));
+            lock.unlock();
+            add_threads();
+            lock.lock();
+        }
+    }
+
+    for (auto& [tid, t] : timers) timer_delete(t.timer);
+    g_active = false;
+    while (g_in_handler.load() != 0) std::this_thread::yield();
+    size_t taken = std::min(g_next.load(), capacity);
+    size_t dropped = g_next.load() - taken;
+    g_samples = nullptr;
+    g_capacity = 0;
+
+    std::unordered_map<const void*, std::string> outer_names;   // Symbolization cache
+    std::unordered_map<const void*, std::string> inner_names;
+    std::map<std::string, uint64_t> stacks;
+    size_t recorded = 0;
+    for (size_t i = 0; i < taken; i++) {
+        const Sample& sample = samples[i];
+        if (!sample.ready.load(std::memory_order_acquire)) continue;
+        recorded++;
+
+        std::string line;
+        if (sample.label) {
+            line = sample.label;
+        } else if (sample.role >= 0) {
+            line = thread_role_name(static_cast<ThreadRole>(sample.role));
+        } else {
+            auto it = timers.find(sample.tid);
+            line = it != timers.end() && !it->second.name.empty() ? clean_frame(it->second.name) : "other";
+            std::replace(line.begin(), line.end(), ' ', '_');
+        }
+        for (int f = sample.depth - 1; f >= 0; f--) {
+            auto& cache = f == 0 ? inner_names : outer_names;
+            auto [it, inserted] = cache.try_emplace(sample.frames[f]);
+            if (inserted) it->second = symbolize(sample.frames[f], f == 0);
+            line += ';';
+            line += it->second;
+        }
+        stacks[line]++;
+    }
+
+    std::vector<std::pair<std::string, uint64_t>> sorted(stacks.begin(), stacks.end());
+    std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    std::string out;
+    for (const auto& [stack, count] : sorted) out += stack + ' ' + std::to_string(count) + '\n';
+
+    std::string summary = "Profiled " + std::to_string(timers.size()) + " threads at " + std::to_string(hz) +
+                          " Hz: " + std::to_string(recorded) + " samples, " + std::to_string(sorted.size()) +
+                          " distinct stacks";
+    if (dropped) summary += ", " + std::to_string(dropped) + " dropped (buffer full)";
+    ServerLog::log("Profiler", summary);
+    return out;
+}
+
+#else
+
+std::optional<std::string> CpuProfiler::profile(std::chrono::milliseconds, int) {
+    throw std::runtime_error("CPU profiling is only supported on Linux");
+}
+
+#endif
+
+} // namespace mcp_logs
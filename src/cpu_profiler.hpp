@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+
+namespace mcp_logs {
+
+// In-process sampling CPU profiler (Linux). Each thread gets a timer on its
+// own CPU clock that raises SIGPROF in that thread, so samples land on the
+// threads actually burning CPU. The handler records the interrupted stack
+// and the thread's label or ThreadPlacement role. It walks frame pointers
+// from the signal's ucontext, reading each frame with process_vm_readv so a
+// bad pointer ends the walk instead of faulting; backtrace()'s DWARF
+// unwinder isn't async-signal-safe. Stacks stop at the first frame built
+// without frame pointers (the build passes -fno-omit-frame-pointer; system
+// libraries may not). Frames are symbolized with dladdr, so the executable
+// must export its symbols (-rdynamic).
+class CpuProfiler {
+public:
+    static constexpr int kDefaultHz = 99;
+    static constexpr int kMaxHz = 1000;
+    static constexpr auto kMaxDuration = std::chrono::seconds(60);
+
+    static constexpr bool supported() {
+#ifdef __linux__
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Sample every thread at `hz` per CPU-second for `duration`, then return
+    // collapsed stacks for flame graphs, one "label;outer;...;inner count"
+    // line per distinct stack, busiest first. The label is the thread's
+    // label (udp, writer), else its role (ingest, tailer, query, http, ui),
+    // else its name.
+    // nullopt if another profile is running. Throws std::runtime_error if
+    // the platform isn't supported or the timers can't be set up.
+    static std::optional<std::string> profile(std::chrono::milliseconds duration, int hz = kDefaultHz);
+
+    // End a running profile early; it returns what it has (shutdown)
+    static void cancel();
+
+    // Whether a profile is running (cancel() before then does nothing)
+    static bool running();
+
+    // Label the calling thread's samples in place of its role, e.g. "udp"
+    // on ingest threads. `label` must be a string literal; nullptr reverts
+    // to the role.
+    static void set_thread_label(const char* label);
+
+    // Relabels the calling thread until destroyed, e.g. "writer" around a
+    // SQLite commit. Don't hold one across a coroutine suspension.
+    class LabelScope {
+    public:
+        explicit LabelScope(const char* label);
+        ~LabelScope();
+        LabelScope(const LabelScope&) = delete;
+        LabelScope& operator=(const LabelScope&) = delete;
+
+    private:
+        const char* previous_;
+    };
+};
+
+} // namespace mcp_logs
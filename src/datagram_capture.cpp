@@ -0,0 +1,136 @@
+#include "datagram_capture.hpp"
+#include "server_log.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace mcp_logs {
+
+namespace {
+
+constexpr uint64_t kMaxDatagramBytes = 65536;
+
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void put_u64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) out += static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+} // namespace
+
+CaptureWriter::CaptureWriter(const std::string& path)
+    : path_(path)
+    , out_(path, std::ios::binary | std::ios::trunc)
+    , last_(std::chrono::steady_clock::now())
+{
+    if (!out_) {
+        throw std::runtime_error("Failed to create capture file: " + path);
+    }
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    std::string header(kCaptureMagic, sizeof(kCaptureMagic));
+    put_u64(header, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count()));
+    out_.write(header.data(), static_cast<std::streamsize>(header.size()));
+    if (!out_) {
+        throw std::runtime_error("Failed to write capture file: " + path);
+    }
+}
+
+CaptureWriter::~CaptureWriter() {
+    flush();
+}
+
+bool CaptureWriter::write(std::string_view datagram) {
+    return write(datagram, std::chrono::steady_clock::now());
+}
+
+bool CaptureWriter::write(std::string_view datagram, std::chrono::steady_clock::time_point received) {
+    std::string record;
+    record.reserve(datagram.size() + 8);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (failed_) return false;
+
+    // Receive threads can race to the lock; keep offsets monotonic
+    auto delta = std::chrono::duration_cast<std::chrono::microseconds>(received - last_).count();
+    if (delta > 0) last_ = received;
+    put_varint(record, static_cast<uint64_t>(delta > 0 ? delta : 0));
+    put_varint(record, datagram.size());
+    record.append(datagram);
+
+    out_.write(record.data(), static_cast<std::streamsize>(record.size()));
+    if (!out_) {
+        failed_ = true;
+        ServerLog::error("Capture", "Write to " + path_ + " failed; capture stopped after " +
+                         std::to_string(datagrams_) + " datagrams");
+        return false;
+    }
+    datagrams_++;
+    return true;
+}
+
+uint64_t CaptureWriter::datagrams() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return datagrams_;
+}
+
+void CaptureWriter::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out_.flush();
+}
+
+CaptureReader::CaptureReader(const std::string& path)
+    : path_(path)
+    , in_(path, std::ios::binary)
+{
+    if (!in_) {
+        throw std::runtime_error("Failed to open capture file: " + path);
+    }
+    char header[16];
+    if (!in_.read(header, sizeof(header)) || std::memcmp(header, kCaptureMagic, sizeof(kCaptureMagic)) != 0) {
+        throw std::runtime_error("Not a log capture file: " + path);
+    }
+    uint64_t started = 0;
+    for (int i = 0; i < 8; i++) {
+        started |= static_cast<uint64_t>(static_cast<unsigned char>(header[8 + i])) << (8 * i);
+    }
+    started_at_us_ = static_cast<int64_t>(started);
+}
+
+bool CaptureReader::read_varint(uint64_t& value, bool at_record_start) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = in_.get();
+        if (c == std::char_traits<char>::eof()) {
+            if (at_record_start && shift == 0) return false;
+            throw std::runtime_error("Truncated capture record in " + path_);
+        }
+        value |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    throw std::runtime_error("Corrupt capture record in " + path_);
+}
+
+bool CaptureReader::next(CapturedDatagram& out) {
+    uint64_t delta = 0;
+    uint64_t length = 0;
+    if (!read_varint(delta, true)) return false;
+    read_varint(length, false);
+    if (length > kMaxDatagramBytes) {
+        throw std::runtime_error("Corrupt capture record in " + path_);
+    }
+
+    offset_ += std::chrono::microseconds(delta);
+    out.offset = offset_;
+    out.data.resize(length);
+    if (length && !in_.read(out.data.data(), static_cast<std::streamsize>(length))) {
+        throw std::runtime_error("Truncated capture record in " + path_);
+    }
+    return true;
+}
+
+} // namespace mcp_logs
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace mcp_logs {
+
+// Raw UDP log traffic as received, for replaying a real session's exact
+// shape (bursts, datagram sizes, instance mix) against the server. The
+// file is an 8-byte magic, the capture start as Unix microseconds (8 bytes,
+// little-endian), then one record per datagram:
+//
+//   varint  microseconds since the previous datagram (the start, for the first)
+//   varint  length
+//   bytes   the datagram
+//
+// Varints are LEB128: 7 bits per byte, low bits first.
+constexpr char kCaptureMagic[8] = {'M', 'L', 'O', 'G', 'C', 'A', 'P', '1'};
+
+class CaptureWriter {
+public:
+    // Creates or truncates path. Throws std::runtime_error if it can't.
+    explicit CaptureWriter(const std::string& path);
+    ~CaptureWriter();
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    // Append a datagram received now. Thread-safe. Returns false (and drops
+    // the datagram) once a write has failed; the failure is logged once.
+    bool write(std::string_view datagram);
+    bool write(std::string_view datagram, std::chrono::steady_clock::time_point received);
+
+    const std::string& path() const { return path_; }
+    uint64_t datagrams() const;
+
+    // Flush buffered records to disk; also done on destruction
+    void flush();
+
+private:
+    std::string path_;
+    mutable std::mutex mutex_;
+    std::ofstream out_;
+    std::chrono::steady_clock::time_point last_;
+    uint64_t datagrams_ = 0;
+    bool failed_ = false;
+};
+
+struct CapturedDatagram {
+    std::chrono::microseconds offset{0};   // Since the capture started
+    std::string data;
+};
+
+class CaptureReader {
+public:
+    // Throws std::runtime_error if path can't be opened or isn't a capture
+    explicit CaptureReader(const std::string& path);
+
+    // Unix microseconds when the capture started
+    int64_t started_at_us() const { return started_at_us_; }
+
+    // Read the next datagram into out; false at the end of the file. Throws
+    // std::runtime_error on a truncated or corrupt record.
+    bool next(CapturedDatagram& out);
+
+private:
+    bool read_varint(uint64_t& value, bool at_record_start);
+
+    std::string path_;
+    std::ifstream in_;
+    int64_t started_at_us_ = 0;
+    std::chrono::microseconds offset_{0};
+};
+
+} // namespace mcp_logs
@@ -1,4 +1,5 @@
 #include "file_tailer.hpp"
+#include "thread_placement.hpp"
 #include <chrono>
 #include <sstream>
 
@@ -46,6 +47,7 @@ void FileTailer::start() {
     ServerLog::log("FileTailer", "Started tailing: " + path_ + " (as " + source_name_ + ")");
 
     thread_ = std::thread([this]() {
+        ThreadPlacement::adopt(ThreadRole::Tailer);
         monitor_loop();
     });
 }
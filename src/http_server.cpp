@@ -1,31 +1,20 @@
 #include "http_server.hpp"
+#include "alloc_tracker.hpp"
+#include "cpu_profiler.hpp"
 #include "server_log.hpp"
+#include "metrics.hpp"
+#include "thread_placement.hpp"
 #include <sstream>
 #include <iomanip>
 #include <random>
+#include <algorithm>
 
 namespace mcp_logs {
 
-// HTTP constructor
-HttpServer::HttpServer(uint16_t port)
-    : server_(std::make_unique<httplib::Server>())
-    , port_(port)
-    , is_https_(false)
-{
-    setup_routes();
-}
-
-// HTTPS constructor
-HttpServer::HttpServer(uint16_t port, const std::string& cert_path, const std::string& key_path)
-    : server_(std::make_unique<httplib::SSLServer>(cert_path.c_str(), key_path.c_str()))
-    , port_(port)
-    , is_https_(true)
+HttpServer::HttpServer(uint16_t port, bool is_https)
+    : port_(port)
+    , is_https_(is_https)
 {
-    setup_routes();
-}
-
-HttpServer::~HttpServer() {
-    stop();
 }
 
 std::string HttpServer::generate_session_id() {
@@ -44,7 +33,237 @@ std::string HttpServer::generate_session_id() {
     return ss.str();
 }
 
-void HttpServer::setup_routes() {
+std::string HttpServer::endpoint_event(const std::string& session_id) {
+    // The data field should be the raw URL, not JSON
+    return "event: endpoint\ndata: /messages?session_id=" + session_id + "\n\n";
+}
+
+std::shared_ptr<HttpServer::SseClient> HttpServer::add_sse_client(const std::string& session_id,
+                                                                  std::function<void()> wake) {
+    auto client = std::make_shared<SseClient>();
+    client->session_id = session_id;
+    client->wake = std::move(wake);
+
+    auto lock = sse_mutex_.acquire("add_sse_client");
+    sse_clients_.push_back(client);
+    Metrics::set_gauge("mcp_sse_clients", static_cast<double>(sse_clients_.size()));
+    return client;
+}
+
+void HttpServer::remove_sse_client(const std::shared_ptr<SseClient>& client) {
+    bool last = false;
+    {
+        auto lock = sse_mutex_.acquire("remove_sse_client");
+        auto it = std::remove(sse_clients_.begin(), sse_clients_.end(), client);
+        if (it == sse_clients_.end()) return;
+        sse_clients_.erase(it, sse_clients_.end());
+        Metrics::set_gauge("mcp_sse_clients", static_cast<double>(sse_clients_.size()));
+        last = std::none_of(sse_clients_.begin(), sse_clients_.end(),
+                            [&](const auto& other) { return other->session_id == client->session_id; });
+    }
+    // Outside sse_mutex_: the handler may take its own locks
+    if (last && disconnect_handler_) {
+        disconnect_handler_(client->session_id);
+    }
+}
+
+size_t HttpServer::sse_client_count() {
+    auto lock = sse_mutex_.acquire("sse_client_count");
+    return sse_clients_.size();
+}
+
+bool HttpServer::has_sse_client(const std::string& session_id) {
+    auto lock = sse_mutex_.acquire("has_sse_client");
+    return std::any_of(sse_clients_.begin(), sse_clients_.end(),
+                       [&](const auto& client) { return client->session_id == session_id; });
+}
+
+std::deque<std::string> HttpServer::take_sse_events(SseClient& client, std::chrono::milliseconds wait) {
+    std::deque<std::string> pending;
+    auto lock = sse_mutex_.acquire("take_sse_events");
+    if (wait.count() > 0) {
+        sse_cv_.wait_for(lock, wait, [&client] { return !client.pending.empty(); });
+    }
+    pending.swap(client.pending);
+    return pending;
+}
+
+HttpServer::MessageResult HttpServer::accept_message(const std::string& session_id, const std::string& body) {
+    if (session_id.empty()) {
+        return {400, R"({"error":"Missing session_id"})"};
+    }
+
+    AllocScope alloc_scope(AllocSubsystem::Json);
+    try {
+        auto request_json = nlohmann::json::parse(body);
+
+        if (message_handler_) {
+            // Run on the executor; requests from one session stay in order
+            bool queued = executor_->submit_ordered(session_id, [this, request_json, session_id] {
+                auto response_json = message_handler_(request_json, session_id);
+
+                // Notifications get no response
+                if (!response_json.is_null()) {
+                    send_sse(session_id, "message", response_json);
+                }
+            }, kMaxQueuedMessages);
+            if (!queued) {
+                Metrics::increment("mcp_messages_rejected_total", {{"reason", "session_queue_full"}});
+                nlohmann::json error;
+                error["error"] = "Too many queued requests for this session (max " +
+                                 std::to_string(kMaxQueuedMessages) + ")";
+                return {429, error.dump()};
+            }
+        }
+
+        return {202, R"({"status":"accepted"})"};  // Accepted
+
+    } catch (const std::exception& e) {
+        nlohmann::json error;
+        error["error"] = e.what();
+        return {400, error.dump()};
+    }
+}
+
+bool HttpServer::is_loopback_address(const std::string& address) {
+    return address == "::1" || address.rfind("127.", 0) == 0 || address.rfind("::ffff:127.", 0) == 0;
+}
+
+HttpServer::MessageResult HttpServer::debug_profile(const std::string& remote_address, const std::string& seconds,
+                                                    const std::string& hz) {
+    if (!is_loopback_address(remote_address)) {
+        return {403, "Profiling is only available from localhost\n"};
+    }
+    if (!CpuProfiler::supported()) {
+        return {501, "CPU profiling is not supported on this platform\n"};
+    }
+
+    auto parse = [](const std::string& value, int fallback, int max) -> std::optional<int> {
+        if (value.empty()) return fallback;
+        if (value.size() > 6 || value.find_first_not_of("0123456789") != std::string::npos) return std::nullopt;
+        int n = std::stoi(value);
+        if (n < 1 || n > max) return std::nullopt;
+        return n;
+    };
+    auto duration = parse(seconds, kDefaultProfileSeconds,
+                          static_cast<int>(CpuProfiler::kMaxDuration.count()));
+    auto rate = parse(hz, CpuProfiler::kDefaultHz, CpuProfiler::kMaxHz);
+    if (!duration || !rate) {
+        return {400, "seconds must be 1-" + std::to_string(CpuProfiler::kMaxDuration.count()) +
+                     " and hz 1-" + std::to_string(CpuProfiler::kMaxHz) + "\n"};
+    }
+
+    ServerLog::log("Profiler", "Profiling for " + std::to_string(*duration) + "s at " +
+                   std::to_string(*rate) + " Hz for " + remote_address);
+    try {
+        auto stacks = CpuProfiler::profile(std::chrono::seconds(*duration), *rate);
+        if (!stacks) return {409, "A profile is already running\n"};
+        return {200, std::move(*stacks)};
+    } catch (const std::exception& e) {
+        ServerLog::error("Profiler", e.what());
+        return {500, std::string(e.what()) + "\n"};
+    }
+}
+
+void HttpServer::start_executor() {
+    executor_ = std::make_unique<WorkStealingPool>(worker_threads_);
+    ServerLog::log("HTTP", "MCP executor running " + std::to_string(executor_->thread_count()) + " threads");
+}
+
+void HttpServer::stop_executor() {
+    // Finish requests already accepted before the handler's owner goes away
+    executor_.reset();
+}
+
+ContentEncoding HttpServer::stream_encoding(const std::string& accept_encoding) const {
+    return compression_ ? negotiate_encoding(accept_encoding) : ContentEncoding::Identity;
+}
+
+ContentEncoding HttpServer::encode_body(std::string& body, const std::string& accept_encoding,
+                                        std::unique_ptr<Compressor>& compressor) const {
+    if (!compression_ || body.size() < compress_min_bytes_) return ContentEncoding::Identity;
+    ContentEncoding encoding = negotiate_encoding(accept_encoding);
+    if (encoding == ContentEncoding::Identity) return encoding;
+
+    if (!compressor || compressor->encoding() != encoding) {
+        compressor = std::make_unique<Compressor>(encoding);
+    }
+    std::string encoded = compressor->compress(body);
+    Metrics::increment("http_body_bytes_total", {{"encoding", encoding_name(encoding)}, {"stage", "raw"}},
+                       static_cast<double>(body.size()));
+    Metrics::increment("http_body_bytes_total", {{"encoding", encoding_name(encoding)}, {"stage", "sent"}},
+                       static_cast<double>(encoded.size()));
+    body = std::move(encoded);
+    return encoding;
+}
+
+std::string HttpServer::encode_stream(Compressor& compressor, const std::string& data) {
+    std::string encoded = compressor.flush(data);
+    const char* name = encoding_name(compressor.encoding());
+    Metrics::increment("http_body_bytes_total", {{"encoding", name}, {"stage", "raw"}},
+                       static_cast<double>(data.size()));
+    Metrics::increment("http_body_bytes_total", {{"encoding", name}, {"stage", "sent"}},
+                       static_cast<double>(encoded.size()));
+    return encoded;
+}
+
+void HttpServer::broadcast_sse(const std::string& event_type, const nlohmann::json& data) {
+    AllocScope alloc_scope(AllocSubsystem::Sse);
+    std::string message = "event: " + event_type + "\ndata: " + data.dump() + "\n\n";
+
+    {
+        auto lock = sse_mutex_.acquire("broadcast_sse");
+        for (auto& client : sse_clients_) {
+            client->pending.push_back(message);
+            if (client->pending.size() > kMaxPendingEvents) {
+                client->pending.pop_front();
+            }
+            if (client->wake) client->wake();
+        }
+    }
+    sse_cv_.notify_all();
+}
+
+void HttpServer::send_sse(const std::string& session_id, const std::string& event_type,
+                          const nlohmann::json& data) {
+    AllocScope alloc_scope(AllocSubsystem::Sse);
+    std::string message = "event: " + event_type + "\ndata: " + data.dump() + "\n\n";
+
+    {
+        auto lock = sse_mutex_.acquire("send_sse");
+        for (auto& client : sse_clients_) {
+            if (client->session_id != session_id) continue;
+            client->pending.push_back(message);
+            if (client->pending.size() > kMaxPendingEvents) {
+                client->pending.pop_front();   // Slow reader: drop the oldest
+            }
+            if (client->wake) client->wake();
+        }
+    }
+    sse_cv_.notify_all();
+}
+
+// HTTP constructor
+HttplibServer::HttplibServer(uint16_t port)
+    : HttpServer(port, false)
+    , server_(std::make_unique<httplib::Server>())
+{
+    setup_routes();
+}
+
+// HTTPS constructor
+HttplibServer::HttplibServer(uint16_t port, const std::string& cert_path, const std::string& key_path)
+    : HttpServer(port, true)
+    , server_(std::make_unique<httplib::SSLServer>(cert_path.c_str(), key_path.c_str()))
+{
+    setup_routes();
+}
+
+HttplibServer::~HttplibServer() {
+    stop();
+}
+
+void HttplibServer::setup_routes() {
     // Log 404s and other errors
     server_->set_error_handler([](const httplib::Request& req, httplib::Response& res) {
         std::stringstream msg;
@@ -62,11 +281,33 @@ void HttpServer::setup_routes() {
         ServerLog::log("HTTP", msg.str());
     });
 
+    // httplib's worker threads aren't ours to start; place each one on its
+    // first request
+    server_->set_pre_routing_handler([](const httplib::Request&, httplib::Response&) {
+        ThreadPlacement::adopt(ThreadRole::Http);
+        return httplib::Server::HandlerResponse::Unhandled;
+    });
+
     // Health check
     server_->Get("/health", [](const httplib::Request&, httplib::Response& res) {
         res.set_content(R"({"status":"ok"})", "application/json");
     });
 
+    // Prometheus metrics (query scheduler lanes, queue and run times)
+    server_->Get("/metrics", [this](const httplib::Request& req, httplib::Response& res) {
+        ThreadPlacement::publish_metrics();
+        LockProfiler::publish_metrics();
+        AllocTracker::publish_metrics();
+        set_body(req, res, Metrics::render(), "text/plain; version=0.0.4");
+    });
+
+    // Sampling CPU profile as collapsed stacks (localhost only)
+    server_->Get("/debug/profile", [this](const httplib::Request& req, httplib::Response& res) {
+        auto result = debug_profile(req.remote_addr, req.get_param_value("seconds"), req.get_param_value("hz"));
+        res.status = result.status;
+        set_body(req, res, std::move(result.body), "text/plain; charset=utf-8");
+    });
+
     // SSE endpoint for MCP at root (MCP clients expect event-stream at base URL)
     server_->Get("/", [this](const httplib::Request& req, httplib::Response& res) {
         std::string session_id = generate_session_id();
@@ -80,55 +321,69 @@ void HttpServer::setup_routes() {
         res.set_header("Connection", "keep-alive");
         res.set_header("Access-Control-Allow-Origin", "*");
 
+        // One compression stream per SSE connection, flushed after every event
+        ContentEncoding encoding = stream_encoding(req.get_header_value("Accept-Encoding"));
+        if (encoding != ContentEncoding::Identity) {
+            res.set_header("Content-Encoding", encoding_name(encoding));
+            res.set_header("Vary", "Accept-Encoding");
+        }
+
         res.set_chunked_content_provider(
             "text/event-stream",
-            [this, session_id](size_t offset, httplib::DataSink& sink) -> bool {
-                // Register this client
-                auto client = std::make_shared<SseClient>();
-                client->session_id = session_id;
-                client->sink = &sink;
-
-                {
-                    std::lock_guard<std::mutex> lock(sse_mutex_);
-                    sse_clients_.push_back(client);
+            [this, session_id, encoding](size_t offset, httplib::DataSink& sink) -> bool {
+                AllocScope alloc_scope(AllocSubsystem::Sse);   // This thread only streams events
+                std::unique_ptr<Compressor> compressor;
+                if (encoding != ContentEncoding::Identity) {
+                    compressor = std::make_unique<Compressor>(encoding);
                 }
+                auto write = [&](const std::string& data) {
+                    if (!compressor) return sink.write(data.c_str(), data.size());
+                    std::string wire = encode_stream(*compressor, data);
+                    return sink.write(wire.c_str(), wire.size());
+                };
+
+                // Register this client
+                auto client = add_sse_client(session_id);
 
                 // Send initial endpoint event per MCP spec
-                // The data field should be the raw URL, not JSON
-                std::stringstream ss;
-                ss << "event: endpoint\n";
-                ss << "data: /messages?session_id=" << session_id << "\n\n";
-                if (!sink.write(ss.str().c_str(), ss.str().size())) {
+                std::string endpoint = endpoint_event(session_id);
+                if (!write(endpoint)) {
                     ServerLog::error("HTTP", "Failed to send initial endpoint event: " + session_id);
+                    remove_sse_client(client);
                     return false;
                 }
                 ServerLog::log("HTTP", "Sent endpoint event, entering keep-alive loop: " + session_id);
 
-                // Keep connection alive until client disconnects
-                // Send periodic SSE comments as keep-alive pings for remote connections
-                int ping_counter = 0;
+                // Write queued events as they arrive, until the client disconnects.
+                // Only this thread writes to the sink. Send SSE comments as
+                // keep-alive pings after 15s of silence for remote connections.
+                auto last_write = std::chrono::steady_clock::now();
                 while (running_ && sink.is_writable()) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    auto pending = take_sse_events(*client, std::chrono::milliseconds(100));
 
-                    // Send keep-alive ping every 15 seconds (150 * 100ms)
-                    if (++ping_counter >= 150) {
-                        ping_counter = 0;
+                    bool lost = false;
+                    for (const auto& event : pending) {
+                        if (!write(event)) {
+                            lost = true;
+                            break;
+                        }
+                    }
+                    if (lost) break;  // Connection lost
+
+                    auto now = std::chrono::steady_clock::now();
+                    if (!pending.empty()) {
+                        last_write = now;
+                    } else if (now - last_write >= kPingInterval) {
+                        last_write = now;
                         std::string ping = ": ping\n\n";
-                        if (!sink.write(ping.c_str(), ping.size())) {
+                        if (!write(ping)) {
                             break;  // Connection lost
                         }
                     }
                 }
 
                 // Remove client on disconnect
-                {
-                    std::lock_guard<std::mutex> lock(sse_mutex_);
-                    sse_clients_.erase(
-                        std::remove_if(sse_clients_.begin(), sse_clients_.end(),
-                            [&session_id](const auto& c) { return c->session_id == session_id; }),
-                        sse_clients_.end()
-                    );
-                }
+                remove_sse_client(client);
 
                 ServerLog::log("HTTP", "SSE client disconnected: " + session_id);
                 return false;
@@ -142,40 +397,9 @@ void HttpServer::setup_routes() {
         res.set_header("Access-Control-Allow-Methods", "POST, OPTIONS");
         res.set_header("Access-Control-Allow-Headers", "Content-Type");
 
-        std::string session_id = req.get_param_value("session_id");
-        if (session_id.empty()) {
-            res.status = 400;
-            res.set_content(R"({"error":"Missing session_id"})", "application/json");
-            return;
-        }
-
-        try {
-            auto request_json = nlohmann::json::parse(req.body);
-
-            if (message_handler_) {
-                auto response_json = message_handler_(request_json, session_id);
-
-                // Send response via SSE
-                std::lock_guard<std::mutex> lock(sse_mutex_);
-                for (auto& client : sse_clients_) {
-                    if (client->session_id == session_id && client->sink->is_writable()) {
-                        std::stringstream ss;
-                        ss << "event: message\n";
-                        ss << "data: " << response_json.dump() << "\n\n";
-                        client->sink->write(ss.str().c_str(), ss.str().size());
-                    }
-                }
-            }
-
-            res.status = 202;  // Accepted
-            res.set_content(R"({"status":"accepted"})", "application/json");
-
-        } catch (const std::exception& e) {
-            res.status = 400;
-            nlohmann::json error;
-            error["error"] = e.what();
-            res.set_content(error.dump(), "application/json");
-        }
+        auto result = accept_message(req.get_param_value("session_id"), req.body);
+        res.status = result.status;
+        res.set_content(result.body, "application/json");
     });
 
     // CORS preflight
@@ -187,11 +411,26 @@ void HttpServer::setup_routes() {
     });
 }
 
-void HttpServer::start() {
+void HttplibServer::set_body(const httplib::Request& req, httplib::Response& res,
+                             std::string body, const char* content_type) {
+    // httplib runs each connection on its own thread, so a thread-local
+    // context is reused across that connection's keep-alive requests
+    thread_local std::unique_ptr<Compressor> compressor;
+    ContentEncoding encoding = encode_body(body, req.get_header_value("Accept-Encoding"), compressor);
+    if (encoding != ContentEncoding::Identity) {
+        res.set_header("Content-Encoding", encoding_name(encoding));
+    }
+    if (compression_enabled()) res.set_header("Vary", "Accept-Encoding");
+    res.set_content(body, content_type);
+}
+
+void HttplibServer::start() {
     if (running_) return;
     running_ = true;
+    start_executor();
 
     thread_ = std::thread([this]() {
+        ThreadPlacement::adopt(ThreadRole::Http);
         ServerLog::log(is_https_ ? "HTTPS" : "HTTP", "Server starting on port " + std::to_string(port_));
         server_->listen("0.0.0.0", port_);
     });
@@ -200,28 +439,15 @@ void HttpServer::start() {
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
 }
 
-void HttpServer::stop() {
+void HttplibServer::stop() {
     if (!running_) return;
     running_ = false;
+    CpuProfiler::cancel();
     server_->stop();
     if (thread_.joinable()) {
         thread_.join();
     }
-}
-
-void HttpServer::broadcast_sse(const std::string& event_type, const nlohmann::json& data) {
-    std::lock_guard<std::mutex> lock(sse_mutex_);
-
-    std::stringstream ss;
-    ss << "event: " << event_type << "\n";
-    ss << "data: " << data.dump() << "\n\n";
-    std::string message = ss.str();
-
-    for (auto& client : sse_clients_) {
-        if (client->sink->is_writable()) {
-            client->sink->write(message.c_str(), message.size());
-        }
-    }
+    stop_executor();
 }
 
 } // namespace mcp_logs
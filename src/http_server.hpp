@@ -1,13 +1,19 @@
 #pragma once
 
+#include "compression.hpp"
+#include "lock_profiler.hpp"
+#include "thread_pool.hpp"
 #include <httplib.h>
 #include <nlohmann/json.hpp>
 #include <functional>
 #include <string>
 #include <memory>
 #include <mutex>
+#include <condition_variable>
+#include <deque>
 #include <vector>
 #include <atomic>
+#include <chrono>
 #include <iostream>
 
 namespace mcp_logs {
@@ -15,50 +21,169 @@ namespace mcp_logs {
 // Forward declaration
 class McpServer;
 
+// MCP HTTP/SSE endpoint. This base class holds everything that does not
+// depend on the socket layer: session IDs, the SSE client registry and its
+// event queues, and handing POSTed messages to the executor. Backends
+// (HttplibServer, AsioHttpServer) serve the routes:
+//   GET /health, GET /metrics, GET / (SSE), POST /messages, OPTIONS /messages,
+//   GET /debug/profile
 class HttpServer {
 public:
     using MessageHandler = std::function<nlohmann::json(const nlohmann::json&, const std::string&)>;
 
-    // HTTP constructor
-    explicit HttpServer(uint16_t port = 8080);
+    virtual ~HttpServer() = default;
 
-    // HTTPS constructor
-    HttpServer(uint16_t port, const std::string& cert_path, const std::string& key_path);
+    void set_message_handler(MessageHandler handler) { message_handler_ = std::move(handler); }
 
-    ~HttpServer();
+    // Called with a session's ID once its SSE stream has closed, so owners of
+    // per-session state can drop it. Set before start().
+    using DisconnectHandler = std::function<void(const std::string&)>;
+    void set_disconnect_handler(DisconnectHandler handler) { disconnect_handler_ = std::move(handler); }
 
-    void set_message_handler(MessageHandler handler) { message_handler_ = std::move(handler); }
-    void start();
-    void stop();
+    // Threads executing MCP requests (0: hardware concurrency, at least 4).
+    // Takes effect on start().
+    void set_worker_threads(size_t threads) { worker_threads_ = threads; }
+
+    // Compress response bodies and SSE streams for clients that accept gzip
+    // or zstd. Bodies under min_bytes are sent as-is. Set before start().
+    static constexpr size_t kDefaultCompressMinBytes = 1024;
+    void set_compression(bool enabled, size_t min_bytes = kDefaultCompressMinBytes) {
+        compression_ = enabled;
+        compress_min_bytes_ = min_bytes;
+    }
+
+    virtual void start() = 0;
+    virtual void stop() = 0;
 
     // Send an SSE event to all connected clients
     void broadcast_sse(const std::string& event_type, const nlohmann::json& data);
 
+    // Queue an SSE event for one session; the backend writes it on the
+    // client's stream. Never blocks on the network, so it is safe to call
+    // from the insert path. Unknown sessions are ignored.
+    void send_sse(const std::string& session_id, const std::string& event_type, const nlohmann::json& data);
+
     // Get the next session ID
     std::string generate_session_id();
 
     bool is_https() const { return is_https_; }
 
-private:
-    void setup_routes();
+    // Currently open SSE streams
+    size_t sse_client_count();
+
+    // Whether the session still has an open SSE stream
+    bool has_sse_client(const std::string& session_id);
+
+protected:
+    HttpServer(uint16_t port, bool is_https);
+
+    struct SseClient {
+        std::string session_id;
+        std::deque<std::string> pending;   // Events waiting to be written (guarded by sse_mutex_)
+        std::function<void()> wake;        // Called (under sse_mutex_) when events are queued; may be empty
+    };
+
+    struct MessageResult {
+        int status;
+        std::string body;                  // JSON (text for debug_profile)
+    };
+
+    // Register an SSE stream. Backends that block a thread per stream pass no
+    // wake callback and poll with take_sse_events(); event-driven backends
+    // pass a callback that schedules a write.
+    std::shared_ptr<SseClient> add_sse_client(const std::string& session_id,
+                                              std::function<void()> wake = nullptr);
+    void remove_sse_client(const std::shared_ptr<SseClient>& client);
+
+    // Take the client's queued events, waiting up to `wait` for one to arrive
+    std::deque<std::string> take_sse_events(SseClient& client,
+                                            std::chrono::milliseconds wait = std::chrono::milliseconds(0));
+
+    // First event on every stream, per the MCP SSE transport
+    static std::string endpoint_event(const std::string& session_id);
+
+    // POST /messages: parse and submit to the executor. 202 on success, the
+    // response follows on the session's SSE stream. 429 when the session
+    // already has kMaxQueuedMessages waiting or running.
+    static constexpr size_t kMaxQueuedMessages = 16;   // As QuerySchedulerOptions::max_queued_per_session
+    MessageResult accept_message(const std::string& session_id, const std::string& body);
+
+    // GET /debug/profile?seconds=N&hz=H: run the CPU profiler (default 10 s
+    // at 99 Hz) and return collapsed stacks. Loopback clients only. Blocks
+    // for the duration; 409 while another profile runs.
+    static constexpr int kDefaultProfileSeconds = 10;
+    MessageResult debug_profile(const std::string& remote_address, const std::string& seconds,
+                                const std::string& hz);
+    static bool is_loopback_address(const std::string& address);
+
+    void start_executor();
+    void stop_executor();
+
+    // Encoding for an SSE stream, from the request's Accept-Encoding
+    // (Identity when compression is off)
+    ContentEncoding stream_encoding(const std::string& accept_encoding) const;
+
+    // Compress a whole response body in place if the client accepts it and
+    // it's over the threshold; returns the encoding applied. `compressor` is
+    // the connection's context, created or replaced as needed.
+    ContentEncoding encode_body(std::string& body, const std::string& accept_encoding,
+                                std::unique_ptr<Compressor>& compressor) const;
+
+    // Compress and flush one chunk of a stream opened with stream_encoding()
+    static std::string encode_stream(Compressor& compressor, const std::string& data);
+
+    bool compression_enabled() const { return compression_; }
+
+    static constexpr auto kPingInterval = std::chrono::seconds(15);   // SSE keep-alive after silence
 
-    // Use unique_ptr to hold either Server or SSLServer
-    std::unique_ptr<httplib::Server> server_;
     uint16_t port_;
-    std::thread thread_;
     std::atomic<bool> running_{false};
     bool is_https_{false};
 
+private:
     MessageHandler message_handler_;
+    DisconnectHandler disconnect_handler_;
 
-    // SSE client management
-    struct SseClient {
-        std::string session_id;
-        httplib::DataSink* sink;
-    };
-    std::mutex sse_mutex_;
+    bool compression_ = true;
+    size_t compress_min_bytes_ = kDefaultCompressMinBytes;
+
+    // Runs message_handler_ off the HTTP threads; POST /messages returns 202
+    // at once and the response follows on the session's SSE stream
+    size_t worker_threads_ = 0;
+    std::unique_ptr<WorkStealingPool> executor_;
+
+    static constexpr size_t kMaxPendingEvents = 1000;
+    ProfiledMutex sse_mutex_{"HttpServer::sse"};
+    std::condition_variable_any sse_cv_;   // Signalled when events are queued
     std::vector<std::shared_ptr<SseClient>> sse_clients_;
     std::atomic<uint64_t> session_counter_{0};
 };
 
+// cpp-httplib backend: thread per connection, so every open SSE stream holds
+// a thread for its lifetime
+class HttplibServer : public HttpServer {
+public:
+    // HTTP constructor
+    explicit HttplibServer(uint16_t port = 8080);
+
+    // HTTPS constructor
+    HttplibServer(uint16_t port, const std::string& cert_path, const std::string& key_path);
+
+    ~HttplibServer() override;
+
+    void start() override;
+    void stop() override;
+
+private:
+    void setup_routes();
+
+    // Set a response body, compressed when the client accepts it
+    void set_body(const httplib::Request& req, httplib::Response& res,
+                  std::string body, const char* content_type);
+
+    // Use unique_ptr to hold either Server or SSLServer
+    std::unique_ptr<httplib::Server> server_;
+    std::thread thread_;
+};
+
 } // namespace mcp_logs
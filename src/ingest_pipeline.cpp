@@ -0,0 +1,183 @@
+#ifdef MCP_LOGS_COROUTINES
+
+#include "ingest_pipeline.hpp"
+#include "cpu_profiler.hpp"
+#include "log_store.hpp"
+#include "metrics.hpp"
+#include "server_log.hpp"
+#include "thread_placement.hpp"
+#include <nlohmann/json.hpp>
+
+namespace mcp_logs {
+
+namespace {
+
+double now_seconds() {
+    auto now = std::chrono::system_clock::now();
+    return std::chrono::duration<double>(now.time_since_epoch()).count();
+}
+
+} // namespace
+
+IngestPipeline::IngestPipeline(LogStore& store, IngestPipelineOptions options)
+    : store_(store)
+    , options_(options)
+    , datagrams_(options.queue_capacity)
+    , entries_(options.queue_capacity)
+{
+    if (options_.threads == 0) options_.threads = 1;
+    if (options_.batch_size == 0) options_.batch_size = 1;
+}
+
+IngestPipeline::~IngestPipeline() {
+    stop();
+}
+
+void IngestPipeline::listen_udp(uint16_t port) {
+    // Each socket gets its own strand so stop() can close it safely
+    sockets_.push_back(std::make_unique<asio::ip::udp::socket>(
+        asio::make_strand(io_), asio::ip::udp::endpoint(asio::ip::udp::v4(), port)));
+    ServerLog::log("UDP", "Listening on port " + std::to_string(port) + " (coroutine pipeline)");
+}
+
+void IngestPipeline::start() {
+    if (running_) return;
+    running_ = true;
+
+    work_.emplace(io_.get_executor());
+    receivers_ = sockets_.size();
+    for (auto& socket : sockets_) {
+        asio::co_spawn(socket->get_executor(), receive(*socket), asio::detached);
+    }
+    asio::co_spawn(io_, parse(), asio::detached);
+    asio::co_spawn(io_, commit(), asio::detached);
+
+    for (size_t i = 0; i < options_.threads; i++) {
+        threads_.emplace_back([this] {
+            ThreadPlacement::adopt(ThreadRole::Ingest);
+            CpuProfiler::set_thread_label("udp");   // "writer" while committing
+            io_.run();
+        });
+    }
+}
+
+void IngestPipeline::stop() {
+    if (!running_) return;
+    running_ = false;
+
+    // Closing the sockets ends receive(); the last one closes datagrams_,
+    // which drains through parse() and commit() in turn
+    for (auto& socket : sockets_) {
+        asio::post(socket->get_executor(), [&socket] {
+            asio::error_code ec;
+            socket->close(ec);
+        });
+    }
+    if (sockets_.empty()) datagrams_.close();
+
+    work_.reset();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+    io_.restart();
+}
+
+bool IngestPipeline::submit(LogEntry entry) {
+    received_++;
+    if (entry.received_at == 0.0) entry.received_at = now_seconds();
+    return entries_.push_blocking(std::move(entry));
+}
+
+IngestPipelineStats IngestPipeline::stats() const {
+    IngestPipelineStats s;
+    s.received = received_;
+    s.parse_errors = parse_errors_;
+    s.committed = committed_;
+    s.batches = batches_;
+    s.commit_errors = commit_errors_;
+    return s;
+}
+
+asio::awaitable<void> IngestPipeline::receive(asio::ip::udp::socket& socket) {
+    std::vector<char> buffer(65536);
+    asio::ip::udp::endpoint remote;
+
+    for (;;) {
+        asio::error_code ec;
+        size_t bytes = co_await socket.async_receive_from(asio::buffer(buffer), remote,
+                                                          asio::redirect_error(asio::use_awaitable, ec));
+        if (ec == asio::error::operation_aborted || !socket.is_open()) break;
+        if (ec || bytes == 0) continue;
+
+        received_++;
+        if (capture_) capture_->write(std::string_view(buffer.data(), bytes));
+        // Suspends while parse is behind
+        if (!co_await datagrams_.push(std::string(buffer.data(), bytes))) break;
+    }
+
+    if (--receivers_ == 0) datagrams_.close();
+}
+
+asio::awaitable<void> IngestPipeline::parse() {
+    while (auto datagram = co_await datagrams_.pop()) {
+        LogEntry entry;
+        try {
+            entry = LogEntry::from_json(nlohmann::json::parse(*datagram));
+        } catch (const std::exception& e) {
+            parse_errors_++;
+            ServerLog::error("UDP", std::string("Failed to parse log: ") + e.what());
+            continue;
+        }
+        entry.received_at = now_seconds();
+
+        // Suspends while commit is behind
+        if (!co_await entries_.push(std::move(entry))) break;
+    }
+    entries_.close();
+}
+
+asio::awaitable<void> IngestPipeline::commit() {
+    asio::steady_timer timer(co_await asio::this_coro::executor);
+    std::vector<LogEntry> batch;
+    batch.reserve(options_.batch_size);
+
+    auto fill = [this, &batch] {
+        while (batch.size() < options_.batch_size) {
+            auto entry = entries_.try_pop();
+            if (!entry) break;
+            batch.push_back(std::move(*entry));
+        }
+    };
+
+    while (auto first = co_await entries_.pop()) {
+        batch.push_back(std::move(*first));
+        fill();
+        if (batch.size() < options_.batch_size && options_.batch_delay.count() > 0) {
+            // Give a partial batch a moment to fill rather than committing per log
+            timer.expires_after(options_.batch_delay);
+            asio::error_code ec;
+            co_await timer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+            fill();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        try {
+            CpuProfiler::LabelScope label("writer");
+            store_.insert_batch(batch);
+            committed_ += static_cast<int64_t>(batch.size());
+            batches_++;
+            Metrics::increment("ingest_committed_total", {}, static_cast<double>(batch.size()));
+        } catch (const std::exception& e) {
+            commit_errors_++;
+            ServerLog::error("Ingest", "Failed to commit " + std::to_string(batch.size()) + " logs: " + e.what());
+        }
+        Metrics::observe("ingest_commit_seconds",
+                         std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        batch.clear();
+    }
+}
+
+} // namespace mcp_logs
+
+#endif // MCP_LOGS_COROUTINES
@@ -0,0 +1,102 @@
+#pragma once
+
+#ifdef MCP_LOGS_COROUTINES
+
+#include "awaitable_queue.hpp"
+#include "datagram_capture.hpp"
+#include "log_entry.hpp"
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mcp_logs {
+
+class LogStore;
+
+struct IngestPipelineOptions {
+    size_t threads = 2;                          // io_context threads shared by all stages
+    size_t queue_capacity = 8192;                // Items buffered between two stages
+    size_t batch_size = 256;                     // Most entries per commit
+    std::chrono::milliseconds batch_delay{5};    // Longest wait for a partial batch to fill
+};
+
+struct IngestPipelineStats {
+    int64_t received = 0;                        // Datagrams and submitted entries
+    int64_t parse_errors = 0;
+    int64_t committed = 0;
+    int64_t batches = 0;
+    int64_t commit_errors = 0;                   // Failed batches (their entries are lost)
+};
+
+// Coroutine ingestion (C++20 builds with ENABLE_COROUTINES). Each stage is a
+// coroutine on a small fixed io_context pool, and bounded AwaitableQueues
+// sit between the stages:
+//
+//   receive (UDP) -> datagrams -> parse -> entries -> batch + commit
+//
+// When commit falls behind, the entries queue fills. Parse then blocks on
+// it, and receive stops reading the socket, so the kernel buffer absorbs or
+// drops the overflow. Commit uses LogStore::insert_batch: one transaction
+// per batch, published to LogStore subscribers after it commits. Each
+// stage runs one coroutine, so entries keep arrival order.
+class IngestPipeline {
+public:
+    explicit IngestPipeline(LogStore& store, IngestPipelineOptions options = {});
+    ~IngestPipeline();
+
+    IngestPipeline(const IngestPipeline&) = delete;
+    IngestPipeline& operator=(const IngestPipeline&) = delete;
+
+    // Receive JSON log datagrams on port (call before start). Throws if the
+    // port can't be bound.
+    void listen_udp(uint16_t port);
+
+    // Record every datagram received to capture (see UdpReceiver::set_capture)
+    void set_capture(CaptureWriter* capture) { capture_ = capture; }
+
+    void start();
+
+    // Stop receiving, commit everything already queued, then join
+    void stop();
+
+    // Feed an entry from a thread outside the pipeline (e.g. a file tailer).
+    // Blocks while the pipeline is full; false once stopped.
+    bool submit(LogEntry entry);
+
+    IngestPipelineStats stats() const;
+
+private:
+    asio::awaitable<void> receive(asio::ip::udp::socket& socket);
+    asio::awaitable<void> parse();
+    asio::awaitable<void> commit();
+
+    LogStore& store_;
+    IngestPipelineOptions options_;
+
+    asio::io_context io_;
+    std::optional<asio::executor_work_guard<asio::io_context::executor_type>> work_;   // Held while running
+    std::vector<std::unique_ptr<asio::ip::udp::socket>> sockets_;
+    CaptureWriter* capture_ = nullptr;
+    std::vector<std::thread> threads_;
+    std::atomic<bool> running_{false};
+    std::atomic<size_t> receivers_{0};           // receive() coroutines still running
+
+    AwaitableQueue<std::string> datagrams_;
+    AwaitableQueue<LogEntry> entries_;
+
+    std::atomic<int64_t> received_{0};
+    std::atomic<int64_t> parse_errors_{0};
+    std::atomic<int64_t> committed_{0};
+    std::atomic<int64_t> batches_{0};
+    std::atomic<int64_t> commit_errors_{0};
+};
+
+} // namespace mcp_logs
+
+#endif // MCP_LOGS_COROUTINES
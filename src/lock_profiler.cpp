@@ -0,0 +1,236 @@
+#include "lock_profiler.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <array>
+#include <memory>
+
+namespace mcp_logs {
+
+namespace {
+
+// Log2 buckets of nanoseconds: bucket 0 is under 1024 ns, bucket b covers
+// [2^(b+9), 2^(b+10)) ns. The last bucket takes everything from ~18 minutes.
+constexpr size_t kBuckets = 32;
+
+size_t bucket_for(uint64_t ns) {
+    size_t bucket = 0;
+    for (uint64_t v = ns >> 10; v && bucket < kBuckets - 1; v >>= 1) bucket++;
+    return bucket;
+}
+
+double seconds(uint64_t ns) {
+    return static_cast<double>(ns) / 1e9;
+}
+
+void raise_max(std::atomic<uint64_t>& max, uint64_t value) {
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+struct LockProfiler::SiteStats {
+    SiteStats(std::string mutex, std::string site) : mutex(std::move(mutex)), site(std::move(site)) {}
+
+    const std::string mutex;
+    const std::string site;
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> wait_ns{0};
+    std::atomic<uint64_t> wait_max_ns{0};
+    std::atomic<uint64_t> hold_ns{0};
+    std::atomic<uint64_t> hold_max_ns{0};
+    std::atomic<uint64_t> blocked_others_ns{0};
+    std::array<std::atomic<uint64_t>, kBuckets> wait_buckets{};   // Contended acquisitions only
+    std::array<std::atomic<uint64_t>, kBuckets> hold_buckets{};
+};
+
+namespace {
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<LockProfiler::SiteStats>> sites;   // Never shrinks; ProfiledMutex caches pointers
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// Upper bound of the bucket holding quantile q, capped at the largest value
+// seen. `total` counts samples not in the buckets, which are all zero.
+double quantile(const std::array<std::atomic<uint64_t>, kBuckets>& buckets, uint64_t total,
+                uint64_t max_ns, double q) {
+    uint64_t bucketed = 0;
+    for (const auto& b : buckets) bucketed += b.load(std::memory_order_relaxed);
+    if (total < bucketed) total = bucketed;
+    if (total == 0) return 0.0;
+
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = total - bucketed;   // Uncontended acquisitions waited 0 ns
+    if (seen >= rank) return 0.0;
+    for (size_t i = 0; i < kBuckets; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return seconds(std::min<uint64_t>(uint64_t{1} << (i + 10), max_ns));
+    }
+    return seconds(max_ns);
+}
+
+} // namespace
+
+LockProfiler::SiteStats* LockProfiler::site(const char* mutex, const char* site) {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& stats : r.sites) {
+        if (stats->mutex == mutex && stats->site == site) return stats.get();
+    }
+    r.sites.push_back(std::make_unique<SiteStats>(mutex, site));
+    return r.sites.back().get();
+}
+
+void LockProfiler::record_acquire(SiteStats* stats, uint64_t wait_ns, SiteStats* holder) {
+    stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (wait_ns == 0) return;
+
+    stats->contended.fetch_add(1, std::memory_order_relaxed);
+    stats->wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+    stats->wait_buckets[bucket_for(wait_ns)].fetch_add(1, std::memory_order_relaxed);
+    raise_max(stats->wait_max_ns, wait_ns);
+    if (holder) holder->blocked_others_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+}
+
+void LockProfiler::record_hold(SiteStats* stats, uint64_t hold_ns) {
+    stats->hold_ns.fetch_add(hold_ns, std::memory_order_relaxed);
+    stats->hold_buckets[bucket_for(hold_ns)].fetch_add(1, std::memory_order_relaxed);
+    raise_max(stats->hold_max_ns, hold_ns);
+}
+
+std::vector<LockSiteReport> LockProfiler::report() {
+    std::vector<LockSiteReport> out;
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& s : r.sites) {
+        uint64_t acquisitions = s->acquisitions.load(std::memory_order_relaxed);
+        if (acquisitions == 0) continue;
+
+        LockSiteReport site;
+        site.mutex = s->mutex;
+        site.site = s->site;
+        site.acquisitions = acquisitions;
+        site.contended = s->contended.load(std::memory_order_relaxed);
+        site.wait_seconds = seconds(s->wait_ns.load(std::memory_order_relaxed));
+        site.wait_max = seconds(s->wait_max_ns.load(std::memory_order_relaxed));
+        site.wait_p50 = quantile(s->wait_buckets, acquisitions, s->wait_max_ns.load(), 0.5);
+        site.wait_p99 = quantile(s->wait_buckets, acquisitions, s->wait_max_ns.load(), 0.99);
+        site.hold_seconds = seconds(s->hold_ns.load(std::memory_order_relaxed));
+        site.hold_max = seconds(s->hold_max_ns.load(std::memory_order_relaxed));
+        site.hold_p50 = quantile(s->hold_buckets, 0, s->hold_max_ns.load(), 0.5);
+        site.hold_p99 = quantile(s->hold_buckets, 0, s->hold_max_ns.load(), 0.99);
+        site.blocked_others_seconds = seconds(s->blocked_others_ns.load(std::memory_order_relaxed));
+        out.push_back(std::move(site));
+    }
+    std::sort(out.begin(), out.end(), [](const LockSiteReport& a, const LockSiteReport& b) {
+        if (a.wait_seconds != b.wait_seconds) return a.wait_seconds > b.wait_seconds;
+        return a.hold_seconds > b.hold_seconds;
+    });
+    return out;
+}
+
+void LockProfiler::publish_metrics() {
+    for (const auto& site : report()) {
+        Metrics::Labels labels = {{"mutex", site.mutex}, {"site", site.site}};
+        auto with_quantile = [&labels](const char* q) {
+            auto out = labels;
+            out.emplace_back("quantile", q);
+            return out;
+        };
+        Metrics::set_gauge("lock_acquisitions", static_cast<double>(site.acquisitions), labels);
+        Metrics::set_gauge("lock_contended", static_cast<double>(site.contended), labels);
+        Metrics::set_gauge("lock_wait_seconds_sum", site.wait_seconds, labels);
+        Metrics::set_gauge("lock_wait_seconds", site.wait_p50, with_quantile("0.5"));
+        Metrics::set_gauge("lock_wait_seconds", site.wait_p99, with_quantile("0.99"));
+        Metrics::set_gauge("lock_wait_seconds", site.wait_max, with_quantile("1"));
+        Metrics::set_gauge("lock_hold_seconds_sum", site.hold_seconds, labels);
+        Metrics::set_gauge("lock_hold_seconds", site.hold_p50, with_quantile("0.5"));
+        Metrics::set_gauge("lock_hold_seconds", site.hold_p99, with_quantile("0.99"));
+        Metrics::set_gauge("lock_hold_seconds", site.hold_max, with_quantile("1"));
+        Metrics::set_gauge("lock_blocked_others_seconds", site.blocked_others_seconds, labels);
+    }
+}
+
+void LockProfiler::reset() {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& s : r.sites) {
+        for (auto* counter : {&s->acquisitions, &s->contended, &s->wait_ns, &s->wait_max_ns,
+                              &s->hold_ns, &s->hold_max_ns, &s->blocked_others_ns}) {
+            counter->store(0, std::memory_order_relaxed);
+        }
+        for (auto& b : s->wait_buckets) b.store(0, std::memory_order_relaxed);
+        for (auto& b : s->hold_buckets) b.store(0, std::memory_order_relaxed);
+    }
+}
+
+#ifdef MCP_LOGS_LOCK_PROFILING
+
+LockProfiler::SiteStats* ProfiledMutex::stats_for(const char* site) {
+    auto find = [this, site](size_t count) -> LockProfiler::SiteStats* {
+        for (size_t i = 0; i < count; i++) {
+            if (site_keys_[i].load(std::memory_order_relaxed) == site) return site_stats_[i];
+        }
+        return nullptr;
+    };
+    if (auto* stats = find(site_count_.load(std::memory_order_acquire))) return stats;
+
+    // Miss: look again under cache_mutex_, in case another thread just added it
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    size_t count = site_count_.load(std::memory_order_relaxed);
+    if (auto* stats = find(count)) return stats;
+
+    LockProfiler::SiteStats* stats = LockProfiler::site(name_, site);
+    if (count < kSiteCache) {
+        site_stats_[count] = stats;
+        site_keys_[count].store(site, std::memory_order_relaxed);
+        site_count_.store(count + 1, std::memory_order_release);
+    }
+    return stats;
+}
+
+void ProfiledMutex::lock(const char* site) {
+    LockProfiler::SiteStats* stats = stats_for(site);
+    uint64_t wait_ns = 0;
+    LockProfiler::SiteStats* holder = nullptr;
+    if (!mutex_.try_lock()) {
+        holder = holder_.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        mutex_.lock();
+        wait_ns = static_cast<uint64_t>(std::max<int64_t>(1,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+    }
+    holder_.store(stats, std::memory_order_relaxed);
+    acquired_at_ = std::chrono::steady_clock::now();
+    LockProfiler::record_acquire(stats, wait_ns, holder);
+}
+
+bool ProfiledMutex::try_lock() {
+    if (!mutex_.try_lock()) return false;
+    LockProfiler::SiteStats* stats = stats_for(kUntagged);
+    holder_.store(stats, std::memory_order_relaxed);
+    acquired_at_ = std::chrono::steady_clock::now();
+    LockProfiler::record_acquire(stats, 0, nullptr);
+    return true;
+}
+
+void ProfiledMutex::unlock() {
+    LockProfiler::SiteStats* stats = holder_.load(std::memory_order_relaxed);
+    auto held = std::chrono::steady_clock::now() - acquired_at_;
+    mutex_.unlock();
+    // Recorded after unlocking so the bookkeeping doesn't lengthen the hold
+    LockProfiler::record_hold(stats, static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(held).count()));
+}
+
+#endif
+
+} // namespace mcp_logs
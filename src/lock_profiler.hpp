@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef MCP_LOGS_LOCK_PROFILING
+#include <array>
+#endif
+
+namespace mcp_logs {
+
+// Wait and hold times at one call site of a profiled mutex
+struct LockSiteReport {
+    std::string mutex;
+    std::string site;
+    uint64_t acquisitions = 0;
+    uint64_t contended = 0;              // Acquisitions that had to wait
+    double wait_seconds = 0.0;           // Total time spent waiting here
+    double wait_p50 = 0.0;
+    double wait_p99 = 0.0;
+    double wait_max = 0.0;
+    double hold_seconds = 0.0;           // Total time the lock was held from here
+    double hold_p50 = 0.0;
+    double hold_p99 = 0.0;
+    double hold_max = 0.0;
+    double blocked_others_seconds = 0.0; // Time other sites waited while this one held the lock
+};
+
+// Statistics collected by ProfiledMutex. Only gathered in builds with
+// ENABLE_LOCK_PROFILING; otherwise report() is empty.
+class LockProfiler {
+public:
+    static constexpr bool enabled() {
+#ifdef MCP_LOGS_LOCK_PROFILING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Every site that has taken a lock, most time spent waiting first
+    static std::vector<LockSiteReport> report();
+
+    // lock_acquisitions, lock_contended, lock_wait_seconds{quantile},
+    // lock_hold_seconds{quantile} and lock_blocked_others_seconds gauges,
+    // labelled {mutex,site}, for /metrics
+    static void publish_metrics();
+
+    // Zero all statistics (tests)
+    static void reset();
+
+    // Per-site counters; used by ProfiledMutex
+    struct SiteStats;
+    static SiteStats* site(const char* mutex, const char* site);
+    static void record_acquire(SiteStats* stats, uint64_t wait_ns, SiteStats* holder);
+    static void record_hold(SiteStats* stats, uint64_t hold_ns);
+};
+
+// std::mutex with a name, whose lock() can carry a call-site tag:
+//
+//   auto lock = mutex_.acquire("insert");
+//
+// With ENABLE_LOCK_PROFILING it records how long each site waited for the
+// lock, how long it held it, and which site was holding it while others
+// waited. Without it, this is a plain std::mutex and the tags compile away.
+// Untagged locks (std::lock_guard, condition variables) count under "other".
+class ProfiledMutex {
+public:
+    // constexpr so a static ProfiledMutex is usable during static init
+#ifdef MCP_LOGS_LOCK_PROFILING
+    constexpr explicit ProfiledMutex(const char* name) : name_(name) {}
+#else
+    constexpr explicit ProfiledMutex(const char*) {}
+#endif
+    ProfiledMutex(const ProfiledMutex&) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+#ifdef MCP_LOGS_LOCK_PROFILING
+    void lock() { lock(kUntagged); }
+    void lock(const char* site);
+    bool try_lock();
+    void unlock();
+#else
+    void lock() { mutex_.lock(); }
+    void lock(const char*) { mutex_.lock(); }
+    bool try_lock() { return mutex_.try_lock(); }
+    void unlock() { mutex_.unlock(); }
+#endif
+
+    // Lock for the life of the returned guard, tagged with `site` (a string
+    // literal)
+    std::unique_lock<ProfiledMutex> acquire(const char* site) {
+        lock(site);
+        return std::unique_lock<ProfiledMutex>(*this, std::adopt_lock);
+    }
+
+    // Sites this mutex resolves without the profiler's registry (tests)
+#ifdef MCP_LOGS_LOCK_PROFILING
+    size_t cached_sites() const { return site_count_.load(std::memory_order_acquire); }
+#else
+    size_t cached_sites() const { return 0; }
+#endif
+
+private:
+    std::mutex mutex_;
+
+#ifdef MCP_LOGS_LOCK_PROFILING
+    static constexpr const char* kUntagged = "other";
+
+    LockProfiler::SiteStats* stats_for(const char* site);
+
+    const char* name_;
+
+    // Written by the holding thread; waiters read holder_ to blame it
+    std::atomic<LockProfiler::SiteStats*> holder_{nullptr};
+    std::chrono::steady_clock::time_point acquired_at_{};
+
+    // Sites seen on this mutex, matched by pointer so a lock doesn't need
+    // the profiler's registry. Sized well above the busiest mutex (LogStore
+    // has about 20 sites); site_count_ only counts published slots, and
+    // cache_mutex_ serializes misses so racing threads don't add a site twice.
+    static constexpr size_t kSiteCache = 64;
+    std::mutex cache_mutex_;
+    std::atomic<size_t> site_count_{0};
+    std::array<std::atomic<const char*>, kSiteCache> site_keys_{};
+    std::array<LockProfiler::SiteStats*, kSiteCache> site_stats_{};
+#endif
+};
+
+} // namespace mcp_logs
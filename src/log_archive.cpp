@@ -0,0 +1,392 @@
+#include "log_archive.hpp"
+#include "metrics.hpp"
+#include "server_log.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <set>
+
+namespace mcp_logs {
+
+namespace {
+
+constexpr size_t kMaxCategories = 20;   // As LogStore::get_stats reports them
+constexpr int64_t kEstimatedRowBytes = 256;   // For archives not opened yet
+
+// Per-store filter for a merged page: every store returns its first
+// offset + limit rows, and the offset is applied after merging
+LogFilter widen(const LogFilter& filter) {
+    LogFilter wide = filter;
+    wide.offset = 0;
+    if (filter.limit >= 0) wide.limit = std::max(0, filter.offset) + filter.limit;
+    return wide;
+}
+
+void tag(std::vector<ArchivedLog>& out, const std::string& archive, std::vector<LogEntry> logs) {
+    for (auto& entry : logs) out.push_back({archive, std::move(entry)});
+}
+
+// Newest first, then the page the filter asks for
+void take_page(std::vector<ArchivedLog>& logs, const LogFilter& filter) {
+    std::stable_sort(logs.begin(), logs.end(), [](const ArchivedLog& a, const ArchivedLog& b) {
+        return a.entry.timestamp > b.entry.timestamp;
+    });
+    size_t offset = std::min(logs.size(), static_cast<size_t>(std::max(0, filter.offset)));
+    logs.erase(logs.begin(), logs.begin() + static_cast<std::ptrdiff_t>(offset));
+    if (filter.limit >= 0 && logs.size() > static_cast<size_t>(filter.limit)) {
+        logs.resize(static_cast<size_t>(filter.limit));
+    }
+}
+
+void add_stats(LogStats& total, const LogStats& stats) {
+    total.total_count += stats.total_count;
+    total.client_count += stats.client_count;
+    total.server_count += stats.server_count;
+    total.error_count += stats.error_count;
+    total.warning_count += stats.warning_count;
+    for (const auto& [category, count] : stats.by_category) total.by_category[category] += count;
+}
+
+void keep_top_categories(LogStats& stats) {
+    if (stats.by_category.size() <= kMaxCategories) return;
+    std::vector<std::pair<std::string, int64_t>> categories(stats.by_category.begin(), stats.by_category.end());
+    std::partial_sort(categories.begin(), categories.begin() + kMaxCategories, categories.end(),
+                      [](const auto& a, const auto& b) { return a.second > b.second; });
+    categories.resize(kMaxCategories);
+    stats.by_category = std::map<std::string, int64_t>(categories.begin(), categories.end());
+}
+
+int64_t file_mtime(const std::filesystem::path& path, std::error_code& ec) {
+    auto time = std::filesystem::last_write_time(path, ec);
+    return ec ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+} // namespace
+
+nlohmann::json archive_errors_to_json(const ArchiveErrors& errors) {
+    nlohmann::json failed = nlohmann::json::array();
+    for (const auto& [name, error] : errors) failed.push_back({{"archive", name}, {"error", error}});
+    return failed;
+}
+
+nlohmann::json ArchivedStats::to_json() const {
+    nlohmann::json j = total.to_json();
+    nlohmann::json per_archive = nlohmann::json::array();
+    for (const auto& [name, stats] : archives) {
+        per_archive.push_back({
+            {"archive", name},
+            {"total", stats.total_count},
+            {"errors", stats.error_count},
+            {"session_count", stats.session_count},
+            {"instance_count", stats.instance_count}
+        });
+    }
+    j["archives"] = per_archive;
+    if (!errors.empty()) j["archive_errors"] = archive_errors_to_json(errors);
+    return j;
+}
+
+LogArchives::LogArchives(std::string dir, std::string live_db_path, StorageSettings storage, size_t threads)
+    : dir_(std::move(dir))
+    , live_db_path_(std::move(live_db_path))
+    , storage_(std::move(storage))
+    , threads_(threads)
+{
+    if (!std::filesystem::is_directory(dir_)) {
+        throw std::runtime_error("Archive directory not found: " + dir_);
+    }
+}
+
+LogArchives::~LogArchives() = default;
+
+LogArchives::FileSignature LogArchives::signature_of(const std::string& path) {
+    FileSignature signature;
+    std::error_code ec;
+    signature.size = std::filesystem::file_size(path, ec);
+    if (ec) signature.size = 0;
+    signature.mtime = file_mtime(path, ec);
+    std::string wal = path + "-wal";
+    signature.wal_size = std::filesystem::file_size(wal, ec);
+    if (ec) signature.wal_size = 0;
+    signature.wal_mtime = file_mtime(wal, ec);
+    return signature;
+}
+
+std::vector<std::shared_ptr<LogArchives::Archive>> LogArchives::refresh() {
+    std::set<std::string> found;
+    std::error_code ec;
+    for (const auto& file : std::filesystem::directory_iterator(dir_, ec)) {
+        std::error_code file_ec;
+        if (!file.is_regular_file(file_ec) || file.path().extension() != ".db") continue;
+        if (std::filesystem::equivalent(file.path(), live_db_path_, file_ec)) continue;
+        found.insert(file.path().filename().string());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = archives_.begin(); it != archives_.end();) {
+        it = found.count(it->first) ? std::next(it) : archives_.erase(it);
+    }
+    for (const auto& name : found) {
+        if (archives_.count(name)) continue;
+        auto archive = std::make_shared<Archive>();
+        archive->name = name;
+        archive->path = (std::filesystem::path(dir_) / name).string();
+        archives_.emplace(name, std::move(archive));
+    }
+
+    if (!pool_ && !archives_.empty()) {
+        size_t threads = threads_;
+        if (threads == 0) {
+            threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), archives_.size());
+        }
+        pool_ = std::make_unique<WorkStealingPool>(threads, ThreadRole::Query);
+    }
+    if (!scan_pool_ && !archives_.empty()) {
+        size_t workers = std::max(1u, std::thread::hardware_concurrency());
+        scan_pool_ = std::make_unique<WorkStealingPool>(std::max<size_t>(1, workers - 1), ThreadRole::Query);
+    }
+
+    std::vector<std::shared_ptr<Archive>> archives;
+    archives.reserve(archives_.size());
+    for (const auto& [name, archive] : archives_) archives.push_back(archive);
+    Metrics::set_gauge("archives_attached", static_cast<double>(archives.size()));
+    return archives;
+}
+
+std::vector<std::string> LogArchives::names() {
+    std::vector<std::string> names;
+    for (const auto& archive : refresh()) names.push_back(archive->name);
+    return names;
+}
+
+LogStore& LogArchives::open(Archive& archive) {
+    FileSignature current = signature_of(archive.path);
+    if (archive.store && current == archive.signature) return *archive.store;
+
+    // New, or rewritten since it was opened: nothing cached still holds
+    archive.store.reset();
+    archive.stats.clear();
+    archive.sessions.clear();
+    archive.rows = -1;
+    try {
+        archive.store = std::make_unique<LogStore>(archive.path, storage_, StoreRole::Archive, scan_pool_.get());
+    } catch (const std::exception& e) {
+        if (archive.error != e.what()) {
+            ServerLog::error("Archive", "Can't read " + archive.path + ": " + e.what());
+        }
+        archive.error = e.what();
+        throw;
+    }
+    archive.error.clear();
+    archive.signature = current;
+    LogFilter all;
+    all.all_sessions = true;
+    archive.rows = archive.store->estimate_rows(all);
+    return *archive.store;
+}
+
+int64_t LogArchives::estimate_rows() {
+    int64_t rows = 0;
+    for (const auto& archive : refresh()) {
+        int64_t counted = archive->rows.load();
+        if (counted < 0) {
+            std::error_code ec;
+            auto size = std::filesystem::file_size(archive->path, ec);
+            counted = ec ? 0 : static_cast<int64_t>(size) / kEstimatedRowBytes;
+        }
+        rows += counted;
+    }
+    return rows;
+}
+
+template <typename T, typename Fn>
+std::vector<std::pair<std::optional<T>, std::string>> LogArchives::fan_out(
+    const std::vector<std::shared_ptr<Archive>>& archives, Fn fn, const std::function<void()>& local) {
+    std::vector<std::pair<std::optional<T>, std::string>> results(archives.size());
+
+    std::mutex done_mutex;
+    std::condition_variable done;
+    size_t remaining = archives.size();
+
+    for (size_t i = 0; i < archives.size(); i++) {
+        pool_->submit([&, i]() {
+            Archive& archive = *archives[i];
+            try {
+                std::lock_guard<std::mutex> lock(archive.mutex);
+                results[i].first = fn(archive, open(archive));
+            } catch (const std::exception& e) {
+                results[i].second = e.what();
+            }
+            std::lock_guard<std::mutex> lock(done_mutex);
+            if (--remaining == 0) done.notify_one();   // Under the lock: the waiter owns done
+        });
+    }
+
+    // Archive failures are reported per archive; the live store's propagate,
+    // but only once the pool no longer references this frame
+    std::exception_ptr local_error;
+    try {
+        local();
+    } catch (...) {
+        local_error = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done.wait(lock, [&] { return remaining == 0; });
+    if (local_error) std::rethrow_exception(local_error);
+    return results;
+}
+
+ArchivedLogs LogArchives::query(LogStore& live, const LogFilter& filter) {
+    auto archives = refresh();
+    LogFilter wide = widen(filter);
+
+    ArchivedLogs merged;
+    auto results = fan_out<std::vector<LogEntry>>(archives,
+        [&wide](Archive&, LogStore& store) { return store.query(wide); },
+        [&] { tag(merged.logs, "", live.query(wide)); });
+    for (size_t i = 0; i < archives.size(); i++) {
+        if (results[i].first) {
+            tag(merged.logs, archives[i]->name, std::move(*results[i].first));
+        } else {
+            merged.errors.emplace_back(archives[i]->name, results[i].second);
+        }
+    }
+    take_page(merged.logs, filter);
+    return merged;
+}
+
+ArchivedLogs LogArchives::search(LogStore& live, const std::string& query, const LogFilter& filter) {
+    auto archives = refresh();
+    LogFilter wide = widen(filter);
+
+    ArchivedLogs merged;
+    auto results = fan_out<std::vector<LogEntry>>(archives,
+        [&](Archive&, LogStore& store) { return store.search(query, wide); },
+        [&] { tag(merged.logs, "", live.search(query, wide)); });
+    for (size_t i = 0; i < archives.size(); i++) {
+        if (results[i].first) {
+            tag(merged.logs, archives[i]->name, std::move(*results[i].first));
+        } else {
+            merged.errors.emplace_back(archives[i]->name, results[i].second);
+        }
+    }
+    take_page(merged.logs, filter);
+    return merged;
+}
+
+ArchivedScan LogArchives::scan(LogStore& live, const LogFilter& filter, int64_t max_scan,
+                               const std::function<ScanResult(LogStore&, const LogFilter&, ScanBudget&)>& fn) {
+    auto archives = refresh();
+    LogFilter wide = widen(filter);
+
+    // One budget for every store, so the call scans at most max_scan rows
+    // (0: no cap) and rows a small store doesn't need go to the others
+    ScanBudget budget(max_scan);
+
+    ArchivedScan merged;
+    auto add = [&merged](const std::string& archive, ScanResult result) {
+        merged.scanned += result.scanned;
+        merged.matched += result.matched;
+        merged.truncated = merged.truncated || result.truncated;
+        tag(merged.logs, archive, std::move(result.logs));
+    };
+
+    auto results = fan_out<ScanResult>(archives,
+        [&](Archive&, LogStore& store) { return fn(store, wide, budget); },
+        [&] { add("", fn(live, wide, budget)); });
+    for (size_t i = 0; i < archives.size(); i++) {
+        if (results[i].first) {
+            add(archives[i]->name, std::move(*results[i].first));
+        } else {
+            merged.errors.emplace_back(archives[i]->name, results[i].second);
+        }
+    }
+    take_page(merged.logs, filter);
+    return merged;
+}
+
+ArchivedScan LogArchives::grep(LogStore& live, const std::string& pattern, bool ignore_case,
+                               const LogFilter& filter, int64_t max_scan) {
+    return scan(live, filter, max_scan, [&](LogStore& store, const LogFilter& wide, ScanBudget& budget) {
+        return store.grep(pattern, ignore_case, wide, budget);
+    });
+}
+
+ArchivedScan LogArchives::regex_search(LogStore& live, const std::string& pattern, bool ignore_case,
+                                       const LogFilter& filter, int64_t max_scan, const std::string& query) {
+    return scan(live, filter, max_scan, [&](LogStore& store, const LogFilter& wide, ScanBudget& budget) {
+        return store.regex_search(pattern, ignore_case, wide, budget, query);
+    });
+}
+
+ArchivedStats LogArchives::get_stats(LogStore& live, std::optional<std::string> source,
+                                     std::optional<double> since) {
+    auto archives = refresh();
+    std::string key = source ? "=" + *source : "*";
+
+    ArchivedStats merged;
+    auto results = fan_out<LogStats>(archives,
+        [&](Archive& archive, LogStore& store) {
+            // `since` is usually "the last few minutes", different every call: not cached
+            if (since) return store.get_stats(source, since);
+            if (const LogStats* cached = archive.stats.find(key)) {
+                cache_hits_++;
+                return *cached;
+            }
+            cache_misses_++;
+            LogStats stats = store.get_stats(source, since);
+            archive.stats.put(key, stats);
+            return stats;
+        },
+        [&] { merged.total = live.get_stats(source, since); });
+
+    for (size_t i = 0; i < archives.size(); i++) {
+        if (results[i].first) {
+            add_stats(merged.total, *results[i].first);
+            merged.archives.emplace_back(archives[i]->name, std::move(*results[i].first));
+        } else {
+            merged.errors.emplace_back(archives[i]->name, results[i].second);
+        }
+    }
+    keep_top_categories(merged.total);
+    Metrics::set_gauge("archive_cache_hits", static_cast<double>(cache_hits_));
+    Metrics::set_gauge("archive_cache_misses", static_cast<double>(cache_misses_));
+    return merged;
+}
+
+ArchivedSessions LogArchives::get_sessions(LogStore& live, std::optional<std::string> source) {
+    auto archives = refresh();
+    std::string key = source ? "=" + *source : "*";
+
+    ArchivedSessions merged;
+    auto& sessions = merged.sessions;
+    auto results = fan_out<std::vector<SessionInfo>>(archives,
+        [&](Archive& archive, LogStore& store) {
+            if (const auto* cached = archive.sessions.find(key)) {
+                cache_hits_++;
+                return *cached;
+            }
+            cache_misses_++;
+            auto found = store.get_sessions(source);
+            archive.sessions.put(key, found);
+            return found;
+        },
+        [&] {
+            for (auto& info : live.get_sessions(source)) sessions.push_back({"", std::move(info)});
+        });
+
+    for (size_t i = 0; i < archives.size(); i++) {
+        if (!results[i].first) {
+            merged.errors.emplace_back(archives[i]->name, results[i].second);
+            continue;
+        }
+        for (auto& info : *results[i].first) sessions.push_back({archives[i]->name, std::move(info)});
+    }
+    std::stable_sort(sessions.begin(), sessions.end(), [](const ArchivedSession& a, const ArchivedSession& b) {
+        return a.info.last_seen > b.info.last_seen;
+    });
+    return merged;
+}
+
+} // namespace mcp_logs
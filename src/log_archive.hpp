@@ -0,0 +1,211 @@
+#pragma once
+
+#include "log_store.hpp"
+#include "thread_pool.hpp"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace mcp_logs {
+
+// Archives that couldn't be read: file name and error
+using ArchiveErrors = std::vector<std::pair<std::string, std::string>>;
+
+// [{"archive", "error"}], for a response's "archive_errors"
+nlohmann::json archive_errors_to_json(const ArchiveErrors& errors);
+
+// A log from the live store (archive empty) or an attached archive
+struct ArchivedLog {
+    std::string archive;        // Archive file name
+    LogEntry entry;
+
+    nlohmann::json to_json() const {
+        nlohmann::json j = entry.to_json();
+        if (!archive.empty()) j["archive"] = archive;
+        return j;
+    }
+};
+
+struct ArchivedSession {
+    std::string archive;
+    SessionInfo info;
+
+    nlohmann::json to_json() const {
+        nlohmann::json j = info.to_json();
+        if (!archive.empty()) j["archive"] = archive;
+        return j;
+    }
+};
+
+struct ArchivedLogs {
+    std::vector<ArchivedLog> logs;    // Requested page, newest first
+    ArchiveErrors errors;
+};
+
+struct ArchivedScan {
+    std::vector<ArchivedLog> logs;    // Requested page of matches, newest first
+    int64_t scanned = 0;
+    int64_t matched = 0;
+    bool truncated = false;           // max_scan ran out before a store's candidates did
+    ArchiveErrors errors;
+};
+
+struct ArchivedSessions {
+    std::vector<ArchivedSession> sessions;   // By last received, newest first
+    ArchiveErrors errors;
+};
+
+// Stats over the live store and every archive. Sessions and instances can
+// recur across databases, so they aren't summed: total's session_count,
+// instance_count and current_session are the live store's, and each
+// archive's are in `archives`.
+struct ArchivedStats {
+    LogStats total;
+    std::vector<std::pair<std::string, LogStats>> archives;
+    ArchiveErrors errors;
+
+    nlohmann::json to_json() const;
+};
+
+// Historical databases (rotated logs.db files) in one directory, attached
+// read-only so queries across all sessions can include them. Each call
+// runs the live store on the calling thread and every archive on a thread
+// pool, then merges: logs newest first with limit and offset applied to
+// the merged result, counts summed, and a scan's max_scan drawn on by
+// every store as it goes (see ScanBudget). Archives that can't be read are reported in the result's
+// errors. Archives open on first use; files added to or removed from the
+// directory are picked up on the next call. Stats (without `since`) and
+// session lists are cached per archive and only recomputed when the file
+// changes.
+class LogArchives {
+public:
+    // Every *.db file in dir except live_db_path. threads 0: one per
+    // archive, up to the hardware concurrency.
+    LogArchives(std::string dir, std::string live_db_path, StorageSettings storage = {}, size_t threads = 0);
+    ~LogArchives();
+
+    LogArchives(const LogArchives&) = delete;
+    LogArchives& operator=(const LogArchives&) = delete;
+
+    const std::string& dir() const { return dir_; }
+
+    // Archive file names, sorted
+    std::vector<std::string> names();
+
+    ArchivedLogs query(LogStore& live, const LogFilter& filter);
+    ArchivedLogs search(LogStore& live, const std::string& query, const LogFilter& filter);
+    ArchivedScan grep(LogStore& live, const std::string& pattern, bool ignore_case, const LogFilter& filter,
+                      int64_t max_scan);
+    ArchivedScan regex_search(LogStore& live, const std::string& pattern, bool ignore_case,
+                              const LogFilter& filter, int64_t max_scan, const std::string& query = "");
+    ArchivedStats get_stats(LogStore& live, std::optional<std::string> source = std::nullopt,
+                            std::optional<double> since = std::nullopt);
+    ArchivedSessions get_sessions(LogStore& live, std::optional<std::string> source = std::nullopt);
+
+    // Rows in all archives, for query cost estimates: counted when each
+    // archive was opened, or guessed from the file size before that. Never
+    // waits for a read in progress.
+    int64_t estimate_rows();
+
+    // Calls answered from an archive's cache, and those that read the file
+    uint64_t cache_hits() const { return cache_hits_; }
+    uint64_t cache_misses() const { return cache_misses_; }
+
+private:
+    // Size and modification time of the database and its WAL
+    struct FileSignature {
+        uintmax_t size = 0;
+        int64_t mtime = 0;
+        uintmax_t wal_size = 0;
+        int64_t wal_mtime = 0;
+
+        bool operator==(const FileSignature& other) const {
+            return size == other.size && mtime == other.mtime && wal_size == other.wal_size &&
+                   wal_mtime == other.wal_mtime;
+        }
+        bool operator!=(const FileSignature& other) const { return !(*this == other); }
+    };
+
+    static constexpr size_t kMaxCachedKeys = 32;
+
+    // Values by key, dropping the oldest key once it holds kMaxCachedKeys
+    template <typename T>
+    struct KeyedCache {
+        std::map<std::string, T> values;
+        std::deque<std::string> order;           // Keys, oldest first
+
+        const T* find(const std::string& key) const {
+            auto it = values.find(key);
+            return it == values.end() ? nullptr : &it->second;
+        }
+        void put(const std::string& key, T value) {
+            if (values.count(key)) return;
+            if (values.size() >= kMaxCachedKeys) {
+                values.erase(order.front());
+                order.pop_front();
+            }
+            values.emplace(key, std::move(value));
+            order.push_back(key);
+        }
+        void clear() {
+            values.clear();
+            order.clear();
+        }
+    };
+
+    struct Archive {
+        std::string name;
+        std::string path;
+
+        std::mutex mutex;                        // Guards everything below
+        std::unique_ptr<LogStore> store;
+        FileSignature signature;
+        std::string error;                       // Why the last open failed
+        KeyedCache<LogStats> stats;              // By source
+        KeyedCache<std::vector<SessionInfo>> sessions;
+
+        std::atomic<int64_t> rows{-1};           // Counted at open, -1 until then
+    };
+
+    static FileSignature signature_of(const std::string& path);
+
+    // Current archives, after picking up directory changes
+    std::vector<std::shared_ptr<Archive>> refresh();
+
+    // The archive's store, reopened (and its caches dropped) if the file
+    // changed. Archive::mutex must be held. Throws if it can't be opened.
+    LogStore& open(Archive& archive);
+
+    // Run fn on every archive on the pool, and local on this thread
+    // meanwhile. Per archive, the result or why there is none.
+    template <typename T, typename Fn>
+    std::vector<std::pair<std::optional<T>, std::string>> fan_out(
+        const std::vector<std::shared_ptr<Archive>>& archives, Fn fn, const std::function<void()>& local);
+
+    // fn scans one store, drawing on a budget of max_scan rows shared by all
+    ArchivedScan scan(LogStore& live, const LogFilter& filter, int64_t max_scan,
+                      const std::function<ScanResult(LogStore&, const LogFilter&, ScanBudget&)>& fn);
+
+    std::string dir_;
+    std::string live_db_path_;
+    StorageSettings storage_;
+    size_t threads_;
+
+    std::mutex mutex_;
+    std::unique_ptr<WorkStealingPool> scan_pool_;   // Shared by every archive's scans; outlives the stores
+    std::map<std::string, std::shared_ptr<Archive>> archives_;   // By file name
+    std::unique_ptr<WorkStealingPool> pool_;
+
+    std::atomic<uint64_t> cache_hits_{0};
+    std::atomic<uint64_t> cache_misses_{0};
+};
+
+} // namespace mcp_logs
@@ -2,7 +2,10 @@
 
 #include <string>
 #include <optional>
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <limits>
 #include <vector>
 #include <nlohmann/json.hpp>
 
@@ -58,40 +61,15 @@ struct LogEntry {
     double received_at = 0.0;                 // Server receive timestamp
     std::string session_id;                   // Shared game session identifier
     std::string instance_id;                  // Unique app instance identifier
+    std::optional<int64_t> seq;               // Sender's sequence number, for gaps and reordering
+    std::optional<std::string> attrs;         // Structured attributes, a JSON object's text
+    int64_t template_id = 0;                  // Hash of the normalized message (see message_template_id)
+    double norm_time = 0.0;                   // timestamp on the server clock, corrected for instance skew
 
-    nlohmann::json to_json() const {
-        nlohmann::json j;
-        j["id"] = id;
-        j["source"] = source;
-        j["category"] = category;
-        j["verbosity"] = verbosity_to_string(verbosity);
-        j["message"] = message;
-        j["timestamp"] = timestamp;
-        j["received_at"] = received_at;
-        j["session_id"] = session_id;
-        j["instance_id"] = instance_id;
-        if (frame) j["frame"] = *frame;
-        if (file) j["file"] = *file;
-        if (line) j["line"] = *line;
-        return j;
-    }
-
-    static LogEntry from_json(const nlohmann::json& j) {
-        LogEntry entry;
-        if (j.contains("id")) entry.id = j["id"].get<int64_t>();
-        entry.source = j.value("source", "unknown");
-        entry.category = j.value("category", "LogTemp");
-        entry.verbosity = string_to_verbosity(j.value("verbosity", "Log"));
-        entry.message = j.value("message", "");
-        entry.timestamp = j.value("timestamp", 0.0);
-        entry.received_at = j.value("received_at", 0.0);
-        entry.session_id = j.value("session_id", "");
-        entry.instance_id = j.value("instance_id", "");
-        if (j.contains("frame")) entry.frame = j["frame"].get<int64_t>();
-        if (j.contains("file")) entry.file = j["file"].get<std::string>();
-        if (j.contains("line")) entry.line = j["line"].get<int>();
-        return entry;
-    }
+    // Generated from kLogFields (log_schema.hpp). from_json leaves the
+    // server-derived template_id and norm_time unset.
+    nlohmann::json to_json() const;
+    static LogEntry from_json(const nlohmann::json& j);
 };
 
 struct LogFilter {
@@ -107,6 +85,43 @@ struct LogFilter {
     int offset = 0;
 };
 
+// Result of a scan-based search (grep/regex) over message text
+struct ScanResult {
+    std::vector<LogEntry> logs;   // Requested page of matches, newest first
+    int64_t scanned = 0;          // Rows whose message was checked
+    int64_t matched = 0;          // Matches among scanned rows
+    bool truncated = false;       // Stopped at the scan cap before running out of rows
+};
+
+// Rows scans may still check. Stores scanning in parallel draw from one
+// budget, so rows one of them doesn't need go to the others.
+class ScanBudget {
+public:
+    // rows <= 0: no cap
+    explicit ScanBudget(int64_t rows)
+        : left_(rows > 0 ? rows : std::numeric_limits<int64_t>::max()) {}
+
+    ScanBudget(const ScanBudget&) = delete;
+    ScanBudget& operator=(const ScanBudget&) = delete;
+
+    // Up to `rows` rows of the budget, 0 once it's spent
+    int64_t take(int64_t rows) {
+        int64_t left = left_.load();
+        int64_t taken;
+        do {
+            taken = std::min(left, rows);
+            if (taken <= 0) return 0;
+        } while (!left_.compare_exchange_weak(left, left - taken));
+        return taken;
+    }
+
+    // Return rows taken but not scanned
+    void give_back(int64_t rows) { left_ += rows; }
+
+private:
+    std::atomic<int64_t> left_;
+};
+
 struct LogStats {
     int64_t total_count = 0;
     int64_t client_count = 0;
@@ -152,3 +167,5 @@ struct SessionInfo {
 };
 
 } // namespace mcp_logs
+
+#include "log_schema.hpp"   // Defines LogEntry::to_json and from_json
@@ -0,0 +1,304 @@
+#include "log_export.hpp"
+#include "alloc_tracker.hpp"
+#include "arrow_ipc.hpp"
+#include "log_schema.hpp"
+#include "server_log.hpp"
+#include "thread_placement.hpp"
+#include <sqlite3.h>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace mcp_logs {
+
+namespace {
+
+constexpr int64_t kProgressRows = 4096;
+
+// Read-only connection and statement, closed on every path out
+struct ExportCursor {
+    sqlite3* db = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+
+    ~ExportCursor() {
+        if (stmt) sqlite3_finalize(stmt);
+        if (db) sqlite3_close(db);
+    }
+
+    std::string error() const { return db ? sqlite3_errmsg(db) : "out of memory"; }
+};
+
+const char* column_text(sqlite3_stmt* stmt, int column) {
+    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+    return text ? text : "";
+}
+
+// Expand "latest" to the session of the newest row
+std::vector<std::string> resolve_sessions(sqlite3* db, const std::vector<std::string>& sessions) {
+    std::vector<std::string> resolved;
+    for (const auto& session : sessions) {
+        if (session != "latest") {
+            resolved.push_back(session);
+            continue;
+        }
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT session_id FROM logs ORDER BY id DESC LIMIT 1", -1, &stmt,
+                               nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW) {
+            resolved.push_back(column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    }
+    return resolved;
+}
+
+} // namespace
+
+ExportProgress export_logs(const std::string& db_path, const ExportOptions& options,
+                           const std::string& out_path, const ExportProgressFn& progress) {
+    ExportCursor cursor;
+    if (sqlite3_open_v2(db_path.c_str(), &cursor.db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Failed to open read-only connection: " + cursor.error());
+    }
+    sqlite3_busy_timeout(cursor.db, 5000);
+
+    auto sessions = resolve_sessions(cursor.db, options.sessions);
+    if (!options.sessions.empty() && sessions.empty()) {
+        sessions.push_back("");   // Only "latest" was asked for, and there are no logs
+    }
+
+    // Rows past the newest one now are left for a later export
+    int64_t max_id = 0;
+    {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(cursor.db, "SELECT MAX(id) FROM logs", -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW) {
+            max_id = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    std::ostringstream sql;
+    sql << "SELECT " << LogSchema::select_columns("", LogSchema::missing_columns(cursor.db)) << " FROM logs WHERE 1=1";
+    if (!sessions.empty()) {
+        sql << " AND session_id IN (";
+        for (size_t i = 0; i < sessions.size(); i++) sql << (i ? ", ?" : "?");
+        sql << ")";
+    }
+    if (options.since) sql << " AND timestamp >= ?";
+    if (options.until) sql << " AND timestamp <= ?";
+    if (options.source) sql << " AND source = ?";
+    sql << " AND id > ? AND id <= ? ORDER BY id LIMIT ?";
+
+    if (sqlite3_prepare_v2(cursor.db, sql.str().c_str(), -1, &cursor.stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare export query: " + cursor.error());
+    }
+    int param = 1;
+    for (const auto& session : sessions) {
+        sqlite3_bind_text(cursor.stmt, param++, session.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    if (options.since) sqlite3_bind_double(cursor.stmt, param++, *options.since);
+    if (options.until) sqlite3_bind_double(cursor.stmt, param++, *options.until);
+    if (options.source) sqlite3_bind_text(cursor.stmt, param++, options.source->c_str(), -1, SQLITE_TRANSIENT);
+    int range_param = param;
+    int64_t chunk_rows = std::max<int64_t>(1, options.chunk_rows);
+    sqlite3_bind_int64(cursor.stmt, range_param + 1, max_id);
+    sqlite3_bind_int64(cursor.stmt, range_param + 2, chunk_rows);
+
+    std::string partial_path = out_path + ".partial";
+    std::ofstream out(partial_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Failed to create export file: " + partial_path);
+    }
+
+    ExportProgress result;
+    try {
+        ArrowLogWriter writer(out, options.compression);
+
+        // One entry reused for every row, so its strings keep their capacity
+        LogEntry entry;
+        int64_t last_id = 0;
+        int64_t in_chunk = chunk_rows;
+        while (in_chunk == chunk_rows) {
+            // Each chunk is its own read transaction, ended by the reset
+            sqlite3_reset(cursor.stmt);
+            sqlite3_bind_int64(cursor.stmt, range_param, last_id);
+            in_chunk = 0;
+            int rc;
+            while ((rc = sqlite3_step(cursor.stmt)) == SQLITE_ROW) {
+                LogSchema::read(cursor.stmt, entry);
+                LogSchema::fill_derived(entry);
+                last_id = entry.id;
+                in_chunk++;
+
+                writer.add(entry);
+                if (progress && writer.rows() % kProgressRows == 0) {
+                    result = {writer.rows(), writer.batches(), writer.bytes_written()};
+                    if (!progress(result)) throw std::runtime_error("Export cancelled");
+                }
+            }
+            if (rc != SQLITE_DONE) {
+                throw std::runtime_error("Export query failed: " + cursor.error());
+            }
+        }
+        if (progress && !progress({writer.rows(), writer.batches(), writer.bytes_written()})) {
+            throw std::runtime_error("Export cancelled");
+        }
+
+        writer.finish();
+        out.close();
+        if (!out) throw std::runtime_error("Failed to write export file: " + partial_path);
+        result = {writer.rows(), writer.batches(), writer.bytes_written()};
+    } catch (...) {
+        out.close();
+        std::remove(partial_path.c_str());
+        throw;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(partial_path, out_path, ec);
+    if (ec) {
+        std::remove(partial_path.c_str());
+        throw std::runtime_error("Failed to rename export to " + out_path + ": " + ec.message());
+    }
+    return result;
+}
+
+ExportJobs::ExportJobs(std::string db_path, std::string export_dir, std::chrono::seconds retention)
+    : db_path_(std::move(db_path))
+    , export_dir_(std::move(export_dir))
+    , retention_(retention)
+{
+}
+
+ExportJobs::~ExportJobs() {
+    stop();
+}
+
+std::string ExportJobs::start(const ExportOptions& options, const std::string& file_name) {
+    if (file_name.empty() || file_name.find('/') != std::string::npos ||
+        file_name.find('\\') != std::string::npos || file_name == "." || file_name == "..") {
+        throw std::runtime_error("Export file name must be a plain file name: " + file_name);
+    }
+
+    std::string path = (std::filesystem::path(export_dir_) / file_name).string();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    prune_locked();
+    size_t running = 0;
+    for (const auto& [id, job] : jobs_) {
+        if (job->state == "running") {
+            running++;
+            if (job->path == path) {
+                throw std::runtime_error("An export to " + file_name + " is already running");
+            }
+        }
+    }
+    if (running >= kMaxRunningJobs) {
+        throw std::runtime_error("Too many exports running (" + std::to_string(running) + "); try again later");
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(export_dir_, ec);
+    if (ec) {
+        throw std::runtime_error("Failed to create export directory " + export_dir_ + ": " + ec.message());
+    }
+
+    auto job = std::make_unique<Job>();
+    job->id = "export-" + std::to_string(next_id_++);
+    job->path = path;
+    job->started = std::chrono::steady_clock::now();
+    Job& ref = *job;
+    ref.thread = std::thread(&ExportJobs::run, this, std::ref(ref), options);
+    jobs_.emplace(job->id, std::move(job));
+    return ref.id;
+}
+
+void ExportJobs::run(Job& job, ExportOptions options) {
+    ThreadPlacement::adopt(ThreadRole::Query);
+    AllocScope scope(AllocSubsystem::Query);
+
+    std::string state = "done";
+    std::string error;
+    try {
+        auto result = export_logs(db_path_, options, job.path, [this, &job](const ExportProgress& progress) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job.progress = progress;
+            return !job.cancel.load();
+        });
+        std::lock_guard<std::mutex> lock(mutex_);
+        job.progress = result;
+    } catch (const std::exception& e) {
+        state = job.cancel ? "cancelled" : "failed";
+        error = e.what();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    job.state = state;
+    job.error = error;
+    job.finished = std::chrono::steady_clock::now();
+    if (state == "done") {
+        ServerLog::log("Export", "Exported " + std::to_string(job.progress.rows) + " logs to " + job.path);
+    } else if (state == "failed") {
+        ServerLog::error("Export", "Export to " + job.path + " failed: " + error);
+    }
+}
+
+std::optional<nlohmann::json> ExportJobs::status(const std::string& job_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    prune_locked();
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end()) return std::nullopt;
+
+    const Job& job = *it->second;
+    auto end = job.state == "running" ? std::chrono::steady_clock::now() : job.finished;
+    nlohmann::json status = {
+        {"job_id", job.id},
+        {"state", job.state},
+        {"path", job.path},
+        {"rows", job.progress.rows},
+        {"batches", job.progress.batches},
+        {"bytes", job.progress.bytes},
+        {"elapsed_seconds", std::chrono::duration<double>(end - job.started).count()}
+    };
+    if (!job.error.empty()) status["error"] = job.error;
+    return status;
+}
+
+bool ExportJobs::cancel(const std::string& job_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end() || it->second->state != "running") return false;
+    it->second->cancel = true;
+    return true;
+}
+
+void ExportJobs::prune_locked() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = jobs_.begin(); it != jobs_.end();) {
+        Job& job = *it->second;
+        if (job.state == "running") {
+            ++it;
+            continue;
+        }
+        if (job.thread.joinable()) job.thread.join();
+        it = now - job.finished >= retention_ ? jobs_.erase(it) : std::next(it);
+    }
+}
+
+void ExportJobs::stop() {
+    std::vector<std::thread*> threads;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [id, job] : jobs_) {
+            job->cancel = true;
+            if (job->thread.joinable()) threads.push_back(&job->thread);
+        }
+    }
+    for (auto* thread : threads) thread->join();
+}
+
+} // namespace mcp_logs
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "compression.hpp"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mcp_logs {
+
+// Which rows an export covers. Filters combine with AND; sessions match any
+// listed ID, "latest" naming the most recent session.
+struct ExportOptions {
+    std::vector<std::string> sessions;        // Empty: every session
+    std::optional<double> since;              // Timestamp >=
+    std::optional<double> until;              // Timestamp <=
+    std::optional<std::string> source;
+    ContentEncoding compression = zstd_supported() ? ContentEncoding::Zstd : ContentEncoding::Identity;
+    int64_t chunk_rows = 50000;               // Rows read per read transaction
+};
+
+struct ExportProgress {
+    int64_t rows = 0;
+    int64_t batches = 0;
+    uint64_t bytes = 0;
+};
+
+// Stream the matching rows, oldest first, from db_path to out_path as an
+// Arrow IPC file (see ArrowLogWriter). Reads on its own read-only
+// connection, one row at a time, so memory stays at one record batch and
+// inserts are never blocked. Rows are read in id ranges of chunk_rows, each
+// in its own read transaction, so a long export doesn't stop WAL
+// checkpoints; it covers rows up to the newest one when it started, less
+// any cleared meanwhile. The file is written under a temporary name and
+// renamed when complete. progress is called every few thousand rows and
+// once before the footer; returning false cancels. Throws
+// std::runtime_error on failure or cancel.
+using ExportProgressFn = std::function<bool(const ExportProgress&)>;
+ExportProgress export_logs(const std::string& db_path, const ExportOptions& options,
+                           const std::string& out_path, const ExportProgressFn& progress = {});
+
+// Background exports into one directory, for the export_logs MCP tool.
+// Each job runs on its own thread in the query role. Finished jobs are
+// joined, and forgotten once they have been finished for `retention`.
+class ExportJobs {
+public:
+    static constexpr size_t kMaxRunningJobs = 2;
+    static constexpr std::chrono::seconds kDefaultRetention{600};
+
+    ExportJobs(std::string db_path, std::string export_dir,
+               std::chrono::seconds retention = kDefaultRetention);
+    ~ExportJobs();
+
+    ExportJobs(const ExportJobs&) = delete;
+    ExportJobs& operator=(const ExportJobs&) = delete;
+
+    // Start exporting to export_dir/file_name, returning the job ID. Throws
+    // std::runtime_error if file_name isn't a plain file name or too many
+    // jobs are running.
+    std::string start(const ExportOptions& options, const std::string& file_name);
+
+    // {job_id, state (running, done, failed, cancelled), path, rows, batches,
+    // bytes, elapsed_seconds, error}; nullopt for an unknown or expired job
+    std::optional<nlohmann::json> status(const std::string& job_id);
+
+    // Ask a running job to stop; false if it isn't running
+    bool cancel(const std::string& job_id);
+
+    // Cancel running jobs and wait for them
+    void stop();
+
+    const std::string& export_dir() const { return export_dir_; }
+
+private:
+    struct Job {
+        std::string id;
+        std::string path;
+        std::string state = "running";
+        std::string error;
+        ExportProgress progress;
+        std::chrono::steady_clock::time_point started;
+        std::chrono::steady_clock::time_point finished;
+        std::atomic<bool> cancel{false};
+        std::thread thread;
+    };
+
+    void run(Job& job, ExportOptions options);
+
+    // Join finished jobs' threads and drop those past retention_. mutex_
+    // must be held; a finished job's thread no longer takes it.
+    void prune_locked();
+
+    std::string db_path_;
+    std::string export_dir_;
+    std::chrono::seconds retention_;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<Job>> jobs_;
+    uint64_t next_id_ = 1;
+};
+
+} // namespace mcp_logs
@@ -0,0 +1,405 @@
+#pragma once
+
+#include "log_entry.hpp"
+#include "message_template.hpp"
+#include <sqlite3.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace mcp_logs {
+
+// How a field's C++ type is stored in SQLite and written as JSON. The code
+// generated from kLogFields calls these directly, one call per field.
+template <typename T>
+struct Codec;
+
+template <>
+struct Codec<int64_t> {
+    static constexpr const char* kSqlType = "INTEGER";
+    static void bind(sqlite3_stmt* stmt, int param, int64_t value) { sqlite3_bind_int64(stmt, param, value); }
+    static void read(sqlite3_stmt* stmt, int column, int64_t& out) { out = sqlite3_column_int64(stmt, column); }
+    static nlohmann::json to_json(int64_t value) { return value; }
+    static int64_t from_json(const nlohmann::json& j) { return j.get<int64_t>(); }
+};
+
+template <>
+struct Codec<int> {
+    static constexpr const char* kSqlType = "INTEGER";
+    static void bind(sqlite3_stmt* stmt, int param, int value) { sqlite3_bind_int(stmt, param, value); }
+    static void read(sqlite3_stmt* stmt, int column, int& out) { out = sqlite3_column_int(stmt, column); }
+    static nlohmann::json to_json(int value) { return value; }
+    static int from_json(const nlohmann::json& j) { return j.get<int>(); }
+};
+
+template <>
+struct Codec<double> {
+    static constexpr const char* kSqlType = "REAL";
+    static void bind(sqlite3_stmt* stmt, int param, double value) { sqlite3_bind_double(stmt, param, value); }
+    static void read(sqlite3_stmt* stmt, int column, double& out) { out = sqlite3_column_double(stmt, column); }
+    static nlohmann::json to_json(double value) { return value; }
+    static double from_json(const nlohmann::json& j) { return j.get<double>(); }
+};
+
+template <>
+struct Codec<std::string> {
+    static constexpr const char* kSqlType = "TEXT";
+    static void bind(sqlite3_stmt* stmt, int param, const std::string& value) {
+        sqlite3_bind_text(stmt, param, value.data(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+    }
+    // Assigns, so a reused entry keeps its capacity
+    static void read(sqlite3_stmt* stmt, int column, std::string& out) {
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+        out.assign(text ? text : "", static_cast<size_t>(sqlite3_column_bytes(stmt, column)));
+    }
+    static nlohmann::json to_json(const std::string& value) { return value; }
+    static std::string from_json(const nlohmann::json& j) { return j.get<std::string>(); }
+};
+
+template <>
+struct Codec<Verbosity> {
+    static constexpr const char* kSqlType = "INTEGER";
+    static void bind(sqlite3_stmt* stmt, int param, Verbosity value) {
+        sqlite3_bind_int(stmt, param, static_cast<int>(value));
+    }
+    static void read(sqlite3_stmt* stmt, int column, Verbosity& out) {
+        out = static_cast<Verbosity>(sqlite3_column_int(stmt, column));
+    }
+    static nlohmann::json to_json(Verbosity value) { return verbosity_to_string(value); }
+    static Verbosity from_json(const nlohmann::json& j) { return string_to_verbosity(j.get<std::string>()); }
+};
+
+// A 64-bit hash stored as INTEGER and written to JSON as 16 hex digits,
+// which JavaScript clients can't round to a different value
+struct HexIdCodec : Codec<int64_t> {
+    static nlohmann::json to_json(int64_t value) {
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(value));
+        return hex;
+    }
+    static int64_t from_json(const nlohmann::json& j) {
+        if (j.is_string()) return static_cast<int64_t>(std::strtoull(j.get<std::string>().c_str(), nullptr, 16));
+        return j.get<int64_t>();
+    }
+};
+
+// A JSON value stored as its serialized text
+struct JsonTextCodec : Codec<std::string> {
+    static nlohmann::json to_json(const std::string& value) {
+        auto parsed = nlohmann::json::parse(value, nullptr, false);
+        return parsed.is_discarded() ? nlohmann::json(value) : parsed;
+    }
+    static std::string from_json(const nlohmann::json& j) { return j.dump(); }
+};
+
+namespace detail {
+
+template <typename M>
+struct MemberOf;
+template <typename C, typename T>
+struct MemberOf<T C::*> {
+    using Value = T;
+};
+
+template <typename T>
+struct Nullable : std::false_type {
+    using Value = T;
+};
+template <typename T>
+struct Nullable<std::optional<T>> : std::true_type {
+    using Value = T;
+};
+
+template <auto Member>
+using DefaultCodec = Codec<typename Nullable<typename MemberOf<decltype(Member)>::Value>::Value>;
+
+} // namespace detail
+
+enum FieldFlags : unsigned {
+    kRowId = 1,     // INTEGER PRIMARY KEY: assigned by SQLite, never bound on insert
+    kDerived = 2,   // Computed by the server on insert: written to JSON, never read from it
+};
+
+// One LogEntry member and its logs column. std::optional members are
+// nullable columns, omitted from JSON when empty; the rest are NOT NULL.
+template <auto Member, typename C = detail::DefaultCodec<Member>>
+struct Field {
+    using Value = typename detail::MemberOf<decltype(Member)>::Value;
+    using ColumnCodec = C;
+    static constexpr bool kNullable = detail::Nullable<Value>::value;
+    static constexpr auto kMember = Member;
+
+    const char* name;
+    unsigned flags = 0;
+    const char* sql_default = nullptr;    // Required for NOT NULL columns added after the first schema
+    const char* json_default = nullptr;   // from_json value for a missing key, as a JSON string
+};
+
+// The logs table, in column order. New columns go at the end: existing
+// databases get them by ALTER TABLE ADD COLUMN, which appends.
+inline constexpr auto kLogFields = std::make_tuple(
+    Field<&LogEntry::id>{"id", kRowId},
+    Field<&LogEntry::source>{"source", 0, nullptr, "unknown"},
+    Field<&LogEntry::category>{"category", 0, nullptr, "LogTemp"},
+    Field<&LogEntry::verbosity>{"verbosity", 0, nullptr, "Log"},
+    Field<&LogEntry::message>{"message"},
+    Field<&LogEntry::timestamp>{"timestamp"},
+    Field<&LogEntry::frame>{"frame"},
+    Field<&LogEntry::file>{"file"},
+    Field<&LogEntry::line>{"line"},
+    Field<&LogEntry::received_at>{"received_at"},
+    Field<&LogEntry::session_id>{"session_id"},
+    Field<&LogEntry::instance_id>{"instance_id"},
+    Field<&LogEntry::seq>{"seq"},
+    Field<&LogEntry::attrs, JsonTextCodec>{"attrs"},
+    Field<&LogEntry::template_id, HexIdCodec>{"template_id", kDerived, "0"},
+    Field<&LogEntry::norm_time>{"norm_time", kDerived, "0"}
+);
+
+namespace detail {
+
+constexpr size_t kLogColumns = std::tuple_size_v<std::decay_t<decltype(kLogFields)>>;
+using LogColumns = std::make_index_sequence<kLogColumns>;
+
+// Insert parameter number of each column, 0 for the row ID
+template <size_t... I>
+constexpr std::array<int, kLogColumns> insert_params(std::index_sequence<I...>) {
+    const bool bound[] = {!(std::get<I>(kLogFields).flags & kRowId)...};
+    std::array<int, kLogColumns> params{};
+    int next = 1;
+    for (size_t i = 0; i < kLogColumns; i++) params[i] = bound[i] ? next++ : 0;
+    return params;
+}
+inline constexpr auto kInsertParams = insert_params(LogColumns{});
+
+template <typename F>
+std::string column_definition(const F& field) {
+    std::string def = field.name;
+    if (field.flags & kRowId) return def + " INTEGER PRIMARY KEY AUTOINCREMENT";
+    def += ' ';
+    def += F::ColumnCodec::kSqlType;
+    if (!F::kNullable) def += " NOT NULL";
+    if (field.sql_default) def += std::string(" DEFAULT ") + field.sql_default;
+    return def;
+}
+
+template <size_t I>
+void bind_field(sqlite3_stmt* stmt, const LogEntry& entry) {
+    using F = std::tuple_element_t<I, std::decay_t<decltype(kLogFields)>>;
+    constexpr int param = kInsertParams[I];
+    if constexpr (param != 0) {
+        const auto& value = entry.*F::kMember;
+        if constexpr (F::kNullable) {
+            if (value) {
+                F::ColumnCodec::bind(stmt, param, *value);
+            } else {
+                sqlite3_bind_null(stmt, param);
+            }
+        } else {
+            F::ColumnCodec::bind(stmt, param, value);
+        }
+    }
+}
+
+template <size_t I>
+void read_field(sqlite3_stmt* stmt, int column, LogEntry& entry) {
+    using F = std::tuple_element_t<I, std::decay_t<decltype(kLogFields)>>;
+    auto& value = entry.*F::kMember;
+    if constexpr (F::kNullable) {
+        if (sqlite3_column_type(stmt, column) == SQLITE_NULL) {
+            value.reset();
+        } else {
+            F::ColumnCodec::read(stmt, column, value.emplace());
+        }
+    } else {
+        F::ColumnCodec::read(stmt, column, value);
+    }
+}
+
+template <size_t I>
+void field_to_json(const LogEntry& entry, nlohmann::json& j) {
+    const auto& field = std::get<I>(kLogFields);
+    using F = std::decay_t<decltype(field)>;
+    const auto& value = entry.*F::kMember;
+    if constexpr (F::kNullable) {
+        if (value) j[field.name] = F::ColumnCodec::to_json(*value);
+    } else {
+        j[field.name] = F::ColumnCodec::to_json(value);
+    }
+}
+
+template <size_t I>
+void field_from_json(const nlohmann::json& j, LogEntry& entry) {
+    const auto& field = std::get<I>(kLogFields);
+    using F = std::decay_t<decltype(field)>;
+    if (field.flags & kDerived) return;
+    auto it = j.find(field.name);
+    if (it != j.end() && !it->is_null()) {
+        entry.*F::kMember = F::ColumnCodec::from_json(*it);
+    } else if (field.json_default) {
+        entry.*F::kMember = F::ColumnCodec::from_json(nlohmann::json(field.json_default));
+    }
+}
+
+template <size_t... I>
+std::vector<std::string> column_definitions(std::index_sequence<I...>) {
+    return {column_definition(std::get<I>(kLogFields))...};
+}
+
+template <size_t... I>
+void bind_fields(sqlite3_stmt* stmt, const LogEntry& entry, std::index_sequence<I...>) {
+    (bind_field<I>(stmt, entry), ...);
+}
+
+template <size_t... I>
+void read_fields(sqlite3_stmt* stmt, int first_column, LogEntry& entry, std::index_sequence<I...>) {
+    (read_field<I>(stmt, first_column + static_cast<int>(I), entry), ...);
+}
+
+template <size_t... I>
+void fields_to_json(const LogEntry& entry, nlohmann::json& j, std::index_sequence<I...>) {
+    (field_to_json<I>(entry, j), ...);
+}
+
+template <size_t... I>
+void fields_from_json(const nlohmann::json& j, LogEntry& entry, std::index_sequence<I...>) {
+    (field_from_json<I>(j, entry), ...);
+}
+
+template <size_t... I>
+constexpr std::array<const char*, kLogColumns> column_names(std::index_sequence<I...>) {
+    return {std::get<I>(kLogFields).name...};
+}
+inline constexpr auto kColumnNames = column_names(LogColumns{});
+
+template <size_t... I>
+constexpr std::array<const char*, kLogColumns> sql_defaults(std::index_sequence<I...>) {
+    return {std::get<I>(kLogFields).sql_default...};
+}
+inline constexpr auto kSqlDefaults = sql_defaults(LogColumns{});
+
+} // namespace detail
+
+// SQL, binds, row reads and JSON for LogEntry, all generated from
+// kLogFields. Binding and reading are unrolled at compile time into one
+// direct sqlite3 call per column; the SQL text is built once.
+class LogSchema {
+public:
+    static constexpr size_t kColumns = detail::kLogColumns;
+
+    static const std::string& create_table_sql() {
+        static const std::string sql = [] {
+            std::string s = "CREATE TABLE IF NOT EXISTS logs (";
+            auto defs = detail::column_definitions(detail::LogColumns{});
+            for (size_t i = 0; i < defs.size(); i++) s += (i ? ", " : "") + defs[i];
+            return s + ")";
+        }();
+        return sql;
+    }
+
+    // Parameters follow table order, bound by bind()
+    static const std::string& insert_sql() {
+        static const std::string sql = [] {
+            std::string columns;
+            std::string params;
+            for (size_t i = 0; i < kColumns; i++) {
+                if (!detail::kInsertParams[i]) continue;
+                columns += (columns.empty() ? "" : ", ") + std::string(detail::kColumnNames[i]);
+                params += params.empty() ? "?" : ", ?";
+            }
+            return "INSERT INTO logs (" + columns + ") VALUES (" + params + ")";
+        }();
+        return sql;
+    }
+
+    // Every column, for reading with read(). prefix qualifies each name
+    // ("l."); columns in missing (an older database that can't be migrated)
+    // are selected as their default instead.
+    static std::string select_columns(const std::string& prefix = "", const std::vector<std::string>& missing = {}) {
+        std::string columns;
+        for (size_t i = 0; i < kColumns; i++) {
+            std::string name = detail::kColumnNames[i];
+            if (i) columns += ", ";
+            if (std::find(missing.begin(), missing.end(), name) == missing.end()) {
+                columns += prefix + name;
+            } else {
+                columns += std::string(detail::kSqlDefaults[i] ? detail::kSqlDefaults[i] : "NULL") + " AS " + name;
+            }
+        }
+        return columns;
+    }
+
+    // Columns db's logs table lacks, in table order
+    static std::vector<std::string> missing_columns(sqlite3* db) {
+        std::vector<std::string> present;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "PRAGMA table_info(logs)", -1, &stmt, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                present.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+            }
+        }
+        sqlite3_finalize(stmt);
+
+        std::vector<std::string> missing;
+        for (const char* name : detail::kColumnNames) {
+            if (std::find(present.begin(), present.end(), name) == present.end()) missing.emplace_back(name);
+        }
+        return missing;
+    }
+
+    // ALTER TABLE statement adding column name
+    static std::string add_column_sql(const std::string& name) {
+        auto defs = detail::column_definitions(detail::LogColumns{});
+        for (size_t i = 0; i < kColumns; i++) {
+            if (name == detail::kColumnNames[i]) return "ALTER TABLE logs ADD COLUMN " + defs[i];
+        }
+        return {};
+    }
+
+    // Bind entry to a statement prepared from insert_sql()
+    static void bind(sqlite3_stmt* stmt, const LogEntry& entry) {
+        detail::bind_fields(stmt, entry, detail::LogColumns{});
+    }
+
+    // Read the row's select_columns() into entry, starting at first_column
+    static void read(sqlite3_stmt* stmt, LogEntry& entry, int first_column = 0) {
+        detail::read_fields(stmt, first_column, entry, detail::LogColumns{});
+    }
+
+    static nlohmann::json to_json(const LogEntry& entry) {
+        nlohmann::json j = nlohmann::json::object();
+        detail::fields_to_json(entry, j, detail::LogColumns{});
+        return j;
+    }
+
+    static LogEntry from_json(const nlohmann::json& j) {
+        LogEntry entry;
+        detail::fields_from_json(j, entry, detail::LogColumns{});
+        return entry;
+    }
+
+    // Rows written before template_id and norm_time existed hold 0 in them:
+    // derive them on read, so every path reports the same values
+    static void fill_derived(LogEntry& entry) {
+        if (entry.template_id == 0) entry.template_id = message_template_id(entry.message);
+        if (entry.norm_time == 0.0) entry.norm_time = entry.timestamp != 0.0 ? entry.timestamp : entry.received_at;
+    }
+};
+
+inline nlohmann::json LogEntry::to_json() const {
+    return LogSchema::to_json(*this);
+}
+
+inline LogEntry LogEntry::from_json(const nlohmann::json& j) {
+    return LogSchema::from_json(j);
+}
+
+} // namespace mcp_logs
@@ -1,26 +1,175 @@
 #include "log_store.hpp"
+#include "log_schema.hpp"
+#include "message_template.hpp"
+#include "regex_matcher.hpp"
+#include "substring_search.hpp"
+#include "thread_placement.hpp"
 #include <stdexcept>
 #include <sstream>
 #include <chrono>
+#include <condition_variable>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <tuple>
 
 namespace mcp_logs {
 
-LogStore::LogStore(const std::string& db_path) {
-    int rc = sqlite3_open(db_path.c_str(), &db_);
+namespace {
+
+// Rows scanned per batch, and the smallest share worth a thread of its own
+constexpr size_t kScanBatchRows = 16384;
+constexpr size_t kScanRowsPerWorker = 2048;
+
+// Newest rows find_similar's index is built from, so a huge table doesn't
+// take minutes (and gigabytes) to index
+constexpr int64_t kSimilarityLoadRows = 1000000;
+
+// Add rows with ids in (after_id, up_to_id] to a similarity index
+void add_similar_rows(sqlite3* db, int64_t after_id, int64_t up_to_id, SimilarityIndex& index) {
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db,
+        "SELECT id, message, timestamp, session_id FROM logs WHERE id > ? AND id <= ? ORDER BY id",
+        -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare similarity index load: " + std::string(sqlite3_errmsg(db)));
+    }
+    sqlite3_bind_int64(stmt, 1, after_id);
+    sqlite3_bind_int64(stmt, 2, up_to_id);
+
+    LogEntry entry;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        entry.id = sqlite3_column_int64(stmt, 0);
+        entry.message.assign(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+                             sqlite3_column_bytes(stmt, 1));
+        entry.timestamp = sqlite3_column_double(stmt, 2);
+        entry.session_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        index.add(entry);
+    }
+    sqlite3_finalize(stmt);
+}
+
+// Threads that share a scan batch: the caller plus the pool's workers
+size_t scan_workers() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Run fn(i) for i in [0, count), split across the pool for large counts. The
+// calling thread takes the first chunk and then waits for the rest.
+template<typename F, typename Pool>
+void parallel_for(size_t count, F&& fn, Pool&& pool) {
+    size_t workers = std::min<size_t>(scan_workers(), count / kScanRowsPerWorker);
+    if (workers <= 1) {
+        for (size_t i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    size_t pending = workers - 1;
+    size_t chunk = (count + workers - 1) / workers;
+    WorkStealingPool& executor = pool();
+    for (size_t w = 1; w < workers; w++) {
+        size_t begin = w * chunk;
+        size_t end = std::min(count, begin + chunk);
+        executor.submit([&, begin, end]() {
+            for (size_t i = begin; i < end; i++) fn(i);
+            std::lock_guard<std::mutex> lock(done_mutex);
+            if (--pending == 0) done_cv.notify_one();
+        });
+    }
+    for (size_t i = 0; i < std::min(count, chunk); i++) fn(i);
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&] { return pending == 0; });
+}
+
+} // namespace
+
+LogStore::LogStore(const std::string& db_path, const StorageSettings& storage, StoreRole role,
+                   WorkStealingPool* scan_pool)
+    : role_(role)
+    , shared_scan_pool_(scan_pool)
+{
+    // A follower needs the file to exist, and write access to the WAL index
+    // (-shm) that it shares with the primary, even though it never writes
+    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+    if (role == StoreRole::Follower) flags = SQLITE_OPEN_READWRITE;
+    if (role == StoreRole::Archive) flags = SQLITE_OPEN_READONLY;
+    int rc = sqlite3_open_v2(db_path.c_str(), &db_, flags, nullptr);
     if (rc != SQLITE_OK) {
-        std::string err = sqlite3_errmsg(db_);
+        std::string err = db_ ? sqlite3_errmsg(db_) : "out of memory";
         sqlite3_close(db_);
+        db_ = nullptr;
         throw std::runtime_error("Failed to open database: " + err);
     }
 
-    // Enable WAL mode for better concurrent access
-    exec("PRAGMA journal_mode=WAL");
-    exec("PRAGMA synchronous=NORMAL");
+    // Before anything touches the file, so a new database gets the page size
+    apply_storage_settings(db_, storage);
 
-    init_schema();
+    std::vector<std::string> missing_columns;
+
+    if (role != StoreRole::Primary) {
+        if (role == StoreRole::Follower) exec("PRAGMA query_only=1");
+        sqlite3_busy_timeout(db_, 5000);
+
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db_, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'logs'",
+                           -1, &stmt, nullptr);
+        bool has_schema = stmt && sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+        if (!has_schema) {
+            sqlite3_close(db_);
+            db_ = nullptr;
+            throw std::runtime_error("No logs table in " + db_path +
+                                     (role == StoreRole::Follower ? "; start the primary first" : ""));
+        }
+
+        // An older database is read as is; columns it lacks read as their defaults
+        missing_columns = LogSchema::missing_columns(db_);
+
+        // One snapshot, so the estimates and the follow position agree
+        exec("BEGIN");
+        refresh_latest_session();
+        load_row_estimates();
+        std::tie(followed_min_id_, followed_id_) = id_range();
+        followed_clear_generation_ = clear_generation();
+        exec("COMMIT");
+    } else {
+        // Enable WAL mode for better concurrent access
+        exec("PRAGMA journal_mode=WAL");
+        exec("PRAGMA synchronous=NORMAL");
+
+        init_schema();
+        refresh_latest_session();
+        load_row_estimates();
+    }
+    select_columns_ = LogSchema::select_columns("", missing_columns);
+    fts_select_columns_ = LogSchema::select_columns("l.", missing_columns);
+    storage_ = effective_storage_settings(db_, storage.profile);
+
+    // The session being written when the server stopped is likely to carry
+    // on; later sessions are indexed from their first row (see index_entry)
+    if (role != StoreRole::Archive && has_rows_) load_session_index(latest_session_);
+
+    // Read-only connection for agent SQL, opened once the schema exists.
+    // Same cache and mmap sizing, so large aggregations benefit too.
+    // sql_query only ever reaches the live store, so archives skip it.
+    if (role != StoreRole::Archive) {
+        sql_sandbox_ = std::make_unique<SqlSandbox>(db_path, std::set<std::string>{"logs", "logs_fts"},
+                                                    storage.pragmas());
+    }
 }
 
 LogStore::~LogStore() {
+    // Persist digests of sessions that were still live
+    try {
+        for (const auto& [session_id, digest] : digests_) {
+            store_digest(digest);
+        }
+    } catch (const std::exception&) {
+    }
+
     if (db_) {
         sqlite3_close(db_);
     }
@@ -37,22 +186,12 @@ void LogStore::exec(const std::string& sql) {
 }
 
 void LogStore::init_schema() {
-    exec(R"(
-        CREATE TABLE IF NOT EXISTS logs (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            source TEXT NOT NULL,
-            category TEXT NOT NULL,
-            verbosity INTEGER NOT NULL,
-            message TEXT NOT NULL,
-            timestamp REAL NOT NULL,
-            frame INTEGER,
-            file TEXT,
-            line INTEGER,
-            received_at REAL NOT NULL,
-            session_id TEXT NOT NULL,
-            instance_id TEXT NOT NULL
-        )
-    )");
+    exec(LogSchema::create_table_sql());
+
+    // Columns added since the database was created (see kLogFields)
+    for (const auto& column : LogSchema::missing_columns(db_)) {
+        exec(LogSchema::add_column_sql(column));
+    }
 
     exec("CREATE INDEX IF NOT EXISTS idx_logs_source ON logs(source)");
     exec("CREATE INDEX IF NOT EXISTS idx_logs_verbosity ON logs(verbosity)");
@@ -72,6 +211,25 @@ void LogStore::init_schema() {
         )
     )");
 
+    // Final per-session digests (JSON), written when a session goes idle
+    exec(R"(
+        CREATE TABLE IF NOT EXISTS session_digests (
+            session_id TEXT PRIMARY KEY,
+            digest TEXT NOT NULL,
+            log_count INTEGER NOT NULL,
+            finalized_at REAL NOT NULL
+        )
+    )");
+
+    // Counters other processes watch, e.g. clear_generation, bumped by clear()
+    // so followers notice deletes that leave the ID range unchanged
+    exec(R"(
+        CREATE TABLE IF NOT EXISTS store_meta (
+            key TEXT PRIMARY KEY,
+            value INTEGER NOT NULL
+        )
+    )");
+
     // Triggers to keep FTS in sync
     exec(R"(
         CREATE TRIGGER IF NOT EXISTS logs_ai AFTER INSERT ON logs BEGIN
@@ -93,106 +251,277 @@ void LogStore::init_schema() {
     )");
 }
 
-int64_t LogStore::insert(const LogEntry& entry) {
-    std::lock_guard<std::mutex> lock(mutex_);
+void LogStore::require_primary(const char* operation) const {
+    if (role_ == StoreRole::Follower) {
+        throw std::runtime_error(std::string("Read-only follower: ") + operation + " is only possible on the primary");
+    }
+    if (role_ == StoreRole::Archive) {
+        throw std::runtime_error(std::string("Read-only archive: ") + operation + " is not possible");
+    }
+}
 
-    const char* sql = R"(
-        INSERT INTO logs (source, category, verbosity, message, timestamp, frame, file, line, received_at, session_id, instance_id)
-        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
-    )";
+int64_t LogStore::insert(const LogEntry& entry) {
+    require_primary("insert");
+    auto lock = mutex_.acquire("insert");
 
     sqlite3_stmt* stmt;
-    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
+    int rc = sqlite3_prepare_v2(db_, LogSchema::insert_sql().c_str(), -1, &stmt, nullptr);
     if (rc != SQLITE_OK) {
         throw std::runtime_error("Failed to prepare insert: " + std::string(sqlite3_errmsg(db_)));
     }
 
-    double received_at = entry.received_at;
-    if (received_at == 0.0) {
-        auto now = std::chrono::system_clock::now();
-        received_at = std::chrono::duration<double>(now.time_since_epoch()).count();
+    LogEntry inserted_entry;
+    try {
+        inserted_entry = write_row(stmt, entry);
+    } catch (...) {
+        sqlite3_finalize(stmt);
+        throw;
     }
+    sqlite3_finalize(stmt);
 
-    sqlite3_bind_text(stmt, 1, entry.source.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, entry.category.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 3, static_cast<int>(entry.verbosity));
-    sqlite3_bind_text(stmt, 4, entry.message.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_double(stmt, 5, entry.timestamp);
+    apply_inserted(inserted_entry);
+    AllocTracker::note_rows_ingested(1);
+    return inserted_entry.id;
+}
 
-    if (entry.frame) {
-        sqlite3_bind_int64(stmt, 6, *entry.frame);
-    } else {
-        sqlite3_bind_null(stmt, 6);
+std::vector<int64_t> LogStore::insert_batch(const std::vector<LogEntry>& entries) {
+    std::vector<int64_t> ids;
+    if (entries.empty()) return ids;
+
+    require_primary("insert");
+    auto lock = mutex_.acquire("insert_batch");
+
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db_, LogSchema::insert_sql().c_str(), -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare insert: " + std::string(sqlite3_errmsg(db_)));
     }
 
-    if (entry.file) {
-        sqlite3_bind_text(stmt, 7, entry.file->c_str(), -1, SQLITE_TRANSIENT);
-    } else {
-        sqlite3_bind_null(stmt, 7);
+    // One transaction for the batch; indexes and subscribers only see it
+    // once it has committed
+    std::vector<LogEntry> inserted;
+    inserted.reserve(entries.size());
+    try {
+        exec("BEGIN");
+        for (const auto& entry : entries) {
+            inserted.push_back(write_row(stmt, entry));
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        }
+        exec("COMMIT");
+    } catch (...) {
+        sqlite3_finalize(stmt);
+        sqlite3_exec(db_, "ROLLBACK", nullptr, nullptr, nullptr);
+        throw;
     }
+    sqlite3_finalize(stmt);
 
-    if (entry.line) {
-        sqlite3_bind_int(stmt, 8, *entry.line);
-    } else {
-        sqlite3_bind_null(stmt, 8);
+    ids.reserve(inserted.size());
+    for (const auto& entry : inserted) {
+        apply_inserted(entry);
+        ids.push_back(entry.id);
     }
+    AllocTracker::note_rows_ingested(ids.size());
+    return ids;
+}
 
-    sqlite3_bind_double(stmt, 9, received_at);
-    sqlite3_bind_text(stmt, 10, entry.session_id.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 11, entry.instance_id.c_str(), -1, SQLITE_TRANSIENT);
+LogEntry LogStore::write_row(sqlite3_stmt* stmt, const LogEntry& entry) {
+    // A copy with the server-derived columns and ID, for subscribers.
+    // Whatever the sender put in the derived columns is replaced.
+    LogEntry row = entry;
+    if (row.received_at == 0.0) {
+        auto now = std::chrono::system_clock::now();
+        row.received_at = std::chrono::duration<double>(now.time_since_epoch()).count();
+    }
+    row.template_id = message_template_id(row.message);
+    row.norm_time = server_time(row);
 
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    LogSchema::bind(stmt, row);
 
+    int rc = sqlite3_step(stmt);
     if (rc != SQLITE_DONE) {
         throw std::runtime_error("Failed to insert log: " + std::string(sqlite3_errmsg(db_)));
     }
 
-    int64_t id = sqlite3_last_insert_rowid(db_);
+    row.id = sqlite3_last_insert_rowid(db_);
+    return row;
+}
+
+double LogStore::server_time(const LogEntry& entry) {
+    if (entry.timestamp == 0.0) return entry.received_at;
+
+    // The smallest receive delay seen is the instance's clock offset plus
+    // its fastest delivery, which is as close as one-way timing can get.
+    // The applied offset slews down to it no faster than the instance's
+    // clock advances, so norm_time never runs backwards within an instance.
+    double offset = entry.received_at - entry.timestamp;
+    auto it = clock_offsets_.find(entry.instance_id);
+    if (it == clock_offsets_.end()) {
+        if (clock_offsets_.size() >= kMaxClockOffsets) evict_clock_offset();
+        ClockOffset loaded = load_clock_offset(entry.instance_id).value_or(
+            ClockOffset{offset, offset, entry.timestamp, entry.received_at});
+        it = clock_offsets_.emplace(entry.instance_id, loaded).first;
+    }
+
+    ClockOffset& clock = it->second;
+    if (entry.timestamp < clock.last_timestamp) {
+        return entry.timestamp + clock.applied;   // Out of order: no new information about the offset
+    }
+    clock.min_offset = std::min(clock.min_offset, offset);
+    clock.applied = std::max(clock.min_offset, clock.applied - (entry.timestamp - clock.last_timestamp));
+    clock.last_timestamp = entry.timestamp;
+    clock.last_received_at = entry.received_at;
+    return entry.timestamp + clock.applied;
+}
+
+std::optional<LogStore::ClockOffset> LogStore::load_clock_offset(const std::string& instance_id) {
+    // Continue from the offset applied to the instance's last stored row,
+    // so a restart doesn't move norm_time backwards either
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db_,
+                       "SELECT timestamp, norm_time, received_at FROM logs WHERE instance_id = ? "
+                       "AND timestamp != 0 AND norm_time != 0 ORDER BY id DESC LIMIT 1",
+                       -1, &stmt, nullptr);
+    sqlite3_bind_text(stmt, 1, instance_id.c_str(), -1, SQLITE_TRANSIENT);
+    std::optional<ClockOffset> clock;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        double timestamp = sqlite3_column_double(stmt, 0);
+        double applied = sqlite3_column_double(stmt, 1) - timestamp;
+        clock = ClockOffset{applied, applied, timestamp, sqlite3_column_double(stmt, 2)};
+    }
+    sqlite3_finalize(stmt);
+    return clock;
+}
 
-    // Create a copy with the ID for subscribers
-    LogEntry inserted_entry = entry;
-    inserted_entry.id = id;
-    inserted_entry.received_at = received_at;
+void LogStore::evict_clock_offset() {
+    // Drop the instance heard from least recently; it reloads from its rows
+    auto oldest = std::min_element(clock_offsets_.begin(), clock_offsets_.end(), [](const auto& a, const auto& b) {
+        return a.second.last_received_at < b.second.last_received_at;
+    });
+    clock_offsets_.erase(oldest);
+}
+
+void LogStore::apply_inserted(const LogEntry& inserted_entry) {
+    double received_at = inserted_entry.received_at;
+    if (!has_rows_ || received_at >= latest_received_at_) {
+        latest_session_ = inserted_entry.session_id;
+        latest_received_at_ = received_at;
+        has_rows_ = true;
+    }
+    index_entry(inserted_entry);
+    digest_entry(inserted_entry);
+    {
+        std::lock_guard<std::mutex> estimate_lock(estimate_mutex_);
+        total_rows_++;
+        session_rows_[inserted_entry.session_id]++;
+        estimate_latest_session_ = latest_session_;
+    }
+
+    // Check for idle sessions every 30s of wall time
+    if (received_at - last_idle_check_ >= 30.0) {
+        last_idle_check_ = received_at;
+        finalize_idle_digests_locked(received_at, kDigestIdleSeconds);
+    }
 
     // Notify subscribers (outside the lock would be better, but keeping simple)
     for (auto& callback : subscribers_) {
         callback(inserted_entry);
     }
+}
 
-    return id;
+int64_t LogStore::follow(int64_t max_rows) {
+    if (role_ != StoreRole::Follower) {
+        throw std::runtime_error("follow() is only for follower stores");
+    }
+    auto lock = mutex_.acquire("follow");
+
+    // One snapshot: the ID range, any rebuild and the new rows agree
+    exec("BEGIN");
+    int64_t applied = 0;
+    try {
+        auto [min_id, max_id] = id_range();
+        int64_t generation = clear_generation();
+        if (generation != followed_clear_generation_ || max_id < followed_id_ ||
+            (followed_min_id_ != 0 && min_id != followed_min_id_)) {
+            // clear_logs on the primary: indexes and counts describe rows that are gone
+            reset_indexes();
+            followed_id_ = max_id;
+            followed_min_id_ = min_id;
+            followed_clear_generation_ = generation;
+        } else if (max_id > followed_id_) {
+            if (followed_min_id_ == 0) followed_min_id_ = min_id;
+
+            sqlite3_stmt* stmt;
+            std::string sql = "SELECT " + select_columns_ + " FROM logs WHERE id > ? ORDER BY id LIMIT ?";
+            int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
+            if (rc != SQLITE_OK) {
+                throw std::runtime_error("Failed to prepare follow: " + std::string(sqlite3_errmsg(db_)));
+            }
+            sqlite3_bind_int64(stmt, 1, followed_id_);
+            sqlite3_bind_int64(stmt, 2, max_rows);
+
+            std::vector<LogEntry> entries;
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                entries.push_back(row_to_entry(stmt));
+            }
+            sqlite3_finalize(stmt);
+
+            for (const auto& entry : entries) {
+                followed_id_ = entry.id;
+                apply_inserted(entry);
+            }
+            applied = static_cast<int64_t>(entries.size());
+        }
+    } catch (...) {
+        sqlite3_exec(db_, "COMMIT", nullptr, nullptr, nullptr);
+        throw;
+    }
+    exec("COMMIT");
+    return applied;
 }
 
-LogEntry LogStore::row_to_entry(sqlite3_stmt* stmt) {
-    LogEntry entry;
-    entry.id = sqlite3_column_int64(stmt, 0);
-    entry.source = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-    entry.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-    entry.verbosity = static_cast<Verbosity>(sqlite3_column_int(stmt, 3));
-    entry.message = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-    entry.timestamp = sqlite3_column_double(stmt, 5);
+std::pair<int64_t, int64_t> LogStore::id_range() {
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db_, "SELECT COALESCE(MIN(id), 0), COALESCE(MAX(id), 0) FROM logs", -1, &stmt, nullptr);
 
-    if (sqlite3_column_type(stmt, 6) != SQLITE_NULL) {
-        entry.frame = sqlite3_column_int64(stmt, 6);
-    }
-    if (sqlite3_column_type(stmt, 7) != SQLITE_NULL) {
-        entry.file = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
+    std::pair<int64_t, int64_t> range{0, 0};
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        range = {sqlite3_column_int64(stmt, 0), sqlite3_column_int64(stmt, 1)};
     }
-    if (sqlite3_column_type(stmt, 8) != SQLITE_NULL) {
-        entry.line = sqlite3_column_int(stmt, 8);
+    sqlite3_finalize(stmt);
+    return range;
+}
+
+int64_t LogStore::clear_generation() {
+    // 0 for a database written before store_meta existed
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(db_, "SELECT value FROM store_meta WHERE key = 'clear_generation'", -1, &stmt, nullptr);
+    int64_t generation = 0;
+    if (stmt && sqlite3_step(stmt) == SQLITE_ROW) {
+        generation = sqlite3_column_int64(stmt, 0);
     }
-    entry.received_at = sqlite3_column_double(stmt, 9);
-    entry.session_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 10));
-    entry.instance_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 11));
+    sqlite3_finalize(stmt);
+    return generation;
+}
 
+LogEntry LogStore::row_to_entry(sqlite3_stmt* stmt) {
+    LogEntry entry;
+    LogSchema::read(stmt, entry);
+    LogSchema::fill_derived(entry);
     return entry;
 }
 
 std::vector<LogEntry> LogStore::query(const LogFilter& filter) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = lock_for_read("query");
+
+    // Sessions covered by the in-memory index are answered by bitmap
+    // intersection, and only the requested page is read back from SQLite
+    if (auto session = indexed_session(filter)) {
+        return fetch_by_ids(index_.select(*session, filter));
+    }
 
     std::ostringstream sql;
-    sql << "SELECT id, source, category, verbosity, message, timestamp, frame, file, line, received_at, session_id, instance_id FROM logs WHERE 1=1";
+    sql << "SELECT " << select_columns_ << " FROM logs WHERE 1=1";
 
     std::vector<std::pair<int, std::string>> text_bindings;
     std::vector<std::pair<int, double>> double_bindings;
@@ -267,11 +596,19 @@ std::vector<LogEntry> LogStore::query(const LogFilter& filter) {
 }
 
 std::vector<LogEntry> LogStore::search(const std::string& query, const LogFilter& filter) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = lock_for_read("search");
+
+    // Simple term queries on an indexed session use the in-memory inverted
+    // index; anything it cannot answer exactly goes through FTS5 below
+    if (auto session = indexed_session(filter)) {
+        std::vector<int64_t> ids;
+        if (index_.search(*session, query, filter, ids)) {
+            return fetch_by_ids(ids);
+        }
+    }
 
     std::ostringstream sql;
-    sql << R"(
-        SELECT l.id, l.source, l.category, l.verbosity, l.message, l.timestamp, l.frame, l.file, l.line, l.received_at, l.session_id, l.instance_id
+    sql << "SELECT " << fts_select_columns_ << R"(
         FROM logs l
         JOIN logs_fts fts ON l.id = fts.rowid
         WHERE logs_fts MATCH ?
@@ -298,6 +635,10 @@ std::vector<LogEntry> LogStore::search(const std::string& query, const LogFilter
         sql << " AND l.verbosity <= ?" << param_idx++;
     }
 
+    if (filter.category) {
+        sql << " AND l.category = ?" << param_idx++;
+    }
+
     if (filter.since) {
         sql << " AND l.timestamp >= ?" << param_idx++;
     }
@@ -329,6 +670,9 @@ std::vector<LogEntry> LogStore::search(const std::string& query, const LogFilter
     if (filter.min_verbosity) {
         sqlite3_bind_int(stmt, param_idx++, static_cast<int>(*filter.min_verbosity));
     }
+    if (filter.category) {
+        sqlite3_bind_text(stmt, param_idx++, filter.category->c_str(), -1, SQLITE_TRANSIENT);
+    }
     if (filter.since) {
         sqlite3_bind_double(stmt, param_idx++, *filter.since);
     }
@@ -345,8 +689,310 @@ std::vector<LogEntry> LogStore::search(const std::string& query, const LogFilter
     return results;
 }
 
+ScanResult LogStore::grep(const std::string& pattern, bool ignore_case, const LogFilter& filter,
+                          int64_t max_scan) {
+    ScanBudget budget(max_scan);
+    return grep(pattern, ignore_case, filter, budget);
+}
+
+ScanResult LogStore::grep(const std::string& pattern, bool ignore_case, const LogFilter& filter,
+                          ScanBudget& budget) {
+    auto lock = lock_for_read("grep");
+
+    SubstringMatcher matcher(pattern, ignore_case);
+    return scan_messages(filter, [&matcher](std::string_view message) {
+        return matcher.matches(message);
+    }, budget);
+}
+
+ScanResult LogStore::regex_search(const std::string& pattern, bool ignore_case, const LogFilter& filter,
+                                  int64_t max_scan, const std::string& query) {
+    ScanBudget budget(max_scan);
+    return regex_search(pattern, ignore_case, filter, budget, query);
+}
+
+ScanResult LogStore::regex_search(const std::string& pattern, bool ignore_case, const LogFilter& filter,
+                                  ScanBudget& budget, const std::string& query) {
+    RegexMatcher regex(pattern, ignore_case);
+
+    // Literals every match must contain become FTS terms to narrow the
+    // candidate rows, and a SIMD substring check ahead of the NFA
+    std::string fts_query;
+    for (const auto& term : regex.index_terms()) {
+        if (!fts_query.empty()) fts_query += ' ';
+        fts_query += term;
+    }
+    if (!query.empty()) {
+        fts_query = fts_query.empty() ? query : "(" + query + ") " + fts_query;
+    }
+
+    std::optional<SubstringMatcher> prefilter;
+    if (!regex.required_literal().empty()) {
+        prefilter.emplace(regex.required_literal(), ignore_case);
+    }
+
+    auto lock = lock_for_read("regex_search");
+
+    return scan_messages(filter, [&regex, &prefilter](std::string_view message) {
+        if (prefilter && !prefilter->matches(message)) return false;
+        return regex.matches(message);
+    }, budget, fts_query);
+}
+
+WorkStealingPool& LogStore::scan_pool() {
+    if (shared_scan_pool_) return *shared_scan_pool_;
+    std::call_once(scan_pool_once_, [this] {
+        scan_pool_ = std::make_unique<WorkStealingPool>(std::max<size_t>(1, scan_workers() - 1), ThreadRole::Query);
+    });
+    return *scan_pool_;
+}
+
+ScanResult LogStore::scan_messages(const LogFilter& filter, const MessagePredicate& match, ScanBudget& budget,
+                                   const std::string& fts_query) {
+    ScanResult result;
+
+    size_t offset = static_cast<size_t>(std::max(0, filter.offset));
+    size_t limit = filter.limit < 0 ? std::numeric_limits<size_t>::max() - offset
+                                    : static_cast<size_t>(filter.limit);
+    size_t wanted = offset + limit;
+
+    // Candidate rows come newest first from the session index when it covers
+    // the session, otherwise from SQLite with the filter applied
+    sqlite3_stmt* stmt = nullptr;
+    bool use_index = false;
+    std::vector<int64_t> candidates;
+    size_t next_candidate = 0;
+
+    auto session = indexed_session(filter);
+    if (session) {
+        LogFilter all = filter;
+        all.limit = -1;
+        all.offset = 0;
+        if (fts_query.empty()) {
+            candidates = index_.select(*session, all);
+            use_index = true;
+        } else {
+            use_index = index_.search(*session, fts_query, all, candidates);
+        }
+    }
+
+    if (use_index) {
+        int rc = sqlite3_prepare_v2(db_, "SELECT id, message FROM logs WHERE id = ?", -1, &stmt, nullptr);
+        if (rc != SQLITE_OK) {
+            throw std::runtime_error("Failed to prepare scan: " + std::string(sqlite3_errmsg(db_)));
+        }
+    } else {
+        std::ostringstream sql;
+        sql << "SELECT id, message FROM logs WHERE 1=1";
+        if (filter.session_id) {
+            sql << " AND session_id = ?";
+        } else if (!filter.all_sessions) {
+            sql << " AND session_id = (SELECT session_id FROM logs ORDER BY received_at DESC LIMIT 1)";
+        }
+        if (filter.instance_id) sql << " AND instance_id = ?";
+        if (filter.source) sql << " AND source = ?";
+        if (filter.min_verbosity) sql << " AND verbosity <= ?";
+        if (filter.category) sql << " AND category = ?";
+        if (filter.since) sql << " AND timestamp >= ?";
+        if (filter.until) sql << " AND timestamp <= ?";
+        if (!fts_query.empty()) sql << " AND id IN (SELECT rowid FROM logs_fts WHERE logs_fts MATCH ?)";
+        sql << " ORDER BY timestamp DESC";
+
+        int rc = sqlite3_prepare_v2(db_, sql.str().c_str(), -1, &stmt, nullptr);
+        if (rc != SQLITE_OK) {
+            throw std::runtime_error("Failed to prepare scan: " + std::string(sqlite3_errmsg(db_)));
+        }
+
+        int idx = 1;
+        if (filter.session_id) sqlite3_bind_text(stmt, idx++, filter.session_id->c_str(), -1, SQLITE_TRANSIENT);
+        if (filter.instance_id) sqlite3_bind_text(stmt, idx++, filter.instance_id->c_str(), -1, SQLITE_TRANSIENT);
+        if (filter.source) sqlite3_bind_text(stmt, idx++, filter.source->c_str(), -1, SQLITE_TRANSIENT);
+        if (filter.min_verbosity) sqlite3_bind_int(stmt, idx++, static_cast<int>(*filter.min_verbosity));
+        if (filter.category) sqlite3_bind_text(stmt, idx++, filter.category->c_str(), -1, SQLITE_TRANSIENT);
+        if (filter.since) sqlite3_bind_double(stmt, idx++, *filter.since);
+        if (filter.until) sqlite3_bind_double(stmt, idx++, *filter.until);
+        if (!fts_query.empty()) sqlite3_bind_text(stmt, idx++, fts_query.c_str(), -1, SQLITE_TRANSIENT);
+    }
+
+    // Pull the next candidate (id, message) pair
+    auto next_row = [&](int64_t& id, std::string& message) -> bool {
+        if (use_index) {
+            while (next_candidate < candidates.size()) {
+                sqlite3_bind_int64(stmt, 1, candidates[next_candidate++]);
+                bool found = sqlite3_step(stmt) == SQLITE_ROW;
+                if (found) {
+                    id = sqlite3_column_int64(stmt, 0);
+                    message.assign(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+                                   sqlite3_column_bytes(stmt, 1));
+                }
+                sqlite3_reset(stmt);
+                if (found) return true;
+            }
+            return false;
+        }
+        if (sqlite3_step(stmt) != SQLITE_ROW) return false;
+        id = sqlite3_column_int64(stmt, 0);
+        message.assign(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+                       sqlite3_column_bytes(stmt, 1));
+        return true;
+    };
+
+    std::vector<int64_t> hits;
+    std::vector<int64_t> batch_ids;
+    std::vector<std::string> batch_messages;
+    bool exhausted = false;
+
+    while (hits.size() < wanted && !exhausted) {
+        size_t allowed = static_cast<size_t>(budget.take(static_cast<int64_t>(kScanBatchRows)));
+        if (allowed == 0) {
+            // Only report truncation if rows were actually left behind
+            int64_t id;
+            std::string message;
+            result.truncated = next_row(id, message);
+            break;
+        }
+
+        batch_ids.clear();
+        size_t filled = 0;
+        while (filled < allowed) {
+            if (batch_messages.size() <= filled) batch_messages.emplace_back();
+            int64_t id;
+            if (!next_row(id, batch_messages[filled])) {
+                exhausted = true;
+                break;
+            }
+            batch_ids.push_back(id);
+            filled++;
+        }
+        budget.give_back(static_cast<int64_t>(allowed - filled));
+        if (filled == 0) break;
+
+        std::vector<char> matched(filled, 0);
+        parallel_for(filled, [&](size_t i) {
+            matched[i] = match(batch_messages[i]) ? 1 : 0;
+        }, [this]() -> WorkStealingPool& { return scan_pool(); });
+
+        result.scanned += static_cast<int64_t>(filled);
+        for (size_t i = 0; i < filled; i++) {
+            if (!matched[i]) continue;
+            result.matched++;
+            if (hits.size() < wanted) hits.push_back(batch_ids[i]);
+        }
+    }
+
+    if (stmt) sqlite3_finalize(stmt);
+
+    if (offset < hits.size()) {
+        std::vector<int64_t> page(hits.begin() + offset, hits.end());
+        result.logs = fetch_by_ids(page);
+    }
+    return result;
+}
+
+std::vector<SimilarCluster> LogStore::find_similar(const std::string& message, double min_similarity,
+                                                   size_t limit) {
+    // Built off the store lock, unless this thread's snapshot already holds it
+    if (!similar_loaded_ && snapshot_thread_.load() != std::this_thread::get_id()) {
+        build_similarity_index();
+    }
+    auto lock = lock_for_read("find_similar");
+
+    if (!similar_loaded_) {
+        load_similarity_index();   // In a snapshot, or cleared since the build
+    }
+    return similar_.find(message, min_similarity, limit);
+}
+
+std::optional<nlohmann::json> LogStore::get_session_digest(const std::string& session_id) {
+    auto lock = lock_for_read("get_session_digest");
+
+    std::string session = session_id == "latest" ? latest_session_ : session_id;
+    if (session.empty()) return std::nullopt;
+
+    auto live = digests_.find(session);
+    if (live != digests_.end()) {
+        return live->second.to_json(false);
+    }
+
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db_, "SELECT digest FROM session_digests WHERE session_id = ?", -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare digest lookup: " + std::string(sqlite3_errmsg(db_)));
+    }
+    sqlite3_bind_text(stmt, 1, session.c_str(), -1, SQLITE_TRANSIENT);
+
+    std::optional<nlohmann::json> stored;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        stored = nlohmann::json::parse(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+    }
+    sqlite3_finalize(stmt);
+    if (stored) return stored;
+
+    // Not written to since startup and never finalized: build it once now
+    SessionDigestBuilder digest = build_session_digest(session);
+    if (digest.count() == 0) return std::nullopt;
+    store_digest(digest);
+    return digest.to_json(true);
+}
+
+void LogStore::finalize_idle_digests(double now, double idle_seconds) {
+    auto lock = mutex_.acquire("finalize_idle_digests");
+    finalize_idle_digests_locked(now, idle_seconds);
+}
+
+std::optional<LogEntry> LogStore::get_log(int64_t id) {
+    auto lock = lock_for_read("get_log");
+
+    auto logs = fetch_by_ids({id});
+    if (logs.empty()) return std::nullopt;
+    return logs.front();
+}
+
+void LogStore::read_snapshot(const std::function<void()>& fn) {
+    if (snapshot_thread_.load() == std::this_thread::get_id()) {
+        fn();   // Already inside a snapshot on this thread
+        return;
+    }
+
+    auto lock = mutex_.acquire("read_snapshot");
+    exec("BEGIN");
+    snapshot_thread_ = std::this_thread::get_id();
+    try {
+        fn();
+    } catch (...) {
+        snapshot_thread_ = std::thread::id();
+        sqlite3_exec(db_, "COMMIT", nullptr, nullptr, nullptr);
+        throw;
+    }
+    snapshot_thread_ = std::thread::id();
+    exec("COMMIT");
+}
+
+LogStore::ReadLock LogStore::lock_for_read(const char* site) {
+    if (snapshot_thread_.load() == std::this_thread::get_id()) {
+        return {AllocScope(AllocSubsystem::Results), {}};   // read_snapshot() holds mutex_
+    }
+    return {AllocScope(AllocSubsystem::Results), mutex_.acquire(site)};
+}
+
+void LogStore::set_indexed_sessions(size_t max_sessions) {
+    auto lock = mutex_.acquire("set_indexed_sessions");
+    index_.set_max_sessions(max_sessions);
+}
+
+SqliteMemoryStats LogStore::sqlite_memory() {
+    auto lock = lock_for_read("sqlite_memory");
+    return sqlite_memory_stats(db_);
+}
+
+SqlResult LogStore::sql_query(const std::string& sql, const SqlLimits& limits) {
+    // No mutex_: the sandbox has its own connection and lock
+    if (!sql_sandbox_) throw std::runtime_error("sql_query is not available on archives");
+    return sql_sandbox_->run(sql, limits);
+}
+
 LogStats LogStore::get_stats(std::optional<std::string> source, std::optional<double> since) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = lock_for_read("get_stats");
 
     LogStats stats;
 
@@ -488,7 +1134,7 @@ LogStats LogStore::get_stats(std::optional<std::string> source, std::optional<do
 }
 
 std::vector<std::string> LogStore::get_categories(std::optional<std::string> source) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = lock_for_read("get_categories");
 
     std::string sql = "SELECT DISTINCT category FROM logs";
     if (source) sql += " WHERE source = ?";
@@ -511,7 +1157,8 @@ std::vector<std::string> LogStore::get_categories(std::optional<std::string> sou
 }
 
 int64_t LogStore::clear(std::optional<std::string> source, std::optional<double> before) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    require_primary("clear");
+    auto lock = mutex_.acquire("clear");
 
     std::ostringstream sql;
     sql << "DELETE FROM logs WHERE 1=1";
@@ -519,21 +1166,51 @@ int64_t LogStore::clear(std::optional<std::string> source, std::optional<double>
     if (source) sql << " AND source = ?";
     if (before) sql << " AND timestamp < ?";
 
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db_, sql.str().c_str(), -1, &stmt, nullptr);
+    // The delete and the generation bump commit together, so a follower
+    // never sees one without the other
+    exec("BEGIN");
+    int64_t deleted = 0;
+    try {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db_, sql.str().c_str(), -1, &stmt, nullptr);
 
-    int idx = 1;
-    if (source) sqlite3_bind_text(stmt, idx++, source->c_str(), -1, SQLITE_TRANSIENT);
-    if (before) sqlite3_bind_double(stmt, idx++, *before);
+        int idx = 1;
+        if (source) sqlite3_bind_text(stmt, idx++, source->c_str(), -1, SQLITE_TRANSIENT);
+        if (before) sqlite3_bind_double(stmt, idx++, *before);
 
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        deleted = sqlite3_changes(db_);
+
+        exec("DELETE FROM session_digests");
+        exec("INSERT INTO store_meta (key, value) VALUES ('clear_generation', 1) "
+             "ON CONFLICT(key) DO UPDATE SET value = value + 1");
+        exec("COMMIT");
+    } catch (...) {
+        sqlite3_exec(db_, "ROLLBACK", nullptr, nullptr, nullptr);
+        throw;
+    }
+    reset_indexes();
+
+    return deleted;
+}
 
-    return sqlite3_changes(db_);
+void LogStore::reset_indexes() {
+    // Ordinals no longer line up with the table, rebuild lazily on next insert
+    index_.clear();
+    similar_.clear();
+    similar_loaded_ = false;
+    similar_generation_++;   // A build in progress read rows that may be gone
+
+    // Digests are rebuilt from the remaining rows when next needed
+    digests_.clear();
+    refresh_latest_session();
+    load_row_estimates();
+    if (has_rows_) load_session_index(latest_session_);
 }
 
 int64_t LogStore::count() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = lock_for_read("count");
 
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(db_, "SELECT COUNT(*) FROM logs", -1, &stmt, nullptr);
@@ -547,13 +1224,296 @@ int64_t LogStore::count() {
     return count;
 }
 
+int64_t LogStore::estimate_rows(const LogFilter& filter) const {
+    std::lock_guard<std::mutex> lock(estimate_mutex_);
+
+    if (!filter.session_id && filter.all_sessions) return total_rows_;
+
+    const std::string& session = filter.session_id ? *filter.session_id : estimate_latest_session_;
+    auto it = session_rows_.find(session);
+    return it == session_rows_.end() ? 0 : it->second;
+}
+
+void LogStore::load_row_estimates() {
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db_, "SELECT session_id, COUNT(*) FROM logs GROUP BY session_id",
+                                -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare row estimates: " + std::string(sqlite3_errmsg(db_)));
+    }
+
+    std::unordered_map<std::string, int64_t> sessions;
+    int64_t total = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* session = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        int64_t rows = sqlite3_column_int64(stmt, 1);
+        sessions[session ? session : ""] = rows;
+        total += rows;
+    }
+    sqlite3_finalize(stmt);
+
+    std::lock_guard<std::mutex> lock(estimate_mutex_);
+    total_rows_ = total;
+    session_rows_ = std::move(sessions);
+    estimate_latest_session_ = latest_session_;
+}
+
+void LogStore::index_entry(const LogEntry& entry) {
+    if (index_.covers(entry.session_id)) {
+        index_.add(entry);
+    } else {
+        // A new session is indexed from its first row. One with earlier rows
+        // (evicted, or written before startup) would need all of them loaded
+        // here on the write path, so it's left to SQL instead.
+        LogFilter session;
+        session.session_id = entry.session_id;
+        if (estimate_rows(session) == 0) {
+            index_.begin_session(entry.session_id);
+            index_.add(entry);
+        }
+    }
+
+    if (similar_loaded_) {
+        similar_.add(entry);
+    }
+}
+
+int64_t LogStore::applied_max_id() {
+    // A follower's table can hold rows it hasn't applied yet; follow() indexes those
+    return role_ == StoreRole::Follower ? followed_id_ : id_range().second;
+}
+
+void LogStore::load_similarity_index() {
+    int64_t up_to = applied_max_id();
+    add_similar_rows(db_, std::max<int64_t>(0, up_to - kSimilarityLoadRows), up_to, similar_);
+    similar_loaded_ = true;
+}
+
+void LogStore::build_similarity_index() {
+    // One build at a time; callers arriving meanwhile wait and find it loaded
+    std::lock_guard<std::mutex> building(similar_build_mutex_);
+    if (similar_loaded_) return;
+
+    int64_t up_to = 0;
+    int64_t generation = 0;
+    std::string path;
+    {
+        auto lock = mutex_.acquire("similarity_index");
+        if (similar_loaded_) return;
+        up_to = applied_max_id();
+        generation = similar_generation_;
+        const char* file = sqlite3_db_filename(db_, "main");
+        path = file ? file : "";
+    }
+    if (path.empty()) return;   // In-memory: find_similar loads it under the lock
+
+    // The bulk of the rows on a connection of our own, so inserts carry on
+    SimilarityIndex built;
+    sqlite3* reader = nullptr;
+    if (sqlite3_open_v2(path.c_str(), &reader, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        std::string err = reader ? sqlite3_errmsg(reader) : "out of memory";
+        sqlite3_close(reader);
+        throw std::runtime_error("Failed to open similarity index reader: " + err);
+    }
+    sqlite3_busy_timeout(reader, 5000);
+    try {
+        add_similar_rows(reader, std::max<int64_t>(0, up_to - kSimilarityLoadRows), up_to, built);
+    } catch (...) {
+        sqlite3_close(reader);
+        throw;
+    }
+    sqlite3_close(reader);
+
+    // Then the rows applied since, which insert didn't index while unloaded
+    auto lock = mutex_.acquire("similarity_index");
+    if (similar_loaded_ || generation != similar_generation_) return;   // Cleared: the next call rebuilds
+    add_similar_rows(db_, up_to, applied_max_id(), built);
+    similar_ = std::move(built);
+    similar_loaded_ = true;
+}
+
+void LogStore::digest_entry(const LogEntry& entry) {
+    auto it = digests_.find(entry.session_id);
+    if (it != digests_.end()) {
+        it->second.add(entry);
+        return;
+    }
+
+    // First write since startup or since the session was finalized: rebuild
+    // from its rows up to this one. Later rows of the same batch (or, on a
+    // follower, the same follow) are added as they're applied.
+    digests_.emplace(entry.session_id, build_session_digest(entry.session_id, entry.id));
+}
+
+SessionDigestBuilder LogStore::build_session_digest(const std::string& session_id, int64_t up_to_id) {
+    const char* sql = R"(
+        SELECT id, source, category, verbosity, message, timestamp, received_at, instance_id
+        FROM logs WHERE session_id = ? AND id <= ? ORDER BY id
+    )";
+
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare digest build: " + std::string(sqlite3_errmsg(db_)));
+    }
+    sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, up_to_id);
+
+    SessionDigestBuilder digest(session_id);
+    LogEntry entry;
+    entry.session_id = session_id;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        entry.id = sqlite3_column_int64(stmt, 0);
+        entry.source = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        entry.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        entry.verbosity = static_cast<Verbosity>(sqlite3_column_int(stmt, 3));
+        entry.message.assign(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)),
+                             sqlite3_column_bytes(stmt, 4));
+        entry.timestamp = sqlite3_column_double(stmt, 5);
+        entry.received_at = sqlite3_column_double(stmt, 6);
+        entry.instance_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
+        digest.add(entry);
+    }
+    sqlite3_finalize(stmt);
+    return digest;
+}
+
+void LogStore::store_digest(const SessionDigestBuilder& digest) {
+    if (role_ != StoreRole::Primary) return;   // Read-only; the primary stores final digests
+
+    const char* sql = R"(
+        INSERT OR REPLACE INTO session_digests (session_id, digest, log_count, finalized_at)
+        VALUES (?, ?, ?, ?)
+    )";
+
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare digest store: " + std::string(sqlite3_errmsg(db_)));
+    }
+
+    std::string text = digest.to_json(true).dump();
+    double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    sqlite3_bind_text(stmt, 1, digest.session_id().c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, text.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 3, digest.count());
+    sqlite3_bind_double(stmt, 4, now);
+
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        throw std::runtime_error("Failed to store digest: " + std::string(sqlite3_errmsg(db_)));
+    }
+}
+
+void LogStore::finalize_idle_digests_locked(double now, double idle_seconds) {
+    for (auto it = digests_.begin(); it != digests_.end();) {
+        if (it->second.last_received() <= now - idle_seconds) {
+            store_digest(it->second);
+            it = digests_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void LogStore::load_session_index(const std::string& session_id) {
+    const char* sql = R"(
+        SELECT id, source, category, verbosity, timestamp, instance_id, message
+        FROM logs WHERE session_id = ? ORDER BY id
+    )";
+
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare session index load: " + std::string(sqlite3_errmsg(db_)));
+    }
+    sqlite3_bind_text(stmt, 1, session_id.c_str(), -1, SQLITE_TRANSIENT);
+
+    index_.begin_session(session_id);
+    session_index_loads_++;
+
+    LogEntry entry;
+    entry.session_id = session_id;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        entry.id = sqlite3_column_int64(stmt, 0);
+        entry.source = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        entry.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        entry.verbosity = static_cast<Verbosity>(sqlite3_column_int(stmt, 3));
+        entry.timestamp = sqlite3_column_double(stmt, 4);
+        entry.instance_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+        entry.message = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
+        index_.add(entry);
+    }
+
+    sqlite3_finalize(stmt);
+}
+
+void LogStore::refresh_latest_session() {
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db_, "SELECT session_id, received_at FROM logs ORDER BY received_at DESC LIMIT 1",
+                       -1, &stmt, nullptr);
+
+    has_rows_ = false;
+    latest_session_.clear();
+    latest_received_at_ = 0.0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* session = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        if (session) latest_session_ = session;
+        latest_received_at_ = sqlite3_column_double(stmt, 1);
+        has_rows_ = true;
+    }
+
+    sqlite3_finalize(stmt);
+}
+
+std::optional<std::string> LogStore::indexed_session(const LogFilter& filter) const {
+    std::optional<std::string> session;
+    if (filter.session_id) {
+        session = filter.session_id;
+    } else if (!filter.all_sessions && has_rows_) {
+        session = latest_session_;
+    }
+
+    if (session && index_.covers(*session)) {
+        return session;
+    }
+    return std::nullopt;
+}
+
+std::vector<LogEntry> LogStore::fetch_by_ids(const std::vector<int64_t>& ids) {
+    std::vector<LogEntry> results;
+    if (ids.empty()) return results;
+
+    std::string sql = "SELECT " + select_columns_ + " FROM logs WHERE id = ?";
+
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare fetch: " + std::string(sqlite3_errmsg(db_)));
+    }
+
+    results.reserve(ids.size());
+    for (int64_t id : ids) {
+        sqlite3_bind_int64(stmt, 1, id);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            results.push_back(row_to_entry(stmt));
+        }
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_finalize(stmt);
+    return results;
+}
+
 void LogStore::subscribe(LogCallback callback) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = mutex_.acquire("subscribe");
     subscribers_.push_back(std::move(callback));
 }
 
 std::vector<SessionInfo> LogStore::get_sessions(std::optional<std::string> source) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = lock_for_read("get_sessions");
 
     std::ostringstream sql;
     sql << R"(
@@ -616,7 +1576,7 @@ std::vector<SessionInfo> LogStore::get_sessions(std::optional<std::string> sourc
 }
 
 std::string LogStore::get_latest_session(std::optional<std::string> source) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = lock_for_read("get_latest_session");
 
     std::string sql = "SELECT session_id FROM logs";
     if (source) {
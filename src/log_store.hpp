@@ -1,17 +1,45 @@
 #pragma once
 
+#include "alloc_tracker.hpp"
+#include "lock_profiler.hpp"
 #include "log_entry.hpp"
+#include "session_digest.hpp"
+#include "session_index.hpp"
+#include "similarity_index.hpp"
+#include "sql_sandbox.hpp"
+#include "storage_tuning.hpp"
+#include "thread_pool.hpp"
 #include <sqlite3.h>
+#include <atomic>
+#include <limits>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <mutex>
 #include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 
 namespace mcp_logs {
 
+// Primary: owns the database, ingests and deletes. Follower: serves reads
+// from a database a primary process writes, kept current by follow().
+// Archive: a database nothing writes any more, opened read-only (see
+// LogArchives).
+enum class StoreRole { Primary, Follower, Archive };
+
 class LogStore {
 public:
-    explicit LogStore(const std::string& db_path);
+    // Opens (or creates) the database with the given SQLite settings; see
+    // storage_profile() and autotune_storage(). A follower opens an existing
+    // database with query_only set, an archive opens it read-only; both
+    // throw std::runtime_error if it has no logs table. Scans split across
+    // scan_pool when given (it must outlive the store), else across a pool
+    // of the store's own. Archives have no sql_query connection.
+    explicit LogStore(const std::string& db_path, const StorageSettings& storage = {},
+                      StoreRole role = StoreRole::Primary, WorkStealingPool* scan_pool = nullptr);
     ~LogStore();
 
     // Non-copyable
@@ -21,12 +49,72 @@ public:
     // Insert a new log entry, returns the assigned ID
     int64_t insert(const LogEntry& entry);
 
+    // Insert entries in one transaction, returns their IDs in order. All or
+    // nothing: throws std::runtime_error (and rolls back) if any row fails.
+    std::vector<int64_t> insert_batch(const std::vector<LogEntry>& entries);
+
+    // Follower only: take up to max_rows rows the primary has committed
+    // since the last call and apply them as insert would (indexes, digests,
+    // estimates, subscribers). If the primary cleared any rows, in-memory
+    // state is rebuilt from the table instead.
+    // Returns the number of rows applied.
+    static constexpr int64_t kFollowBatchRows = 4096;
+    int64_t follow(int64_t max_rows = kFollowBatchRows);
+
+    StoreRole role() const { return role_; }
+    bool is_follower() const { return role_ == StoreRole::Follower; }
+
     // Query logs with filters
     std::vector<LogEntry> query(const LogFilter& filter);
 
     // Full-text search
     std::vector<LogEntry> search(const std::string& query, const LogFilter& filter);
 
+    // Raw substring search over message bytes, scanning at most max_scan rows
+    // (or what's left of a budget shared with other scans)
+    ScanResult grep(const std::string& pattern, bool ignore_case, const LogFilter& filter,
+                    int64_t max_scan = 100000);
+    ScanResult grep(const std::string& pattern, bool ignore_case, const LogFilter& filter, ScanBudget& budget);
+
+    // Regular expression search over messages (see RegexMatcher for syntax),
+    // scanning at most max_scan rows (or a shared budget's). A non-empty FTS5
+    // query narrows the candidates further. Throws std::runtime_error on an
+    // invalid pattern.
+    ScanResult regex_search(const std::string& pattern, bool ignore_case, const LogFilter& filter,
+                            int64_t max_scan = 100000, const std::string& query = "");
+    ScanResult regex_search(const std::string& pattern, bool ignore_case, const LogFilter& filter,
+                            ScanBudget& budget, const std::string& query = "");
+
+    // Near-duplicate clusters of message across all sessions (numbers and hex
+    // IDs ignored), most similar first. The first call (and the first after
+    // clear) indexes the newest million rows on a separate connection, so
+    // inserts aren't blocked while it runs.
+    std::vector<SimilarCluster> find_similar(const std::string& message, double min_similarity = 0.5,
+                                             size_t limit = 20);
+
+    // Digest of a session (see SessionDigestBuilder): live while the session
+    // is receiving logs, the stored final version once it has gone idle.
+    // "latest" names the most recent session. nullopt if it has no logs.
+    std::optional<nlohmann::json> get_session_digest(const std::string& session_id);
+
+    // Store the final digest of every session with no logs received since
+    // now - idle_seconds. Also runs periodically from insert.
+    static constexpr double kDigestIdleSeconds = 300.0;
+    void finalize_idle_digests(double now, double idle_seconds = kDigestIdleSeconds);
+
+    // Fetch a single log by ID
+    std::optional<LogEntry> get_log(int64_t id);
+
+    // Run fn as one consistent read: the store stays locked, inside a single
+    // SQLite read transaction, so no insert lands between the reads fn makes.
+    // The read methods above (and get_stats, get_sessions, ...) called from
+    // fn don't lock again; insert, insert_batch and clear must not be.
+    void read_snapshot(const std::function<void()>& fn);
+
+    // Run a read-only SELECT against the logs tables on a separate connection
+    // (see SqlSandbox). Does not block inserts. Throws on archive stores.
+    SqlResult sql_query(const std::string& sql, const SqlLimits& limits = {});
+
     // Get statistics
     LogStats get_stats(std::optional<std::string> source = std::nullopt,
                        std::optional<double> since = std::nullopt);
@@ -47,18 +135,155 @@ public:
     // Get total log count
     int64_t count();
 
+    // Rows a query over this filter's session scope (a named session, the
+    // latest one, or all) has to consider, from counters kept on insert.
+    // Never waits on queries in progress; used for query cost estimates.
+    int64_t estimate_rows(const LogFilter& filter) const;
+
+    // Settings in effect on the write connection, as SQLite reports them
+    const StorageSettings& storage_settings() const { return storage_; }
+
+    // SQLite heap use, including the write connection's caches
+    SqliteMemoryStats sqlite_memory();
+
+    // Sessions the in-memory index keeps (default 4), most recently written
+    // first. A session evicted from it is served from SQLite from then on.
+    void set_indexed_sessions(size_t max_sessions);
+
+    // Times a session's existing rows were read into the index: at startup,
+    // and after clear
+    uint64_t session_index_loads() const { return session_index_loads_; }
+
+    // True once find_similar's index is built, so further calls are cheap
+    bool similarity_index_loaded() const { return similar_loaded_; }
+
     // Subscribe to new log entries (called from insert)
     using LogCallback = std::function<void(const LogEntry&)>;
     void subscribe(LogCallback callback);
 
 private:
     void init_schema();
+
+    // Throws std::runtime_error naming operation unless this is the primary
+    void require_primary(const char* operation) const;
+
+    // Drop in-memory indexes, digests and estimates and reload what's eager
+    // from the table, after rows were deleted (mutex_ must be held)
+    void reset_indexes();
+
+    // Smallest and largest row ID, 0 for an empty table
+    std::pair<int64_t, int64_t> id_range();
+
+    // Times clear() has run on this database (store_meta), 0 if never
+    int64_t clear_generation();
+
+    // Lock mutex_ for a read tagged with `site`, or nothing if this thread
+    // is in read_snapshot(). Allocations made while it's held (the results)
+    // count under AllocSubsystem::Results.
+    struct ReadLock {
+        AllocScope scope;
+        std::unique_lock<ProfiledMutex> lock;
+    };
+    ReadLock lock_for_read(const char* site);
     void exec(const std::string& sql);
     LogEntry row_to_entry(sqlite3_stmt* stmt);
 
+    // Insert path (mutex_ must be held): write_row binds and steps the insert
+    // statement, apply_inserted updates indexes and notifies subscribers once
+    // the row is committed
+    LogEntry write_row(sqlite3_stmt* stmt, const LogEntry& entry);
+    void apply_inserted(const LogEntry& inserted_entry);
+
+    // entry's timestamp on the server clock, for norm_time (mutex_ must be held)
+    struct ClockOffset {
+        double min_offset;         // Smallest received_at - timestamp seen
+        double applied;            // Offset added to the last row's timestamp
+        double last_timestamp;
+        double last_received_at;
+    };
+    static constexpr size_t kMaxClockOffsets = 4096;
+    double server_time(const LogEntry& entry);
+    std::optional<ClockOffset> load_clock_offset(const std::string& instance_id);
+    void evict_clock_offset();
+
+    // In-memory session index maintenance (mutex_ must be held)
+    void index_entry(const LogEntry& entry);
+    void load_session_index(const std::string& session_id);
+    void refresh_latest_session();
+    void load_similarity_index();
+    int64_t applied_max_id();
+    void load_row_estimates();
+
+    // Build find_similar's index from a separate connection, then take
+    // mutex_ only to add the rows inserted meanwhile. mutex_ must not be held.
+    void build_similarity_index();
+
+    // Session digest maintenance (mutex_ must be held)
+    void digest_entry(const LogEntry& entry);
+    SessionDigestBuilder build_session_digest(const std::string& session_id,
+                                              int64_t up_to_id = std::numeric_limits<int64_t>::max());
+    void store_digest(const SessionDigestBuilder& digest);
+    void finalize_idle_digests_locked(double now, double idle_seconds);
+    std::optional<std::string> indexed_session(const LogFilter& filter) const;
+    std::vector<LogEntry> fetch_by_ids(const std::vector<int64_t>& ids);
+
+    // Scan candidate rows for filter newest first, testing each message with
+    // match (called concurrently from several threads). A non-empty fts_query
+    // restricts candidates to its FTS5 matches. mutex_ must be held.
+    using MessagePredicate = std::function<bool(std::string_view)>;
+    ScanResult scan_messages(const LogFilter& filter, const MessagePredicate& match, ScanBudget& budget,
+                             const std::string& fts_query = "");
+
     sqlite3* db_ = nullptr;
-    std::mutex mutex_;
+    StoreRole role_;
+    ProfiledMutex mutex_{"LogStore"};
+    std::atomic<std::thread::id> snapshot_thread_{};   // Thread in read_snapshot(), holding mutex_
     std::vector<LogCallback> subscribers_;
+
+    std::unique_ptr<SqlSandbox> sql_sandbox_;
+    StorageSettings storage_;
+
+    // LogSchema::select_columns for this database, plain and with the "l." prefix
+    std::string select_columns_;
+    std::string fts_select_columns_;
+
+    // Per instance norm_time offsets, at most kMaxClockOffsets of them
+    std::unordered_map<std::string, ClockOffset> clock_offsets_;
+
+    SessionIndex index_;
+    std::atomic<uint64_t> session_index_loads_{0};
+    std::string latest_session_;          // Session of the most recently received row
+    double latest_received_at_ = 0.0;
+    bool has_rows_ = false;
+
+    SimilarityIndex similar_;
+    std::atomic<bool> similar_loaded_{false};   // Built from the table on first use, then fed on insert
+    std::mutex similar_build_mutex_;            // Held through build_similarity_index()
+    int64_t similar_generation_ = 0;            // Bumped by reset_indexes(), under mutex_
+
+    // Query workers for scan_messages: the shared pool from the constructor,
+    // or one started on the first batch big enough to split and kept for
+    // the life of the store
+    WorkStealingPool* shared_scan_pool_;
+    std::once_flag scan_pool_once_;
+    std::unique_ptr<WorkStealingPool> scan_pool_;
+    WorkStealingPool& scan_pool();
+
+    // Row counts for estimate_rows, guarded by estimate_mutex_ rather than
+    // mutex_ so estimates don't queue behind running queries
+    mutable std::mutex estimate_mutex_;
+    int64_t total_rows_ = 0;
+    std::unordered_map<std::string, int64_t> session_rows_;
+    std::string estimate_latest_session_;
+
+    std::unordered_map<std::string, SessionDigestBuilder> digests_;   // Sessions still receiving logs
+    double last_idle_check_ = 0.0;
+
+    // Follower: highest row ID applied, and the oldest row ID and clear
+    // generation seen, to notice deletes on the primary
+    int64_t followed_id_ = 0;
+    int64_t followed_min_id_ = 0;
+    int64_t followed_clear_generation_ = 0;
 };
 
 } // namespace mcp_logs
@@ -1,11 +1,22 @@
 #include "log_store.hpp"
+#include "anomaly_detector.hpp"
+#include "rule_engine.hpp"
+#include "datagram_capture.hpp"
+#include "log_export.hpp"
 #include "udp_receiver.hpp"
+#include "ingest_pipeline.hpp"
 #include "http_server.hpp"
+#include "asio_http_server.hpp"
 #include "mcp_server.hpp"
 #include "server_log.hpp"
 #include "console_ui.hpp"
 #include "source_manager.hpp"
+#include "store_follower.hpp"
+#include "log_archive.hpp"
+#include "thread_placement.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <csignal>
 #include <atomic>
@@ -30,10 +41,34 @@ void print_usage(const char* program) {
     std::cout << "  --udp-port PORT   UDP port for receiving logs (default: 52099)\n";
     std::cout << "  --http-port PORT  HTTP port for MCP SSE server (default: 52080)\n";
     std::cout << "  --db PATH         SQLite database path (default: logs.db)\n";
+    std::cout << "  --storage-profile P  SQLite tuning: default, small, large-ssd or ram-heavy\n";
+    std::cout << "  --autotune        Benchmark the database's disk at startup and pick SQLite settings\n";
     std::cout << "  --cert PATH       TLS certificate file (PEM format) for HTTPS\n";
     std::cout << "  --key PATH        TLS private key file (PEM format) for HTTPS\n";
     std::cout << "  --tail PATH       Tail a file as a log source (can be specified multiple times)\n";
     std::cout << "  --tail-name NAME  Name for the preceding --tail source (optional)\n";
+    std::cout << "  --mcp-threads N   Threads executing MCP requests (default: CPU count, at least 4)\n";
+    std::cout << "  --http-backend B  HTTP server: httplib (thread per connection, default) or asio\n";
+    std::cout << "  --http-threads N  I/O threads for the asio backend (default: 2)\n";
+    std::cout << "  --no-compression  Never gzip/zstd HTTP responses or SSE streams\n";
+    std::cout << "  --compress-min-bytes N  Send smaller response bodies uncompressed (default: 1024)\n";
+    std::cout << "  --ingest-pipeline Receive UDP logs through the coroutine pipeline (ENABLE_COROUTINES builds)\n";
+    std::cout << "  --capture FILE    Record raw UDP datagrams with receive times, for the replay tool\n";
+    std::cout << "  --follower        Serve MCP read-only from a database another server (the primary) ingests into\n";
+    std::cout << "  --follow-interval-ms N  How often a follower polls for new rows (default: 200)\n";
+    std::cout << "  --indexed-sessions N  Sessions kept in the in-memory query index (default: 4)\n";
+    std::cout << "  --archive-dir DIR Attach every .db file in DIR read-only; all-session queries, searches\n";
+    std::cout << "                    and stats also cover them\n";
+    std::cout << "  --export-dir DIR  Directory for export_logs tool output (default: exports)\n";
+    std::cout << "  --export FILE     Export logs from --db to an Arrow IPC file and exit, narrowed by:\n";
+    std::cout << "    --export-session ID  A session to include, or latest (can be specified multiple times)\n";
+    std::cout << "    --export-since T     Only logs with timestamp >= Unix time T\n";
+    std::cout << "    --export-until T     Only logs with timestamp <= Unix time T\n";
+    std::cout << "    --export-source S    Only logs from source S (client, server, ...)\n";
+    std::cout << "    --export-uncompressed  Don't zstd-compress column buffers\n";
+    std::cout << "  --cpu-affinity R=CPUS  Pin a thread role (ingest, tailer, query, http, ui) to CPUs, e.g. ingest=0-7\n";
+    std::cout << "                    (can be specified multiple times), or 'auto' to split by NUMA node\n";
+    std::cout << "  --nic IFACE       Network interface receiving logs; --cpu-affinity auto puts ingest on its NUMA node\n";
     std::cout << "  --legacy-console  Use simple text output instead of TUI\n";
     std::cout << "  --help            Show this help message\n\n";
     std::cout << "Examples:\n";
@@ -41,6 +76,9 @@ void print_usage(const char* program) {
     std::cout << "  " << program << " --http-port 52080 --cert server.crt --key server.key\n";
     std::cout << "  " << program << " --tail /var/log/nginx/access.log --tail-name nginx\n";
     std::cout << "  " << program << " --legacy-console  # Simple text mode\n";
+    std::cout << "  " << program << " --db ue_logs.db --export match.arrow --export-session latest\n";
+    std::cout << "  " << program << " --db ue_logs.db --follower --http-port 52081  # Extra MCP capacity\n";
+    std::cout << "  " << program << " --db ue_logs.db --archive-dir old_logs  # Search past rotated databases\n";
 }
 
 int main(int argc, char* argv[]) {
@@ -50,6 +88,24 @@ int main(int argc, char* argv[]) {
     std::string cert_path;
     std::string key_path;
     bool legacy_console = false;
+    size_t mcp_threads = 0;
+    std::string http_backend = "httplib";
+    size_t http_threads = 0;
+    bool compression = true;
+    size_t compress_min_bytes = HttpServer::kDefaultCompressMinBytes;
+    bool ingest_pipeline = false;
+    std::string capture_path;
+    bool follower = false;
+    std::chrono::milliseconds follow_interval = StoreFollower::kDefaultInterval;
+    size_t indexed_sessions = SessionIndex::kDefaultMaxSessions;
+    std::string export_path;
+    std::string export_dir = "exports";
+    std::string archive_dir;
+    ExportOptions export_options;
+    std::string storage_profile_name = "default";
+    bool autotune = false;
+    std::vector<std::string> affinity_specs;
+    std::string nic;
 
     // File tailers: pairs of (path, name)
     std::vector<std::pair<std::string, std::string>> tail_files;
@@ -93,6 +149,72 @@ int main(int argc, char* argv[]) {
             tail_files.emplace_back(pending_tail_path, argv[++i]);
             pending_tail_path.clear();
         }
+        else if (arg == "--mcp-threads" && i + 1 < argc) {
+            mcp_threads = static_cast<size_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--http-backend" && i + 1 < argc) {
+            http_backend = argv[++i];
+        }
+        else if (arg == "--http-threads" && i + 1 < argc) {
+            http_threads = static_cast<size_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--storage-profile" && i + 1 < argc) {
+            storage_profile_name = argv[++i];
+        }
+        else if (arg == "--autotune") {
+            autotune = true;
+        }
+        else if (arg == "--cpu-affinity" && i + 1 < argc) {
+            affinity_specs.push_back(argv[++i]);
+        }
+        else if (arg == "--nic" && i + 1 < argc) {
+            nic = argv[++i];
+        }
+        else if (arg == "--no-compression") {
+            compression = false;
+        }
+        else if (arg == "--compress-min-bytes" && i + 1 < argc) {
+            compress_min_bytes = static_cast<size_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--ingest-pipeline") {
+            ingest_pipeline = true;
+        }
+        else if (arg == "--capture" && i + 1 < argc) {
+            capture_path = argv[++i];
+        }
+        else if (arg == "--follower") {
+            follower = true;
+        }
+        else if (arg == "--follow-interval-ms" && i + 1 < argc) {
+            follow_interval = std::chrono::milliseconds(std::max(1, std::stoi(argv[++i])));
+        }
+        else if (arg == "--indexed-sessions" && i + 1 < argc) {
+            indexed_sessions = static_cast<size_t>(std::max(1, std::stoi(argv[++i])));
+        }
+        else if (arg == "--export" && i + 1 < argc) {
+            export_path = argv[++i];
+        }
+        else if (arg == "--archive-dir" && i + 1 < argc) {
+            archive_dir = argv[++i];
+        }
+        else if (arg == "--export-dir" && i + 1 < argc) {
+            export_dir = argv[++i];
+        }
+        else if (arg == "--export-session" && i + 1 < argc) {
+            export_options.sessions.push_back(argv[++i]);
+        }
+        else if (arg == "--export-since" && i + 1 < argc) {
+            export_options.since = std::stod(argv[++i]);
+        }
+        else if (arg == "--export-until" && i + 1 < argc) {
+            export_options.until = std::stod(argv[++i]);
+        }
+        else if (arg == "--export-source" && i + 1 < argc) {
+            export_options.source = argv[++i];
+        }
+        else if (arg == "--export-uncompressed") {
+            export_options.compression = ContentEncoding::Identity;
+        }
         else if (arg == "--legacy-console") {
             legacy_console = true;
         }
@@ -114,6 +236,81 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    if (http_backend != "httplib" && http_backend != "asio") {
+        std::cerr << "Error: --http-backend must be httplib or asio\n";
+        return 1;
+    }
+
+    auto storage = storage_profile(storage_profile_name);
+    if (!storage) {
+        std::cerr << "Error: unknown --storage-profile " << storage_profile_name << " (";
+        auto names = storage_profile_names();
+        for (size_t i = 0; i < names.size(); i++) {
+            std::cerr << (i ? ", " : "") << names[i];
+        }
+        std::cerr << ")\n";
+        return 1;
+    }
+
+    // Thread placement: explicit role=cpus lists, or a split by NUMA node
+    try {
+        for (const auto& spec : affinity_specs) {
+            if (spec == "auto") {
+                int node = 0;
+                if (!nic.empty()) {
+                    if (auto nic_node = nic_numa_node(nic)) {
+                        node = *nic_node;
+                    } else {
+                        std::cerr << "Warning: no NUMA node reported for " << nic << ", using node 0\n";
+                    }
+                }
+                ThreadPlacement::configure_auto(read_numa_topology(), node);
+                continue;
+            }
+            size_t eq = spec.find('=');
+            auto role = eq == std::string::npos ? std::nullopt : thread_role_from_name(spec.substr(0, eq));
+            if (!role) {
+                std::cerr << "Error: --cpu-affinity expects auto or ROLE=CPUS with ROLE one of "
+                             "ingest, tailer, query, http, ui\n";
+                return 1;
+            }
+            ThreadPlacement::set_cpus(*role, parse_cpu_list(spec.substr(eq + 1)));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (follower && (!capture_path.empty() || ingest_pipeline || !tail_files.empty())) {
+        std::cerr << "Error: a --follower doesn't ingest; --capture, --ingest-pipeline and --tail "
+                     "belong on the primary\n";
+        return 1;
+    }
+
+    // Export mode: stream the selected rows to a file and exit, without
+    // starting the server (which may be running on the same database)
+    if (!export_path.empty()) {
+        try {
+            std::cout << "Exporting " << db_path << " to " << export_path << "..." << std::endl;
+            ExportProgress result = export_logs(db_path, export_options, export_path);
+            std::cout << "Exported " << result.rows << " logs in " << result.batches << " batches ("
+                      << result.bytes << " bytes, "
+                      << (export_options.compression == ContentEncoding::Zstd ? "zstd" : "uncompressed") << ")"
+                      << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+#ifndef MCP_LOGS_COROUTINES
+    if (ingest_pipeline) {
+        std::cerr << "Error: --ingest-pipeline needs a build with -DENABLE_COROUTINES=ON\n";
+        return 1;
+    }
+#endif
+
     // Setup signal handlers
     std::signal(SIGINT, signal_handler);
     std::signal(SIGTERM, signal_handler);
@@ -122,23 +319,86 @@ int main(int argc, char* argv[]) {
         std::cout << "=== UE Log Server ===" << std::endl;
         std::cout << "Database: " << db_path << std::endl;
 
+        if (autotune) {
+            std::cout << "Autotuning storage..." << std::endl;
+            AutotuneResult tuned = autotune_storage(db_path);
+            ServerLog::log("Store", "Autotune measured " + tuned.describe());
+            storage = tuned.settings;
+        }
+
         // Initialize components
-        LogStore store(db_path);
+        LogStore store(db_path, *storage, follower ? StoreRole::Follower : StoreRole::Primary);
+        store.set_indexed_sessions(indexed_sessions);
+        ServerLog::log("Store", "Storage " + store.storage_settings().describe());
+        if (store.storage_settings().page_size != storage->page_size) {
+            ServerLog::log("Store", "page_size " + std::to_string(storage->page_size) +
+                           " applies to new databases only; run VACUUM in rollback-journal mode to convert");
+        }
         ServerLog::log("Store", "Initialized with " + std::to_string(store.count()) + " existing logs");
+        if (follower) {
+            ServerLog::log("Store", "Read-only follower: serving MCP only, following new rows every " +
+                           std::to_string(follow_interval.count()) + " ms");
+        }
+        if (!affinity_specs.empty()) {
+            ServerLog::log("Main", "Thread placement: " + ThreadPlacement::describe());
+        }
 
+        AnomalyDetector anomalies(store);
+        anomalies.start_ticking();   // Notices quiet instances even when all ingest stops
+        RuleEngine rules(store);
         SourceManager sources(store);
 
-        UdpReceiver udp(store, udp_port);
+        // Raw datagram recording; declared first so it outlives the receivers
+        std::unique_ptr<CaptureWriter> capture;
+        if (!capture_path.empty()) {
+            capture = std::make_unique<CaptureWriter>(capture_path);
+            ServerLog::log("UDP", "Capturing datagrams to " + capture_path);
+        }
+
+        // UDP ingestion: callback receiver, or the coroutine pipeline
+        std::unique_ptr<UdpReceiver> udp;
+#ifdef MCP_LOGS_COROUTINES
+        std::unique_ptr<IngestPipeline> pipeline;
+        if (ingest_pipeline) {
+            pipeline = std::make_unique<IngestPipeline>(store);
+            pipeline->listen_udp(udp_port);
+            pipeline->set_capture(capture.get());
+        }
+#endif
+        std::unique_ptr<StoreFollower> follow;
+        if (follower) {
+            follow = std::make_unique<StoreFollower>(store, follow_interval);
+        } else if (!ingest_pipeline) {
+            udp = std::make_unique<UdpReceiver>(store, udp_port);
+            udp->set_capture(capture.get());
+        }
 
         // Create HTTP or HTTPS server based on options
         std::unique_ptr<HttpServer> http;
-        if (!cert_path.empty()) {
-            http = std::make_unique<HttpServer>(http_port, cert_path, key_path);
+        if (http_backend == "asio") {
+            if (!cert_path.empty()) {
+                http = std::make_unique<AsioHttpServer>(http_port, cert_path, key_path, http_threads);
+            } else {
+                http = std::make_unique<AsioHttpServer>(http_port, http_threads);
+            }
+        } else if (!cert_path.empty()) {
+            http = std::make_unique<HttplibServer>(http_port, cert_path, key_path);
         } else {
-            http = std::make_unique<HttpServer>(http_port);
+            http = std::make_unique<HttplibServer>(http_port);
+        }
+
+        http->set_worker_threads(mcp_threads);
+        http->set_compression(compression, compress_min_bytes);
+
+        std::unique_ptr<LogArchives> archives;
+        if (!archive_dir.empty()) {
+            archives = std::make_unique<LogArchives>(archive_dir, db_path, *storage);
+            ServerLog::log("Store", "Archives: " + std::to_string(archives->names().size()) +
+                           " databases in " + archive_dir);
         }
 
-        McpServer mcp(store, sources, *http);
+        ExportJobs exports(db_path, export_dir);
+        McpServer mcp(store, sources, *http, anomalies, rules, exports, archives.get());
 
         // Start file tailers from command line
         for (const auto& [path, name] : tail_files) {
@@ -149,15 +409,26 @@ int main(int argc, char* argv[]) {
         }
 
         // Start services
-        udp.start();
+        if (udp) udp->start();
+        if (follow) follow->start();
+#ifdef MCP_LOGS_COROUTINES
+        if (pipeline) pipeline->start();
+#endif
         http->start();
 
+        // The main thread runs the console from here on
+        ThreadPlacement::adopt(ThreadRole::Ui);
+
         if (legacy_console) {
             // Legacy mode: simple text output
             std::cout << "\nServer ready. Press Ctrl+C to stop.\n" << std::endl;
             std::cout << "MCP endpoint: " << (http->is_https() ? "https" : "http")
                       << "://0.0.0.0:" << http_port << "/sse" << std::endl;
-            std::cout << "UDP logs:     0.0.0.0:" << udp_port << std::endl;
+            if (follow) {
+                std::cout << "Following:    " << db_path << " (read-only)" << std::endl;
+            } else {
+                std::cout << "UDP logs:     0.0.0.0:" << udp_port << std::endl;
+            }
 
             // Main loop
             while (running) {
@@ -165,7 +436,7 @@ int main(int argc, char* argv[]) {
             }
         } else {
             // TUI mode: modern console UI
-            ConsoleUI ui(store, sources, udp_port, http_port, http->is_https(), db_path);
+            ConsoleUI ui(store, sources, anomalies, udp_port, http_port, http->is_https(), db_path);
 
             // Redirect server logging to TUI
             ServerLog::set_sink(ui.get_log_sink());
@@ -183,9 +454,20 @@ int main(int argc, char* argv[]) {
         // Cleanup
         ServerLog::log("Main", "Stopping services...");
         sources.stop_all();
-        udp.stop();
+        if (udp) udp->stop();
+        if (follow) follow->stop();
+#ifdef MCP_LOGS_COROUTINES
+        if (pipeline) pipeline->stop();
+#endif
         http->stop();
+        exports.stop();
+        if (capture) {
+            capture->flush();
+            ServerLog::log("UDP", "Captured " + std::to_string(capture->datagrams()) + " datagrams to " +
+                           capture->path());
+        }
 
+        ServerLog::log("Main", "CPU time by thread role: " + ThreadPlacement::describe_cpu_usage());
         ServerLog::log("Main", "Shutdown complete. Total logs: " + std::to_string(store.count()));
 
     } catch (const std::exception& e) {
@@ -1,16 +1,34 @@
 #include "mcp_server.hpp"
+#include "alloc_tracker.hpp"
 #include "source_manager.hpp"
 #include "server_log.hpp"
+#include "metrics.hpp"
+#include <algorithm>
 #include <chrono>
 
 namespace mcp_logs {
 
-McpServer::McpServer(LogStore& store, SourceManager& sources, HttpServer& http)
-    : store_(store), sources_(sources), http_(http)
+McpServer::McpServer(LogStore& store, SourceManager& sources, HttpServer& http,
+                     AnomalyDetector& anomalies, RuleEngine& rules, ExportJobs& exports,
+                     LogArchives* archives)
+    : store_(store), sources_(sources), http_(http), anomalies_(anomalies), rules_(rules), exports_(exports)
+    , archives_(archives)
+    , scheduler_(store, {}, archives)
+    , calls_(scheduler_.total_slots(), ThreadRole::Query)
 {
+    for (const auto& tool : handle_tools_list()["tools"]) {
+        tool_names_.insert(tool["name"].get<std::string>());
+    }
+
     http_.set_message_handler([this](const nlohmann::json& req, const std::string& session_id) {
         return handle_request(req, session_id);
     });
+    http_.set_disconnect_handler([this](const std::string& session_id) {
+        forget_session(session_id);
+    });
+    rules_.on_match([this](const RuleMatch& match) {
+        notify_rule_match(match);
+    });
 }
 
 nlohmann::json McpServer::success_response(const nlohmann::json& id, const nlohmann::json& result) {
@@ -30,6 +48,7 @@ nlohmann::json McpServer::error_response(const nlohmann::json& id, int code, con
 }
 
 nlohmann::json McpServer::handle_request(const nlohmann::json& request, const std::string& session_id) {
+    AllocScope alloc_scope(AllocSubsystem::Json);
     try {
         std::string method = request.value("method", "");
         nlohmann::json id = request.value("id", nlohmann::json());
@@ -48,14 +67,24 @@ nlohmann::json McpServer::handle_request(const nlohmann::json& request, const st
             return success_response(id, handle_tools_list());
         }
         else if (method == "tools/call") {
-            return success_response(id, handle_tools_call(params));
+            // Answered on the session's stream once the scheduler admits
+            // it, so a call waiting for a slot holds no executor thread
+            start_tools_call(id, params, session_id);
+            return nlohmann::json();
         }
         else if (method == "resources/list") {
             return success_response(id, handle_resources_list());
         }
+        else if (method == "resources/templates/list") {
+            return success_response(id, handle_resource_templates_list());
+        }
         else if (method == "resources/read") {
             return success_response(id, handle_resources_read(params));
         }
+        else if (method == "logging/setLevel") {
+            // Rule notifications are always sent; nothing to filter
+            return success_response(id, nlohmann::json::object());
+        }
         else if (method == "ping") {
             return success_response(id, nlohmann::json::object());
         }
@@ -73,7 +102,8 @@ nlohmann::json McpServer::handle_initialize(const nlohmann::json& params) {
         {"protocolVersion", "2024-11-05"},
         {"capabilities", {
             {"tools", nlohmann::json::object()},
-            {"resources", {{"subscribe", false}}}
+            {"resources", {{"subscribe", false}}},
+            {"logging", nlohmann::json::object()}
         }},
         {"serverInfo", {
             {"name", "ue-log-server"},
@@ -124,7 +154,8 @@ nlohmann::json McpServer::handle_tools_list() {
             "- Filter by 'verbosity' to focus on errors first, then expand\n"
             "- Compare multiple 'instance_id' values to debug desync between clients\n\n"
             "WORKFLOW: Call get_stats first to understand log distribution, then query specific categories.\n\n"
-            "RETURNS: {count, logs[]} where each log has source, category, verbosity, message, timestamp, frame, session_id, instance_id, and optionally file/line."},
+            "RETURNS: {count, logs[]} where each log has source, category, verbosity, message, timestamp, frame, session_id, instance_id, "
+            "template_id, norm_time, and optionally file/line/seq/attrs."},
         {"inputSchema", {
             {"type", "object"},
             {"properties", {
@@ -136,7 +167,8 @@ nlohmann::json McpServer::handle_tools_list() {
                 {"limit", {{"type", "integer"}, {"description", "Maximum results (default: 100). Increase for comprehensive analysis."}}},
                 {"session_id", {{"type", "string"}, {"description", "Filter to specific game session. Get session IDs from get_sessions."}}},
                 {"instance_id", {{"type", "string"}, {"description", "Filter to specific client/server instance within a session. Useful for debugging specific player's issues."}}},
-                {"all_sessions", {{"type", "boolean"}, {"description", "If true, query across all sessions. Default false returns only latest session. Set true to compare behavior across sessions."}}}
+                {"all_sessions", {{"type", "boolean"}, {"description", "If true, query across all sessions. Default false returns only latest session. Set true to compare behavior across sessions."}}},
+                {"include_archives", {{"type", "boolean"}, {"description", "With all_sessions (or an archived session_id), also read the server's archived databases (--archive-dir). Default true; results from an archive carry its file name in 'archive'."}}}
             }}
         }}
     });
@@ -152,6 +184,11 @@ nlohmann::json McpServer::handle_tools_list() {
             "- OR: 'error OR warning' finds either\n"
             "- NOT: 'player NOT respawn' excludes respawn\n"
             "- Prefix: 'play*' matches player, playing, etc.\n\n"
+            "REGEX: pass 'regex' (with or without 'query') to match messages against a regular expression, "
+            "e.g. 'Player_\\d+ took \\d+ damage' or '^Loaded .*\\.umap$'. Supports classes, \\d \\w \\s \\b, "
+            "anchors, groups, | and * + ? {m,n}; no backreferences or lookaround. Literal text in the pattern is "
+            "used to narrow candidates first, so include some. Regex results add {scanned, matched, truncated}; "
+            "'truncated' means max_scan rows were checked before the candidates ran out.\n\n"
             "WHEN TO USE:\n"
             "- Search for entity IDs: 'Player_123' or 'Entity_456'\n"
             "- Find error messages: 'failed OR error OR exception'\n"
@@ -162,14 +199,200 @@ nlohmann::json McpServer::handle_tools_list() {
             {"type", "object"},
             {"properties", {
                 {"query", {{"type", "string"}, {"description", "FTS5 search query. Use quotes for exact phrases, OR/NOT for boolean logic, * for prefix matching."}}},
+                {"regex", {{"type", "string"}, {"description", "Regular expression the message must match. Combined with 'query' when both are given."}}},
+                {"ignore_case", {{"type", "boolean"}, {"description", "Match the regex case-insensitively (default: false)."}}},
+                {"max_scan", {{"type", "integer"}, {"description", "Maximum rows to test against the regex (default: 100000), shared between the live store and any archives read."}}},
                 {"source", {{"type", "string"}, {"description", "Filter by 'client' or 'server' to narrow scope."}}},
                 {"verbosity", {{"type", "string"}, {"description", "Minimum verbosity level to include in results."}}},
+                {"category", {{"type", "string"}, {"description", "Only search within this log category."}}},
                 {"limit", {{"type", "integer"}, {"description", "Maximum results (default: 100)."}}},
                 {"session_id", {{"type", "string"}, {"description", "Search within specific session only."}}},
                 {"instance_id", {{"type", "string"}, {"description", "Search within specific client/server instance."}}},
-                {"all_sessions", {{"type", "boolean"}, {"description", "If true, search across all sessions. Useful for finding recurring issues."}}}
+                {"all_sessions", {{"type", "boolean"}, {"description", "If true, search across all sessions. Useful for finding recurring issues."}}},
+                {"include_archives", {{"type", "boolean"}, {"description", "With all_sessions (or an archived session_id), also read the server's archived databases (--archive-dir). Default true; results from an archive carry its file name in 'archive'."}}}
+            }}
+        }}
+    });
+
+    // grep_logs
+    tools.push_back({
+        {"name", "grep_logs"},
+        {"description",
+            "Raw substring search over log message bytes - no tokenization. Searches latest session by default.\n\n"
+            "WHEN TO USE (instead of search_logs):\n"
+            "- Hex IDs and GUIDs: '0x7ff3a2' or '3F2504E0-4F89'\n"
+            "- Punctuation-heavy text: asset paths like '/Game/Maps/Arena.umap', 'Actor::Tick', 'x=12.5'\n"
+            "- Partial words: 'spawn' also matches 'Respawned'\n"
+            "- Underscored identifiers: 'Player_123' without phrase-query surprises\n\n"
+            "The pattern is matched literally (no wildcards or operators). Filters are applied before scanning, "
+            "so narrow with session/category/verbosity/time to scan fewer rows.\n\n"
+            "RETURNS: {count, scanned, matched, truncated, logs[]}. 'truncated' means max_scan rows were checked "
+            "before the candidates ran out - narrow the filters or raise max_scan."},
+        {"inputSchema", {
+            {"type", "object"},
+            {"properties", {
+                {"pattern", {{"type", "string"}, {"description", "Literal text to find anywhere in the message."}}},
+                {"ignore_case", {{"type", "boolean"}, {"description", "Match ASCII letters case-insensitively (default: false)."}}},
+                {"source", {{"type", "string"}, {"description", "Filter by 'client' or 'server'."}}},
+                {"category", {{"type", "string"}, {"description", "Only scan this log category."}}},
+                {"verbosity", {{"type", "string"}, {"description", "Minimum verbosity level to include in results."}}},
+                {"since", {{"type", "number"}, {"description", "Only scan logs at or after this timestamp."}}},
+                {"until", {{"type", "number"}, {"description", "Only scan logs at or before this timestamp."}}},
+                {"limit", {{"type", "integer"}, {"description", "Maximum results (default: 100)."}}},
+                {"max_scan", {{"type", "integer"}, {"description", "Maximum rows to scan (default: 100000), shared between the live store and any archives read."}}},
+                {"session_id", {{"type", "string"}, {"description", "Scan within specific session only."}}},
+                {"instance_id", {{"type", "string"}, {"description", "Scan within specific client/server instance."}}},
+                {"all_sessions", {{"type", "boolean"}, {"description", "If true, scan across all sessions."}}},
+                {"include_archives", {{"type", "boolean"}, {"description", "With all_sessions (or an archived session_id), also read the server's archived databases (--archive-dir). Default true; results from an archive carry its file name in 'archive'."}}}
             }},
-            {"required", {"query"}}
+            {"required", {"pattern"}}
+        }}
+    });
+
+    // sql_query
+    tools.push_back({
+        {"name", "sql_query"},
+        {"description",
+            "Run a read-only SQL SELECT directly against the log database. The aggregation runs next to the "
+            "data, so use this instead of pulling thousands of rows through query_logs.\n\n"
+            "SCHEMA:\n"
+            "- logs(id, source, category, verbosity, message, timestamp, frame, file, line, received_at, "
+            "session_id, instance_id, seq, attrs, template_id, norm_time). verbosity: 1=Fatal 2=Error 3=Warning "
+            "4=Display 5=Log 6=Verbose 7=VeryVerbose. attrs: JSON object text, use json_extract(attrs, '$.key'). "
+            "template_id: same value for messages differing only in numbers/IDs (0 in rows older than the column). "
+            "norm_time: timestamp corrected for the instance's clock skew; order across instances by it\n"
+            "- logs_fts(message): FTS5 index over logs.message, rowid = logs.id\n\n"
+            "WHEN TO USE:\n"
+            "- Group/count: SELECT category, COUNT(*) FROM logs WHERE session_id = '...' GROUP BY category ORDER BY 2 DESC\n"
+            "- Time buckets: SELECT CAST(timestamp / 10 AS INT) * 10 AS bucket, COUNT(*) FROM logs WHERE verbosity <= 2 GROUP BY bucket\n"
+            "- Per-instance comparisons, top-N messages, joins against logs_fts\n\n"
+            "LIMITS: one SELECT statement only; writes, PRAGMA and ATTACH are rejected. Core, date, math, JSON, "
+            "window and FTS5 (bm25, highlight, snippet) functions are available; others such as load_extension "
+            "are rejected. Queries are interrupted "
+            "after timeout_ms, and results stop at max_rows rows or about 1MB.\n\n"
+            "RETURNS: {columns[], rows[][], row_count, truncated, elapsed_ms}."},
+        {"inputSchema", {
+            {"type", "object"},
+            {"properties", {
+                {"sql", {{"type", "string"}, {"description", "A single SELECT statement."}}},
+                {"max_rows", {{"type", "integer"}, {"description", "Maximum rows to return (default: 1000, max: 10000)."}}},
+                {"timeout_ms", {{"type", "integer"}, {"description", "Time limit in milliseconds (default: 2000, max: 10000)."}}}
+            }},
+            {"required", {"sql"}}
+        }}
+    });
+
+    // find_similar
+    tools.push_back({
+        {"name", "find_similar"},
+        {"description",
+            "Find near-duplicates of a log message across ALL sessions - the same message with different IDs, "
+            "numbers or addresses, plus close variants. Numbers become <N> and hex IDs <HEX>, so "
+            "'Player_12 took 30 damage' and 'Player_7 took 115 damage' fall in the same cluster.\n\n"
+            "WHEN TO USE:\n"
+            "- You found one interesting message and want every place it (or something like it) happened\n"
+            "- Checking whether an error is new or recurs across sessions\n"
+            "- Instead of building long OR-queries out of IDs for search_logs\n\n"
+            "Pass either 'log_id' (from another tool's results) or the 'message' text.\n\n"
+            "RETURNS: clusters[] of {template, similarity, count, sessions[{session_id, count}], example}, most similar first. "
+            "similarity is an estimate in [0, 1]; 1.0 means the same template."},
+        {"inputSchema", {
+            {"type", "object"},
+            {"properties", {
+                {"log_id", {{"type", "integer"}, {"description", "ID of the log whose message to match."}}},
+                {"message", {{"type", "string"}, {"description", "Message text to match (if no log_id)."}}},
+                {"min_similarity", {{"type", "number"}, {"description", "Minimum estimated similarity, 0-1 (default: 0.5)."}}},
+                {"limit", {{"type", "integer"}, {"description", "Maximum clusters (default: 20)."}}}
+            }}
+        }}
+    });
+
+    // get_anomalies
+    tools.push_back({
+        {"name", "get_anomalies"},
+        {"description",
+            "Get anomalies the server detected on its own while logs streamed in - no query needed.\n\n"
+            "TYPES:\n"
+            "- spike: a (category, instance, verbosity) stream logged far above its recent baseline "
+            "(10s buckets, score = standard deviations above normal)\n"
+            "- new_error_template: an Error/Fatal message shape not seen since the server started\n"
+            "- quiet_instance: an instance that was logging steadily has gone silent (crash, hang, disconnect)\n\n"
+            "WHEN TO USE:\n"
+            "- First thing when asked 'did anything weird happen?'\n"
+            "- Polling during a live repro - pass the highest id you have seen as since_id\n\n"
+            "RETURNS: anomalies[] newest first, each {id, type, detected_at, category, instance_id, session_id, "
+            "verbosity, observed, expected, score, detail, example_id}, plus total detected so far. "
+            "Use example_id with find_similar or query_logs to see the surrounding logs."},
+        {"inputSchema", {
+            {"type", "object"},
+            {"properties", {
+                {"type", {{"type", "string"}, {"description", "Only 'spike', 'new_error_template' or 'quiet_instance'."}}},
+                {"since_id", {{"type", "integer"}, {"description", "Only anomalies with a greater id."}}},
+                {"limit", {{"type", "integer"}, {"description", "Maximum anomalies (default: 50)."}}}
+            }}
+        }}
+    });
+
+    // add_rule
+    tools.push_back({
+        {"name", "add_rule"},
+        {"description",
+            "Install a trigger rule that is checked against every incoming log, so you are told about "
+            "errors instead of polling for them. Matches are pushed to this MCP session as "
+            "notifications/message (logger 'rules') and shown in the server console.\n\n"
+            "EXAMPLES:\n"
+            "- Any Fatal: {verbosity: 'Fatal'}\n"
+            "- Error storm: {verbosity: 'Error', category: 'LogNet', threshold: 50, window_seconds: 10}\n"
+            "- Specific message: {regex: 'Ensure condition failed.*Inventory'}\n\n"
+            "All conditions that are given must hold. 'verbosity' matches that level and more severe. "
+            "The rule fires when 'threshold' matching logs arrive within 'window_seconds', then starts a fresh window.\n\n"
+            "RETURNS: the installed rule with its id. Use list_rules to see matches (also useful if your "
+            "client does not surface notifications) and remove_rule to delete it."},
+        {"inputSchema", {
+            {"type", "object"},
+            {"properties", {
+                {"name", {{"type", "string"}, {"description", "Label shown with each match."}}},
+                {"verbosity", {{"type", "string"}, {"description", "Match this level and more severe (Fatal, Error, Warning, ...)."}}},
+                {"category", {{"type", "string"}, {"description", "Exact category."}}},
+                {"source", {{"type", "string"}, {"description", "'client' or 'server'."}}},
+                {"instance_id", {{"type", "string"}, {"description", "Exact instance."}}},
+                {"contains", {{"type", "string"}, {"description", "Substring the message must contain."}}},
+                {"regex", {{"type", "string"}, {"description", "Regex the message must match. It needs some literal text (e.g. 'Ensure.*failed'), unless category, instance_id or contains narrows the rule."}}},
+                {"ignore_case", {{"type", "boolean"}, {"description", "Case-insensitive contains/regex (default: false)."}}},
+                {"threshold", {{"type", "integer"}, {"description", "Matching logs needed to fire (default: 1)."}}},
+                {"window_seconds", {{"type", "number"}, {"description", "Time the threshold must be reached in (default: unlimited)."}}},
+                {"cooldown_seconds", {{"type", "number"}, {"description", "Minimum seconds between firings (default: 0)."}}},
+                {"notify", {{"type", "boolean"}, {"description", "Push matches to this session (default: true)."}}}
+            }}
+        }}
+    });
+
+    // remove_rule
+    tools.push_back({
+        {"name", "remove_rule"},
+        {"description", "Delete a trigger rule installed with add_rule.\n\nRETURNS: {removed: bool}"},
+        {"inputSchema", {
+            {"type", "object"},
+            {"properties", {
+                {"rule_id", {{"type", "string"}, {"description", "Rule id from add_rule or list_rules."}}}
+            }},
+            {"required", {"rule_id"}}
+        }}
+    });
+
+    // list_rules
+    tools.push_back({
+        {"name", "list_rules"},
+        {"description",
+            "List trigger rules with their match/fire counts, plus recent firings.\n\n"
+            "RETURNS: rules[] of {rule, matched, fired, last_fired}, and matches[] newest first of "
+            "{id, rule_id, rule_name, fired_at, window_count, log}. Pass the highest match id you have seen as since_id to poll."},
+        {"inputSchema", {
+            {"type", "object"},
+            {"properties", {
+                {"since_id", {{"type", "integer"}, {"description", "Only matches with a greater id."}}},
+                {"limit", {{"type", "integer"}, {"description", "Maximum matches (default: 50)."}}}
+            }}
         }}
     });
 
@@ -183,13 +406,16 @@ nlohmann::json McpServer::handle_tools_list() {
             "- Identify hot spots: Which categories have the most logs?\n"
             "- Compare client vs server: Is one side logging more errors?\n"
             "- Track trends: Use 'since' to see stats for recent time window only.\n\n"
-            "RETURNS: total_count, client_count, server_count, error_count, warning_count, by_category (top 20), session_count, instance_count, current_session.\n\n"
+            "RETURNS: total_count, client_count, server_count, error_count, warning_count, by_category (top 20), session_count, instance_count, current_session. "
+            "With archives, counts are summed but session_count and instance_count are the live store's; "
+            "archives[] has each archive's own.\n\n"
             "WORKFLOW: Call this first, then drill down into specific categories or error types."},
         {"inputSchema", {
             {"type", "object"},
             {"properties", {
                 {"source", {{"type", "string"}, {"description", "Filter stats to 'client' or 'server' only."}}},
-                {"since", {{"type", "number"}, {"description", "Only count logs after this Unix timestamp. Use to see recent activity only."}}}
+                {"since", {{"type", "number"}, {"description", "Only count logs after this Unix timestamp. Use to see recent activity only."}}},
+                {"include_archives", {{"type", "boolean"}, {"description", "Add the server's archived databases (--archive-dir) to the counts, with a per-archive breakdown in 'archives'. Default true."}}}
             }}
         }}
     });
@@ -292,52 +518,156 @@ nlohmann::json McpServer::handle_tools_list() {
             {"type", "object"},
             {"properties", {
                 {"source", {{"type", "string"}, {"description", "Filter to sessions that have 'client' or 'server' logs."}}},
-                {"limit", {{"type", "integer"}, {"description", "Max sessions to return (default: 20). Most recent sessions first."}}}
+                {"limit", {{"type", "integer"}, {"description", "Max sessions to return (default: 20). Most recent sessions first."}}},
+                {"include_archives", {{"type", "boolean"}, {"description", "Also list sessions from the server's archived databases (--archive-dir), tagged with 'archive'. Default true."}}}
             }}
         }}
     });
 
+    // multi_query
+    tools.push_back({
+        {"name", "multi_query"},
+        {"description",
+            "Run several read tools in one call, against one consistent snapshot of the logs.\n\n"
+            "WHEN TO USE:\n"
+            "- Starting an investigation: get_stats + errors + a category or two + a search, in one round-trip\n"
+            "- Comparing views that must agree (e.g. stats and the matching logs), since no new logs arrive between the sub-requests\n\n"
+            "SUB-REQUESTS: Each is {tool, arguments} where tool is one of query_logs, search_logs, grep_logs, "
+            "get_stats, get_categories, tail_logs, get_sessions, and arguments are that tool's arguments. "
+            "They run in order; a failing sub-request reports its error without failing the others. "
+            "They read the live store only (no archives), and grep_logs and regex searches share one max_scan.\n\n"
+            "RETURNS: {count, results[]} with one {tool, result} or {tool, error} per sub-request, in request order."},
+        {"inputSchema", {
+            {"type", "object"},
+            {"properties", {
+                {"requests", {
+                    {"type", "array"},
+                    {"description", "Up to 20 sub-requests, e.g. [{\"tool\": \"get_stats\"}, {\"tool\": \"query_logs\", \"arguments\": {\"verbosity\": \"Error\"}}]"},
+                    {"items", {
+                        {"type", "object"},
+                        {"properties", {
+                            {"tool", {{"type", "string"}, {"description", "Read tool to run."}}},
+                            {"arguments", {{"type", "object"}, {"description", "Arguments for that tool."}}}
+                        }},
+                        {"required", {"tool"}}
+                    }}
+                }},
+                {"max_scan", {{"type", "integer"}, {"description", "Rows all grep_logs and regex sub-requests may scan together (default and maximum: 100000)."}}}
+            }},
+            {"required", {"requests"}}
+        }}
+    });
+
+    // get_memory_stats
+    tools.push_back({
+        {"name", "get_memory_stats"},
+        {"description",
+            "Debug: where the server's heap memory goes.\n\n"
+            "RETURNS: tracking (true only in builds with ENABLE_ALLOC_TRACKING; otherwise subsystems is empty), "
+            "rows_ingested, subsystems[] of {subsystem, live_bytes, allocated_bytes, allocations, frees, "
+            "allocations_per_row, bytes_per_row}, and sqlite {memory_used, memory_highwater, allocations, "
+            "largest_allocation, pagecache_overflow_bytes, connection {cache_bytes, schema_bytes, statement_bytes, lookaside_slots}}."},
+        {"inputSchema", {
+            {"type", "object"},
+            {"properties", nlohmann::json::object()}
+        }}
+    });
+
+    // export_logs
+    tools.push_back({
+        {"name", "export_logs"},
+        {"description",
+            "Export logs to a columnar Arrow IPC (Feather v2) file in the server's export directory, "
+            "for analysis in pandas, polars, DuckDB or Arrow. Runs in the background; poll export_status.\n\n"
+            "WHEN TO USE:\n"
+            "- Whole sessions or long time ranges, too big to page through query_logs\n"
+            "- Offline analysis or archiving of a play session\n\n"
+            "COLUMNS: id, source, category, verbosity, message, timestamp, frame, file, line, received_at, "
+            "session_id, instance_id, seq, attrs (JSON text), template_id, norm_time. Timestamps are UTC microseconds; source, category, verbosity, file, "
+            "session_id and instance_id are dictionary encoded. Buffers are zstd compressed when the server supports it.\n\n"
+            "RETURNS: job_id, state, path. Rows are exported oldest first, up to the newest row when the job "
+            "started. Rows are read in chunks, each in its own read transaction, so a long export doesn't "
+            "hold back the database's write-ahead log."},
+        {"inputSchema", {
+            {"type", "object"},
+            {"properties", {
+                {"file", {{"type", "string"}, {"description", "File name within the export directory, e.g. 'match42.arrow'. No paths."}}},
+                {"sessions", {{"type", "array"}, {"items", {{"type", "string"}}}, {"description", "Session IDs to export ('latest' for the current one). Omit for all sessions."}}},
+                {"since", {{"type", "number"}, {"description", "Only logs with timestamp >= this Unix time."}}},
+                {"until", {{"type", "number"}, {"description", "Only logs with timestamp <= this Unix time."}}},
+                {"source", {{"type", "string"}, {"description", "Only 'client' or 'server' logs (or a tailer's source name)."}}},
+                {"compress", {{"type", "boolean"}, {"description", "Compress column buffers with zstd when supported (default: true)."}}}
+            }},
+            {"required", {"file"}}
+        }}
+    });
+
+    // export_status
+    tools.push_back({
+        {"name", "export_status"},
+        {"description",
+            "Progress of an export_logs job, or cancel it.\n\n"
+            "RETURNS: job_id, state (running, done, failed, cancelled), path, rows, batches, bytes, "
+            "elapsed_seconds, and error if it failed. Finished jobs are forgotten after 10 minutes."},
+        {"inputSchema", {
+            {"type", "object"},
+            {"properties", {
+                {"job_id", {{"type", "string"}, {"description", "ID returned by export_logs."}}},
+                {"cancel", {{"type", "boolean"}, {"description", "Stop the job if it is still running."}}}
+            }},
+            {"required", {"job_id"}}
+        }}
+    });
+
     return {{"tools", tools}};
 }
 
-nlohmann::json McpServer::handle_tools_call(const nlohmann::json& params) {
+void McpServer::start_tools_call(const nlohmann::json& id, const nlohmann::json& params,
+                                 const std::string& session_id) {
     std::string name = params.value("name", "");
     nlohmann::json args = params.value("arguments", nlohmann::json::object());
+    auto respond = [this, id, session_id](const nlohmann::json& content) {
+        http_.send_sse(session_id, "message", success_response(id, content));
+    };
 
-    nlohmann::json result;
-    bool is_error = false;
+    QueryCost cost;
+    try {
+        cost = scheduler_.estimate(tool_names_.count(name) ? name : "other", args);
+    } catch (const std::exception& e) {
+        respond(tool_content(std::string("Error: ") + e.what(), true));
+        return;
+    }
+
+    // Queue for a slot in the lane this call's estimated cost puts it in,
+    // then run on calls_, which has a thread for every slot
+    scheduler_.submit(session_id, cost,
+        [this, name, args, session_id, respond](QueryScheduler::Admission admission) {
+            auto slot = std::make_shared<QueryScheduler::Admission>(std::move(admission));
+            calls_.submit([this, name, args, session_id, respond, slot]() mutable {
+                AllocScope alloc_scope(AllocSubsystem::Json);
+                nlohmann::json content = run_tools_call(name, args, session_id);
+                slot.reset();   // Free the slot before the response goes out
+                respond(content);
+            });
+        },
+        [respond](const std::string& error) {
+            respond(tool_content("Error: " + error, true));
+        });
+}
 
+nlohmann::json McpServer::run_tools_call(const std::string& name, const nlohmann::json& args,
+                                         const std::string& session_id) {
     try {
-        if (name == "query_logs") {
-            result = tool_query_logs(args);
-        }
-        else if (name == "search_logs") {
-            result = tool_search_logs(args);
-        }
-        else if (name == "get_stats") {
-            result = tool_get_stats(args);
-        }
-        else if (name == "get_categories") {
-            result = tool_get_categories(args);
-        }
-        else if (name == "clear_logs") {
-            result = tool_clear_logs(args);
-        }
-        else if (name == "tail_logs") {
-            result = tool_tail_logs(args);
-        }
-        else if (name == "get_sessions") {
-            result = tool_get_sessions(args);
-        }
-        else {
-            is_error = true;
-            result = "Unknown tool: " + name;
+        if (auto output = call_tool(name, args, session_id)) {
+            return tool_content(*output, false);
         }
+        return tool_content("Unknown tool: " + name, true);
     } catch (const std::exception& e) {
-        is_error = true;
-        result = std::string("Error: ") + e.what();
+        return tool_content(std::string("Error: ") + e.what(), true);
     }
+}
 
+nlohmann::json McpServer::tool_content(const nlohmann::json& result, bool is_error) {
     nlohmann::json content = nlohmann::json::array();
     content.push_back({
         {"type", "text"},
@@ -350,6 +680,65 @@ nlohmann::json McpServer::handle_tools_call(const nlohmann::json& params) {
     };
 }
 
+std::optional<nlohmann::json> McpServer::call_tool(const std::string& name, const nlohmann::json& args,
+                                                  const std::string& session_id) {
+    if (name == "query_logs") {
+        return tool_query_logs(args);
+    }
+    else if (name == "search_logs") {
+        return tool_search_logs(args);
+    }
+    else if (name == "grep_logs") {
+        return tool_grep_logs(args);
+    }
+    else if (name == "sql_query") {
+        return tool_sql_query(args);
+    }
+    else if (name == "find_similar") {
+        return tool_find_similar(args);
+    }
+    else if (name == "get_anomalies") {
+        return tool_get_anomalies(args);
+    }
+    else if (name == "add_rule") {
+        return tool_add_rule(args, session_id);
+    }
+    else if (name == "remove_rule") {
+        return tool_remove_rule(args);
+    }
+    else if (name == "list_rules") {
+        return tool_list_rules(args);
+    }
+    else if (name == "get_stats") {
+        return tool_get_stats(args);
+    }
+    else if (name == "get_categories") {
+        return tool_get_categories(args);
+    }
+    else if (name == "clear_logs") {
+        return tool_clear_logs(args);
+    }
+    else if (name == "tail_logs") {
+        return tool_tail_logs(args);
+    }
+    else if (name == "get_sessions") {
+        return tool_get_sessions(args);
+    }
+    else if (name == "multi_query") {
+        return tool_multi_query(args, session_id);
+    }
+    else if (name == "get_memory_stats") {
+        return tool_get_memory_stats(args);
+    }
+    else if (name == "export_logs") {
+        return tool_export_logs(args);
+    }
+    else if (name == "export_status") {
+        return tool_export_status(args);
+    }
+    return std::nullopt;
+}
+
 nlohmann::json McpServer::handle_resources_list() {
     nlohmann::json resources = nlohmann::json::array();
 
@@ -400,6 +789,26 @@ nlohmann::json McpServer::handle_resources_list() {
     return {{"resources", resources}};
 }
 
+nlohmann::json McpServer::handle_resource_templates_list() {
+    nlohmann::json templates = nlohmann::json::array();
+
+    templates.push_back({
+        {"uriTemplate", "logs://session/{id}/digest"},
+        {"name", "Session Digest"},
+        {"description",
+            "Precomputed summary of one session in a single cheap read. Use 'latest' as the id for the most recent session.\n\n"
+            "USE FOR: RECOMMENDED FIRST STEP for a session - replaces get_stats, get_categories, logs://errors and several queries.\n\n"
+            "RETURNS: log_count, first/last timestamp, by_source, by_category, by_verbosity, error_count, warning_count, "
+            "first_error, last_error, top_templates (most frequent messages with numbers normalized), "
+            "timeline {start, bucket_seconds, counts[]}, instances[] with count and largest_gap (longest silence, a hint at hangs or disconnects). "
+            "'final' is false while the session is still receiving logs.\n\n"
+            "TIP: Session IDs come from get_sessions."},
+        {"mimeType", "application/json"}
+    });
+
+    return {{"resourceTemplates", templates}};
+}
+
 nlohmann::json McpServer::handle_resources_read(const nlohmann::json& params) {
     std::string uri = params.value("uri", "");
 
@@ -417,6 +826,10 @@ nlohmann::json McpServer::handle_resources_read(const nlohmann::json& params) {
     else if (uri == "logs://current-session") {
         result = resource_current_session();
     }
+    else if (uri.rfind("logs://session/", 0) == 0 && uri.size() > 22 &&
+             uri.compare(uri.size() - 7, 7, "/digest") == 0) {
+        result = resource_session_digest(uri.substr(15, uri.size() - 22));
+    }
     else {
         throw std::runtime_error("Unknown resource: " + uri);
     }
@@ -448,27 +861,45 @@ nlohmann::json McpServer::tool_query_logs(const nlohmann::json& args) {
     if (args.contains("instance_id")) filter.instance_id = args["instance_id"].get<std::string>();
     if (args.contains("all_sessions")) filter.all_sessions = args["all_sessions"].get<bool>();
 
-    auto logs = store_.query(filter);
-
     nlohmann::json result = nlohmann::json::array();
-    for (const auto& log : logs) {
-        result.push_back(log.to_json());
+    ArchiveErrors archive_errors;
+    if (use_archives(args, &filter)) {
+        auto merged = archives_->query(store_, filter);
+        for (const auto& log : merged.logs) {
+            result.push_back(log.to_json());
+        }
+        archive_errors = std::move(merged.errors);
+    } else {
+        for (const auto& log : store_.query(filter)) {
+            result.push_back(log.to_json());
+        }
     }
 
-    return {
-        {"count", logs.size()},
+    nlohmann::json response = {
+        {"count", result.size()},
         {"logs", result}
     };
+    if (!archive_errors.empty()) response["archive_errors"] = archive_errors_to_json(archive_errors);
+    return response;
+}
+
+bool McpServer::use_archives(const nlohmann::json& args, const LogFilter* filter) const {
+    if (!archives_ || !args.value("include_archives", true)) return false;
+    if (!filter) return true;
+    if (filter->session_id) return store_.estimate_rows(*filter) == 0;
+    return filter->all_sessions;
 }
 
 nlohmann::json McpServer::tool_search_logs(const nlohmann::json& args) {
     std::string query = args.value("query", "");
-    if (query.empty()) {
-        throw std::runtime_error("Query parameter is required");
+    std::string regex = args.value("regex", "");
+    if (query.empty() && regex.empty()) {
+        throw std::runtime_error("Query or regex parameter is required");
     }
 
     LogFilter filter;
     if (args.contains("source")) filter.source = args["source"].get<std::string>();
+    if (args.contains("category")) filter.category = args["category"].get<std::string>();
     if (args.contains("limit")) filter.limit = args["limit"].get<int>();
     if (args.contains("verbosity")) {
         filter.min_verbosity = string_to_verbosity(args["verbosity"].get<std::string>());
@@ -477,18 +908,254 @@ nlohmann::json McpServer::tool_search_logs(const nlohmann::json& args) {
     if (args.contains("instance_id")) filter.instance_id = args["instance_id"].get<std::string>();
     if (args.contains("all_sessions")) filter.all_sessions = args["all_sessions"].get<bool>();
 
-    auto logs = store_.search(query, filter);
+    if (!regex.empty()) {
+        bool ignore_case = args.value("ignore_case", false);
+        int64_t max_scan = args.value("max_scan", static_cast<int64_t>(100000));
+        ArchivedScan scan;
+        if (use_archives(args, &filter)) {
+            scan = archives_->regex_search(store_, regex, ignore_case, filter, max_scan, query);
+        } else {
+            ScanResult live = store_.regex_search(regex, ignore_case, filter, max_scan, query);
+            scan = {{}, live.scanned, live.matched, live.truncated, {}};
+            for (auto& log : live.logs) scan.logs.push_back({"", std::move(log)});
+        }
+
+        nlohmann::json result = nlohmann::json::array();
+        for (const auto& log : scan.logs) {
+            result.push_back(log.to_json());
+        }
+
+        nlohmann::json response = {
+            {"count", scan.logs.size()},
+            {"regex", regex},
+            {"scanned", scan.scanned},
+            {"matched", scan.matched},
+            {"truncated", scan.truncated},
+            {"logs", result}
+        };
+        if (!query.empty()) response["query"] = query;
+        if (!scan.errors.empty()) response["archive_errors"] = archive_errors_to_json(scan.errors);
+        return response;
+    }
 
     nlohmann::json result = nlohmann::json::array();
-    for (const auto& log : logs) {
-        result.push_back(log.to_json());
+    ArchiveErrors archive_errors;
+    if (use_archives(args, &filter)) {
+        auto merged = archives_->search(store_, query, filter);
+        for (const auto& log : merged.logs) {
+            result.push_back(log.to_json());
+        }
+        archive_errors = std::move(merged.errors);
+    } else {
+        for (const auto& log : store_.search(query, filter)) {
+            result.push_back(log.to_json());
+        }
     }
 
-    return {
-        {"count", logs.size()},
+    nlohmann::json response = {
+        {"count", result.size()},
         {"query", query},
         {"logs", result}
     };
+    if (!archive_errors.empty()) response["archive_errors"] = archive_errors_to_json(archive_errors);
+    return response;
+}
+
+nlohmann::json McpServer::tool_grep_logs(const nlohmann::json& args) {
+    std::string pattern = args.value("pattern", "");
+    if (pattern.empty()) {
+        throw std::runtime_error("Pattern parameter is required");
+    }
+
+    bool ignore_case = args.value("ignore_case", false);
+    int64_t max_scan = args.value("max_scan", static_cast<int64_t>(100000));
+
+    LogFilter filter;
+    if (args.contains("source")) filter.source = args["source"].get<std::string>();
+    if (args.contains("category")) filter.category = args["category"].get<std::string>();
+    if (args.contains("since")) filter.since = args["since"].get<double>();
+    if (args.contains("until")) filter.until = args["until"].get<double>();
+    if (args.contains("limit")) filter.limit = args["limit"].get<int>();
+    if (args.contains("verbosity")) {
+        filter.min_verbosity = string_to_verbosity(args["verbosity"].get<std::string>());
+    }
+    if (args.contains("session_id")) filter.session_id = args["session_id"].get<std::string>();
+    if (args.contains("instance_id")) filter.instance_id = args["instance_id"].get<std::string>();
+    if (args.contains("all_sessions")) filter.all_sessions = args["all_sessions"].get<bool>();
+
+    ArchivedScan scan;
+    if (use_archives(args, &filter)) {
+        scan = archives_->grep(store_, pattern, ignore_case, filter, max_scan);
+    } else {
+        ScanResult live = store_.grep(pattern, ignore_case, filter, max_scan);
+        scan = {{}, live.scanned, live.matched, live.truncated, {}};
+        for (auto& log : live.logs) scan.logs.push_back({"", std::move(log)});
+    }
+
+    nlohmann::json result = nlohmann::json::array();
+    for (const auto& log : scan.logs) {
+        result.push_back(log.to_json());
+    }
+
+    nlohmann::json response = {
+        {"count", scan.logs.size()},
+        {"pattern", pattern},
+        {"scanned", scan.scanned},
+        {"matched", scan.matched},
+        {"truncated", scan.truncated},
+        {"logs", result}
+    };
+    if (!scan.errors.empty()) response["archive_errors"] = archive_errors_to_json(scan.errors);
+    return response;
+}
+
+nlohmann::json McpServer::tool_sql_query(const nlohmann::json& args) {
+    std::string sql = args.value("sql", "");
+    if (sql.empty()) {
+        throw std::runtime_error("SQL parameter is required");
+    }
+
+    SqlLimits limits;
+    limits.max_rows = std::clamp<int64_t>(args.value("max_rows", static_cast<int64_t>(1000)), 1, 10000);
+    limits.timeout_ms = std::clamp(args.value("timeout_ms", 2000), 1, 10000);
+
+    auto result = store_.sql_query(sql, limits);
+
+    return {
+        {"columns", result.columns},
+        {"rows", result.rows},
+        {"row_count", result.rows.size()},
+        {"truncated", result.truncated},
+        {"elapsed_ms", result.elapsed_ms}
+    };
+}
+
+nlohmann::json McpServer::tool_find_similar(const nlohmann::json& args) {
+    std::string message = args.value("message", "");
+    if (args.contains("log_id")) {
+        int64_t id = args["log_id"].get<int64_t>();
+        auto log = store_.get_log(id);
+        if (!log) {
+            throw std::runtime_error("Log not found: " + std::to_string(id));
+        }
+        message = log->message;
+    }
+    if (message.empty()) {
+        throw std::runtime_error("log_id or message parameter is required");
+    }
+
+    double min_similarity = args.value("min_similarity", 0.5);
+    int limit = args.value("limit", 20);
+
+    auto clusters = store_.find_similar(message, min_similarity, static_cast<size_t>(std::max(1, limit)));
+
+    nlohmann::json result = nlohmann::json::array();
+    for (const auto& cluster : clusters) {
+        nlohmann::json sessions = nlohmann::json::array();
+        for (const auto& [session_id, count] : cluster.sessions) {
+            sessions.push_back({{"session_id", session_id}, {"count", count}});
+        }
+        result.push_back({
+            {"template", cluster.template_text},
+            {"similarity", cluster.similarity},
+            {"count", cluster.count},
+            {"sessions", sessions},
+            {"example", {
+                {"id", cluster.example_id},
+                {"message", cluster.example_message},
+                {"session_id", cluster.example_session},
+                {"timestamp", cluster.example_timestamp}
+            }}
+        });
+    }
+
+    return {
+        {"count", clusters.size()},
+        {"message", message},
+        {"clusters", result}
+    };
+}
+
+nlohmann::json McpServer::tool_get_anomalies(const nlohmann::json& args) {
+    std::string type = args.value("type", "");
+    int64_t since_id = args.value("since_id", static_cast<int64_t>(0));
+    int limit = args.value("limit", 50);
+
+    // Up to date as of now, rather than the last log or timer tick
+    auto now = std::chrono::system_clock::now();
+    anomalies_.tick(std::chrono::duration<double>(now.time_since_epoch()).count());
+
+    auto anomalies = anomalies_.get(since_id, type, static_cast<size_t>(std::max(1, limit)));
+
+    nlohmann::json result = nlohmann::json::array();
+    for (const auto& anomaly : anomalies) {
+        result.push_back(anomaly.to_json());
+    }
+
+    return {
+        {"count", result.size()},
+        {"total_detected", anomalies_.total()},
+        {"anomalies", result}
+    };
+}
+
+nlohmann::json McpServer::tool_add_rule(const nlohmann::json& args, const std::string& session_id) {
+    TriggerRule rule = rules_.add_rule(TriggerRule::from_json(args));
+
+    bool notify = args.value("notify", true);
+    if (notify) {
+        // Checked under the lock so a stream closing meanwhile can't be missed
+        // by forget_session()
+        std::lock_guard<std::mutex> lock(rule_sessions_mutex_);
+        if (http_.has_sse_client(session_id)) rule_sessions_[rule.id].insert(session_id);
+    }
+
+    return {
+        {"rule", rule.to_json()},
+        {"notify", notify}
+    };
+}
+
+nlohmann::json McpServer::tool_remove_rule(const nlohmann::json& args) {
+    if (!args.contains("rule_id")) {
+        throw std::runtime_error("rule_id parameter is required");
+    }
+    std::string rule_id = args["rule_id"].get<std::string>();
+
+    bool removed = rules_.remove_rule(rule_id);
+    {
+        std::lock_guard<std::mutex> lock(rule_sessions_mutex_);
+        rule_sessions_.erase(rule_id);
+    }
+
+    return {{"removed", removed}};
+}
+
+nlohmann::json McpServer::tool_list_rules(const nlohmann::json& args) {
+    int64_t since_id = args.value("since_id", static_cast<int64_t>(0));
+    int limit = args.value("limit", 50);
+
+    nlohmann::json rules = nlohmann::json::array();
+    for (const auto& status : rules_.rules()) {
+        nlohmann::json entry = {
+            {"rule", status.rule.to_json()},
+            {"matched", status.matched},
+            {"fired", status.fired},
+            {"last_fired", nullptr}
+        };
+        if (status.last_fired) entry["last_fired"] = *status.last_fired;
+        rules.push_back(entry);
+    }
+
+    nlohmann::json matches = nlohmann::json::array();
+    for (const auto& match : rules_.matches(since_id, static_cast<size_t>(std::max(1, limit)))) {
+        matches.push_back(match.to_json());
+    }
+
+    return {
+        {"rules", rules},
+        {"matches", matches}
+    };
 }
 
 nlohmann::json McpServer::tool_get_stats(const nlohmann::json& args) {
@@ -498,6 +1165,9 @@ nlohmann::json McpServer::tool_get_stats(const nlohmann::json& args) {
     if (args.contains("source")) source = args["source"].get<std::string>();
     if (args.contains("since")) since = args["since"].get<double>();
 
+    if (use_archives(args)) {
+        return archives_->get_stats(store_, source, since).to_json();
+    }
     return store_.get_stats(source, since).to_json();
 }
 
@@ -559,24 +1229,165 @@ nlohmann::json McpServer::tool_get_sessions(const nlohmann::json& args) {
 
     if (args.contains("source")) source = args["source"].get<std::string>();
 
-    auto sessions = store_.get_sessions(source);
+    nlohmann::json result = nlohmann::json::array();
+    ArchiveErrors archive_errors;
+    if (use_archives(args)) {
+        auto merged = archives_->get_sessions(store_, source);
+        auto& sessions = merged.sessions;
+        if (sessions.size() > static_cast<size_t>(limit)) {
+            sessions.resize(limit);
+        }
+        for (const auto& session : sessions) {
+            result.push_back(session.to_json());
+        }
+        archive_errors = std::move(merged.errors);
+    } else {
+        auto sessions = store_.get_sessions(source);
 
-    // Apply limit
-    if (sessions.size() > static_cast<size_t>(limit)) {
-        sessions.resize(limit);
+        // Apply limit
+        if (sessions.size() > static_cast<size_t>(limit)) {
+            sessions.resize(limit);
+        }
+        for (const auto& session : sessions) {
+            result.push_back(session.to_json());
+        }
     }
 
-    nlohmann::json result = nlohmann::json::array();
-    for (const auto& session : sessions) {
-        result.push_back(session.to_json());
+    nlohmann::json response = {
+        {"count", result.size()},
+        {"sessions", result}
+    };
+    if (!archive_errors.empty()) response["archive_errors"] = archive_errors_to_json(archive_errors);
+    return response;
+}
+
+nlohmann::json McpServer::tool_get_memory_stats(const nlohmann::json&) {
+    nlohmann::json subsystems = nlohmann::json::array();
+    for (const auto& stats : AllocTracker::report()) {
+        subsystems.push_back({
+            {"subsystem", stats.subsystem},
+            {"live_bytes", stats.live_bytes},
+            {"allocated_bytes", stats.allocated_bytes},
+            {"allocations", stats.allocations},
+            {"frees", stats.frees},
+            {"allocations_per_row", stats.allocations_per_row},
+            {"bytes_per_row", stats.bytes_per_row}
+        });
     }
 
     return {
-        {"count", result.size()},
-        {"sessions", result}
+        {"tracking", AllocTracker::enabled()},
+        {"rows_ingested", AllocTracker::rows_ingested()},
+        {"subsystems", subsystems},
+        {"sqlite", store_.sqlite_memory().to_json()}
+    };
+}
+
+nlohmann::json McpServer::tool_export_logs(const nlohmann::json& args) {
+    ExportOptions options;
+    if (args.contains("sessions")) options.sessions = args["sessions"].get<std::vector<std::string>>();
+    if (args.contains("since")) options.since = args["since"].get<double>();
+    if (args.contains("until")) options.until = args["until"].get<double>();
+    if (args.contains("source")) options.source = args["source"].get<std::string>();
+    if (!args.value("compress", true)) options.compression = ContentEncoding::Identity;
+
+    std::string job_id = exports_.start(options, args.value("file", ""));
+    return *exports_.status(job_id);
+}
+
+nlohmann::json McpServer::tool_export_status(const nlohmann::json& args) {
+    std::string job_id = args.value("job_id", "");
+    if (args.value("cancel", false)) exports_.cancel(job_id);
+
+    auto status = exports_.status(job_id);
+    if (!status) throw std::runtime_error("Unknown export job: " + job_id);
+    return *status;
+}
+
+nlohmann::json McpServer::tool_multi_query(const nlohmann::json& args, const std::string& session_id) {
+    if (!args.contains("requests") || !args["requests"].is_array()) {
+        throw std::runtime_error("Requests parameter is required");
+    }
+    const auto& requests = args["requests"];
+    if (requests.size() > kMaxMultiQueryRequests) {
+        throw std::runtime_error("At most " + std::to_string(kMaxMultiQueryRequests) + " requests per multi_query");
+    }
+    for (const auto& request : requests) {
+        std::string tool = request.is_object() ? request.value("tool", "") : "";
+        if (!is_snapshot_tool(tool)) {
+            throw std::runtime_error("multi_query can't run '" + tool + "'");
+        }
+    }
+
+    // The snapshot holds the store lock, so scans share one row budget and
+    // archives (read from the pool, outside any snapshot) are left out
+    int64_t scan_left = args.value("max_scan", kMultiQueryMaxScan);
+    if (scan_left <= 0 || scan_left > kMultiQueryMaxScan) scan_left = kMultiQueryMaxScan;
+
+    nlohmann::json results = nlohmann::json::array();
+    store_.read_snapshot([&] {
+        for (const auto& request : requests) {
+            std::string tool = request["tool"].get<std::string>();
+            nlohmann::json item = {{"tool", tool}};
+            try {
+                nlohmann::json arguments = request.value("arguments", nlohmann::json::object());
+                if (!arguments.is_object()) throw std::runtime_error("arguments must be an object");
+                arguments["include_archives"] = false;
+
+                bool scans = is_scan_request(tool, arguments);
+                if (scans) {
+                    if (scan_left == 0) throw std::runtime_error("multi_query's max_scan is used up");
+                    int64_t wanted = arguments.value("max_scan", static_cast<int64_t>(100000));
+                    arguments["max_scan"] = wanted > 0 ? std::min(wanted, scan_left) : scan_left;
+                }
+                item["result"] = *call_tool(tool, arguments, session_id);
+                if (scans) scan_left = std::max<int64_t>(0, scan_left - item["result"].value("scanned", scan_left));
+            } catch (const std::exception& e) {
+                item["error"] = e.what();
+            }
+            results.push_back(std::move(item));
+        }
+    });
+
+    return {
+        {"count", results.size()},
+        {"results", results}
     };
 }
 
+void McpServer::forget_session(const std::string& session_id) {
+    std::lock_guard<std::mutex> lock(rule_sessions_mutex_);
+    for (auto it = rule_sessions_.begin(); it != rule_sessions_.end();) {
+        it->second.erase(session_id);
+        it = it->second.empty() ? rule_sessions_.erase(it) : std::next(it);
+    }
+}
+
+void McpServer::notify_rule_match(const RuleMatch& match) {
+    std::set<std::string> sessions;
+    {
+        std::lock_guard<std::mutex> lock(rule_sessions_mutex_);
+        auto it = rule_sessions_.find(match.rule_id);
+        if (it == rule_sessions_.end()) return;
+        sessions = it->second;
+    }
+
+    std::string level = match.entry.verbosity == Verbosity::Fatal ? "critical"
+                      : match.entry.verbosity == Verbosity::Error ? "error" : "warning";
+    nlohmann::json notification = {
+        {"jsonrpc", "2.0"},
+        {"method", "notifications/message"},
+        {"params", {
+            {"level", level},
+            {"logger", "rules"},
+            {"data", match.to_json()}
+        }}
+    };
+    for (const auto& session_id : sessions) {
+        http_.send_sse(session_id, "message", notification);
+    }
+}
+
 // Resource implementations
 
 nlohmann::json McpServer::resource_recent_logs() {
@@ -632,4 +1443,12 @@ nlohmann::json McpServer::resource_current_session() {
     };
 }
 
+nlohmann::json McpServer::resource_session_digest(const std::string& session_id) {
+    auto digest = store_.get_session_digest(session_id);
+    if (!digest) {
+        throw std::runtime_error("Unknown session: " + session_id);
+    }
+    return *digest;
+}
+
 } // namespace mcp_logs
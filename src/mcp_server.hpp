@@ -1,10 +1,19 @@
 #pragma once
 
+#include "anomaly_detector.hpp"
 #include "log_store.hpp"
+#include "query_scheduler.hpp"
+#include "rule_engine.hpp"
 #include "http_server.hpp"
+#include "log_archive.hpp"
+#include "log_export.hpp"
+#include "thread_pool.hpp"
 #include <nlohmann/json.hpp>
 #include <string>
 #include <map>
+#include <optional>
+#include <mutex>
+#include <set>
 #include <functional>
 
 namespace mcp_logs {
@@ -13,7 +22,8 @@ class SourceManager;
 
 class McpServer {
 public:
-    McpServer(LogStore& store, SourceManager& sources, HttpServer& http);
+    McpServer(LogStore& store, SourceManager& sources, HttpServer& http, AnomalyDetector& anomalies,
+              RuleEngine& rules, ExportJobs& exports, LogArchives* archives = nullptr);
 
     // Handle incoming MCP JSON-RPC request
     nlohmann::json handle_request(const nlohmann::json& request, const std::string& session_id);
@@ -26,28 +36,77 @@ private:
     // MCP protocol handlers
     nlohmann::json handle_initialize(const nlohmann::json& params);
     nlohmann::json handle_tools_list();
-    nlohmann::json handle_tools_call(const nlohmann::json& params);
+    // tools/call: estimate and queue the call with scheduler_; the response
+    // is sent on the session's SSE stream when it has run
+    void start_tools_call(const nlohmann::json& id, const nlohmann::json& params, const std::string& session_id);
+    nlohmann::json run_tools_call(const std::string& name, const nlohmann::json& args,
+                                  const std::string& session_id);
+    static nlohmann::json tool_content(const nlohmann::json& result, bool is_error);
     nlohmann::json handle_resources_list();
+    nlohmann::json handle_resource_templates_list();
     nlohmann::json handle_resources_read(const nlohmann::json& params);
 
+    // Run a tool by name; nullopt if there is no such tool
+    std::optional<nlohmann::json> call_tool(const std::string& name, const nlohmann::json& args,
+                                            const std::string& session_id);
+
+    // Whether a read should fan out to the archives: they're attached, the
+    // call didn't opt out, and it covers all sessions or names a session
+    // the live store doesn't have
+    bool use_archives(const nlohmann::json& args, const LogFilter* filter = nullptr) const;
+
     // Tool implementations
     nlohmann::json tool_query_logs(const nlohmann::json& args);
     nlohmann::json tool_search_logs(const nlohmann::json& args);
+    nlohmann::json tool_grep_logs(const nlohmann::json& args);
+    nlohmann::json tool_sql_query(const nlohmann::json& args);
+    nlohmann::json tool_find_similar(const nlohmann::json& args);
+    nlohmann::json tool_get_anomalies(const nlohmann::json& args);
+    nlohmann::json tool_add_rule(const nlohmann::json& args, const std::string& session_id);
+    nlohmann::json tool_remove_rule(const nlohmann::json& args);
+    nlohmann::json tool_list_rules(const nlohmann::json& args);
     nlohmann::json tool_get_stats(const nlohmann::json& args);
     nlohmann::json tool_get_categories(const nlohmann::json& args);
     nlohmann::json tool_clear_logs(const nlohmann::json& args);
     nlohmann::json tool_tail_logs(const nlohmann::json& args);
     nlohmann::json tool_get_sessions(const nlohmann::json& args);
+    nlohmann::json tool_multi_query(const nlohmann::json& args, const std::string& session_id);
+    nlohmann::json tool_get_memory_stats(const nlohmann::json& args);
+    nlohmann::json tool_export_logs(const nlohmann::json& args);
+    nlohmann::json tool_export_status(const nlohmann::json& args);
 
     // Resource implementations
     nlohmann::json resource_recent_logs();
     nlohmann::json resource_stats();
     nlohmann::json resource_errors();
     nlohmann::json resource_current_session();
+    nlohmann::json resource_session_digest(const std::string& session_id);
+
+    // Push a fired rule to the MCP sessions subscribed to it
+    void notify_rule_match(const RuleMatch& match);
+
+    // Drop a closed session from every rule's subscribers
+    void forget_session(const std::string& session_id);
 
     LogStore& store_;
     SourceManager& sources_;
     HttpServer& http_;
+    AnomalyDetector& anomalies_;
+    RuleEngine& rules_;
+    ExportJobs& exports_;
+    LogArchives* archives_;               // Null without --archive-dir
+
+    static constexpr size_t kMaxMultiQueryRequests = 20;
+
+    QueryScheduler scheduler_;
+    std::set<std::string> tool_names_;    // From handle_tools_list, for metric labels
+
+    // Rule id -> MCP sessions receiving notifications/message for it
+    std::mutex rule_sessions_mutex_;
+    std::map<std::string, std::set<std::string>> rule_sessions_;
+
+    // Runs admitted tool calls. Last, so it drains before the state they use goes away.
+    WorkStealingPool calls_;
 };
 
 } // namespace mcp_logs
@@ -0,0 +1,86 @@
+#include "message_template.hpp"
+
+namespace mcp_logs {
+
+namespace {
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+bool is_alnum(char c) {
+    return is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool is_hex(char c) {
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Hex identifier: 0x-prefixed, or 4+ hex chars containing both a digit and a letter
+bool is_hex_word(std::string_view word) {
+    if (word.size() > 2 && word[0] == '0' && (word[1] == 'x' || word[1] == 'X')) {
+        for (size_t i = 2; i < word.size(); i++) {
+            if (!is_hex(word[i])) return false;
+        }
+        return true;
+    }
+
+    if (word.size() < 4) return false;
+    bool digit = false;
+    bool letter = false;
+    for (char c : word) {
+        if (!is_hex(c)) return false;
+        if (is_digit(c)) digit = true;
+        else letter = true;
+    }
+    return digit && letter;
+}
+
+} // namespace
+
+std::string normalize_message(std::string_view message) {
+    std::string out;
+    out.reserve(message.size());
+
+    size_t i = 0;
+    while (i < message.size()) {
+        if (!is_alnum(message[i])) {
+            out.push_back(message[i++]);
+            continue;
+        }
+
+        size_t start = i;
+        while (i < message.size() && is_alnum(message[i])) i++;
+        std::string_view word = message.substr(start, i - start);
+
+        if (is_hex_word(word)) {
+            out += "<HEX>";
+            continue;
+        }
+
+        // Keep letters, collapse each digit run ("Actor42" -> "Actor<N>")
+        for (size_t k = 0; k < word.size();) {
+            if (is_digit(word[k])) {
+                while (k < word.size() && is_digit(word[k])) k++;
+                out += "<N>";
+            } else {
+                out.push_back(word[k++]);
+            }
+        }
+    }
+    return out;
+}
+
+uint64_t template_hash(std::string_view text) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+int64_t message_template_id(std::string_view message) {
+    auto id = static_cast<int64_t>(template_hash(normalize_message(message)));
+    return id != 0 ? id : 1;
+}
+
+} // namespace mcp_logs
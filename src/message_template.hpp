@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace mcp_logs {
+
+// Reduce a log message to its template by replacing the parts that vary
+// between otherwise identical messages: digit runs become <N> and hex
+// identifiers (0x..., or 4+ hex characters mixing letters and digits) become
+// <HEX>. "Player_12 hit 0x7ff3 for 3.5" -> "Player_<N> hit <HEX> for <N>.<N>"
+std::string normalize_message(std::string_view message);
+
+// Stable 64-bit FNV-1a hash, used to key templates
+uint64_t template_hash(std::string_view text);
+
+// template_hash of the normalized message, as stored in the logs table's
+// template_id column. Never 0, which marks rows written before the column.
+int64_t message_template_id(std::string_view message);
+
+} // namespace mcp_logs
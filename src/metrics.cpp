@@ -0,0 +1,101 @@
+#include "metrics.hpp"
+#include <sstream>
+
+namespace mcp_logs {
+
+std::mutex Metrics::mutex_;
+std::map<std::string, std::map<std::string, double>> Metrics::counters_;
+std::map<std::string, std::map<std::string, double>> Metrics::gauges_;
+std::map<std::string, std::map<std::string, Metrics::Histogram>> Metrics::histograms_;
+
+std::string Metrics::format_labels(const Labels& labels) {
+    if (labels.empty()) return "";
+
+    std::string out = "{";
+    for (size_t i = 0; i < labels.size(); i++) {
+        if (i) out += ',';
+        out += labels[i].first + "=\"";
+        for (char c : labels[i].second) {
+            if (c == '\\' || c == '"') out += '\\';
+            if (c == '\n') {
+                out += "\\n";
+                continue;
+            }
+            out += c;
+        }
+        out += '"';
+    }
+    return out + "}";
+}
+
+void Metrics::increment(const std::string& name, const Labels& labels, double value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    counters_[name][format_labels(labels)] += value;
+}
+
+void Metrics::set_gauge(const std::string& name, double value, const Labels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gauges_[name][format_labels(labels)] = value;
+}
+
+void Metrics::add_gauge(const std::string& name, double delta, const Labels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gauges_[name][format_labels(labels)] += delta;
+}
+
+void Metrics::observe(const std::string& name, double seconds, const Labels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Histogram& h = histograms_[name][format_labels(labels)];
+    for (size_t i = 0; i < kBuckets.size(); i++) {
+        if (seconds <= kBuckets[i]) {
+            h.counts[i]++;
+            break;
+        }
+    }
+    h.count++;
+    h.sum += seconds;
+}
+
+double Metrics::value(const std::string& name, const Labels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = format_labels(labels);
+    for (const auto* family : {&counters_, &gauges_}) {
+        auto it = family->find(name);
+        if (it == family->end()) continue;
+        auto series = it->second.find(key);
+        if (series != it->second.end()) return series->second;
+    }
+    return 0.0;
+}
+
+std::string Metrics::render() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream out;
+
+    for (const auto& [name, series] : counters_) {
+        out << "# TYPE " << name << " counter\n";
+        for (const auto& [labels, value] : series) out << name << labels << ' ' << value << '\n';
+    }
+    for (const auto& [name, series] : gauges_) {
+        out << "# TYPE " << name << " gauge\n";
+        for (const auto& [labels, value] : series) out << name << labels << ' ' << value << '\n';
+    }
+    for (const auto& [name, series] : histograms_) {
+        out << "# TYPE " << name << " histogram\n";
+        for (const auto& [labels, h] : series) {
+            // "le" goes after the series' own labels
+            std::string prefix = labels.empty() ? "{" : labels.substr(0, labels.size() - 1) + ",";
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < kBuckets.size(); i++) {
+                cumulative += h.counts[i];
+                out << name << "_bucket" << prefix << "le=\"" << kBuckets[i] << "\"} " << cumulative << '\n';
+            }
+            out << name << "_bucket" << prefix << "le=\"+Inf\"} " << h.count << '\n';
+            out << name << "_sum" << labels << ' ' << h.sum << '\n';
+            out << name << "_count" << labels << ' ' << h.count << '\n';
+        }
+    }
+    return out.str();
+}
+
+} // namespace mcp_logs
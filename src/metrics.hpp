@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mcp_logs {
+
+// Process-wide counters, gauges and histograms, served in the Prometheus
+// text format at /metrics
+class Metrics {
+public:
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+    static void increment(const std::string& name, const Labels& labels = {}, double value = 1.0);
+    static void set_gauge(const std::string& name, double value, const Labels& labels = {});
+    static void add_gauge(const std::string& name, double delta, const Labels& labels = {});
+
+    // Histogram of durations in seconds
+    static void observe(const std::string& name, double seconds, const Labels& labels = {});
+
+    // Current value of a counter or gauge (0 if never set)
+    static double value(const std::string& name, const Labels& labels = {});
+
+    static std::string render();
+
+private:
+    static constexpr std::array<double, 14> kBuckets = {
+        0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0
+    };
+
+    struct Histogram {
+        std::array<uint64_t, kBuckets.size()> counts{};   // Non-cumulative
+        uint64_t count = 0;
+        double sum = 0.0;
+    };
+
+    static std::string format_labels(const Labels& labels);
+
+    static std::mutex mutex_;
+    static std::map<std::string, std::map<std::string, double>> counters_;   // name -> labels -> value
+    static std::map<std::string, std::map<std::string, double>> gauges_;
+    static std::map<std::string, std::map<std::string, Histogram>> histograms_;
+};
+
+} // namespace mcp_logs
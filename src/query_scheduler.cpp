@@ -0,0 +1,330 @@
+#include "query_scheduler.hpp"
+#include "log_archive.hpp"
+#include "log_store.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <stdexcept>
+
+namespace mcp_logs {
+
+namespace {
+
+// FTS5 and the in-memory index touch only a fraction of the rows in scope
+constexpr int64_t kIndexedFraction = 10;
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+bool is_snapshot_tool(const std::string& tool) {
+    static const std::set<std::string> kSnapshotTools = {
+        "query_logs", "search_logs", "grep_logs",
+        "get_stats", "get_categories", "tail_logs", "get_sessions"
+    };
+    return kSnapshotTools.count(tool) > 0;
+}
+
+bool is_scan_request(const std::string& tool, const nlohmann::json& args) {
+    return tool == "grep_logs" || (tool == "search_logs" && args.is_object() && args.contains("regex"));
+}
+
+QueryScheduler::Admission::Admission(QueryScheduler* scheduler, QueryLane lane, std::string tool,
+                                     double queue_seconds)
+    : scheduler_(scheduler)
+    , lane_(lane)
+    , tool_(std::move(tool))
+    , queue_seconds_(queue_seconds)
+    , started_(std::chrono::steady_clock::now())
+{
+}
+
+QueryScheduler::Admission::Admission(Admission&& other) noexcept
+    : scheduler_(other.scheduler_)
+    , lane_(other.lane_)
+    , tool_(std::move(other.tool_))
+    , queue_seconds_(other.queue_seconds_)
+    , started_(other.started_)
+{
+    other.scheduler_ = nullptr;
+}
+
+QueryScheduler::Admission::~Admission() {
+    if (!scheduler_) return;
+    Metrics::observe("mcp_query_run_seconds", seconds_since(started_),
+                     {{"lane", lane_name(lane_)}, {"tool", tool_}});
+    scheduler_->release(lane_);
+}
+
+QueryScheduler::QueryScheduler(LogStore& store, QuerySchedulerOptions options, LogArchives* archives)
+    : store_(store)
+    , archives_(archives)
+    , options_(options)
+{
+    fast_.slots = std::max<size_t>(1, options_.fast_slots);
+    heavy_.slots = std::max<size_t>(1, options_.heavy_slots);
+}
+
+QueryCost QueryScheduler::estimate(const std::string& tool, const nlohmann::json& args) const {
+    LogFilter scope;
+    if (args.contains("session_id")) scope.session_id = args["session_id"].get<std::string>();
+    scope.all_sessions = args.value("all_sessions", false);
+
+    LogFilter everything;
+    everything.all_sessions = true;
+
+    QueryCost cost;
+    cost.tool = tool;
+    int64_t limit = args.value("limit", static_cast<int64_t>(100));
+    int64_t max_scan = args.value("max_scan", static_cast<int64_t>(100000));
+    if (max_scan <= 0) max_scan = std::numeric_limits<int64_t>::max();
+
+    // Rows in scope, plus the archives' when the call reads them too (the
+    // rule of McpServer::use_archives)
+    auto rows_in = [&](const LogFilter& filter, bool scoped) {
+        int64_t rows = store_.estimate_rows(filter);
+        if (!archives_ || !args.value("include_archives", true)) return rows;
+        if (scoped && !(filter.session_id ? rows == 0 : filter.all_sessions)) return rows;
+        return rows + archives_->estimate_rows();
+    };
+
+    if (tool == "tail_logs") {
+        cost.rows = std::min(args.value("count", static_cast<int64_t>(50)), store_.estimate_rows(scope));
+    } else if (tool == "query_logs") {
+        // Within a session the filter is a bitmap intersection; across all
+        // sessions a selective filter can walk most of the table
+        bool filtered = args.contains("category") || args.contains("verbosity") ||
+                        args.contains("source") || args.contains("instance_id") ||
+                        args.contains("since") || args.contains("until");
+        int64_t rows = rows_in(scope, true);
+        cost.rows = filtered && scope.all_sessions && !scope.session_id ? rows : std::min(limit, rows);
+    } else if (tool == "search_logs") {
+        int64_t rows = rows_in(scope, true);
+        cost.rows = args.contains("regex") ? std::min(max_scan, rows) : rows / kIndexedFraction;
+    } else if (tool == "grep_logs") {
+        cost.rows = std::min(max_scan, rows_in(scope, true));
+    } else if (tool == "find_similar") {
+        cost.rows = store_.similarity_index_loaded() ? limit : store_.estimate_rows(everything);
+    } else if (tool == "get_stats" || tool == "get_sessions") {
+        cost.rows = rows_in(everything, false);
+    } else if (tool == "get_categories") {
+        cost.rows = store_.estimate_rows(everything);
+    } else if (tool == "multi_query") {
+        // Sub-requests run back to back under one store lock, on the live
+        // store only: they cost their sum, with the scans capped by the
+        // batch's max_scan. Only tools multi_query runs count (it rejects the
+        // rest), so this never recurses into a nested multi_query.
+        auto add = [](int64_t a, int64_t b) {
+            return b > std::numeric_limits<int64_t>::max() - a ? std::numeric_limits<int64_t>::max() : a + b;
+        };
+        int64_t scan_rows = 0;
+        for (const auto& request : args.value("requests", nlohmann::json::array())) {
+            if (!request.is_object()) continue;
+            std::string sub_tool = request.value("tool", "");
+            if (!is_snapshot_tool(sub_tool)) continue;
+            nlohmann::json sub_args = request.value("arguments", nlohmann::json::object());
+            if (!sub_args.is_object()) continue;
+            sub_args["include_archives"] = false;
+            int64_t rows = estimate(sub_tool, sub_args).rows;
+            if (is_scan_request(sub_tool, sub_args)) {
+                scan_rows = add(scan_rows, rows);
+            } else {
+                cost.rows = add(cost.rows, rows);
+            }
+        }
+        int64_t batch_scan = args.value("max_scan", kMultiQueryMaxScan);
+        if (batch_scan <= 0 || batch_scan > kMultiQueryMaxScan) batch_scan = kMultiQueryMaxScan;
+        cost.rows = add(cost.rows, std::min(scan_rows, batch_scan));
+    } else if (tool == "sql_query" || tool == "clear_logs") {
+        // Arbitrary plans and deletes are always treated as heavy
+        cost.rows = std::max(options_.heavy_rows, store_.estimate_rows(everything));
+    }
+
+    cost.lane = cost.rows >= options_.heavy_rows ? QueryLane::Heavy : QueryLane::Fast;
+    return cost;
+}
+
+QueryScheduler::Admission QueryScheduler::admit(const std::string& session_id, const QueryCost& cost) {
+    auto start = std::chrono::steady_clock::now();
+    const char* name = lane_name(cost.lane);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    Lane& l = lane(cost.lane);
+
+    if (l.running < l.slots && l.turn.empty()) {
+        l.running++;
+        l.admitted++;
+        publish_gauges(cost.lane);
+        lock.unlock();
+        Metrics::observe("mcp_query_queue_seconds", 0.0, {{"lane", name}});
+        return Admission(this, cost.lane, cost.tool, 0.0);
+    }
+
+    auto waiter = std::make_shared<Waiter>();
+    waiter->tool = cost.tool;
+    waiter->queued_at = start;
+    enqueue(cost.lane, session_id, waiter);
+
+    bool admitted = admitted_cv_.wait_for(lock, options_.max_wait, [&waiter] { return waiter->admitted; });
+    if (!admitted) {
+        // Still queued: withdraw, so dispatch never hands a slot to a gone waiter
+        withdraw(l, session_id, waiter);
+        l.rejected++;
+        publish_gauges(cost.lane);
+        lock.unlock();
+        Metrics::increment("mcp_query_rejected_total", {{"lane", name}, {"reason", "timeout"}});
+        throw std::runtime_error("Timed out waiting for a " + std::string(name) + " query slot");
+    }
+    lock.unlock();
+
+    double waited = seconds_since(start);
+    Metrics::observe("mcp_query_queue_seconds", waited, {{"lane", name}});
+    return Admission(this, cost.lane, cost.tool, waited);
+}
+
+void QueryScheduler::submit(const std::string& session_id, const QueryCost& cost, Granted granted,
+                            Rejected rejected) {
+    const char* name = lane_name(cost.lane);
+    Ready ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Lane& l = lane(cost.lane);
+        expire(cost.lane, ready);
+
+        if (l.running < l.slots && l.turn.empty()) {
+            l.running++;
+            l.admitted++;
+            publish_gauges(cost.lane);
+            ready.push_back([this, cost, name, granted = std::move(granted)] {
+                Metrics::observe("mcp_query_queue_seconds", 0.0, {{"lane", name}});
+                granted(Admission(this, cost.lane, cost.tool, 0.0));
+            });
+        } else {
+            auto waiter = std::make_shared<Waiter>();
+            waiter->tool = cost.tool;
+            waiter->queued_at = std::chrono::steady_clock::now();
+            waiter->granted = std::move(granted);
+            waiter->rejected = rejected;
+            try {
+                enqueue(cost.lane, session_id, waiter);
+            } catch (const std::exception& e) {
+                ready.push_back([rejected = std::move(rejected), error = std::string(e.what())] { rejected(error); });
+            }
+        }
+    }
+    for (auto& fn : ready) fn();
+}
+
+void QueryScheduler::enqueue(QueryLane which, const std::string& session_id, const std::shared_ptr<Waiter>& waiter) {
+    const char* name = lane_name(which);
+    Lane& l = lane(which);
+    auto it = l.queues.find(session_id);
+    if (it != l.queues.end() && it->second.size() >= options_.max_queued_per_session) {
+        l.rejected++;
+        Metrics::increment("mcp_query_rejected_total", {{"lane", name}, {"reason", "session_queue_full"}});
+        throw std::runtime_error("Too many queued " + std::string(name) + " queries for this session (max " +
+                                 std::to_string(options_.max_queued_per_session) + ")");
+    }
+
+    auto& queue = l.queues[session_id];
+    if (queue.empty()) l.turn.push_back(session_id);
+    queue.push_back(waiter);
+    l.queued++;
+    publish_gauges(which);
+}
+
+void QueryScheduler::withdraw(Lane& l, const std::string& session_id, const std::shared_ptr<Waiter>& waiter) {
+    auto& q = l.queues[session_id];
+    q.erase(std::find(q.begin(), q.end(), waiter));
+    if (q.empty()) {
+        l.queues.erase(session_id);
+        l.turn.erase(std::find(l.turn.begin(), l.turn.end(), session_id));
+    }
+    l.queued--;
+}
+
+void QueryScheduler::release(QueryLane which) {
+    Ready ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Lane& l = lane(which);
+        l.running--;
+        expire(which, ready);
+        dispatch(which, ready);
+        publish_gauges(which);
+    }
+    for (auto& fn : ready) fn();
+}
+
+void QueryScheduler::expire(QueryLane which, Ready& ready) {
+    Lane& l = lane(which);
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::pair<std::string, std::shared_ptr<Waiter>>> expired;
+    for (const auto& [session, queue] : l.queues) {
+        for (const auto& waiter : queue) {
+            if (waiter->granted && now - waiter->queued_at > options_.max_wait) expired.emplace_back(session, waiter);
+        }
+    }
+    if (expired.empty()) return;
+
+    const char* name = lane_name(which);
+    for (auto& [session, waiter] : expired) {
+        withdraw(l, session, waiter);
+        l.rejected++;
+        ready.push_back([name, rejected = std::move(waiter->rejected)] {
+            Metrics::increment("mcp_query_rejected_total", {{"lane", name}, {"reason", "timeout"}});
+            rejected("Timed out waiting for a " + std::string(name) + " query slot");
+        });
+    }
+    publish_gauges(which);
+}
+
+void QueryScheduler::dispatch(QueryLane which, Ready& ready) {
+    Lane& l = lane(which);
+    bool any = false;
+    while (l.running < l.slots && !l.turn.empty()) {
+        std::string session = std::move(l.turn.front());
+        l.turn.pop_front();
+
+        auto it = l.queues.find(session);
+        std::shared_ptr<Waiter> waiter = std::move(it->second.front());
+        it->second.pop_front();
+        if (it->second.empty()) {
+            l.queues.erase(it);
+        } else {
+            l.turn.push_back(std::move(session));   // Back of the line for its next call
+        }
+
+        l.running++;
+        l.queued--;
+        l.admitted++;
+        if (waiter->granted) {
+            ready.push_back([this, which, waiter] {
+                double waited = seconds_since(waiter->queued_at);
+                Metrics::observe("mcp_query_queue_seconds", waited, {{"lane", lane_name(which)}});
+                waiter->granted(Admission(this, which, waiter->tool, waited));
+            });
+        } else {
+            waiter->admitted = true;
+            any = true;
+        }
+    }
+    if (any) admitted_cv_.notify_all();
+}
+
+void QueryScheduler::publish_gauges(QueryLane which) {
+    const Lane& l = lane(which);
+    Metrics::set_gauge("mcp_query_running", static_cast<double>(l.running), {{"lane", lane_name(which)}});
+    Metrics::set_gauge("mcp_query_queued", static_cast<double>(l.queued), {{"lane", lane_name(which)}});
+}
+
+QueryLaneStats QueryScheduler::stats(QueryLane which) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Lane& l = lane(which);
+    return {l.running, l.queued, l.admitted, l.rejected};
+}
+
+} // namespace mcp_logs
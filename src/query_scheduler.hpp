@@ -0,0 +1,157 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mcp_logs {
+
+class LogArchives;
+class LogStore;
+
+enum class QueryLane { Fast, Heavy };
+
+// Tools multi_query may batch: they only read the LogStore, so they can
+// share its snapshot. sql_query has its own connection, find_similar may
+// build its whole index, and the rest write or don't use the store.
+bool is_snapshot_tool(const std::string& tool);
+
+// Whether a snapshot sub-request scans messages (grep_logs, or search_logs
+// with a regex), drawing on multi_query's max_scan
+bool is_scan_request(const std::string& tool, const nlohmann::json& args);
+
+// Rows the scans in one multi_query may check together: the default, and
+// the most it accepts
+constexpr int64_t kMultiQueryMaxScan = 100000;
+
+struct QueryCost {
+    std::string tool;
+    int64_t rows = 0;                 // Estimated rows the call touches
+    QueryLane lane = QueryLane::Fast;
+};
+
+struct QuerySchedulerOptions {
+    size_t fast_slots = 8;            // Concurrent cheap calls
+    size_t heavy_slots = 2;           // Concurrent expensive calls
+    int64_t heavy_rows = 50000;       // Estimated rows at which a call is heavy
+    size_t max_queued_per_session = 16;
+    std::chrono::milliseconds max_wait{30000};
+};
+
+struct QueryLaneStats {
+    size_t running = 0;
+    size_t queued = 0;
+    int64_t admitted = 0;
+    int64_t rejected = 0;
+};
+
+// Admission control for MCP tool calls. Each call's cost is estimated from
+// its arguments and the row counters of LogStore (and of the archives, for
+// calls that read them), then it waits for a slot in the fast or heavy
+// lane. Cheap calls (tail, paged queries within a session) never queue behind scans, heavy calls are capped, and waiting calls are admitted
+// round-robin across MCP sessions so one agent can't monopolize a lane.
+// Queue and run times are reported through Metrics. McpServer uses submit(),
+// so a waiting call holds no thread; admit() blocks the caller instead.
+class QueryScheduler {
+public:
+    // Holds a lane slot until destroyed
+    class Admission {
+    public:
+        Admission(Admission&& other) noexcept;
+        Admission& operator=(Admission&&) = delete;
+        ~Admission();
+
+        QueryLane lane() const { return lane_; }
+        double queue_seconds() const { return queue_seconds_; }
+
+    private:
+        friend class QueryScheduler;
+        Admission(QueryScheduler* scheduler, QueryLane lane, std::string tool, double queue_seconds);
+
+        QueryScheduler* scheduler_;
+        QueryLane lane_;
+        std::string tool_;
+        double queue_seconds_;
+        std::chrono::steady_clock::time_point started_;
+    };
+
+    explicit QueryScheduler(LogStore& store, QuerySchedulerOptions options = {}, LogArchives* archives = nullptr);
+
+    QueryCost estimate(const std::string& tool, const nlohmann::json& args) const;
+
+    // Blocks until the call may run. Throws std::runtime_error when the
+    // session already has too many calls queued or the wait times out.
+    Admission admit(const std::string& session_id, const QueryCost& cost);
+
+    // Like admit() without blocking: granted runs with the slot at once if
+    // the lane has room, otherwise on the thread whose release frees it (so
+    // it should hand the call to an executor rather than run it inline).
+    // rejected runs instead when the session's queue is full or the call
+    // has waited past max_wait, which is checked as calls are submitted and
+    // slots freed.
+    using Granted = std::function<void(Admission)>;
+    using Rejected = std::function<void(const std::string& error)>;
+    void submit(const std::string& session_id, const QueryCost& cost, Granted granted, Rejected rejected);
+
+    size_t total_slots() const { return fast_.slots + heavy_.slots; }
+
+    QueryLaneStats stats(QueryLane lane) const;
+
+    static const char* lane_name(QueryLane lane) { return lane == QueryLane::Fast ? "fast" : "heavy"; }
+
+private:
+    struct Waiter {
+        std::string tool;
+        std::chrono::steady_clock::time_point queued_at;
+        Granted granted;         // Empty for admit(), which waits on admitted_cv_
+        Rejected rejected;
+        bool admitted = false;
+    };
+
+    struct Lane {
+        size_t slots = 0;
+        size_t running = 0;
+        size_t queued = 0;
+        int64_t admitted = 0;
+        int64_t rejected = 0;
+        std::map<std::string, std::deque<std::shared_ptr<Waiter>>> queues;   // Per MCP session, FIFO
+        std::deque<std::string> turn;                        // Sessions with waiters, next to serve first
+    };
+
+    // Callbacks for submit()ted calls, run once mutex_ is released
+    using Ready = std::vector<std::function<void()>>;
+
+    Lane& lane(QueryLane lane) { return lane == QueryLane::Fast ? fast_ : heavy_; }
+    const Lane& lane(QueryLane lane) const { return lane == QueryLane::Fast ? fast_ : heavy_; }
+
+    void release(QueryLane lane);
+
+    // Queue a waiter, or throw if the session's queue is full (mutex_ must be held)
+    void enqueue(QueryLane lane, const std::string& session_id, const std::shared_ptr<Waiter>& waiter);
+    void withdraw(Lane& lane, const std::string& session_id, const std::shared_ptr<Waiter>& waiter);
+
+    // Reject submit()ted calls that have waited past max_wait, then hand free
+    // slots to waiting sessions in turn (mutex_ must be held)
+    void expire(QueryLane lane, Ready& ready);
+    void dispatch(QueryLane lane, Ready& ready);
+    void publish_gauges(QueryLane lane);
+
+    LogStore& store_;
+    LogArchives* archives_;
+    QuerySchedulerOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable admitted_cv_;
+    Lane fast_;
+    Lane heavy_;
+};
+
+} // namespace mcp_logs
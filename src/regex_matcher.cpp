@@ -0,0 +1,648 @@
+#include "regex_matcher.hpp"
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+namespace mcp_logs {
+
+namespace {
+
+constexpr int kMaxRepeat = 1000;          // Largest {m,n} bound accepted
+constexpr size_t kMaxProgram = 20000;     // Instructions, after expanding counted repeats
+constexpr int kMaxNesting = 100;          // Group depth and syntax tree height, bounding recursion
+constexpr size_t kMinIndexTerm = 3;       // Shorter tokens narrow too little to be worth it
+
+bool is_alpha(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool is_digit(unsigned char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool is_word_char(unsigned char c) {
+    return is_alpha(c) || is_digit(c) || c == '_';
+}
+
+unsigned char ascii_lower(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + ('a' - 'A')) : c;
+}
+
+unsigned char ascii_upper(unsigned char c) {
+    return (c >= 'a' && c <= 'z') ? static_cast<unsigned char>(c - ('a' - 'A')) : c;
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Sparse set of program counters with O(1) clear, one per Pike VM step
+class ThreadList {
+public:
+    void reset(size_t size) {
+        sparse_.resize(size);
+        dense_.resize(size);
+        count_ = 0;
+    }
+
+    bool contains(int pc) const {
+        size_t i = sparse_[pc];
+        return i < count_ && dense_[i] == pc;
+    }
+
+    void insert(int pc) {
+        sparse_[pc] = count_;
+        dense_[count_++] = pc;
+    }
+
+    void clear() { count_ = 0; }
+    bool empty() const { return count_ == 0; }
+    size_t size() const { return count_; }
+    int operator[](size_t i) const { return dense_[i]; }
+
+private:
+    std::vector<size_t> sparse_;
+    std::vector<int> dense_;
+    size_t count_ = 0;
+};
+
+} // namespace
+
+struct RegexMatcher::Node {
+    enum Kind { Empty, Literal, Class, Concat, Alternate, Repeat, Bol, Eol, WordBoundary, NotWordBoundary };
+
+    explicit Node(Kind k) : kind(k) {}
+
+    Kind kind;
+    unsigned char ch = 0;                         // Literal
+    std::bitset<256> set;                         // Class
+    int min = 0;                                  // Repeat
+    int max = -1;                                 // Repeat, -1 = unbounded
+    int height = 1;                               // Levels in this subtree
+    std::vector<std::unique_ptr<Node>> children;
+};
+
+// Recursive descent parser producing the syntax tree
+class RegexMatcher::Parser {
+public:
+    Parser(const std::string& pattern, bool ignore_case)
+        : p_(pattern), ignore_case_(ignore_case) {}
+
+    std::unique_ptr<Node> parse() {
+        auto node = parse_alternate();
+        if (!at_end()) fail("unmatched ')'");
+        return node;
+    }
+
+private:
+    using NodePtr = std::unique_ptr<Node>;
+
+    [[noreturn]] void fail(const std::string& why) const {
+        throw std::runtime_error("Invalid regex at offset " + std::to_string(pos_) + ": " + why);
+    }
+
+    bool at_end() const { return pos_ >= p_.size(); }
+
+    // Set a composite node's height from its children. Parsing, compiling and
+    // destroying the tree all recurse per level, so it's bounded.
+    NodePtr nest(NodePtr node) const {
+        for (const auto& child : node->children) node->height = std::max(node->height, child->height + 1);
+        if (node->height > kMaxNesting) fail("nesting deeper than " + std::to_string(kMaxNesting) + " levels");
+        return node;
+    }
+    char peek() const { return p_[pos_]; }
+
+    NodePtr parse_alternate() {
+        auto first = parse_concat();
+        if (at_end() || peek() != '|') return first;
+
+        auto alt = std::make_unique<Node>(Node::Alternate);
+        alt->children.push_back(std::move(first));
+        while (!at_end() && peek() == '|') {
+            pos_++;
+            alt->children.push_back(parse_concat());
+        }
+        return nest(std::move(alt));
+    }
+
+    NodePtr parse_concat() {
+        auto concat = std::make_unique<Node>(Node::Concat);
+        while (!at_end() && peek() != '|' && peek() != ')') {
+            concat->children.push_back(parse_repeat());
+        }
+        if (concat->children.empty()) return std::make_unique<Node>(Node::Empty);
+        if (concat->children.size() == 1) return std::move(concat->children[0]);
+        return nest(std::move(concat));
+    }
+
+    NodePtr parse_repeat() {
+        auto atom = parse_atom();
+        while (!at_end()) {
+            int min = 0;
+            int max = -1;
+            char c = peek();
+            if (c == '*') {
+                pos_++;
+            } else if (c == '+') {
+                min = 1;
+                pos_++;
+            } else if (c == '?') {
+                max = 1;
+                pos_++;
+            } else if (c != '{' || !parse_counted(min, max)) {
+                break;
+            }
+            if (!at_end() && peek() == '?') pos_++;  // Lazy suffix
+
+            auto repeat = std::make_unique<Node>(Node::Repeat);
+            repeat->min = min;
+            repeat->max = max;
+            repeat->children.push_back(std::move(atom));
+            atom = nest(std::move(repeat));
+        }
+        return atom;
+    }
+
+    // {m}, {m,} or {m,n}; anything else leaves '{' to be read as a literal
+    bool parse_counted(int& min, int& max) {
+        size_t p = pos_ + 1;
+        auto read_int = [this, &p](int& out) {
+            size_t start = p;
+            out = 0;
+            while (p < p_.size() && is_digit(p_[p])) {
+                out = std::min(out * 10 + (p_[p] - '0'), kMaxRepeat + 1);
+                p++;
+            }
+            return p > start;
+        };
+
+        if (!read_int(min) || p >= p_.size()) return false;
+        if (p_[p] == '}') {
+            max = min;
+        } else if (p_[p] == ',') {
+            p++;
+            if (p < p_.size() && p_[p] == '}') {
+                max = -1;
+            } else if (!read_int(max) || p >= p_.size() || p_[p] != '}') {
+                return false;
+            }
+        } else {
+            return false;
+        }
+
+        if (min > kMaxRepeat || max > kMaxRepeat) fail("repeat count exceeds 1000");
+        if (max != -1 && max < min) fail("invalid repeat range");
+        pos_ = p + 1;
+        return true;
+    }
+
+    NodePtr parse_atom() {
+        char c = p_[pos_++];
+        switch (c) {
+        case '(': {
+            if (!at_end() && peek() == '?') {
+                if (pos_ + 1 < p_.size() && p_[pos_ + 1] == ':') {
+                    pos_ += 2;
+                } else {
+                    fail("only (?:...) groups are supported");
+                }
+            }
+            if (++depth_ > kMaxNesting) fail("groups nested deeper than " + std::to_string(kMaxNesting));
+            auto inner = parse_alternate();
+            if (at_end() || peek() != ')') fail("missing ')'");
+            pos_++;
+            depth_--;
+            return inner;
+        }
+        case '[':
+            return parse_class();
+        case '.': {
+            auto node = std::make_unique<Node>(Node::Class);
+            node->set.set();
+            node->set.reset('\n');
+            return node;
+        }
+        case '^':
+            return std::make_unique<Node>(Node::Bol);
+        case '$':
+            return std::make_unique<Node>(Node::Eol);
+        case '\\':
+            return parse_escape();
+        case '*':
+        case '+':
+        case '?':
+            pos_--;
+            fail("nothing to repeat");
+        default:
+            return literal(static_cast<unsigned char>(c));
+        }
+    }
+
+    NodePtr literal(unsigned char c) {
+        auto node = std::make_unique<Node>(Node::Literal);
+        node->ch = c;
+        return node;
+    }
+
+    NodePtr parse_escape() {
+        if (at_end()) fail("trailing backslash");
+        char c = p_[pos_++];
+        if (c == 'b') return std::make_unique<Node>(Node::WordBoundary);
+        if (c == 'B') return std::make_unique<Node>(Node::NotWordBoundary);
+
+        std::bitset<256> set;
+        if (escape_class(c, set)) {
+            auto node = std::make_unique<Node>(Node::Class);
+            node->set = set;
+            return node;
+        }
+        return literal(escape_char(c));
+    }
+
+    // \d \w \s and their negations
+    static bool escape_class(char c, std::bitset<256>& set) {
+        switch (c) {
+        case 'd': case 'D':
+            for (int v = '0'; v <= '9'; v++) set.set(v);
+            break;
+        case 'w': case 'W':
+            for (int v = 0; v < 256; v++) {
+                if (is_word_char(static_cast<unsigned char>(v))) set.set(v);
+            }
+            break;
+        case 's': case 'S':
+            for (char v : {' ', '\t', '\n', '\r', '\f', '\v'}) set.set(static_cast<unsigned char>(v));
+            break;
+        default:
+            return false;
+        }
+        if (c == 'D' || c == 'W' || c == 'S') set.flip();
+        return true;
+    }
+
+    unsigned char escape_char(char c) {
+        switch (c) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case '0': return '\0';
+        case 'x': {
+            int hi = pos_ < p_.size() ? hex_value(p_[pos_]) : -1;
+            int lo = pos_ + 1 < p_.size() ? hex_value(p_[pos_ + 1]) : -1;
+            if (hi < 0 || lo < 0) fail("\\x needs two hex digits");
+            pos_ += 2;
+            return static_cast<unsigned char>(hi * 16 + lo);
+        }
+        default:
+            break;
+        }
+        if (is_digit(c)) fail("backreferences are not supported");
+        if (is_alpha(c)) fail(std::string("unknown escape \\") + c);
+        return static_cast<unsigned char>(c);
+    }
+
+    NodePtr parse_class() {
+        bool negate = false;
+        if (!at_end() && peek() == '^') {
+            negate = true;
+            pos_++;
+        }
+
+        std::bitset<256> set;
+        bool first = true;
+        while (true) {
+            if (at_end()) fail("missing ']'");
+            char c = p_[pos_++];
+            if (c == ']' && !first) break;
+            first = false;
+
+            unsigned char lo;
+            if (c == '\\') {
+                if (at_end()) fail("trailing backslash");
+                char e = p_[pos_++];
+                std::bitset<256> escaped;
+                if (escape_class(e, escaped)) {
+                    set |= escaped;
+                    continue;
+                }
+                lo = e == 'b' ? '\b' : escape_char(e);
+            } else {
+                lo = static_cast<unsigned char>(c);
+            }
+
+            if (pos_ + 1 < p_.size() && p_[pos_] == '-' && p_[pos_ + 1] != ']') {
+                pos_++;
+                char d = p_[pos_++];
+                unsigned char hi = static_cast<unsigned char>(d);
+                if (d == '\\') {
+                    if (at_end()) fail("trailing backslash");
+                    char e = p_[pos_++];
+                    std::bitset<256> escaped;
+                    if (escape_class(e, escaped)) fail("invalid class range");
+                    hi = escape_char(e);
+                }
+                if (hi < lo) fail("invalid class range");
+                for (int v = lo; v <= hi; v++) set.set(v);
+            } else {
+                set.set(lo);
+            }
+        }
+
+        if (ignore_case_) {
+            for (int v = 'a'; v <= 'z'; v++) {
+                if (set[v] || set[ascii_upper(static_cast<unsigned char>(v))]) {
+                    set.set(v);
+                    set.set(ascii_upper(static_cast<unsigned char>(v)));
+                }
+            }
+        }
+        if (negate) set.flip();
+
+        auto node = std::make_unique<Node>(Node::Class);
+        node->set = set;
+        return node;
+    }
+
+    const std::string& p_;
+    bool ignore_case_;
+    size_t pos_ = 0;
+    int depth_ = 0;   // Groups open at pos_
+};
+
+RegexMatcher::RegexMatcher(const std::string& pattern, bool ignore_case)
+    : pattern_(pattern)
+    , ignore_case_(ignore_case)
+{
+    auto root = Parser(pattern_, ignore_case_).parse();
+
+    compile(*root);
+    emit({Inst::Match});
+
+    // A leading ^ means only position 0 can start a match
+    const Node* head = root.get();
+    while (head->kind == Node::Concat) head = head->children.front().get();
+    anchored_ = head->kind == Node::Bol;
+
+    derive_prefilters(*root);
+}
+
+int RegexMatcher::emit(Inst inst) {
+    if (program_.size() >= kMaxProgram) {
+        throw std::runtime_error("Invalid regex: pattern is too large");
+    }
+    program_.push_back(inst);
+    return static_cast<int>(program_.size() - 1);
+}
+
+void RegexMatcher::compile(const Node& node) {
+    auto next_pc = [this] { return static_cast<int>(program_.size()); };
+
+    switch (node.kind) {
+    case Node::Empty:
+        break;
+
+    case Node::Literal:
+        if (ignore_case_ && is_alpha(node.ch)) {
+            std::bitset<256> set;
+            set.set(ascii_lower(node.ch));
+            set.set(ascii_upper(node.ch));
+            classes_.push_back(set);
+            emit({Inst::Class, 0, static_cast<int>(classes_.size() - 1)});
+        } else {
+            emit({Inst::Char, node.ch});
+        }
+        break;
+
+    case Node::Class:
+        classes_.push_back(node.set);
+        emit({Inst::Class, 0, static_cast<int>(classes_.size() - 1)});
+        break;
+
+    case Node::Concat:
+        for (const auto& child : node.children) compile(*child);
+        break;
+
+    case Node::Alternate: {
+        // split L1, L2; L1: a; jmp end; L2: split ...; last: z; end:
+        std::vector<int> jumps;
+        for (size_t i = 0; i + 1 < node.children.size(); i++) {
+            int split = emit({Inst::Split});
+            program_[split].x = next_pc();
+            compile(*node.children[i]);
+            jumps.push_back(emit({Inst::Jmp}));
+            program_[split].y = next_pc();
+        }
+        compile(*node.children.back());
+        for (int jump : jumps) program_[jump].x = next_pc();
+        break;
+    }
+
+    case Node::Repeat: {
+        const Node& body = *node.children[0];
+        for (int i = 0; i < node.min; i++) compile(body);
+
+        if (node.max < 0) {
+            int split = emit({Inst::Split});
+            program_[split].x = next_pc();
+            compile(body);
+            int jump = emit({Inst::Jmp});
+            program_[jump].x = split;
+            program_[split].y = next_pc();
+        } else {
+            std::vector<int> splits;
+            for (int i = node.min; i < node.max; i++) {
+                int split = emit({Inst::Split});
+                program_[split].x = next_pc();
+                splits.push_back(split);
+                compile(body);
+            }
+            for (int split : splits) program_[split].y = next_pc();
+        }
+        break;
+    }
+
+    case Node::Bol:
+        emit({Inst::Bol});
+        break;
+    case Node::Eol:
+        emit({Inst::Eol});
+        break;
+    case Node::WordBoundary:
+        emit({Inst::WordBoundary});
+        break;
+    case Node::NotWordBoundary:
+        emit({Inst::NotWordBoundary});
+        break;
+    }
+}
+
+bool RegexMatcher::matches(std::string_view text) const {
+    thread_local ThreadList current;
+    thread_local ThreadList next;
+    thread_local std::vector<int> stack;
+
+    current.reset(program_.size());
+    next.reset(program_.size());
+
+    const size_t len = text.size();
+
+    // Follow jumps, splits and assertions from pc at position pos, queueing
+    // the consuming instructions reached. True if Match is reachable.
+    auto add_thread = [&](ThreadList& list, int start, size_t pos) {
+        stack.clear();
+        stack.push_back(start);
+        while (!stack.empty()) {
+            int pc = stack.back();
+            stack.pop_back();
+            if (list.contains(pc)) continue;
+            list.insert(pc);
+
+            const Inst& inst = program_[pc];
+            switch (inst.op) {
+            case Inst::Match:
+                return true;
+            case Inst::Jmp:
+                stack.push_back(inst.x);
+                break;
+            case Inst::Split:
+                stack.push_back(inst.y);
+                stack.push_back(inst.x);
+                break;
+            case Inst::Bol:
+                if (pos == 0) stack.push_back(pc + 1);
+                break;
+            case Inst::Eol:
+                if (pos == len) stack.push_back(pc + 1);
+                break;
+            case Inst::WordBoundary:
+            case Inst::NotWordBoundary: {
+                bool before = pos > 0 && is_word_char(static_cast<unsigned char>(text[pos - 1]));
+                bool after = pos < len && is_word_char(static_cast<unsigned char>(text[pos]));
+                if ((before != after) == (inst.op == Inst::WordBoundary)) stack.push_back(pc + 1);
+                break;
+            }
+            case Inst::Char:
+            case Inst::Class:
+                break;
+            }
+        }
+        return false;
+    };
+
+    for (size_t pos = 0;; pos++) {
+        // Unanchored search: a new thread starts at every position
+        if (!anchored_ || pos == 0) {
+            if (add_thread(current, 0, pos)) return true;
+        }
+        if (pos == len || (anchored_ && current.empty())) return false;
+
+        unsigned char c = static_cast<unsigned char>(text[pos]);
+        next.clear();
+        for (size_t t = 0; t < current.size(); t++) {
+            int pc = current[t];
+            const Inst& inst = program_[pc];
+            bool step = (inst.op == Inst::Char && inst.ch == c) ||
+                        (inst.op == Inst::Class && classes_[inst.x][c]);
+            if (step && add_thread(next, pc + 1, pos + 1)) return true;
+        }
+        std::swap(current, next);
+    }
+}
+
+// Gather runs of literal text that appear contiguously in every match. A run
+// is cut wherever the pattern allows variable text; zero-width assertions
+// keep their neighbours adjacent.
+void RegexMatcher::collect_literals(const Node& node, std::string& run,
+                                    std::vector<std::string>& runs) const {
+    auto flush = [&] {
+        if (!run.empty()) runs.push_back(std::move(run));
+        run.clear();
+    };
+
+    switch (node.kind) {
+    case Node::Literal:
+        run.push_back(static_cast<char>(ignore_case_ ? ascii_lower(node.ch) : node.ch));
+        break;
+
+    case Node::Concat:
+        for (const auto& child : node.children) collect_literals(*child, run, runs);
+        break;
+
+    case Node::Empty:
+    case Node::Bol:
+    case Node::Eol:
+    case Node::WordBoundary:
+    case Node::NotWordBoundary:
+        break;
+
+    case Node::Repeat: {
+        if (node.min == 0) {
+            flush();
+            break;
+        }
+        // The first min copies follow the preceding text and the last min
+        // copies precede the following text
+        const Node& body = *node.children[0];
+        for (int i = 0; i < node.min; i++) collect_literals(body, run, runs);
+        flush();
+        for (int i = 0; i < node.min; i++) collect_literals(body, run, runs);
+        break;
+    }
+
+    case Node::Class:
+    case Node::Alternate:
+        flush();
+        break;
+    }
+}
+
+void RegexMatcher::derive_prefilters(const Node& root) {
+    std::string run;
+    std::vector<std::string> runs;
+    collect_literals(root, run, runs);
+    if (!run.empty()) runs.push_back(std::move(run));
+
+    for (const auto& r : runs) {
+        if (r.size() > required_literal_.size()) required_literal_ = r;
+    }
+
+    // A token inside a literal is a whole FTS5 token only when its start is
+    // known: text before it in the same run is a separator. If the run ends
+    // right after it, more token characters may follow, so match as a prefix.
+    for (const auto& r : runs) {
+        if (std::any_of(r.begin(), r.end(), [](char c) { return static_cast<unsigned char>(c) >= 0x80; })) {
+            continue;  // Tokenizer rules for non-ASCII differ
+        }
+
+        size_t i = 0;
+        while (i < r.size()) {
+            unsigned char c = static_cast<unsigned char>(r[i]);
+            if (!is_alpha(c) && !is_digit(c)) {
+                i++;
+                continue;
+            }
+            size_t start = i;
+            while (i < r.size() && (is_alpha(static_cast<unsigned char>(r[i])) ||
+                                    is_digit(static_cast<unsigned char>(r[i])))) {
+                i++;
+            }
+            if (start == 0 || i - start < kMinIndexTerm) continue;
+
+            std::string token;
+            for (size_t k = start; k < i; k++) {
+                token.push_back(static_cast<char>(ascii_lower(static_cast<unsigned char>(r[k]))));
+            }
+            if (i == r.size()) token.push_back('*');
+            if (std::find(index_terms_.begin(), index_terms_.end(), token) == index_terms_.end()) {
+                index_terms_.push_back(std::move(token));
+            }
+        }
+    }
+}
+
+} // namespace mcp_logs
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <bitset>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mcp_logs {
+
+// Linear-time regular expression matcher for server-side log filtering.
+//
+// Patterns compile to a Thompson NFA that is simulated with a Pike VM, so
+// matching is O(pattern * text) with no backtracking blowups. Supported
+// syntax: literals, '.', [classes] with ranges and negation, \d \w \s (and
+// their negations), \b \B, ^ $, groups (...) and (?:...), alternation, and
+// the quantifiers * + ? {m} {m,} {m,n}. Lazy quantifier suffixes are
+// accepted; they don't change whether a line matches. Backreferences and
+// lookaround are rejected.
+//
+// Compiling also extracts literal text every match must contain, which
+// callers use to narrow candidates before running the NFA. Throws
+// std::runtime_error on invalid patterns, and on nesting (groups or stacked
+// quantifiers) more than 100 levels deep. Immutable after construction, so
+// one instance can be shared across scanning threads.
+class RegexMatcher {
+public:
+    RegexMatcher(const std::string& pattern, bool ignore_case = false);
+
+    RegexMatcher(const RegexMatcher&) = delete;
+    RegexMatcher& operator=(const RegexMatcher&) = delete;
+
+    // True if the pattern matches anywhere in text
+    bool matches(std::string_view text) const;
+
+    // Longest literal every match contains (lowercased when ignoring case),
+    // empty if none could be derived
+    const std::string& required_literal() const { return required_literal_; }
+
+    // FTS5 terms ("token" or "token*") implied by the required literals; every
+    // matching message also matches all of them
+    const std::vector<std::string>& index_terms() const { return index_terms_; }
+
+    const std::string& pattern() const { return pattern_; }
+
+    // Compiled instructions; the NFA's work per byte is bounded by this
+    size_t program_size() const { return program_.size(); }
+
+private:
+    struct Node;
+    class Parser;
+
+    struct Inst {
+        enum Op { Char, Class, Split, Jmp, Match, Bol, Eol, WordBoundary, NotWordBoundary };
+        Op op;
+        unsigned char ch = 0;
+        int x = 0;      // Jump/split target, or index into classes_
+        int y = 0;      // Second split target
+    };
+
+    void compile(const Node& node);
+    int emit(Inst inst);
+    void collect_literals(const Node& node, std::string& run, std::vector<std::string>& runs) const;
+    void derive_prefilters(const Node& root);
+
+    std::string pattern_;
+    bool ignore_case_;
+    std::vector<Inst> program_;
+    std::vector<std::bitset<256>> classes_;
+    bool anchored_ = false;   // Pattern starts with ^, only try position 0
+
+    std::string required_literal_;
+    std::vector<std::string> index_terms_;
+};
+
+} // namespace mcp_logs
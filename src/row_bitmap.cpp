@@ -0,0 +1,247 @@
+#include "row_bitmap.hpp"
+#include <algorithm>
+#include <iterator>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace mcp_logs {
+
+namespace {
+
+inline uint32_t popcount64(uint64_t x) {
+#if defined(_MSC_VER)
+    return static_cast<uint32_t>(__popcnt64(x));
+#else
+    return static_cast<uint32_t>(__builtin_popcountll(x));
+#endif
+}
+
+inline uint32_t count_trailing_zeros(uint64_t x) {
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward64(&idx, x);
+    return idx;
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(x));
+#endif
+}
+
+} // namespace
+
+// Container operations
+
+void RowBitmap::Container::add(uint16_t low) {
+    if (is_bitmap()) {
+        uint64_t& word = words[low >> 6];
+        uint64_t bit = uint64_t(1) << (low & 63);
+        if (!(word & bit)) {
+            word |= bit;
+            cardinality++;
+        }
+        return;
+    }
+
+    if (!array.empty() && array.back() >= low) {
+        return;  // Already present (appends are ordered)
+    }
+    array.push_back(low);
+    cardinality++;
+    if (array.size() > kArrayMax) {
+        to_bitmap();
+    }
+}
+
+void RowBitmap::Container::to_bitmap() {
+    words.assign(kBitmapWords, 0);
+    for (uint16_t v : array) {
+        words[v >> 6] |= uint64_t(1) << (v & 63);
+    }
+    array.clear();
+    array.shrink_to_fit();
+}
+
+void RowBitmap::Container::to_array() {
+    array.clear();
+    array.reserve(cardinality);
+    for (size_t w = 0; w < kBitmapWords; w++) {
+        uint64_t word = words[w];
+        while (word) {
+            array.push_back(static_cast<uint16_t>(w * 64 + count_trailing_zeros(word)));
+            word &= word - 1;
+        }
+    }
+    words.clear();
+    words.shrink_to_fit();
+}
+
+RowBitmap::Container RowBitmap::intersect(const Container& a, const Container& b) {
+    Container out;
+    out.key = a.key;
+
+    if (a.is_bitmap() && b.is_bitmap()) {
+        // Straight word-wise AND; kept branch-free so the compiler vectorizes it
+        out.words.resize(kBitmapWords);
+        const uint64_t* aw = a.words.data();
+        const uint64_t* bw = b.words.data();
+        uint64_t* ow = out.words.data();
+        for (size_t i = 0; i < kBitmapWords; i++) {
+            ow[i] = aw[i] & bw[i];
+        }
+        uint32_t card = 0;
+        for (size_t i = 0; i < kBitmapWords; i++) {
+            card += popcount64(ow[i]);
+        }
+        out.cardinality = card;
+        if (card <= kArrayMax) {
+            out.to_array();
+        }
+    } else if (a.is_bitmap() || b.is_bitmap()) {
+        const Container& bits = a.is_bitmap() ? a : b;
+        const Container& arr = a.is_bitmap() ? b : a;
+        out.array.reserve(arr.array.size());
+        for (uint16_t v : arr.array) {
+            if (bits.words[v >> 6] & (uint64_t(1) << (v & 63))) {
+                out.array.push_back(v);
+            }
+        }
+        out.cardinality = static_cast<uint32_t>(out.array.size());
+    } else {
+        std::set_intersection(a.array.begin(), a.array.end(),
+                              b.array.begin(), b.array.end(),
+                              std::back_inserter(out.array));
+        out.cardinality = static_cast<uint32_t>(out.array.size());
+    }
+
+    return out;
+}
+
+RowBitmap::Container RowBitmap::unite(const Container& a, const Container& b) {
+    Container out;
+    out.key = a.key;
+
+    if (a.is_bitmap() || b.is_bitmap() || a.array.size() + b.array.size() > kArrayMax) {
+        out.words.assign(kBitmapWords, 0);
+        for (const Container* c : {&a, &b}) {
+            if (c->is_bitmap()) {
+                for (size_t i = 0; i < kBitmapWords; i++) {
+                    out.words[i] |= c->words[i];
+                }
+            } else {
+                for (uint16_t v : c->array) {
+                    out.words[v >> 6] |= uint64_t(1) << (v & 63);
+                }
+            }
+        }
+        uint32_t card = 0;
+        for (size_t i = 0; i < kBitmapWords; i++) {
+            card += popcount64(out.words[i]);
+        }
+        out.cardinality = card;
+        if (card <= kArrayMax) {
+            out.to_array();
+        }
+    } else {
+        std::set_union(a.array.begin(), a.array.end(),
+                       b.array.begin(), b.array.end(),
+                       std::back_inserter(out.array));
+        out.cardinality = static_cast<uint32_t>(out.array.size());
+    }
+
+    return out;
+}
+
+// RowBitmap
+
+void RowBitmap::add(uint32_t value) {
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    if (containers_.empty() || containers_.back().key != key) {
+        Container c;
+        c.key = key;
+        containers_.push_back(std::move(c));
+    }
+
+    Container& c = containers_.back();
+    uint32_t before = c.cardinality;
+    c.add(static_cast<uint16_t>(value & 0xFFFF));
+    cardinality_ += c.cardinality - before;
+}
+
+void RowBitmap::clear() {
+    containers_.clear();
+    cardinality_ = 0;
+}
+
+RowBitmap RowBitmap::intersect(const RowBitmap& a, const RowBitmap& b) {
+    RowBitmap out;
+    size_t i = 0, j = 0;
+    while (i < a.containers_.size() && j < b.containers_.size()) {
+        const Container& ca = a.containers_[i];
+        const Container& cb = b.containers_[j];
+        if (ca.key < cb.key) {
+            i++;
+        } else if (cb.key < ca.key) {
+            j++;
+        } else {
+            Container c = intersect(ca, cb);
+            if (c.cardinality > 0) {
+                out.cardinality_ += c.cardinality;
+                out.containers_.push_back(std::move(c));
+            }
+            i++;
+            j++;
+        }
+    }
+    return out;
+}
+
+RowBitmap RowBitmap::unite(const RowBitmap& a, const RowBitmap& b) {
+    RowBitmap out;
+    size_t i = 0, j = 0;
+    while (i < a.containers_.size() || j < b.containers_.size()) {
+        if (j >= b.containers_.size() ||
+            (i < a.containers_.size() && a.containers_[i].key < b.containers_[j].key)) {
+            out.containers_.push_back(a.containers_[i++]);
+        } else if (i >= a.containers_.size() || b.containers_[j].key < a.containers_[i].key) {
+            out.containers_.push_back(b.containers_[j++]);
+        } else {
+            out.containers_.push_back(unite(a.containers_[i++], b.containers_[j++]));
+        }
+        out.cardinality_ += out.containers_.back().cardinality;
+    }
+    return out;
+}
+
+std::vector<uint32_t> RowBitmap::to_vector() const {
+    std::vector<uint32_t> result;
+    result.reserve(cardinality_);
+    for (const auto& c : containers_) {
+        uint32_t high = static_cast<uint32_t>(c.key) << 16;
+        if (c.is_bitmap()) {
+            for (size_t w = 0; w < kBitmapWords; w++) {
+                uint64_t word = c.words[w];
+                while (word) {
+                    result.push_back(high | static_cast<uint32_t>(w * 64 + count_trailing_zeros(word)));
+                    word &= word - 1;
+                }
+            }
+        } else {
+            for (uint16_t v : c.array) {
+                result.push_back(high | v);
+            }
+        }
+    }
+    return result;
+}
+
+size_t RowBitmap::memory_usage() const {
+    size_t bytes = containers_.capacity() * sizeof(Container);
+    for (const auto& c : containers_) {
+        bytes += c.array.capacity() * sizeof(uint16_t);
+        bytes += c.words.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+} // namespace mcp_logs
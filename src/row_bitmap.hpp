@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace mcp_logs {
+
+// Compressed bitmap of row ordinals, laid out like a roaring bitmap:
+// ordinals are split into 64K chunks keyed by their high 16 bits, and each
+// chunk is stored either as a sorted array (sparse) or as a 1024-word bitmap
+// (dense). Ordinals must be added in increasing order, which matches how rows
+// are appended to a session.
+class RowBitmap {
+public:
+    // Append an ordinal (must be greater than every ordinal already present)
+    void add(uint32_t value);
+
+    bool empty() const { return cardinality_ == 0; }
+    uint64_t cardinality() const { return cardinality_; }
+    void clear();
+
+    // Set operations producing a new bitmap
+    static RowBitmap intersect(const RowBitmap& a, const RowBitmap& b);
+    static RowBitmap unite(const RowBitmap& a, const RowBitmap& b);
+
+    // Ordinals in increasing order
+    std::vector<uint32_t> to_vector() const;
+
+    // Approximate heap usage in bytes
+    size_t memory_usage() const;
+
+private:
+    static constexpr size_t kArrayMax = 4096;       // Array container limit
+    static constexpr size_t kBitmapWords = 1024;    // 65536 bits
+
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;   // Used while sparse
+        std::vector<uint64_t> words;   // Used once dense
+
+        bool is_bitmap() const { return !words.empty(); }
+        void add(uint16_t low);
+        void to_bitmap();
+        void to_array();
+    };
+
+    static Container intersect(const Container& a, const Container& b);
+    static Container unite(const Container& a, const Container& b);
+
+    std::vector<Container> containers_;   // Sorted by key
+    uint64_t cardinality_ = 0;
+};
+
+} // namespace mcp_logs
@@ -0,0 +1,248 @@
+#include "rule_engine.hpp"
+#include "log_store.hpp"
+#include "server_log.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace mcp_logs {
+
+namespace {
+
+std::optional<Verbosity> parse_verbosity(const std::string& name) {
+    for (int v = static_cast<int>(Verbosity::Fatal); v <= static_cast<int>(Verbosity::VeryVerbose); v++) {
+        if (verbosity_to_string(static_cast<Verbosity>(v)) == name) return static_cast<Verbosity>(v);
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+nlohmann::json TriggerRule::to_json() const {
+    nlohmann::json j = {
+        {"id", id},
+        {"name", name},
+        {"threshold", threshold},
+        {"window_seconds", window_seconds},
+        {"cooldown_seconds", cooldown_seconds}
+    };
+    if (source) j["source"] = *source;
+    if (category) j["category"] = *category;
+    if (instance_id) j["instance_id"] = *instance_id;
+    if (max_verbosity) j["verbosity"] = verbosity_to_string(*max_verbosity);
+    if (!contains.empty()) j["contains"] = contains;
+    if (!regex.empty()) j["regex"] = regex;
+    if (ignore_case) j["ignore_case"] = true;
+    return j;
+}
+
+TriggerRule TriggerRule::from_json(const nlohmann::json& j) {
+    TriggerRule rule;
+    rule.name = j.value("name", "");
+    if (j.contains("source")) rule.source = j["source"].get<std::string>();
+    if (j.contains("category")) rule.category = j["category"].get<std::string>();
+    if (j.contains("instance_id")) rule.instance_id = j["instance_id"].get<std::string>();
+    if (j.contains("verbosity")) {
+        std::string name = j["verbosity"].get<std::string>();
+        rule.max_verbosity = parse_verbosity(name);
+        if (!rule.max_verbosity) {
+            throw std::runtime_error("Unknown verbosity: " + name);
+        }
+    }
+    rule.contains = j.value("contains", "");
+    rule.regex = j.value("regex", "");
+    rule.ignore_case = j.value("ignore_case", false);
+    rule.threshold = j.value("threshold", static_cast<int64_t>(1));
+    rule.window_seconds = j.value("window_seconds", 0.0);
+    rule.cooldown_seconds = j.value("cooldown_seconds", 0.0);
+
+    if (rule.threshold < 1 || rule.threshold > RuleEngine::kMaxThreshold) {
+        throw std::runtime_error("threshold must be between 1 and " + std::to_string(RuleEngine::kMaxThreshold));
+    }
+    if (rule.window_seconds < 0 || rule.cooldown_seconds < 0) {
+        throw std::runtime_error("window_seconds and cooldown_seconds must not be negative");
+    }
+    if (!rule.source && !rule.category && !rule.instance_id && !rule.max_verbosity &&
+        rule.contains.empty() && rule.regex.empty()) {
+        throw std::runtime_error("Rule needs at least one condition");
+    }
+    return rule;
+}
+
+nlohmann::json RuleMatch::to_json() const {
+    return {
+        {"id", id},
+        {"rule_id", rule_id},
+        {"rule_name", rule_name},
+        {"fired_at", fired_at},
+        {"window_count", window_count},
+        {"log", entry.to_json()}
+    };
+}
+
+struct RuleEngine::CompiledRule {
+    TriggerRule rule;
+    std::optional<SubstringMatcher> contains;
+    std::optional<SubstringMatcher> regex_literal;   // Required literal of the regex, checked before the NFA
+    std::unique_ptr<RegexMatcher> regex;
+
+    // Times of the last `threshold` matches, as a ring
+    std::vector<double> times;
+    size_t head = 0;
+    size_t size = 0;
+
+    int64_t matched = 0;
+    int64_t fired = 0;
+    std::optional<double> last_fired;
+
+    explicit CompiledRule(TriggerRule r)
+        : rule(std::move(r))
+        , times(static_cast<size_t>(rule.threshold), 0.0)
+    {
+        if (!rule.regex.empty()) {
+            regex = std::make_unique<RegexMatcher>(rule.regex, rule.ignore_case);
+        }
+        if (!rule.contains.empty()) {
+            contains.emplace(rule.contains, rule.ignore_case);
+        }
+        if (regex && !regex->required_literal().empty()) {
+            regex_literal.emplace(regex->required_literal(), rule.ignore_case);
+        }
+        // Without a prefilter the NFA would run over every inserted message
+        if (regex && !regex_literal && !contains && !rule.category && !rule.instance_id) {
+            throw std::runtime_error("regex has no literal text to prefilter on; add a longer literal, "
+                                     "or narrow the rule with contains, category or instance_id");
+        }
+    }
+
+    size_t program_size() const { return regex ? regex->program_size() : 0; }
+
+    bool matches(const LogEntry& entry) const {
+        if (rule.max_verbosity &&
+            (entry.verbosity > *rule.max_verbosity || entry.verbosity == Verbosity::NoLogging)) {
+            return false;
+        }
+        if (rule.category && entry.category != *rule.category) return false;
+        if (rule.instance_id && entry.instance_id != *rule.instance_id) return false;
+        if (rule.source && entry.source != *rule.source) return false;
+        if (contains && !contains->matches(entry.message)) return false;
+        if (regex_literal && !regex_literal->matches(entry.message)) return false;
+        return !regex || regex->matches(entry.message);
+    }
+
+    // Record a match at `now`; true when the window is complete and the
+    // rule is out of its cooldown
+    bool record(double now) {
+        times[head] = now;
+        head = (head + 1) % times.size();
+        size = std::min(size + 1, times.size());
+        if (size < times.size()) return false;
+
+        double oldest = times[head];   // Next slot to overwrite holds the oldest time
+        if (rule.window_seconds > 0 && now - oldest > rule.window_seconds) return false;
+        if (last_fired && now - *last_fired < rule.cooldown_seconds) return false;
+
+        size = 0;   // Start a fresh window
+        return true;
+    }
+};
+
+RuleEngine::RuleEngine(LogStore& store) {
+    store.subscribe([this](const LogEntry& entry) {
+        evaluate(entry);
+    });
+}
+
+RuleEngine::~RuleEngine() = default;
+
+TriggerRule RuleEngine::add_rule(TriggerRule rule) {
+    auto compiled = std::make_unique<CompiledRule>(std::move(rule));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (rules_.size() >= kMaxRules) {
+        throw std::runtime_error("Too many rules (max " + std::to_string(kMaxRules) + ")");
+    }
+    if (regex_program_ + compiled->program_size() > kMaxRegexProgram) {
+        throw std::runtime_error("Rule regexes are too large in total (max " +
+                                 std::to_string(kMaxRegexProgram) + " instructions); remove a rule first");
+    }
+    regex_program_ += compiled->program_size();
+    compiled->rule.id = "rule_" + std::to_string(next_rule_id_++);
+    if (compiled->rule.name.empty()) compiled->rule.name = compiled->rule.id;
+
+    TriggerRule installed = compiled->rule;
+    rules_.push_back(std::move(compiled));
+    return installed;
+}
+
+bool RuleEngine::remove_rule(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(rules_.begin(), rules_.end(),
+        [&id](const auto& r) { return r->rule.id == id; });
+    if (it == rules_.end()) return false;
+    regex_program_ -= (*it)->program_size();
+    rules_.erase(it);
+    return true;
+}
+
+std::vector<RuleStatus> RuleEngine::rules() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<RuleStatus> result;
+    for (const auto& r : rules_) {
+        result.push_back({r->rule, r->matched, r->fired, r->last_fired});
+    }
+    return result;
+}
+
+std::vector<RuleMatch> RuleEngine::matches(int64_t since_id, size_t limit) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<RuleMatch> result;
+    for (auto it = matches_.rbegin(); it != matches_.rend() && result.size() < limit; ++it) {
+        if (it->id <= since_id) break;
+        result.push_back(*it);
+    }
+    return result;
+}
+
+void RuleEngine::on_match(MatchCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callbacks_.push_back(std::move(callback));
+}
+
+void RuleEngine::evaluate(const LogEntry& entry) {
+    std::vector<RuleMatch> fired;
+    std::vector<MatchCallback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& r : rules_) {
+            if (!r->matches(entry)) continue;
+            r->matched++;
+            if (!r->record(entry.received_at)) continue;
+
+            r->fired++;
+            r->last_fired = entry.received_at;
+
+            RuleMatch match;
+            match.id = next_match_id_++;
+            match.rule_id = r->rule.id;
+            match.rule_name = r->rule.name;
+            match.fired_at = entry.received_at;
+            match.window_count = r->rule.threshold;
+            match.entry = entry;
+
+            matches_.push_back(match);
+            if (matches_.size() > kMaxMatches) matches_.pop_front();
+            fired.push_back(std::move(match));
+        }
+        if (fired.empty()) return;
+        callbacks = callbacks_;
+    }
+
+    for (const auto& match : fired) {
+        ServerLog::log("Rule", match.rule_name + " fired: [" + match.entry.category + "] " + match.entry.message);
+        for (const auto& callback : callbacks) {
+            callback(match);
+        }
+    }
+}
+
+} // namespace mcp_logs
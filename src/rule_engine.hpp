@@ -0,0 +1,108 @@
+#pragma once
+
+#include "log_entry.hpp"
+#include "regex_matcher.hpp"
+#include "substring_search.hpp"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace mcp_logs {
+
+class LogStore;
+
+// Trigger rule evaluated against every inserted log. All conditions that
+// are set must hold for a log to match; the rule fires once `threshold`
+// matches land within `window_seconds`.
+struct TriggerRule {
+    std::string id;                           // Assigned by RuleEngine::add_rule
+    std::string name;
+    std::optional<std::string> source;
+    std::optional<std::string> category;
+    std::optional<std::string> instance_id;
+    std::optional<Verbosity> max_verbosity;   // "Error" matches Error and Fatal
+    std::string contains;                     // Substring of the message
+    std::string regex;                        // Regex over the message
+    bool ignore_case = false;
+    int64_t threshold = 1;                    // Matches needed within the window
+    double window_seconds = 0.0;              // 0: no time limit between matches
+    double cooldown_seconds = 0.0;            // Minimum time between firings
+
+    nlohmann::json to_json() const;
+
+    // Throws std::runtime_error on invalid fields
+    static TriggerRule from_json(const nlohmann::json& j);
+};
+
+struct RuleMatch {
+    int64_t id = 0;                           // Increasing, for polling with since_id
+    std::string rule_id;
+    std::string rule_name;
+    double fired_at = 0.0;                    // received_at of the triggering log
+    int64_t window_count = 0;                 // Matches that made up the window
+    LogEntry entry;                           // The log that completed the window
+
+    nlohmann::json to_json() const;
+};
+
+struct RuleStatus {
+    TriggerRule rule;
+    int64_t matched = 0;                      // Logs that satisfied the conditions
+    int64_t fired = 0;
+    std::optional<double> last_fired;
+};
+
+// Evaluates trigger rules on the insert path (via LogStore::subscribe).
+// Each rule is compiled once: cheap field comparisons first, then a SIMD
+// substring check for `contains` or the regex's required literal, and the
+// NFA only for logs that pass both. Window counting keeps the last
+// `threshold` match times per rule, so evaluation is O(1) per log per rule.
+// Regex rules are bounded because they run under the store's write lock:
+// each needs a required literal or a category/instance/contains condition
+// to skip most logs cheaply, and their programs share kMaxRegexProgram.
+class RuleEngine {
+public:
+    using MatchCallback = std::function<void(const RuleMatch&)>;
+
+    static constexpr size_t kMaxRules = 256;
+    static constexpr int64_t kMaxThreshold = 10000;
+    static constexpr size_t kMaxMatches = 500;    // Recent matches kept for polling
+    static constexpr size_t kMaxRegexProgram = 50000;   // NFA instructions across all rules
+
+    explicit RuleEngine(LogStore& store);
+    ~RuleEngine();
+
+    // Compiles and installs the rule; returns it with its assigned id.
+    // Throws std::runtime_error for invalid rules or bad regexes.
+    TriggerRule add_rule(TriggerRule rule);
+    bool remove_rule(const std::string& id);
+    std::vector<RuleStatus> rules() const;
+
+    // Newest first
+    std::vector<RuleMatch> matches(int64_t since_id, size_t limit) const;
+
+    // Callbacks run on the inserting thread, so they must not block or call
+    // back into LogStore
+    void on_match(MatchCallback callback);
+
+    void evaluate(const LogEntry& entry);
+
+private:
+    struct CompiledRule;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<CompiledRule>> rules_;
+    std::deque<RuleMatch> matches_;
+    std::vector<MatchCallback> callbacks_;
+    size_t regex_program_ = 0;    // Sum of the installed rules' program sizes
+    int64_t next_rule_id_ = 1;
+    int64_t next_match_id_ = 1;
+};
+
+} // namespace mcp_logs
@@ -4,22 +4,22 @@
 namespace mcp_logs {
 
 ServerLog::Sink ServerLog::sink_ = ServerLog::legacy_sink;
-std::mutex ServerLog::mutex_;
+ProfiledMutex ServerLog::mutex_{"ServerLog"};
 
 void ServerLog::set_sink(Sink sink) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = mutex_.acquire("set_sink");
     sink_ = sink ? std::move(sink) : legacy_sink;
 }
 
 void ServerLog::log(const std::string& component, const std::string& message) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = mutex_.acquire("log");
     if (sink_) {
         sink_(component, message, false);
     }
 }
 
 void ServerLog::error(const std::string& component, const std::string& message) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = mutex_.acquire("error");
     if (sink_) {
         sink_(component, message, true);
     }
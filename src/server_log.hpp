@@ -1,8 +1,8 @@
 #pragma once
 
+#include "lock_profiler.hpp"
 #include <string>
 #include <functional>
-#include <mutex>
 
 namespace mcp_logs {
 
@@ -23,7 +23,7 @@ public:
 
 private:
     static Sink sink_;
-    static std::mutex mutex_;
+    static ProfiledMutex mutex_;
 };
 
 } // namespace mcp_logs
@@ -0,0 +1,168 @@
+#include "session_digest.hpp"
+#include "message_template.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace mcp_logs {
+
+SessionDigestBuilder::SessionDigestBuilder(std::string session_id)
+    : session_id_(std::move(session_id))
+    , timeline_(kTimelineBuckets, 0)
+{
+}
+
+void SessionDigestBuilder::add(const LogEntry& entry) {
+    if (count_ == 0) {
+        first_timestamp_ = entry.timestamp;
+        last_timestamp_ = entry.timestamp;
+    }
+    count_++;
+    first_timestamp_ = std::min(first_timestamp_, entry.timestamp);
+    last_timestamp_ = std::max(last_timestamp_, entry.timestamp);
+    last_received_ = std::max(last_received_, entry.received_at);
+
+    by_source_[entry.source]++;
+    by_category_[entry.category]++;
+    by_verbosity_[std::clamp(static_cast<int>(entry.verbosity), 0, 7)]++;
+
+    InstanceStats& inst = instances_[entry.instance_id];
+    if (inst.count == 0) {
+        inst.first = entry.timestamp;
+        inst.last = entry.timestamp;
+    } else if (entry.timestamp > inst.last) {
+        double gap = entry.timestamp - inst.last;
+        if (gap > inst.largest_gap) {
+            inst.largest_gap = gap;
+            inst.largest_gap_at = inst.last;
+        }
+        inst.last = entry.timestamp;
+    }
+    inst.first = std::min(inst.first, entry.timestamp);
+    inst.count++;
+
+    if (entry.verbosity <= Verbosity::Error && entry.verbosity != Verbosity::NoLogging) {
+        error_count_++;
+        ErrorRef ref{entry.id, entry.timestamp, entry.category, entry.instance_id, entry.message};
+        if (!first_error_) first_error_ = ref;
+        last_error_ = std::move(ref);
+    } else if (entry.verbosity == Verbosity::Warning) {
+        warning_count_++;
+    }
+
+    std::string text = normalize_message(entry.message);
+    uint64_t hash = template_hash(text);
+    auto it = templates_.find(hash);
+    if (it != templates_.end()) {
+        it->second.count++;
+        it->second.example_id = entry.id;
+    } else if (templates_.size() < kMaxTemplates) {
+        templates_.emplace(hash, TemplateStats{std::move(text), 1, entry.id});
+    } else {
+        other_templates_++;
+    }
+
+    add_to_timeline(entry.timestamp);
+}
+
+void SessionDigestBuilder::add_to_timeline(double timestamp) {
+    if (count_ == 1) {
+        timeline_start_ = std::floor(timestamp);
+    }
+
+    double offset = timestamp - timeline_start_;
+    if (!std::isfinite(offset)) return;
+    if (offset < 0) offset = 0;  // Out-of-order earlier logs land in the first bucket
+
+    while (offset >= bucket_seconds_ * kTimelineBuckets) {
+        for (size_t i = 0; i < kTimelineBuckets / 2; i++) {
+            timeline_[i] = timeline_[2 * i] + timeline_[2 * i + 1];
+        }
+        std::fill(timeline_.begin() + kTimelineBuckets / 2, timeline_.end(), 0);
+        bucket_seconds_ *= 2;
+    }
+
+    timeline_[static_cast<size_t>(offset / bucket_seconds_)]++;
+}
+
+nlohmann::json SessionDigestBuilder::to_json(bool final) const {
+    static const char* kVerbosityNames[] = {
+        "NoLogging", "Fatal", "Error", "Warning", "Display", "Log", "Verbose", "VeryVerbose"
+    };
+
+    nlohmann::json by_verbosity = nlohmann::json::object();
+    for (int v = 0; v < 8; v++) {
+        if (by_verbosity_[v]) by_verbosity[kVerbosityNames[v]] = by_verbosity_[v];
+    }
+
+    std::vector<const TemplateStats*> top;
+    for (const auto& [hash, stats] : templates_) top.push_back(&stats);
+    size_t keep = std::min(top.size(), kTopTemplates);
+    std::partial_sort(top.begin(), top.begin() + keep, top.end(),
+        [](const TemplateStats* a, const TemplateStats* b) {
+            return a->count != b->count ? a->count > b->count : a->text < b->text;
+        });
+
+    nlohmann::json templates = nlohmann::json::array();
+    for (size_t i = 0; i < keep; i++) {
+        templates.push_back({
+            {"template", top[i]->text},
+            {"count", top[i]->count},
+            {"example_id", top[i]->example_id}
+        });
+    }
+
+    nlohmann::json instances = nlohmann::json::array();
+    for (const auto& [id, inst] : instances_) {
+        instances.push_back({
+            {"instance_id", id},
+            {"count", inst.count},
+            {"first_timestamp", inst.first},
+            {"last_timestamp", inst.last},
+            {"largest_gap", inst.largest_gap},
+            {"largest_gap_at", inst.largest_gap_at}
+        });
+    }
+
+    // Trim empty buckets after the last log
+    size_t used = kTimelineBuckets;
+    while (used > 1 && timeline_[used - 1] == 0) used--;
+
+    nlohmann::json digest = {
+        {"session_id", session_id_},
+        {"final", final},
+        {"log_count", count_},
+        {"first_timestamp", first_timestamp_},
+        {"last_timestamp", last_timestamp_},
+        {"duration", last_timestamp_ - first_timestamp_},
+        {"by_source", by_source_},
+        {"by_category", by_category_},
+        {"by_verbosity", by_verbosity},
+        {"error_count", error_count_},
+        {"warning_count", warning_count_},
+        {"first_error", nullptr},
+        {"last_error", nullptr},
+        {"top_templates", templates},
+        {"distinct_templates", templates_.size()},
+        {"untracked_template_logs", other_templates_},
+        {"timeline", {
+            {"start", timeline_start_},
+            {"bucket_seconds", bucket_seconds_},
+            {"counts", std::vector<int64_t>(timeline_.begin(), timeline_.begin() + used)}
+        }},
+        {"instances", instances}
+    };
+    auto error_json = [](const ErrorRef& e) {
+        return nlohmann::json{
+            {"id", e.id},
+            {"timestamp", e.timestamp},
+            {"category", e.category},
+            {"instance_id", e.instance_id},
+            {"message", e.message}
+        };
+    };
+    if (first_error_) digest["first_error"] = error_json(*first_error_);
+    if (last_error_) digest["last_error"] = error_json(*last_error_);
+    return digest;
+}
+
+} // namespace mcp_logs
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "log_entry.hpp"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace mcp_logs {
+
+// Incrementally maintained summary of one session: counts by source,
+// category, instance and verbosity, first/last error, the most frequent
+// message templates, a timeline histogram and the largest silence per
+// instance. Everything an agent usually recomputes from raw rows with
+// several tool calls, kept up to date in O(1) per log.
+class SessionDigestBuilder {
+public:
+    static constexpr size_t kTimelineBuckets = 60;
+    static constexpr size_t kMaxTemplates = 5000;   // Distinct templates tracked; the rest count as "other"
+    static constexpr size_t kTopTemplates = 10;
+
+    explicit SessionDigestBuilder(std::string session_id);
+
+    void add(const LogEntry& entry);
+
+    // Digest as served by logs://session/{id}/digest
+    nlohmann::json to_json(bool final) const;
+
+    const std::string& session_id() const { return session_id_; }
+    int64_t count() const { return count_; }
+    double last_received() const { return last_received_; }
+
+private:
+    struct ErrorRef {
+        int64_t id = 0;
+        double timestamp = 0.0;
+        std::string category;
+        std::string instance_id;
+        std::string message;
+    };
+
+    struct TemplateStats {
+        std::string text;
+        int64_t count = 0;
+        int64_t example_id = 0;
+    };
+
+    struct InstanceStats {
+        int64_t count = 0;
+        double first = 0.0;
+        double last = 0.0;
+        double largest_gap = 0.0;
+        double largest_gap_at = 0.0;   // Timestamp where the silence began
+    };
+
+    void add_to_timeline(double timestamp);
+
+    std::string session_id_;
+    int64_t count_ = 0;
+    double first_timestamp_ = 0.0;
+    double last_timestamp_ = 0.0;
+    double last_received_ = 0.0;
+
+    std::map<std::string, int64_t> by_source_;
+    std::map<std::string, int64_t> by_category_;
+    int64_t by_verbosity_[8] = {};
+    std::map<std::string, InstanceStats> instances_;
+
+    int64_t error_count_ = 0;
+    int64_t warning_count_ = 0;
+    std::optional<ErrorRef> first_error_;
+    std::optional<ErrorRef> last_error_;
+
+    std::unordered_map<uint64_t, TemplateStats> templates_;
+    int64_t other_templates_ = 0;
+
+    // Fixed number of buckets; the width doubles (merging neighbours) when a
+    // timestamp lands past the end
+    double timeline_start_ = 0.0;
+    double bucket_seconds_ = 1.0;
+    std::vector<int64_t> timeline_;
+};
+
+} // namespace mcp_logs
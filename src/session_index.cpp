@@ -0,0 +1,364 @@
+#include "session_index.hpp"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <numeric>
+
+namespace mcp_logs {
+
+namespace {
+
+size_t verbosity_slot(Verbosity v) {
+    int slot = static_cast<int>(v);
+    return static_cast<size_t>(std::clamp(slot, 0, 7));
+}
+
+bool is_token_char(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Split text into lowercase ASCII alphanumeric tokens, the way FTS5's default
+// unicode61 tokenizer does for ASCII input
+template<typename F>
+void for_each_token(const std::string& text, F&& fn) {
+    std::string token;
+    for (unsigned char c : text) {
+        if (is_token_char(c)) {
+            token.push_back(static_cast<char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c));
+        } else if (!token.empty()) {
+            fn(token);
+            token.clear();
+        }
+    }
+    if (!token.empty()) fn(token);
+}
+
+bool has_non_ascii(const std::string& text) {
+    for (unsigned char c : text) {
+        if (c >= 0x80) return true;
+    }
+    return false;
+}
+
+// One search term: a single token, optionally matched as a prefix
+struct SearchTerm {
+    std::string token;
+    bool prefix = false;
+};
+
+// Parse the subset of FTS5 query syntax the in-memory index can answer
+// exactly. Anything else (phrases, OR/NOT, columns, multi-token barewords)
+// returns false so the caller falls back to FTS5.
+bool parse_simple_query(const std::string& query, std::vector<SearchTerm>& terms) {
+    std::string word;
+    std::vector<std::string> words;
+    for (char c : query) {
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            if (!word.empty()) words.push_back(std::move(word));
+            word.clear();
+        } else {
+            word.push_back(c);
+        }
+    }
+    if (!word.empty()) words.push_back(std::move(word));
+
+    for (auto& w : words) {
+        if (w == "AND") continue;  // Implicit anyway
+        if (w == "OR" || w == "NOT" || w == "NEAR") return false;
+
+        SearchTerm term;
+        if (w.back() == '*') {
+            term.prefix = true;
+            w.pop_back();
+        }
+        if (w.empty()) return false;
+
+        for (unsigned char c : w) {
+            if (!is_token_char(c)) return false;  // '_', quotes, operators, non-ASCII
+        }
+        for (char& c : w) {
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c + ('a' - 'A'));
+        }
+        term.token = std::move(w);
+        terms.push_back(std::move(term));
+    }
+
+    return !terms.empty();
+}
+
+} // namespace
+
+// PostingList
+
+void PostingList::add(uint32_t ordinal) {
+    if (count_ > 0 && ordinal <= last_) return;  // Token repeated within a row
+
+    uint32_t delta = count_ == 0 ? ordinal : ordinal - last_;
+    while (delta >= 0x80) {
+        bytes_.push_back(static_cast<uint8_t>(delta | 0x80));
+        delta >>= 7;
+    }
+    bytes_.push_back(static_cast<uint8_t>(delta));
+
+    last_ = ordinal;
+    count_++;
+}
+
+std::vector<uint32_t> PostingList::decode() const {
+    std::vector<uint32_t> ordinals;
+    ordinals.reserve(count_);
+
+    uint32_t value = 0;
+    uint32_t delta = 0;
+    int shift = 0;
+    for (uint8_t byte : bytes_) {
+        delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte & 0x80) {
+            shift += 7;
+            continue;
+        }
+        value += delta;
+        ordinals.push_back(value);
+        delta = 0;
+        shift = 0;
+    }
+    return ordinals;
+}
+
+SessionIndex::SessionIndex(size_t max_sessions)
+    : max_sessions_(std::max<size_t>(1, max_sessions))
+{
+}
+
+void SessionIndex::set_max_sessions(size_t max_sessions) {
+    max_sessions_ = std::max<size_t>(1, max_sessions);
+    while (sessions_.size() > max_sessions_) {
+        auto oldest = std::min_element(sessions_.begin(), sessions_.end(),
+            [](const auto& a, const auto& b) { return a.second.last_write < b.second.last_write; });
+        sessions_.erase(oldest);
+    }
+}
+
+bool SessionIndex::covers(const std::string& session_id) const {
+    return sessions_.count(session_id) > 0;
+}
+
+void SessionIndex::begin_session(const std::string& session_id) {
+    if (covers(session_id)) return;
+
+    // Evict the least recently written session to bound memory
+    while (sessions_.size() >= max_sessions_) {
+        auto oldest = std::min_element(sessions_.begin(), sessions_.end(),
+            [](const auto& a, const auto& b) { return a.second.last_write < b.second.last_write; });
+        sessions_.erase(oldest);
+    }
+
+    sessions_[session_id].last_write = ++write_clock_;
+}
+
+void SessionIndex::add(const LogEntry& entry) {
+    auto it = sessions_.find(entry.session_id);
+    if (it == sessions_.end()) return;
+
+    Session& s = it->second;
+    if (!s.ids.empty() && entry.id <= s.ids.back()) return;  // Already indexed
+
+    uint32_t ordinal = static_cast<uint32_t>(s.ids.size());
+    if (!s.timestamps.empty() && entry.timestamp < s.timestamps.back()) {
+        s.ordered = false;
+    }
+
+    s.ids.push_back(entry.id);
+    s.timestamps.push_back(entry.timestamp);
+    s.by_source[entry.source].add(ordinal);
+    s.by_category[entry.category].add(ordinal);
+    s.by_instance[entry.instance_id].add(ordinal);
+    s.by_verbosity[verbosity_slot(entry.verbosity)].add(ordinal);
+
+    if (has_non_ascii(entry.message)) {
+        s.ascii_only = false;
+    }
+    for_each_token(entry.message, [&s, ordinal](const std::string& token) {
+        s.postings[token].add(ordinal);
+    });
+
+    s.last_write = ++write_clock_;
+}
+
+std::vector<int64_t> SessionIndex::select(const std::string& session_id, const LogFilter& filter) const {
+    auto it = sessions_.find(session_id);
+    if (it == sessions_.end()) return {};
+
+    return page(it->second, matching_ordinals(it->second, filter), filter);
+}
+
+bool SessionIndex::search(const std::string& session_id, const std::string& query,
+                          const LogFilter& filter, std::vector<int64_t>& ids) const {
+    auto it = sessions_.find(session_id);
+    if (it == sessions_.end()) return false;
+
+    const Session& s = it->second;
+    if (!s.ascii_only) return false;
+
+    std::vector<SearchTerm> terms;
+    if (!parse_simple_query(query, terms)) return false;
+
+    // Resolve each term to its ordinals; prefixes union every matching token
+    std::vector<std::vector<uint32_t>> lists;
+    for (const auto& term : terms) {
+        std::vector<uint32_t> ordinals;
+        if (term.prefix) {
+            for (auto p = s.postings.lower_bound(term.token);
+                 p != s.postings.end() && p->first.compare(0, term.token.size(), term.token) == 0; ++p) {
+                auto decoded = p->second.decode();
+                ordinals.insert(ordinals.end(), decoded.begin(), decoded.end());
+            }
+            std::sort(ordinals.begin(), ordinals.end());
+            ordinals.erase(std::unique(ordinals.begin(), ordinals.end()), ordinals.end());
+        } else {
+            auto p = s.postings.find(term.token);
+            if (p != s.postings.end()) ordinals = p->second.decode();
+        }
+
+        if (ordinals.empty()) {
+            ids.clear();
+            return true;
+        }
+        lists.push_back(std::move(ordinals));
+    }
+
+    // Intersect shortest lists first, then apply the field filters
+    std::sort(lists.begin(), lists.end(),
+        [](const auto& a, const auto& b) { return a.size() < b.size(); });
+
+    std::vector<uint32_t> matches = std::move(lists[0]);
+    if (filter.source || filter.category || filter.instance_id || filter.min_verbosity ||
+        filter.since || filter.until) {
+        lists.push_back(matching_ordinals(s, filter));
+    }
+    for (size_t i = 1; i < lists.size() && !matches.empty(); i++) {
+        std::vector<uint32_t> next;
+        std::set_intersection(matches.begin(), matches.end(),
+                              lists[i].begin(), lists[i].end(),
+                              std::back_inserter(next));
+        matches = std::move(next);
+    }
+
+    ids = page(s, std::move(matches), filter);
+    return true;
+}
+
+std::vector<uint32_t> SessionIndex::matching_ordinals(const Session& s, const LogFilter& filter) {
+    // Equality predicates map to one bitmap each; a missing value matches nothing
+    std::vector<const RowBitmap*> bitmaps;
+    auto lookup = [&bitmaps](const std::unordered_map<std::string, RowBitmap>& map,
+                             const std::optional<std::string>& value) {
+        if (!value) return true;
+        auto it = map.find(*value);
+        if (it == map.end()) return false;
+        bitmaps.push_back(&it->second);
+        return true;
+    };
+
+    if (!lookup(s.by_source, filter.source)) return {};
+    if (!lookup(s.by_category, filter.category)) return {};
+    if (!lookup(s.by_instance, filter.instance_id)) return {};
+
+    // Lower verbosity number = more severe, so "at least" is a union of levels
+    RowBitmap severity;
+    if (filter.min_verbosity) {
+        size_t max_slot = verbosity_slot(*filter.min_verbosity);
+        for (size_t slot = 0; slot <= max_slot; slot++) {
+            if (!s.by_verbosity[slot].empty()) {
+                severity = RowBitmap::unite(severity, s.by_verbosity[slot]);
+            }
+        }
+        if (severity.empty()) return {};
+        bitmaps.push_back(&severity);
+    }
+
+    std::vector<uint32_t> ordinals;
+    if (bitmaps.empty()) {
+        ordinals.resize(s.ids.size());
+        std::iota(ordinals.begin(), ordinals.end(), 0u);
+    } else {
+        // Intersect smallest first so intermediate results stay small
+        std::sort(bitmaps.begin(), bitmaps.end(),
+            [](const RowBitmap* a, const RowBitmap* b) { return a->cardinality() < b->cardinality(); });
+
+        RowBitmap acc = *bitmaps[0];
+        for (size_t i = 1; i < bitmaps.size() && !acc.empty(); i++) {
+            acc = RowBitmap::intersect(acc, *bitmaps[i]);
+        }
+        ordinals = acc.to_vector();
+    }
+
+    if (filter.since || filter.until) {
+        double since = filter.since.value_or(-std::numeric_limits<double>::infinity());
+        double until = filter.until.value_or(std::numeric_limits<double>::infinity());
+        ordinals.erase(std::remove_if(ordinals.begin(), ordinals.end(),
+            [&s, since, until](uint32_t o) {
+                return !(s.timestamps[o] >= since && s.timestamps[o] <= until);
+            }), ordinals.end());
+    }
+
+    return ordinals;
+}
+
+std::vector<int64_t> SessionIndex::page(const Session& s, std::vector<uint32_t> ordinals,
+                                        const LogFilter& filter) {
+    size_t offset = static_cast<size_t>(std::max(0, filter.offset));
+    size_t limit = filter.limit < 0 ? std::numeric_limits<size_t>::max()
+                                    : static_cast<size_t>(filter.limit);
+    if (offset >= ordinals.size() || limit == 0) return {};
+
+    size_t end = ordinals.size() - offset > limit ? offset + limit : ordinals.size();
+
+    std::vector<int64_t> ids;
+    ids.reserve(end - offset);
+
+    if (s.ordered) {
+        // Ordinal order is already time order, newest rows are at the back
+        for (size_t i = offset; i < end; i++) {
+            ids.push_back(s.ids[ordinals[ordinals.size() - 1 - i]]);
+        }
+        return ids;
+    }
+
+    auto newer = [&s](uint32_t a, uint32_t b) {
+        if (s.timestamps[a] != s.timestamps[b]) return s.timestamps[a] > s.timestamps[b];
+        return a > b;
+    };
+    std::partial_sort(ordinals.begin(), ordinals.begin() + end, ordinals.end(), newer);
+
+    for (size_t i = offset; i < end; i++) {
+        ids.push_back(s.ids[ordinals[i]]);
+    }
+    return ids;
+}
+
+void SessionIndex::clear() {
+    sessions_.clear();
+}
+
+size_t SessionIndex::memory_usage() const {
+    size_t bytes = 0;
+    for (const auto& [id, s] : sessions_) {
+        bytes += s.ids.capacity() * sizeof(int64_t);
+        bytes += s.timestamps.capacity() * sizeof(double);
+        for (const auto* map : {&s.by_source, &s.by_category, &s.by_instance}) {
+            for (const auto& [value, bitmap] : *map) {
+                bytes += value.capacity() + bitmap.memory_usage();
+            }
+        }
+        for (const auto& bitmap : s.by_verbosity) {
+            bytes += bitmap.memory_usage();
+        }
+        for (const auto& [token, list] : s.postings) {
+            bytes += token.capacity() + list.memory_usage();
+        }
+    }
+    return bytes;
+}
+
+} // namespace mcp_logs
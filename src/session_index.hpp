@@ -0,0 +1,100 @@
+#pragma once
+
+#include "log_entry.hpp"
+#include "row_bitmap.hpp"
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mcp_logs {
+
+// Append-only list of row ordinals, stored as varint-encoded deltas
+class PostingList {
+public:
+    void add(uint32_t ordinal);
+
+    uint32_t size() const { return count_; }
+    uint32_t last() const { return last_; }
+    std::vector<uint32_t> decode() const;
+    size_t memory_usage() const { return bytes_.capacity(); }
+
+private:
+    std::vector<uint8_t> bytes_;
+    uint32_t last_ = 0;
+    uint32_t count_ = 0;
+};
+
+// In-memory secondary indexes for the most recently written sessions.
+//
+// Each indexed session assigns its rows consecutive ordinals and keeps one
+// RowBitmap per distinct source, category, instance and verbosity value, so a
+// LogFilter combination becomes a bitmap intersection instead of a SQLite
+// index scan. Message tokens feed an inverted index so simple full-text
+// queries skip FTS5 as well. Only the requested page of row IDs is handed back
+// to LogStore.
+//
+// Not thread-safe: LogStore only touches it with its own mutex held.
+class SessionIndex {
+public:
+    static constexpr size_t kDefaultMaxSessions = 4;
+
+    explicit SessionIndex(size_t max_sessions = kDefaultMaxSessions);
+
+    // Evicts the least recently written sessions beyond the new limit
+    void set_max_sessions(size_t max_sessions);
+    size_t max_sessions() const { return max_sessions_; }
+
+    bool covers(const std::string& session_id) const;
+
+    // Start indexing a session, evicting the least recently written one if full
+    void begin_session(const std::string& session_id);
+
+    // Append a persisted row (entry.id must be set) to its session
+    void add(const LogEntry& entry);
+
+    // Row IDs in the session matching the filter, ordered newest first
+    // (timestamp DESC) with the filter's limit/offset applied
+    std::vector<int64_t> select(const std::string& session_id, const LogFilter& filter) const;
+
+    // Full-text search within the session, same ordering and paging as select().
+    // Handles space-separated terms with optional trailing '*' prefixes over
+    // ASCII text; returns false when FTS5 is needed to answer exactly.
+    bool search(const std::string& session_id, const std::string& query,
+                const LogFilter& filter, std::vector<int64_t>& ids) const;
+
+    // Forget all sessions (e.g. after rows were deleted)
+    void clear();
+
+    size_t session_count() const { return sessions_.size(); }
+    size_t memory_usage() const;
+
+private:
+    struct Session {
+        std::vector<int64_t> ids;          // Ordinal -> row ID
+        std::vector<double> timestamps;    // Ordinal -> timestamp
+        std::unordered_map<std::string, RowBitmap> by_source;
+        std::unordered_map<std::string, RowBitmap> by_category;
+        std::unordered_map<std::string, RowBitmap> by_instance;
+        std::array<RowBitmap, 8> by_verbosity;
+        std::map<std::string, PostingList> postings;   // Token -> ordinals
+        bool ascii_only = true;            // Tokenization matches FTS5 exactly
+        bool ordered = true;               // Timestamps non-decreasing by ordinal
+        uint64_t last_write = 0;
+    };
+
+    // Ordinals matching the filter's field predicates, in increasing order
+    static std::vector<uint32_t> matching_ordinals(const Session& session, const LogFilter& filter);
+
+    // Order ordinals newest first and cut out the requested page
+    static std::vector<int64_t> page(const Session& session, std::vector<uint32_t> ordinals,
+                                     const LogFilter& filter);
+
+    std::unordered_map<std::string, Session> sessions_;
+    size_t max_sessions_;
+    uint64_t write_clock_ = 0;
+};
+
+} // namespace mcp_logs
@@ -0,0 +1,166 @@
+#include "similarity_index.hpp"
+#include "message_template.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace mcp_logs {
+
+namespace {
+
+constexpr size_t kRowsPerBand = SimilarityIndex::kHashes / SimilarityIndex::kBands;
+
+uint64_t mix64(uint64_t x) {
+    // splitmix64 finalizer
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// Placeholders like <N> stay whole words
+bool is_word_char(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           c == '_' || c == '<' || c == '>' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+// Split a template into words on whitespace and punctuation and hash each
+// word and adjacent pair
+std::vector<uint64_t> shingles(std::string_view text) {
+    std::vector<uint64_t> words;
+    size_t i = 0;
+    while (i < text.size()) {
+        if (!is_word_char(text[i])) {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < text.size() && is_word_char(text[i])) i++;
+        words.push_back(template_hash(text.substr(start, i - start)));
+    }
+
+    std::vector<uint64_t> features = words;
+    for (size_t w = 1; w < words.size(); w++) {
+        features.push_back(mix64(words[w - 1] * 31 + words[w]));
+    }
+    if (features.empty()) features.push_back(template_hash(text));
+    return features;
+}
+
+} // namespace
+
+SimilarityIndex::SimilarityIndex(size_t max_templates)
+    : max_templates_(max_templates)
+{
+}
+
+SimilarityIndex::Signature SimilarityIndex::signature(std::string_view normalized) {
+    Signature sig;
+    sig.fill(std::numeric_limits<uint32_t>::max());
+
+    for (uint64_t feature : shingles(normalized)) {
+        for (size_t h = 0; h < kHashes; h++) {
+            uint32_t value = static_cast<uint32_t>(mix64(feature ^ (0x632be59bd9b4e019ull * (h + 1))));
+            sig[h] = std::min(sig[h], value);
+        }
+    }
+    return sig;
+}
+
+double SimilarityIndex::similarity(const Signature& a, const Signature& b) {
+    size_t equal = 0;
+    for (size_t h = 0; h < kHashes; h++) {
+        if (a[h] == b[h]) equal++;
+    }
+    return static_cast<double>(equal) / kHashes;
+}
+
+uint64_t SimilarityIndex::band_key(const Signature& sig, size_t band) {
+    uint64_t key = band;
+    for (size_t r = 0; r < kRowsPerBand; r++) {
+        key = mix64(key ^ sig[band * kRowsPerBand + r]);
+    }
+    return key;
+}
+
+void SimilarityIndex::add(const LogEntry& entry) {
+    std::string normalized = normalize_message(entry.message);
+    uint64_t hash = template_hash(normalized);
+
+    auto it = templates_.find(hash);
+    if (it == templates_.end()) {
+        if (templates_.size() >= max_templates_) {
+            dropped_++;
+            return;
+        }
+
+        Template t;
+        t.sig = signature(normalized);
+        t.text = std::move(normalized);
+        for (size_t band = 0; band < kBands; band++) {
+            buckets_[band][band_key(t.sig, band)].push_back(hash);
+        }
+        it = templates_.emplace(hash, std::move(t)).first;
+    }
+
+    Template& t = it->second;
+    t.count++;
+    t.sessions[entry.session_id]++;
+    if (entry.id >= t.last_id) {
+        t.last_id = entry.id;
+        t.last_message = entry.message;
+        t.last_session = entry.session_id;
+        t.last_timestamp = entry.timestamp;
+    }
+}
+
+std::vector<SimilarCluster> SimilarityIndex::find(std::string_view message, double min_similarity,
+                                                  size_t max_results) const {
+    std::string normalized = normalize_message(message);
+    Signature sig = signature(normalized);
+
+    // Candidates are templates sharing at least one band with the query
+    std::vector<uint64_t> candidates;
+    for (size_t band = 0; band < kBands; band++) {
+        auto bucket = buckets_[band].find(band_key(sig, band));
+        if (bucket != buckets_[band].end()) {
+            candidates.insert(candidates.end(), bucket->second.begin(), bucket->second.end());
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<SimilarCluster> clusters;
+    for (uint64_t hash : candidates) {
+        const Template& t = templates_.at(hash);
+        double score = t.text == normalized ? 1.0 : similarity(sig, t.sig);
+        if (score < min_similarity) continue;
+
+        SimilarCluster cluster;
+        cluster.template_text = t.text;
+        cluster.similarity = score;
+        cluster.count = t.count;
+        cluster.sessions.assign(t.sessions.begin(), t.sessions.end());
+        std::sort(cluster.sessions.begin(), cluster.sessions.end(),
+            [](const auto& a, const auto& b) { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+        cluster.example_id = t.last_id;
+        cluster.example_message = t.last_message;
+        cluster.example_session = t.last_session;
+        cluster.example_timestamp = t.last_timestamp;
+        clusters.push_back(std::move(cluster));
+    }
+
+    std::sort(clusters.begin(), clusters.end(), [](const SimilarCluster& a, const SimilarCluster& b) {
+        if (a.similarity != b.similarity) return a.similarity > b.similarity;
+        return a.count > b.count;
+    });
+    if (clusters.size() > max_results) clusters.resize(max_results);
+    return clusters;
+}
+
+void SimilarityIndex::clear() {
+    templates_.clear();
+    for (auto& band : buckets_) band.clear();
+    dropped_ = 0;
+}
+
+} // namespace mcp_logs
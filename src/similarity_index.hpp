@@ -0,0 +1,75 @@
+#pragma once
+
+#include "log_entry.hpp"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mcp_logs {
+
+// A group of near-duplicate messages sharing one normalized template
+struct SimilarCluster {
+    std::string template_text;
+    double similarity = 0.0;                         // Estimated Jaccard similarity to the query
+    int64_t count = 0;                               // Messages with this template
+    std::vector<std::pair<std::string, int64_t>> sessions;   // Per-session counts, largest first
+    int64_t example_id = 0;                          // Most recent message with this template
+    std::string example_message;
+    std::string example_session;
+    double example_timestamp = 0.0;
+};
+
+// Near-duplicate lookup over message templates using MinHash and LSH.
+//
+// Each message is normalized (see normalize_message) and messages sharing a
+// template are counted together, so signatures are only computed once per
+// distinct template. A template's signature is the MinHash of its word
+// unigrams and bigrams; LSH splits it into bands whose hashes key buckets, so
+// a lookup only compares templates colliding with the query in some band.
+// Not thread-safe; LogStore serializes access under its mutex.
+class SimilarityIndex {
+public:
+    static constexpr size_t kHashes = 32;
+    static constexpr size_t kBands = 8;             // kHashes / kBands rows per band
+    using Signature = std::array<uint32_t, kHashes>;
+
+    explicit SimilarityIndex(size_t max_templates = 200000);
+
+    void add(const LogEntry& entry);
+
+    // Clusters whose estimated similarity to message is at least
+    // min_similarity, most similar first
+    std::vector<SimilarCluster> find(std::string_view message, double min_similarity,
+                                     size_t max_results) const;
+
+    static Signature signature(std::string_view normalized);
+    static double similarity(const Signature& a, const Signature& b);
+
+    size_t template_count() const { return templates_.size(); }
+    int64_t dropped() const { return dropped_; }   // Messages not indexed because the template cap was hit
+    void clear();
+
+private:
+    struct Template {
+        std::string text;
+        Signature sig{};
+        int64_t count = 0;
+        std::unordered_map<std::string, int64_t> sessions;
+        int64_t last_id = 0;
+        std::string last_message;
+        std::string last_session;
+        double last_timestamp = 0.0;
+    };
+
+    static uint64_t band_key(const Signature& sig, size_t band);
+
+    size_t max_templates_;
+    std::unordered_map<uint64_t, Template> templates_;     // Keyed by template_hash
+    std::array<std::unordered_map<uint64_t, std::vector<uint64_t>>, kBands> buckets_;
+    int64_t dropped_ = 0;
+};
+
+} // namespace mcp_logs
@@ -12,7 +12,12 @@ SourceManager::~SourceManager() {
 }
 
 std::string SourceManager::add_file_tailer(const std::string& path, const std::string& name) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = mutex_.acquire("add_file_tailer");
+
+    if (store_.is_follower()) {
+        ServerLog::error("Sources", "Not tailing " + path + ": a read-only follower can't ingest");
+        return "";
+    }
 
     std::string id = "file-" + std::to_string(next_id_++);
 
@@ -29,7 +34,7 @@ std::string SourceManager::add_file_tailer(const std::string& path, const std::s
 }
 
 bool SourceManager::remove_source(const std::string& id) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = mutex_.acquire("remove_source");
 
     auto it = tailers_.find(id);
     if (it == tailers_.end()) {
@@ -42,7 +47,7 @@ bool SourceManager::remove_source(const std::string& id) {
 }
 
 std::vector<SourceInfo> SourceManager::list_sources() const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = mutex_.acquire("list_sources");
 
     std::vector<SourceInfo> result;
     for (const auto& [id, tailer] : tailers_) {
@@ -58,7 +63,7 @@ std::vector<SourceInfo> SourceManager::list_sources() const {
 }
 
 void SourceManager::stop_all() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto lock = mutex_.acquire("stop_all");
 
     for (auto& [id, tailer] : tailers_) {
         tailer->stop();
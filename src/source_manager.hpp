@@ -2,10 +2,10 @@
 
 #include "log_store.hpp"
 #include "file_tailer.hpp"
+#include "lock_profiler.hpp"
 #include <string>
 #include <map>
 #include <memory>
-#include <mutex>
 #include <vector>
 
 namespace mcp_logs {
@@ -44,7 +44,7 @@ public:
 private:
     LogStore& store_;
     std::map<std::string, std::unique_ptr<FileTailer>> tailers_;
-    mutable std::mutex mutex_;
+    mutable ProfiledMutex mutex_{"SourceManager"};
     int next_id_{1};
 };
 
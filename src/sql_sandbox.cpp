@@ -0,0 +1,237 @@
+#include "sql_sandbox.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace mcp_logs {
+
+namespace {
+
+// Statements between progress checks; small enough to notice a deadline quickly
+constexpr int kProgressOps = 1000;
+
+// Longest string or blob a statement may build, as a multiple of max_bytes.
+// The progress handler can't interrupt a single huge allocation.
+constexpr int64_t kLengthPerResultByte = 4;
+constexpr int64_t kMinLengthLimit = 1 << 20;
+
+// FTS5 keeps its index in shadow tables that MATCH queries read internally
+constexpr const char* kShadowSuffixes[] = {"_data", "_idx", "_config", "_docsize", "_content"};
+
+// SQL functions agent queries may call: core scalars and aggregates, date,
+// math and JSON helpers, window functions, and the FTS5 MATCH, bm25,
+// highlight and snippet helpers. Everything else is denied, including
+// load_extension, FTS5's introspection functions (fts5, fts5_decode, ...)
+// and randomblob/zeroblob, which only exist to build large values.
+constexpr const char* kAllowedFunctions[] = {
+    // Scalars
+    "abs", "char", "coalesce", "concat", "concat_ws", "format", "glob", "hex", "ifnull", "iif", "instr",
+    "length", "like", "likelihood", "likely", "lower", "ltrim", "max", "min", "nullif", "octet_length",
+    "printf", "quote", "replace", "round", "rtrim", "sign", "soundex", "substr", "substring", "trim",
+    "typeof", "unhex", "unicode", "unlikely", "upper", "random",
+    // Aggregates
+    "avg", "count", "group_concat", "string_agg", "sum", "total", "median", "percentile",
+    "percentile_cont", "percentile_disc",
+    // Dates
+    "date", "time", "datetime", "julianday", "unixepoch", "strftime", "timediff",
+    // Math
+    "acos", "acosh", "asin", "asinh", "atan", "atan2", "atanh", "ceil", "ceiling", "cos", "cosh",
+    "degrees", "exp", "floor", "ln", "log", "log10", "log2", "mod", "pi", "pow", "power", "radians",
+    "sin", "sinh", "sqrt", "tan", "tanh", "trunc",
+    // Window functions
+    "row_number", "rank", "dense_rank", "percent_rank", "cume_dist", "ntile", "lag", "lead",
+    "first_value", "last_value", "nth_value",
+    // JSON
+    "json", "json_array", "json_array_length", "json_extract", "json_insert", "json_object",
+    "json_patch", "json_quote", "json_remove", "json_replace", "json_set", "json_type", "json_valid",
+    "json_group_array", "json_group_object", "json_each", "json_tree",
+    // FTS5 (MATCH is parsed into a call to match())
+    "match", "bm25", "highlight", "snippet",
+};
+
+bool function_allowed(const char* name) {
+    if (!name) return false;
+    for (const char* allowed : kAllowedFunctions) {
+        if (sqlite3_stricmp(name, allowed) == 0) return true;
+    }
+    return false;
+}
+
+int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool only_whitespace(const char* text) {
+    for (; text && *text; text++) {
+        if (*text != ' ' && *text != '\t' && *text != '\n' && *text != '\r' && *text != ';') {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+SqlSandbox::SqlSandbox(const std::string& db_path, std::set<std::string> tables, const std::string& setup_sql)
+    : tables_(std::move(tables))
+{
+    int rc = sqlite3_open_v2(db_path.c_str(), &db_, SQLITE_OPEN_READONLY, nullptr);
+    if (rc != SQLITE_OK) {
+        std::string err = db_ ? sqlite3_errmsg(db_) : "out of memory";
+        sqlite3_close(db_);
+        db_ = nullptr;
+        throw std::runtime_error("Failed to open read-only connection: " + err);
+    }
+
+    if (!setup_sql.empty()) {
+        sqlite3_exec(db_, setup_sql.c_str(), nullptr, nullptr, nullptr);
+    }
+    sqlite3_exec(db_, "PRAGMA query_only=1", nullptr, nullptr, nullptr);
+    sqlite3_set_authorizer(db_, &SqlSandbox::authorize, this);
+    sqlite3_progress_handler(db_, kProgressOps, &SqlSandbox::progress, this);
+}
+
+SqlSandbox::~SqlSandbox() {
+    if (db_) {
+        sqlite3_close(db_);
+    }
+}
+
+bool SqlSandbox::table_allowed(const char* table) const {
+    if (!table || !*table) return true;  // Subqueries and CTEs, whose sources are checked separately
+    if (tables_.count(table)) return true;
+    if (std::strcmp(table, "sqlite_master") == 0) return true;  // Schema only; FTS5 reads it on connect
+
+    for (const auto& approved : tables_) {
+        for (const char* suffix : kShadowSuffixes) {
+            if (approved + suffix == table) return true;
+        }
+    }
+    return false;
+}
+
+int SqlSandbox::authorize(void* self, int action, const char* arg1, const char* arg2,
+                          const char* db_name, const char* trigger) {
+    (void)arg2;
+    (void)trigger;
+    auto* sandbox = static_cast<SqlSandbox*>(self);
+
+    switch (action) {
+    case SQLITE_SELECT:
+    case SQLITE_RECURSIVE:
+        return SQLITE_OK;
+    case SQLITE_FUNCTION:
+        return function_allowed(arg2) ? SQLITE_OK : SQLITE_DENY;
+    case SQLITE_READ:
+        if (db_name && std::strcmp(db_name, "main") != 0) return SQLITE_DENY;
+        return sandbox->table_allowed(arg1) ? SQLITE_OK : SQLITE_DENY;
+    // FTS5 issues these while connecting its virtual table. The connection is
+    // opened read-only and statements must pass sqlite3_stmt_readonly, so
+    // neither can modify anything.
+    case SQLITE_PRAGMA:
+        return arg1 && std::strcmp(arg1, "data_version") == 0 ? SQLITE_OK : SQLITE_DENY;
+    case SQLITE_UPDATE:
+        return arg1 && std::strcmp(arg1, "sqlite_master") == 0 ? SQLITE_OK : SQLITE_DENY;
+    default:
+        return SQLITE_DENY;  // Writes, DDL, PRAGMA, ATTACH, transactions
+    }
+}
+
+int SqlSandbox::progress(void* self) {
+    auto* sandbox = static_cast<SqlSandbox*>(self);
+    return steady_now_ns() > sandbox->deadline_ns_ ? 1 : 0;
+}
+
+SqlResult SqlSandbox::run(const std::string& sql, const SqlLimits& limits) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto start = steady_now_ns();
+    deadline_ns_ = start + static_cast<int64_t>(limits.timeout_ms) * 1000000;
+    int64_t max_length = std::clamp<int64_t>(limits.max_bytes * kLengthPerResultByte, kMinLengthLimit,
+                                             std::numeric_limits<int>::max());
+    sqlite3_limit(db_, SQLITE_LIMIT_LENGTH, static_cast<int>(max_length));
+
+    sqlite3_stmt* stmt = nullptr;
+    const char* tail = nullptr;
+    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, &tail);
+    if (rc != SQLITE_OK) {
+        throw std::runtime_error("SQL rejected: " + std::string(sqlite3_errmsg(db_)));
+    }
+    if (!stmt) {
+        throw std::runtime_error("SQL rejected: empty statement");
+    }
+    if (!only_whitespace(tail)) {
+        sqlite3_finalize(stmt);
+        throw std::runtime_error("SQL rejected: only a single statement is allowed");
+    }
+    if (!sqlite3_stmt_readonly(stmt)) {
+        sqlite3_finalize(stmt);
+        throw std::runtime_error("SQL rejected: only read-only statements are allowed");
+    }
+
+    SqlResult result;
+    int column_count = sqlite3_column_count(stmt);
+    for (int i = 0; i < column_count; i++) {
+        const char* name = sqlite3_column_name(stmt, i);
+        result.columns.push_back(name ? name : "");
+    }
+
+    int64_t bytes = 0;
+    while (true) {
+        rc = sqlite3_step(stmt);
+        if (rc != SQLITE_ROW) break;
+
+        if (static_cast<int64_t>(result.rows.size()) >= limits.max_rows || bytes >= limits.max_bytes) {
+            result.truncated = true;
+            break;
+        }
+
+        nlohmann::json row = nlohmann::json::array();
+        for (int i = 0; i < column_count; i++) {
+            switch (sqlite3_column_type(stmt, i)) {
+            case SQLITE_INTEGER:
+                row.push_back(sqlite3_column_int64(stmt, i));
+                bytes += 8;
+                break;
+            case SQLITE_FLOAT:
+                row.push_back(sqlite3_column_double(stmt, i));
+                bytes += 8;
+                break;
+            case SQLITE_TEXT: {
+                int len = sqlite3_column_bytes(stmt, i);
+                row.push_back(std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, i)), len));
+                bytes += len;
+                break;
+            }
+            case SQLITE_BLOB: {
+                int len = sqlite3_column_bytes(stmt, i);
+                row.push_back("<blob " + std::to_string(len) + " bytes>");
+                bytes += 16;
+                break;
+            }
+            default:
+                row.push_back(nullptr);
+                bytes += 4;
+                break;
+            }
+        }
+        result.rows.push_back(std::move(row));
+    }
+
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        std::string err = rc == SQLITE_INTERRUPT
+            ? "query exceeded " + std::to_string(limits.timeout_ms) + "ms time limit"
+            : std::string(sqlite3_errmsg(db_));
+        sqlite3_finalize(stmt);
+        throw std::runtime_error("SQL failed: " + err);
+    }
+
+    sqlite3_finalize(stmt);
+    result.elapsed_ms = static_cast<double>(steady_now_ns() - start) / 1e6;
+    return result;
+}
+
+} // namespace mcp_logs
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <sqlite3.h>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace mcp_logs {
+
+struct SqlLimits {
+    int64_t max_rows = 1000;
+    int64_t max_bytes = 1 << 20;    // Approximate size of returned values
+    int timeout_ms = 2000;
+};
+
+struct SqlResult {
+    std::vector<std::string> columns;
+    nlohmann::json rows = nlohmann::json::array();   // Array of arrays, one per row
+    bool truncated = false;                          // Stopped at max_rows or max_bytes
+    double elapsed_ms = 0.0;
+};
+
+// Runs agent-supplied SQL on a separate read-only connection.
+//
+// An authorizer only permits SELECT and reads of the approved tables (and the
+// FTS5 shadow and schema tables behind them) and calls to an allowlist of
+// SQL functions; writes, DDL, PRAGMA, ATTACH and other functions (such as
+// load_extension) are denied at prepare time. Strings and blobs a statement
+// builds are capped at a few times max_bytes. A progress handler interrupts statements that run past
+// the deadline, and results stop at the row and byte caps. Uses its own
+// connection and mutex, so long aggregations don't block inserts (WAL mode
+// lets the reader run alongside the writer).
+class SqlSandbox {
+public:
+    // setup_sql runs before the authorizer is installed (e.g. cache and mmap
+    // PRAGMAs, which agent SQL may not use)
+    SqlSandbox(const std::string& db_path, std::set<std::string> tables, const std::string& setup_sql = "");
+    ~SqlSandbox();
+
+    SqlSandbox(const SqlSandbox&) = delete;
+    SqlSandbox& operator=(const SqlSandbox&) = delete;
+
+    // Run a single SELECT statement. Throws std::runtime_error if it is
+    // rejected, fails or times out.
+    SqlResult run(const std::string& sql, const SqlLimits& limits);
+
+    const std::set<std::string>& tables() const { return tables_; }
+
+private:
+    static int authorize(void* self, int action, const char* arg1, const char* arg2,
+                         const char* db_name, const char* trigger);
+    static int progress(void* self);
+
+    bool table_allowed(const char* table) const;
+
+    sqlite3* db_ = nullptr;
+    std::mutex mutex_;
+    std::set<std::string> tables_;
+    int64_t deadline_ns_ = 0;    // steady_clock deadline for the running statement
+};
+
+} // namespace mcp_logs
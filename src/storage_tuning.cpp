@@ -0,0 +1,441 @@
+#include "storage_tuning.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace mcp_logs {
+
+namespace {
+
+constexpr int64_t kKiB = 1024;
+constexpr int64_t kMiB = 1024 * kKiB;
+constexpr int64_t kGiB = 1024 * kMiB;
+
+// Autotune benchmark size: enough rows to spill the page cache a little,
+// small enough to finish in a second or two on an SSD
+constexpr int kBenchRows = 40000;
+constexpr int kBenchBatch = 1000;
+constexpr int kBenchLookups = 5000;
+constexpr int kBenchCommits = 20;
+constexpr int kPageSizes[] = {4096, 8192, 16384};
+
+// Durable commits slower than this suggest network or spinning storage,
+// where mmap is risky (network filesystems) or doesn't help
+constexpr double kSlowCommitMs = 50.0;
+
+std::string format_bytes(int64_t bytes) {
+    std::ostringstream out;
+    auto unit = [&](int64_t size, const char* name) {
+        out << std::fixed << std::setprecision(bytes % size ? 1 : 0)
+            << static_cast<double>(bytes) / static_cast<double>(size) << " " << name;
+    };
+    if (bytes >= kGiB) unit(kGiB, "GiB");
+    else if (bytes >= kMiB) unit(kMiB, "MiB");
+    else if (bytes >= kKiB) unit(kKiB, "KiB");
+    else out << bytes << " B";
+    return out.str();
+}
+
+void exec(sqlite3* db, const std::string& sql) {
+    char* err = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+        std::string error_msg = err ? err : "Unknown error";
+        sqlite3_free(err);
+        throw std::runtime_error("SQL error: " + error_msg);
+    }
+}
+
+int64_t pragma_int(sqlite3* db, const char* name) {
+    sqlite3_stmt* stmt;
+    std::string sql = std::string("PRAGMA ") + name;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("Failed to read " + sql + ": " + sqlite3_errmsg(db));
+    }
+    int64_t value = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+int64_t physical_memory_bytes() {
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status)) return static_cast<int64_t>(status.ullTotalPhys);
+    return 0;
+#else
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGE_SIZE);
+    if (pages <= 0 || page_size <= 0) return 0;
+    return static_cast<int64_t>(pages) * page_size;
+#endif
+}
+
+int64_t file_bytes(const std::string& path) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    return ec ? 0 : static_cast<int64_t>(size);
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Scratch database for the autotune benchmark; the files are removed on
+// construction and destruction
+class ScratchDb {
+public:
+    explicit ScratchDb(std::string path) : path_(std::move(path)) {
+        remove_files();
+        open();
+    }
+
+    ~ScratchDb() {
+        close();
+        remove_files();
+    }
+
+    ScratchDb(const ScratchDb&) = delete;
+    ScratchDb& operator=(const ScratchDb&) = delete;
+
+    sqlite3* db() const { return db_; }
+
+    // Reopen, dropping SQLite's page cache (the OS cache stays warm)
+    void reopen() {
+        close();
+        open();
+    }
+
+private:
+    void open() {
+        if (sqlite3_open(path_.c_str(), &db_) != SQLITE_OK) {
+            std::string err = db_ ? sqlite3_errmsg(db_) : "out of memory";
+            sqlite3_close(db_);
+            db_ = nullptr;
+            throw std::runtime_error("Failed to open autotune scratch database " + path_ + ": " + err);
+        }
+    }
+
+    void close() {
+        if (db_) sqlite3_close(db_);
+        db_ = nullptr;
+    }
+
+    void remove_files() {
+        std::error_code ec;
+        for (const char* suffix : {"", "-wal", "-shm", "-journal"}) {
+            std::filesystem::remove(path_ + suffix, ec);
+        }
+    }
+
+    std::string path_;
+    sqlite3* db_ = nullptr;
+};
+
+struct PageSizeTrial {
+    int page_size = 0;
+    double insert_seconds = 0.0;
+    double lookup_seconds = 0.0;
+    int64_t bytes = 0;
+};
+
+// Insert log-shaped rows in batches, checkpoint them into the main file,
+// then time random lookups on a fresh connection
+PageSizeTrial run_page_size_trial(const std::string& path, int page_size) {
+    ScratchDb scratch(path);
+    exec(scratch.db(), "PRAGMA page_size=" + std::to_string(page_size));
+    exec(scratch.db(), "PRAGMA journal_mode=WAL");
+    exec(scratch.db(), "PRAGMA synchronous=NORMAL");
+    exec(scratch.db(), R"(
+        CREATE TABLE logs (
+            id INTEGER PRIMARY KEY,
+            category TEXT NOT NULL,
+            verbosity INTEGER NOT NULL,
+            message TEXT NOT NULL,
+            timestamp REAL NOT NULL,
+            session_id TEXT NOT NULL
+        )
+    )");
+    exec(scratch.db(), "CREATE INDEX idx_logs_session ON logs(session_id)");
+    exec(scratch.db(), "CREATE INDEX idx_logs_category ON logs(category)");
+
+    static const char* kWords[] = {"Actor", "spawned", "at", "location", "replication", "failed", "for",
+                                   "component", "PlayerController", "tick", "took", "ms", "loaded",
+                                   "asset", "texture", "streaming", "pool", "over", "budget", "by"};
+    std::mt19937 rng(page_size);
+    std::uniform_int_distribution<int> word(0, static_cast<int>(std::size(kWords)) - 1);
+    std::uniform_int_distribution<int> length(8, 24);
+
+    sqlite3_stmt* insert;
+    sqlite3_prepare_v2(scratch.db(),
+                       "INSERT INTO logs (category, verbosity, message, timestamp, session_id) VALUES (?, ?, ?, ?, ?)",
+                       -1, &insert, nullptr);
+
+    PageSizeTrial trial;
+    trial.page_size = page_size;
+    auto start = std::chrono::steady_clock::now();
+    for (int row = 0; row < kBenchRows; row++) {
+        if (row % kBenchBatch == 0) exec(scratch.db(), "BEGIN");
+
+        std::string message;
+        for (int w = length(rng); w > 0; w--) {
+            message += kWords[word(rng)];
+            message += ' ';
+        }
+        message += std::to_string(rng());
+        trial.bytes += static_cast<int64_t>(message.size()) + 40;
+
+        std::string category = std::string("Log") + kWords[row % 7];
+        std::string session = "session_" + std::to_string(row / 5000);
+        sqlite3_bind_text(insert, 1, category.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(insert, 2, row % 6);
+        sqlite3_bind_text(insert, 3, message.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(insert, 4, 1000.0 + row);
+        sqlite3_bind_text(insert, 5, session.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_step(insert);
+        sqlite3_reset(insert);
+
+        if (row % kBenchBatch == kBenchBatch - 1 || row == kBenchRows - 1) exec(scratch.db(), "COMMIT");
+    }
+    sqlite3_finalize(insert);
+    exec(scratch.db(), "PRAGMA wal_checkpoint(TRUNCATE)");
+    trial.insert_seconds = seconds_since(start);
+
+    scratch.reopen();
+    sqlite3_stmt* lookup;
+    sqlite3_prepare_v2(scratch.db(), "SELECT message FROM logs WHERE id = ?", -1, &lookup, nullptr);
+    std::uniform_int_distribution<int> id(1, kBenchRows);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kBenchLookups; i++) {
+        sqlite3_bind_int(lookup, 1, id(rng));
+        sqlite3_step(lookup);
+        sqlite3_reset(lookup);
+    }
+    trial.lookup_seconds = seconds_since(start);
+    sqlite3_finalize(lookup);
+    return trial;
+}
+
+// Average latency of small commits that must reach the disk
+double measure_commit_ms(const std::string& path) {
+    ScratchDb scratch(path);
+    exec(scratch.db(), "PRAGMA journal_mode=WAL");
+    exec(scratch.db(), "PRAGMA synchronous=FULL");
+    exec(scratch.db(), "CREATE TABLE t (x INTEGER)");
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kBenchCommits; i++) {
+        exec(scratch.db(), "INSERT INTO t VALUES (" + std::to_string(i) + ")");
+    }
+    return seconds_since(start) * 1000.0 / kBenchCommits;
+}
+
+} // namespace
+
+std::string StorageSettings::pragmas() const {
+    std::ostringstream sql;
+    sql << "PRAGMA page_size=" << page_size << ";"
+        << "PRAGMA cache_size=" << -(cache_bytes / kKiB) << ";"     // Negative: KiB rather than pages
+        << "PRAGMA mmap_size=" << mmap_bytes << ";"
+        << "PRAGMA temp_store=" << (temp_store_memory ? "MEMORY" : "DEFAULT") << ";"
+        << "PRAGMA wal_autocheckpoint=" << wal_autocheckpoint << ";"
+        << "PRAGMA threads=" << threads << ";";
+    return sql.str();
+}
+
+std::string StorageSettings::describe() const {
+    std::ostringstream out;
+    out << profile << ": page_size " << page_size
+        << ", cache " << format_bytes(cache_bytes)
+        << ", mmap " << (mmap_bytes > 0 ? format_bytes(mmap_bytes) : "off")
+        << ", temp_store " << (temp_store_memory ? "memory" : "file")
+        << ", wal_autocheckpoint " << wal_autocheckpoint << " pages"
+        << ", threads " << threads;
+    return out.str();
+}
+
+nlohmann::json StorageSettings::to_json() const {
+    return {
+        {"profile", profile},
+        {"page_size", page_size},
+        {"cache_bytes", cache_bytes},
+        {"mmap_bytes", mmap_bytes},
+        {"temp_store", temp_store_memory ? "memory" : "file"},
+        {"wal_autocheckpoint", wal_autocheckpoint},
+        {"threads", threads}
+    };
+}
+
+std::optional<StorageSettings> storage_profile(const std::string& name) {
+    StorageSettings s;
+    s.profile = name;
+    if (name == "default") {
+        return s;
+    }
+    if (name == "small") {
+        s.cache_bytes = 8 * kMiB;
+        return s;
+    }
+    if (name == "large-ssd") {
+        s.page_size = 8192;
+        s.cache_bytes = 256 * kMiB;
+        s.mmap_bytes = 1 * kGiB;
+        s.temp_store_memory = true;
+        s.wal_autocheckpoint = 10000;
+        s.threads = 4;
+        return s;
+    }
+    if (name == "ram-heavy") {
+        s.page_size = 8192;
+        s.cache_bytes = 1 * kGiB;
+        s.mmap_bytes = 16 * kGiB;      // SQLite clamps this to its compile-time maximum
+        s.temp_store_memory = true;
+        s.wal_autocheckpoint = 20000;
+        s.threads = 8;
+        return s;
+    }
+    return std::nullopt;
+}
+
+std::vector<std::string> storage_profile_names() {
+    return {"default", "small", "large-ssd", "ram-heavy"};
+}
+
+void apply_storage_settings(sqlite3* db, const StorageSettings& settings) {
+    exec(db, settings.pragmas());
+}
+
+StorageSettings effective_storage_settings(sqlite3* db, const std::string& profile) {
+    StorageSettings s;
+    s.profile = profile;
+    s.page_size = static_cast<int>(pragma_int(db, "page_size"));
+    int64_t cache = pragma_int(db, "cache_size");
+    s.cache_bytes = cache < 0 ? -cache * kKiB : cache * s.page_size;
+    s.mmap_bytes = pragma_int(db, "mmap_size");
+    s.temp_store_memory = pragma_int(db, "temp_store") == 2;
+    s.wal_autocheckpoint = static_cast<int>(pragma_int(db, "wal_autocheckpoint"));
+    s.threads = static_cast<int>(pragma_int(db, "threads"));
+    return s;
+}
+
+nlohmann::json SqliteMemoryStats::to_json() const {
+    nlohmann::json j = {
+        {"memory_used", memory_used},
+        {"memory_highwater", memory_highwater},
+        {"allocations", allocations},
+        {"largest_allocation", largest_allocation},
+        {"pagecache_overflow_bytes", pagecache_overflow_bytes}
+    };
+    if (cache_bytes >= 0) {
+        j["connection"] = {
+            {"cache_bytes", cache_bytes},
+            {"schema_bytes", schema_bytes},
+            {"statement_bytes", statement_bytes},
+            {"lookaside_slots", lookaside_slots}
+        };
+    }
+    return j;
+}
+
+SqliteMemoryStats sqlite_memory_stats(sqlite3* db) {
+    SqliteMemoryStats s;
+    sqlite3_int64 current = 0, highwater = 0;
+    if (sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &current, &highwater, 0) == SQLITE_OK) {
+        s.memory_used = current;
+        s.memory_highwater = highwater;
+    }
+    if (sqlite3_status64(SQLITE_STATUS_MALLOC_COUNT, &current, &highwater, 0) == SQLITE_OK) {
+        s.allocations = current;
+    }
+    if (sqlite3_status64(SQLITE_STATUS_MALLOC_SIZE, &current, &highwater, 0) == SQLITE_OK) {
+        s.largest_allocation = highwater;
+    }
+    if (sqlite3_status64(SQLITE_STATUS_PAGECACHE_OVERFLOW, &current, &highwater, 0) == SQLITE_OK) {
+        s.pagecache_overflow_bytes = current;
+    }
+
+    if (db) {
+        auto db_status = [db](int op) -> int64_t {
+            int cur = 0, high = 0;
+            return sqlite3_db_status(db, op, &cur, &high, 0) == SQLITE_OK ? cur : 0;
+        };
+        s.cache_bytes = db_status(SQLITE_DBSTATUS_CACHE_USED);
+        s.schema_bytes = db_status(SQLITE_DBSTATUS_SCHEMA_USED);
+        s.statement_bytes = db_status(SQLITE_DBSTATUS_STMT_USED);
+        s.lookaside_slots = db_status(SQLITE_DBSTATUS_LOOKASIDE_USED);
+    }
+    return s;
+}
+
+std::string AutotuneResult::describe() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1)
+        << "insert " << insert_mb_per_sec << " MB/s, lookup " << lookup_us << " us"
+        << ", durable commit " << std::setprecision(2) << commit_ms << " ms"
+        << ", RAM " << (memory_bytes ? format_bytes(memory_bytes) : "unknown")
+        << ", database " << format_bytes(database_bytes);
+    return out.str();
+}
+
+AutotuneResult autotune_storage(const std::string& db_path) {
+    std::string scratch = db_path + ".autotune";
+
+    // Pick the page size with the best combined write and read time
+    PageSizeTrial best;
+    for (int page_size : kPageSizes) {
+        PageSizeTrial trial = run_page_size_trial(scratch, page_size);
+        if (best.page_size == 0 ||
+            trial.insert_seconds + trial.lookup_seconds < best.insert_seconds + best.lookup_seconds) {
+            best = trial;
+        }
+    }
+
+    AutotuneResult result;
+    result.insert_mb_per_sec = static_cast<double>(best.bytes) / kMiB / std::max(best.insert_seconds, 1e-6);
+    result.lookup_us = best.lookup_seconds * 1e6 / kBenchLookups;
+    result.commit_ms = measure_commit_ms(scratch);
+    result.database_bytes = file_bytes(db_path) + file_bytes(db_path + "-wal");
+    result.memory_bytes = physical_memory_bytes();
+
+    int64_t memory = result.memory_bytes > 0 ? result.memory_bytes : 4 * kGiB;
+    int64_t database = result.database_bytes;
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    StorageSettings& s = result.settings;
+    s.profile = "autotune";
+    s.page_size = best.page_size;
+
+    // A quarter of the database, within an eighth of RAM
+    s.cache_bytes = std::clamp<int64_t>(database / 4, 16 * kMiB, std::max<int64_t>(16 * kMiB, memory / 8));
+    s.cache_bytes = std::min<int64_t>(s.cache_bytes, 2 * kGiB);
+
+    // Map the whole database with room to grow, on local storage only
+    if (result.commit_ms < kSlowCommitMs) {
+        s.mmap_bytes = std::min<int64_t>(memory / 4, std::max<int64_t>(256 * kMiB, database * 2));
+    }
+
+    s.temp_store_memory = memory >= 4 * kGiB;
+
+    // Let the WAL grow to about a quarter second of insert throughput
+    // before checkpointing, so fast disks checkpoint less often
+    int64_t wal_bytes = static_cast<int64_t>(result.insert_mb_per_sec * kMiB / 4);
+    s.wal_autocheckpoint = static_cast<int>(std::clamp<int64_t>(wal_bytes / s.page_size, 1000, 50000));
+
+    s.threads = cores >= 4 ? static_cast<int>(std::min(8u, cores / 2)) : 0;
+    return result;
+}
+
+} // namespace mcp_logs
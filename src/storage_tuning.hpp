@@ -0,0 +1,88 @@
+#pragma once
+
+#include <sqlite3.h>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace mcp_logs {
+
+// SQLite connection settings for the log database. The defaults are what
+// LogStore has always used: WAL with synchronous=NORMAL, everything else at
+// SQLite's compiled-in values.
+struct StorageSettings {
+    std::string profile = "default";
+    int page_size = 4096;              // Bytes; only takes effect on a new database
+    int64_t cache_bytes = 2048000;     // Page cache per connection
+    int64_t mmap_bytes = 0;            // Memory-mapped I/O window (0: off)
+    bool temp_store_memory = false;    // Sorts and temp indexes in RAM rather than temp files
+    int wal_autocheckpoint = 1000;     // WAL pages between automatic checkpoints
+    int threads = 0;                   // Helper threads SQLite may use for large sorts
+
+    // PRAGMA statements that apply these to a connection, page_size first
+    std::string pragmas() const;
+
+    // One line for the startup log
+    std::string describe() const;
+    nlohmann::json to_json() const;
+};
+
+// Named profiles:
+//   default    what LogStore used before profiles existed
+//   small      laptops and CI: modest cache, no mmap
+//   large-ssd  multi-GB databases on local SSD
+//   ram-heavy  databases that fit in memory on a large host
+// nullopt for an unknown name.
+std::optional<StorageSettings> storage_profile(const std::string& name);
+std::vector<std::string> storage_profile_names();
+
+// Apply settings to an open connection (before any table is created, so a
+// new database gets the page size). Throws std::runtime_error on failure.
+void apply_storage_settings(sqlite3* db, const StorageSettings& settings);
+
+// The values a connection is actually using; SQLite clamps some requests
+// (mmap_size to its compile-time maximum, page_size once the file exists)
+StorageSettings effective_storage_settings(sqlite3* db, const std::string& profile);
+
+// SQLite's heap use. Its allocations go through its own allocator, not
+// operator new, so AllocTracker can't see them; these come from
+// sqlite3_status (process-wide) and sqlite3_db_status (one connection).
+struct SqliteMemoryStats {
+    int64_t memory_used = 0;               // Bytes outstanding, all connections
+    int64_t memory_highwater = 0;
+    int64_t allocations = 0;               // Outstanding allocations
+    int64_t largest_allocation = 0;        // Largest single request seen
+    int64_t pagecache_overflow_bytes = 0;  // Page cache that spilled past SQLITE_CONFIG_PAGECACHE
+    // For the connection passed in; -1 without one
+    int64_t cache_bytes = -1;              // Page cache
+    int64_t schema_bytes = -1;             // Parsed schema
+    int64_t statement_bytes = -1;          // Prepared statements
+    int64_t lookaside_slots = -1;          // Lookaside slots in use
+
+    nlohmann::json to_json() const;
+};
+
+SqliteMemoryStats sqlite_memory_stats(sqlite3* db = nullptr);
+
+struct AutotuneResult {
+    StorageSettings settings;
+    double insert_mb_per_sec = 0.0;    // Bulk insert throughput at the chosen page size
+    double lookup_us = 0.0;            // Random rowid lookup
+    double commit_ms = 0.0;            // Durable (synchronous=FULL) commit latency
+    int64_t database_bytes = 0;        // Existing database size
+    int64_t memory_bytes = 0;          // Physical RAM
+
+    std::string describe() const;
+};
+
+// Short benchmark (a few seconds at most) against a scratch database next to
+// db_path, so it measures the disk the logs live on. Tries each page size
+// with log-shaped rows, times durable commits, then sizes cache, mmap and
+// checkpointing from the results, RAM and the existing database size. The
+// scratch files are removed afterwards. Throws std::runtime_error if the
+// directory isn't writable.
+AutotuneResult autotune_storage(const std::string& db_path);
+
+} // namespace mcp_logs
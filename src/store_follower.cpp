@@ -0,0 +1,71 @@
+#include "store_follower.hpp"
+#include "metrics.hpp"
+#include "server_log.hpp"
+#include "thread_placement.hpp"
+
+namespace mcp_logs {
+
+StoreFollower::StoreFollower(LogStore& store, std::chrono::milliseconds interval)
+    : store_(store)
+    , interval_(interval)
+{
+}
+
+StoreFollower::~StoreFollower() {
+    stop();
+}
+
+void StoreFollower::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) return;
+    running_ = true;
+    thread_ = std::thread([this]() {
+        ThreadPlacement::adopt(ThreadRole::Ingest);
+        run();
+    });
+}
+
+void StoreFollower::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) return;
+        running_ = false;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void StoreFollower::run() {
+    bool failing = false;
+    while (true) {
+        int64_t applied = 0;
+        try {
+            auto start = std::chrono::steady_clock::now();
+            applied = store_.follow();
+            if (applied > 0) {
+                rows_ += applied;
+                Metrics::increment("follower_rows_total", {}, static_cast<double>(applied));
+                Metrics::observe("follower_apply_seconds",
+                                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            if (failing) ServerLog::log("Follower", "Following the primary again");
+            failing = false;
+        } catch (const std::exception& e) {
+            // Typically the primary holding a write lock past the busy timeout
+            if (!failing) ServerLog::error("Follower", std::string("Follow failed, retrying: ") + e.what());
+            failing = true;
+        }
+
+        // A full batch means a backlog: keep going without waiting
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!running_) break;
+        if (applied < LogStore::kFollowBatchRows) {
+            wake_.wait_for(lock, interval_, [this] { return !running_; });
+            if (!running_) break;
+        }
+    }
+}
+
+} // namespace mcp_logs
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "log_store.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace mcp_logs {
+
+// Keeps a follower LogStore current with its primary: calls follow() every
+// interval while caught up, and back to back while there is a backlog.
+// Runs in the ingest thread role, since it is this process's ingest.
+class StoreFollower {
+public:
+    static constexpr std::chrono::milliseconds kDefaultInterval{200};
+
+    explicit StoreFollower(LogStore& store, std::chrono::milliseconds interval = kDefaultInterval);
+    ~StoreFollower();
+
+    StoreFollower(const StoreFollower&) = delete;
+    StoreFollower& operator=(const StoreFollower&) = delete;
+
+    void start();
+    void stop();
+
+    int64_t rows_followed() const { return rows_; }
+
+private:
+    void run();
+
+    LogStore& store_;
+    std::chrono::milliseconds interval_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool running_ = false;
+    std::atomic<int64_t> rows_{0};
+};
+
+} // namespace mcp_logs
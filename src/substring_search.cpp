@@ -0,0 +1,179 @@
+#include "substring_search.hpp"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MCP_LOGS_SIMD_SSE2 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define MCP_LOGS_SIMD_AVX2 1
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace mcp_logs {
+
+namespace {
+
+inline char ascii_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+inline char ascii_upper(char c) {
+    return (c >= 'a' && c <= 'z') ? static_cast<char>(c - ('a' - 'A')) : c;
+}
+
+inline uint32_t lowest_bit(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return idx;
+#else
+    return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+}
+
+// Compare needle against haystack at p; needle is pre-lowered when folding
+inline bool equal_at(const char* p, const std::string& needle, bool ignore_case) {
+    if (!ignore_case) {
+        return std::memcmp(p, needle.data(), needle.size()) == 0;
+    }
+    for (size_t i = 0; i < needle.size(); i++) {
+        if (ascii_lower(p[i]) != needle[i]) return false;
+    }
+    return true;
+}
+
+size_t find_scalar(std::string_view hay, const std::string& needle, bool ignore_case, size_t from) {
+    if (!ignore_case) {
+        return hay.find(needle, from);
+    }
+    if (hay.size() < needle.size()) return std::string_view::npos;
+    for (size_t i = from; i + needle.size() <= hay.size(); i++) {
+        if (equal_at(hay.data() + i, needle, ignore_case)) return i;
+    }
+    return std::string_view::npos;
+}
+
+#ifdef MCP_LOGS_SIMD_SSE2
+// Compare a 16-byte window against the needle's first and last bytes at once,
+// and only verify the positions where both match
+size_t find_sse2(std::string_view hay, const std::string& needle, bool ignore_case) {
+    const size_t n = needle.size();
+    const char* data = hay.data();
+    const size_t len = hay.size();
+
+    const __m128i first_lo = _mm_set1_epi8(needle.front());
+    const __m128i first_up = _mm_set1_epi8(ascii_upper(needle.front()));
+    const __m128i last_lo = _mm_set1_epi8(needle.back());
+    const __m128i last_up = _mm_set1_epi8(ascii_upper(needle.back()));
+
+    size_t i = 0;
+    for (; i + n - 1 + 16 <= len; i += 16) {
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + n - 1));
+
+        __m128i eq_first = _mm_cmpeq_epi8(block_first, first_lo);
+        __m128i eq_last = _mm_cmpeq_epi8(block_last, last_lo);
+        if (ignore_case) {
+            eq_first = _mm_or_si128(eq_first, _mm_cmpeq_epi8(block_first, first_up));
+            eq_last = _mm_or_si128(eq_last, _mm_cmpeq_epi8(block_last, last_up));
+        }
+
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(eq_first, eq_last)));
+        while (mask) {
+            uint32_t bit = lowest_bit(mask);
+            if (equal_at(data + i + bit, needle, ignore_case)) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return find_scalar(hay, needle, ignore_case, i);
+}
+#endif
+
+#ifdef MCP_LOGS_SIMD_AVX2
+// Same filter as find_sse2 over 32-byte windows
+__attribute__((target("avx2")))
+size_t find_avx2(std::string_view hay, const std::string& needle, bool ignore_case) {
+    const size_t n = needle.size();
+    const char* data = hay.data();
+    const size_t len = hay.size();
+
+    const __m256i first_lo = _mm256_set1_epi8(needle.front());
+    const __m256i first_up = _mm256_set1_epi8(ascii_upper(needle.front()));
+    const __m256i last_lo = _mm256_set1_epi8(needle.back());
+    const __m256i last_up = _mm256_set1_epi8(ascii_upper(needle.back()));
+
+    size_t i = 0;
+    for (; i + n - 1 + 32 <= len; i += 32) {
+        __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + n - 1));
+
+        __m256i eq_first = _mm256_cmpeq_epi8(block_first, first_lo);
+        __m256i eq_last = _mm256_cmpeq_epi8(block_last, last_lo);
+        if (ignore_case) {
+            eq_first = _mm256_or_si256(eq_first, _mm256_cmpeq_epi8(block_first, first_up));
+            eq_last = _mm256_or_si256(eq_last, _mm256_cmpeq_epi8(block_last, last_up));
+        }
+
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(eq_first, eq_last)));
+        while (mask) {
+            uint32_t bit = lowest_bit(mask);
+            if (equal_at(data + i + bit, needle, ignore_case)) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    size_t pos = find_sse2(hay.substr(i), needle, ignore_case);
+    return pos == std::string_view::npos ? pos : i + pos;
+}
+
+bool cpu_has_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+} // namespace
+
+SubstringMatcher::SubstringMatcher(std::string needle, bool ignore_case)
+    : needle_(std::move(needle))
+    , ignore_case_(ignore_case)
+{
+    if (ignore_case_) {
+        for (char& c : needle_) c = ascii_lower(c);
+    }
+}
+
+size_t SubstringMatcher::find(std::string_view haystack) const {
+    if (needle_.empty()) return 0;
+    if (haystack.size() < needle_.size()) return std::string_view::npos;
+
+#ifdef MCP_LOGS_SIMD_AVX2
+    if (cpu_has_avx2()) {
+        return find_avx2(haystack, needle_, ignore_case_);
+    }
+#endif
+#ifdef MCP_LOGS_SIMD_SSE2
+    return find_sse2(haystack, needle_, ignore_case_);
+#else
+    return find_scalar(haystack, needle_, ignore_case_, 0);
+#endif
+}
+
+const char* SubstringMatcher::kernel_name() {
+#ifdef MCP_LOGS_SIMD_AVX2
+    if (cpu_has_avx2()) return "avx2";
+#endif
+#ifdef MCP_LOGS_SIMD_SSE2
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace mcp_logs
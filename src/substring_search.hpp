@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace mcp_logs {
+
+// Raw substring matcher for grep-style searches over message bytes.
+//
+// Uses a SIMD first/last-byte filter (AVX2 when the CPU supports it, SSE2
+// otherwise on x86-64) and verifies candidate positions with a byte compare.
+// Other architectures use a scalar fallback. Case-insensitive matching folds
+// ASCII letters only. Immutable after construction, so one instance can be
+// shared by concurrent scanning threads.
+class SubstringMatcher {
+public:
+    SubstringMatcher(std::string needle, bool ignore_case);
+
+    bool matches(std::string_view haystack) const { return find(haystack) != std::string_view::npos; }
+
+    // Offset of the first occurrence, or npos
+    size_t find(std::string_view haystack) const;
+
+    const std::string& needle() const { return needle_; }
+    bool ignore_case() const { return ignore_case_; }
+
+    // Name of the kernel selected for this CPU ("avx2", "sse2" or "scalar")
+    static const char* kernel_name();
+
+private:
+    std::string needle_;     // Lowercased when ignore_case_
+    bool ignore_case_;
+};
+
+} // namespace mcp_logs
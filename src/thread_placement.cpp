@@ -0,0 +1,347 @@
+#include "thread_placement.hpp"
+#include "metrics.hpp"
+#include "server_log.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+namespace mcp_logs {
+
+namespace {
+
+constexpr size_t kRoles = static_cast<size_t>(ThreadRole::Count);
+constexpr const char* kRoleNames[kRoles] = {"ingest", "tailer", "query", "http", "ui"};
+
+// Plain int so reading it needs no TLS initialisation (signal handlers)
+thread_local int t_current_role = -1;
+
+std::string read_first_line(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+#ifdef __linux__
+double thread_cpu_seconds(clockid_t clock) {
+    timespec ts{};
+    if (clock_gettime(clock, &ts) != 0) return 0.0;
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+#endif
+
+} // namespace
+
+const char* thread_role_name(ThreadRole role) {
+    size_t index = static_cast<size_t>(role);
+    return index < kRoles ? kRoleNames[index] : "unknown";
+}
+
+std::optional<ThreadRole> thread_role_from_name(const std::string& name) {
+    for (size_t i = 0; i < kRoles; i++) {
+        if (name == kRoleNames[i]) return static_cast<ThreadRole>(i);
+    }
+    return std::nullopt;
+}
+
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        item.erase(std::remove_if(item.begin(), item.end(), [](unsigned char c) { return std::isspace(c); }),
+                   item.end());
+        if (item.empty()) continue;
+
+        size_t dash = item.find('-');
+        try {
+            size_t used = 0;
+            int first = std::stoi(item.substr(0, dash), &used);
+            if (used != (dash == std::string::npos ? item.size() : dash)) throw std::invalid_argument(item);
+            int last = first;
+            if (dash != std::string::npos) {
+                std::string tail = item.substr(dash + 1);
+                last = std::stoi(tail, &used);
+                if (used != tail.size()) throw std::invalid_argument(item);
+            }
+            if (first < 0 || last < first) throw std::invalid_argument(item);
+            for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+        } catch (const std::logic_error&) {
+            throw std::runtime_error("Invalid CPU list '" + list + "'");
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string format_cpu_list(const std::vector<int>& cpus) {
+    std::string out;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) j++;
+        if (!out.empty()) out += ',';
+        out += std::to_string(cpus[i]);
+        if (j > i) out += '-' + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return out;
+}
+
+NumaTopology read_numa_topology(const std::string& sysfs_root) {
+    NumaTopology topology;
+    std::filesystem::path nodes = std::filesystem::path(sysfs_root) / "devices/system/node";
+
+    std::vector<std::pair<int, std::vector<int>>> found;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(nodes, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+            !std::all_of(name.begin() + 4, name.end(), [](unsigned char c) { return std::isdigit(c); })) {
+            continue;
+        }
+        try {
+            found.emplace_back(std::stoi(name.substr(4)), parse_cpu_list(read_first_line(entry.path() / "cpulist")));
+        } catch (const std::exception&) {
+            continue;
+        }
+    }
+    std::sort(found.begin(), found.end());
+
+    if (found.empty()) {
+        std::vector<int> all;
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++) {
+            all.push_back(static_cast<int>(cpu));
+        }
+        topology.node_cpus.push_back(std::move(all));
+        return topology;
+    }
+
+    // Node numbers can have gaps; index by number so nic_numa_node() matches
+    topology.node_cpus.resize(static_cast<size_t>(found.back().first) + 1);
+    for (auto& [node, cpus] : found) {
+        topology.node_cpus[static_cast<size_t>(node)] = std::move(cpus);
+    }
+    return topology;
+}
+
+std::optional<int> nic_numa_node(const std::string& interface, const std::string& sysfs_root) {
+    std::filesystem::path path = std::filesystem::path(sysfs_root) / "class/net" / interface / "device/numa_node";
+    std::string value = read_first_line(path);
+    if (value.empty()) return std::nullopt;
+    try {
+        int node = std::stoi(value);
+        if (node < 0) return std::nullopt;   // No affinity reported (single node or virtual device)
+        return node;
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+struct ThreadPlacement::Registry {
+    Registry() {
+#ifdef __linux__
+        CPU_ZERO(&process_mask);
+        has_process_mask = sched_getaffinity(0, sizeof(process_mask), &process_mask) == 0;
+#endif
+    }
+
+    std::mutex mutex;
+    std::array<std::vector<int>, kRoles> cpus;
+    std::array<double, kRoles> finished{};      // CPU seconds of exited threads
+    std::vector<Membership*> members;           // Live threads
+#ifdef __linux__
+    cpu_set_t process_mask;                     // CPUs allowed at startup, for unpinned roles
+    bool has_process_mask = false;
+#endif
+};
+
+// A thread's membership in a role; lives in a thread_local so it ends
+// (and its CPU time is banked) when the thread exits
+class ThreadPlacement::Membership {
+public:
+    explicit Membership(ThreadRole role) : role(role) {
+#ifdef __linux__
+        if (pthread_getcpuclockid(pthread_self(), &clock) == 0) {
+            has_clock = true;
+            start = thread_cpu_seconds(clock);
+        }
+#endif
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.members.push_back(this);
+    }
+
+    ~Membership() {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.finished[static_cast<size_t>(role)] += used();
+        r.members.erase(std::remove(r.members.begin(), r.members.end(), this), r.members.end());
+    }
+
+    // CPU seconds since joining the role; registry mutex held, so the thread
+    // (and its clock) is still alive
+    double used() const {
+#ifdef __linux__
+        if (has_clock) return std::max(0.0, thread_cpu_seconds(clock) - start);
+#endif
+        return 0.0;
+    }
+
+    ThreadRole role;
+#ifdef __linux__
+    clockid_t clock{};
+    bool has_clock = false;
+#endif
+    double start = 0.0;
+};
+
+ThreadPlacement::Registry& ThreadPlacement::registry() {
+    static Registry instance;
+    return instance;
+}
+
+void ThreadPlacement::set_cpus(ThreadRole role, std::vector<int> cpus) {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.cpus[static_cast<size_t>(role)] = std::move(cpus);
+}
+
+std::vector<int> ThreadPlacement::cpus(ThreadRole role) {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.cpus[static_cast<size_t>(role)];
+}
+
+void ThreadPlacement::configure_auto(const NumaTopology& topology, int ingest_node) {
+    std::vector<int> ingest;
+    std::vector<int> rest;
+
+    size_t nodes_with_cpus = std::count_if(topology.node_cpus.begin(), topology.node_cpus.end(),
+                                           [](const auto& cpus) { return !cpus.empty(); });
+    if (nodes_with_cpus > 1 && ingest_node >= 0 &&
+        static_cast<size_t>(ingest_node) < topology.node_cpus.size()) {
+        for (size_t node = 0; node < topology.node_cpus.size(); node++) {
+            auto& target = static_cast<int>(node) == ingest_node ? ingest : rest;
+            target.insert(target.end(), topology.node_cpus[node].begin(), topology.node_cpus[node].end());
+        }
+    } else {
+        std::vector<int> all;
+        for (const auto& cpus : topology.node_cpus) all.insert(all.end(), cpus.begin(), cpus.end());
+        std::sort(all.begin(), all.end());
+        size_t reserved = std::max<size_t>(1, all.size() / 4);
+        if (all.size() > reserved) {
+            ingest.assign(all.begin(), all.begin() + static_cast<std::ptrdiff_t>(reserved));
+            rest.assign(all.begin() + static_cast<std::ptrdiff_t>(reserved), all.end());
+        }
+    }
+    if (ingest.empty() || rest.empty()) return;   // Nothing to separate
+
+    std::sort(rest.begin(), rest.end());
+    set_cpus(ThreadRole::Ingest, ingest);
+    set_cpus(ThreadRole::Tailer, ingest);
+    set_cpus(ThreadRole::Query, rest);
+    set_cpus(ThreadRole::Http, rest);
+    set_cpus(ThreadRole::Ui, rest);
+}
+
+void ThreadPlacement::reset() {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto& cpus : r.cpus) cpus.clear();
+}
+
+void ThreadPlacement::adopt(ThreadRole role) {
+    thread_local std::unique_ptr<Membership> membership;
+    if (membership && membership->role == role) return;
+    t_current_role = static_cast<int>(role);
+    membership.reset();   // Bank time spent in the previous role
+
+#ifdef __linux__
+    auto& r = registry();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::vector<int> cpus = ThreadPlacement::cpus(role);
+    if (cpus.empty()) {
+        if (r.has_process_mask) set = r.process_mask;   // Undo any mask inherited from the creating thread
+    } else {
+        for (int cpu : cpus) {
+            if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+        }
+    }
+    if (CPU_COUNT(&set) > 0) {
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0) {
+            ServerLog::error("Placement", std::string("Failed to pin ") + thread_role_name(role) +
+                             " thread to CPUs " + format_cpu_list(cpus) + ": " + std::strerror(rc));
+        }
+    }
+#endif
+
+    membership = std::make_unique<Membership>(role);
+}
+
+std::optional<ThreadRole> ThreadPlacement::current_role() noexcept {
+    if (t_current_role < 0) return std::nullopt;
+    return static_cast<ThreadRole>(t_current_role);
+}
+
+std::array<double, static_cast<size_t>(ThreadRole::Count)> ThreadPlacement::cpu_seconds() {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    auto seconds = r.finished;
+    for (const auto* member : r.members) {
+        seconds[static_cast<size_t>(member->role)] += member->used();
+    }
+    return seconds;
+}
+
+void ThreadPlacement::publish_metrics() {
+    auto seconds = cpu_seconds();
+    std::array<size_t, kRoles> counts{};
+    {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (const auto* member : r.members) counts[static_cast<size_t>(member->role)]++;
+    }
+    for (size_t i = 0; i < kRoles; i++) {
+        Metrics::set_gauge("process_thread_cpu_seconds", seconds[i], {{"role", kRoleNames[i]}});
+        Metrics::set_gauge("process_threads", static_cast<double>(counts[i]), {{"role", kRoleNames[i]}});
+    }
+}
+
+std::string ThreadPlacement::describe() {
+    std::string out;
+    for (size_t i = 0; i < kRoles; i++) {
+        auto list = cpus(static_cast<ThreadRole>(i));
+        if (!out.empty()) out += ", ";
+        out += std::string(kRoleNames[i]) + " " + (list.empty() ? "any" : format_cpu_list(list));
+    }
+    return out;
+}
+
+std::string ThreadPlacement::describe_cpu_usage() {
+    auto seconds = cpu_seconds();
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < kRoles; i++) {
+        if (i) out << ", ";
+        out << kRoleNames[i] << " " << seconds[i] << "s";
+    }
+    return out.str();
+}
+
+} // namespace mcp_logs
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace mcp_logs {
+
+// What a thread does, for CPU placement and per-role CPU accounting
+enum class ThreadRole {
+    Ingest,     // UDP receive, parse and SQLite writes (UdpReceiver, IngestPipeline)
+    Tailer,     // FileTailer polling and inserts
+    Query,      // MCP request executor and parallel scans
+    Http,       // HTTP/SSE I/O
+    Ui,         // Console UI
+    Count
+};
+
+const char* thread_role_name(ThreadRole role);
+std::optional<ThreadRole> thread_role_from_name(const std::string& name);
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}. Throws std::runtime_error on
+// malformed input.
+std::vector<int> parse_cpu_list(const std::string& list);
+std::string format_cpu_list(const std::vector<int>& cpus);
+
+// CPUs of each NUMA node, from sysfs (Linux). Elsewhere, or if sysfs has no
+// node directories, a single node holding every CPU.
+struct NumaTopology {
+    std::vector<std::vector<int>> node_cpus;
+};
+NumaTopology read_numa_topology(const std::string& sysfs_root = "/sys");
+
+// NUMA node a network interface's device is attached to; nullopt if unknown
+std::optional<int> nic_numa_node(const std::string& interface, const std::string& sysfs_root = "/sys");
+
+// Process-wide thread placement. Each long-lived thread calls adopt() with
+// its role when it starts. That pins the thread to the role's CPUs (Linux;
+// elsewhere placement is a no-op) and counts its CPU time under the role
+// until the thread exits.
+//
+// Memory follows placement through the kernel's first-touch policy: pages
+// are allocated on the node of the thread that first writes them. So
+// buffers created by a pinned thread, and the malloc arena it allocates
+// from, end up node-local without an explicit NUMA allocator.
+class ThreadPlacement {
+public:
+    // CPUs a role may run on; empty leaves it on every CPU the process may use
+    static void set_cpus(ThreadRole role, std::vector<int> cpus);
+    static std::vector<int> cpus(ThreadRole role);
+
+    // Ingest and tailer threads on ingest_node, and everything else on the
+    // other nodes. With a single node, ingest gets the first quarter of its
+    // CPUs and everything else the rest.
+    static void configure_auto(const NumaTopology& topology, int ingest_node);
+
+    // Forget all role CPUs (tests)
+    static void reset();
+
+    // Place the calling thread for the rest of its life (or until it adopts
+    // another role)
+    static void adopt(ThreadRole role);
+
+    // Role the calling thread adopted, if any. Async-signal-safe, for the
+    // CPU profiler's SIGPROF handler.
+    static std::optional<ThreadRole> current_role() noexcept;
+
+    // CPU seconds used by each role's threads, live and exited
+    static std::array<double, static_cast<size_t>(ThreadRole::Count)> cpu_seconds();
+
+    // process_thread_cpu_seconds{role} and process_threads{role} gauges for /metrics
+    static void publish_metrics();
+
+    // "ingest 0-7, tailer 0-7, query 8-15, ..." (unpinned roles: "any")
+    static std::string describe();
+    static std::string describe_cpu_usage();
+
+private:
+    class Membership;
+    struct Registry;
+    static Registry& registry();
+};
+
+} // namespace mcp_logs
@@ -0,0 +1,162 @@
+#include "thread_pool.hpp"
+#include "server_log.hpp"
+#include <algorithm>
+
+namespace mcp_logs {
+
+namespace {
+
+// Worker the current thread belongs to, so nested submits stay local
+thread_local const WorkStealingPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool(size_t threads, ThreadRole role) {
+    if (threads == 0) {
+        threads = std::max<size_t>(4, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        threads_.emplace_back([this, i, role] {
+            ThreadPlacement::adopt(role);
+            run(i);
+        });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(Task task) {
+    size_t target = current_pool == this ? current_worker
+                                         : next_worker_.fetch_add(1) % workers_.size();
+    {
+        std::lock_guard<std::mutex> lock(workers_[target]->mutex);
+        workers_[target]->tasks.push_back(std::move(task));
+    }
+    {
+        // Counted once it can be taken, so a worker's claim never outruns it
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        pending_++;
+    }
+    wake_cv_.notify_one();
+}
+
+bool WorkStealingPool::submit_ordered(const std::string& key, Task task, size_t max_queued) {
+    if (max_queued == 0) return false;
+    std::lock_guard<std::mutex> lock(strands_mutex_);
+    auto it = strands_.find(key);
+    if (it != strands_.end() && it->second.tasks.size() >= max_queued) return false;
+
+    Strand& strand = it != strands_.end() ? it->second : strands_[key];
+    strand.tasks.push_back(std::move(task));
+    if (strand.tasks.size() == 1) {
+        submit([this, key] { run_strand(key); });
+    }
+    return true;
+}
+
+void WorkStealingPool::run_strand(const std::string& key) {
+    // The running task stays at the front until it finishes, so
+    // submit_ordered knows the strand is busy
+    Task task;
+    {
+        std::lock_guard<std::mutex> lock(strands_mutex_);
+        task = std::move(strands_[key].tasks.front());
+    }
+
+    try {
+        task();
+    } catch (const std::exception& e) {
+        ServerLog::error("Executor", std::string("Task failed: ") + e.what());
+    }
+
+    std::lock_guard<std::mutex> lock(strands_mutex_);
+    auto it = strands_.find(key);
+    it->second.tasks.pop_front();
+    if (it->second.tasks.empty()) {
+        strands_.erase(it);
+    } else {
+        // One task per turn, so a busy session can't hold a worker forever
+        submit([this, key] { run_strand(key); });
+    }
+}
+
+bool WorkStealingPool::pop_or_steal(size_t index, Task& task) {
+    {
+        Worker& own = *workers_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < workers_.size(); i++) {
+        Worker& victim = *workers_[(index + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            steals_++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(size_t index) {
+    current_pool = this;
+    current_worker = index;
+
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    while (true) {
+        wake_cv_.wait(lock, [this] { return stopping_ || pending_ > 0; });
+        if (pending_ == 0) return;   // Stopping and drained
+
+        // Claim a task before taking it. pending_ only counts tasks already
+        // in a deque and every taker claims first, so a claimed task is
+        // always there to be found.
+        pending_--;
+        active_++;
+        lock.unlock();
+
+        Task task;
+        while (!pop_or_steal(index, task)) {
+            // Rare: the scan passed a deque before a task landed in it and
+            // other workers emptied the rest. Scan again.
+            std::this_thread::yield();
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            ServerLog::error("Executor", std::string("Task failed: ") + e.what());
+        }
+        task = nullptr;   // Release captures before reporting idle
+
+        lock.lock();
+        active_--;
+        if (pending_ == 0 && active_ == 0) idle_cv_.notify_all();
+    }
+}
+
+void WorkStealingPool::wait_idle() {
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    idle_cv_.wait(lock, [this] { return pending_ == 0 && active_ == 0; });
+}
+
+} // namespace mcp_logs
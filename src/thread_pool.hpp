@@ -0,0 +1,84 @@
+#pragma once
+
+#include "thread_placement.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mcp_logs {
+
+// Fixed-size executor for MCP requests. Each worker owns a deque: tasks a
+// worker submits go to its own deque, external submits are spread
+// round-robin, workers take from the front of their own deque and idle
+// workers steal from the back of the others'. Tasks submitted under the
+// same key run one at a time in submission order (a strand), which keeps
+// each MCP session's requests in order while different sessions run in
+// parallel. (Tool calls leave the strand once queued with QueryScheduler,
+// so their responses can overtake one another.)
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // 0 threads: hardware concurrency, at least 4. Workers adopt `role`
+    // (see ThreadPlacement).
+    explicit WorkStealingPool(size_t threads = 0, ThreadRole role = ThreadRole::Query);
+
+    // Runs every queued task, then joins the workers
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void submit(Task task);
+
+    // Queue task behind the key's earlier tasks. Returns false, dropping the
+    // task, if the key already has max_queued tasks queued or running.
+    bool submit_ordered(const std::string& key, Task task,
+                        size_t max_queued = std::numeric_limits<size_t>::max());
+
+    // Block until no task is queued or running
+    void wait_idle();
+
+    size_t thread_count() const { return threads_.size(); }
+    uint64_t steal_count() const { return steals_; }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct Strand {
+        std::deque<Task> tasks;
+    };
+
+    void run(size_t index);
+    bool pop_or_steal(size_t index, Task& task);
+    void run_strand(const std::string& key);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::condition_variable idle_cv_;
+    size_t pending_ = 0;          // Queued tasks not yet claimed by a worker (wake_mutex_)
+    size_t active_ = 0;           // Tasks claimed or running (wake_mutex_)
+    bool stopping_ = false;       // (wake_mutex_)
+
+    std::atomic<size_t> next_worker_{0};
+    std::atomic<uint64_t> steals_{0};
+
+    std::mutex strands_mutex_;
+    std::unordered_map<std::string, Strand> strands_;   // Keys with a task queued or running
+};
+
+} // namespace mcp_logs
@@ -1,12 +1,16 @@
 #pragma once
 
+#include "cpu_profiler.hpp"
+#include "datagram_capture.hpp"
 #include "log_entry.hpp"
 #include "log_store.hpp"
 #include "server_log.hpp"
+#include "thread_placement.hpp"
 #include <asio.hpp>
 #include <thread>
 #include <atomic>
 #include <functional>
+#include <vector>
 
 namespace mcp_logs {
 
@@ -24,11 +28,22 @@ public:
         stop();
     }
 
+    // Record every datagram received to capture (before parsing, so
+    // malformed ones are kept too). Call before start; capture must outlive
+    // the receiver.
+    void set_capture(CaptureWriter* capture) {
+        capture_ = capture;
+    }
+
     void start() {
         if (running_) return;
         running_ = true;
-        start_receive();
         thread_ = std::thread([this]() {
+            // Pin first, so the receive buffer is allocated on this thread's node
+            ThreadPlacement::adopt(ThreadRole::Ingest);
+            CpuProfiler::set_thread_label("udp");   // "writer" while inserting
+            recv_buffer_.assign(kBufferBytes, 0);
+            start_receive();
             io_context_.run();
         });
     }
@@ -56,6 +71,7 @@ private:
         if (!running_) return;
 
         if (!error && bytes_received > 0) {
+            if (capture_) capture_->write(std::string_view(recv_buffer_.data(), bytes_received));
             try {
                 std::string data(recv_buffer_.data(), bytes_received);
                 auto json = nlohmann::json::parse(data);
@@ -65,6 +81,7 @@ private:
                 auto now = std::chrono::system_clock::now();
                 entry.received_at = std::chrono::duration<double>(now.time_since_epoch()).count();
 
+                CpuProfiler::LabelScope label("writer");
                 store_.insert(entry);
             } catch (const std::exception& e) {
                 ServerLog::error("UDP", std::string("Failed to parse log: ") + e.what());
@@ -74,11 +91,14 @@ private:
         start_receive();
     }
 
+    static constexpr size_t kBufferBytes = 65536;
+
     LogStore& store_;
     asio::io_context io_context_;
     asio::ip::udp::socket socket_;
     asio::ip::udp::endpoint remote_endpoint_;
-    std::array<char, 65536> recv_buffer_;
+    std::vector<char> recv_buffer_;
+    CaptureWriter* capture_ = nullptr;
     std::thread thread_;
     std::atomic<bool> running_;
 };
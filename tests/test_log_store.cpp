@@ -1,7 +1,40 @@
 #include <catch2/catch_test_macros.hpp>
+#include "alloc_tracker.hpp"
+#include "anomaly_detector.hpp"
+#include "arrow_ipc.hpp"
+#include "asio_http_server.hpp"
+#include "compression.hpp"
+#include "cpu_profiler.hpp"
+#include "datagram_capture.hpp"
+#include "ingest_pipeline.hpp"
+#include "log_archive.hpp"
+#include "log_export.hpp"
+#include "lock_profiler.hpp"
+#include "log_schema.hpp"
 #include "log_store.hpp"
+#include "mcp_server.hpp"
+#include "message_template.hpp"
+#include "metrics.hpp"
+#include "query_scheduler.hpp"
+#include "regex_matcher.hpp"
+#include "row_bitmap.hpp"
+#include "rule_engine.hpp"
+#include "source_manager.hpp"
+#include "store_follower.hpp"
+#include "substring_search.hpp"
+#include "thread_placement.hpp"
+#include "thread_pool.hpp"
+#include <sqlite3.h>
 #include <filesystem>
 #include <algorithm>
+#include <regex>
+#include <sstream>
+#include <thread>
+#include <zlib.h>
+#include <fstream>
+#ifdef __linux__
+#include <sched.h>
+#endif
 
 using namespace mcp_logs;
 
@@ -323,3 +356,2735 @@ TEST_CASE("LogStore session operations", "[store][session]") {
     // Cleanup
     std::filesystem::remove(db_path);
 }
+
+TEST_CASE("RowBitmap set operations", "[index]") {
+    RowBitmap evens, threes;
+    for (uint32_t i = 0; i < 200000; i++) {
+        if (i % 2 == 0) evens.add(i);
+        if (i % 3 == 0) threes.add(i);
+    }
+    REQUIRE(evens.cardinality() == 100000);
+
+    auto both = RowBitmap::intersect(evens, threes);
+    REQUIRE(both.cardinality() == 33334);
+    auto values = both.to_vector();
+    REQUIRE(values.front() == 0);
+    REQUIRE(values[1] == 6);
+    REQUIRE(values.back() == 199998);
+
+    RowBitmap sparse;
+    sparse.add(6);
+    sparse.add(70000);
+    sparse.add(70001);
+    auto sparse_both = RowBitmap::intersect(sparse, evens);
+    REQUIRE(sparse_both.to_vector() == std::vector<uint32_t>{6, 70000});
+
+    auto either = RowBitmap::unite(sparse, threes);
+    REQUIRE(either.cardinality() == threes.cardinality() + 2);
+}
+
+TEST_CASE("LogStore session index matches SQL results", "[store][index]") {
+    std::string db_path = "/tmp/test_logs_index.db";
+    std::filesystem::remove(db_path);
+
+    const char* sources[] = {"client", "server"};
+    const char* categories[] = {"LogNet", "LogAI", "LogTemp"};
+    const char* instances[] = {"inst_a", "inst_b", "inst_c"};
+
+    {
+        LogStore store(db_path);
+        for (int i = 0; i < 600; i++) {
+            LogEntry entry;
+            entry.source = sources[i % 2];
+            entry.category = categories[i % 3];
+            entry.verbosity = static_cast<Verbosity>(1 + (i % 7));
+            entry.message = "Message " + std::to_string(i);
+            // Out-of-order timestamps exercise the sorted paging path
+            entry.timestamp = 1000.0 + ((i * 37) % 600);
+            entry.session_id = i < 100 ? "older" : "live";
+            entry.instance_id = instances[i % 3 == 0 ? 0 : (i % 5 == 0 ? 1 : 2)];
+            store.insert(entry);
+        }
+    }
+
+    // An archive store keeps no index and answers through SQL; a writable one
+    // indexes the latest session when it opens, and keeps it current
+    LogStore sql_store(db_path, {}, StoreRole::Archive);
+    LogStore indexed_store(db_path);
+    REQUIRE(indexed_store.session_index_loads() == 1);
+    LogEntry extra;
+    extra.source = "client";
+    extra.category = "LogNet";
+    extra.verbosity = Verbosity::Error;
+    extra.message = "Extra";
+    extra.timestamp = 1700.0;
+    extra.session_id = "live";
+    extra.instance_id = "inst_a";
+    indexed_store.insert(extra);
+
+    auto ids = [](const std::vector<LogEntry>& logs) {
+        std::vector<int64_t> result;
+        for (const auto& log : logs) result.push_back(log.id);
+        return result;
+    };
+
+    std::vector<LogFilter> filters(6);
+    filters[0].category = "LogNet";
+    filters[1].source = "server";
+    filters[1].min_verbosity = Verbosity::Warning;
+    filters[2].instance_id = "inst_b";
+    filters[2].category = "LogAI";
+    filters[3].since = 1100.0;
+    filters[3].until = 1300.0;
+    filters[3].limit = 20;
+    filters[3].offset = 5;
+    filters[4].category = "NoSuchCategory";
+    filters[5].session_id = "live";
+    filters[5].limit = 1000;
+
+    for (const auto& filter : filters) {
+        auto expected = ids(sql_store.query(filter));
+        auto actual = ids(indexed_store.query(filter));
+        REQUIRE(actual == expected);
+    }
+
+    std::filesystem::remove(db_path);
+}
+
+TEST_CASE("Sessions beyond the index limit are served from SQL, not reloaded per write", "[store][index]") {
+    std::string db_path = "/tmp/test_logs_index_sessions.db";
+    std::filesystem::remove(db_path);
+
+    LogStore store(db_path);
+    store.set_indexed_sessions(4);
+    LogStore sql_store(db_path, {}, StoreRole::Archive);
+
+    // Six sessions written round robin: the two least recent are evicted on
+    // every round, and must not be read back in on their next write
+    for (int round = 0; round < 50; round++) {
+        for (int s = 0; s < 6; s++) {
+            LogEntry entry;
+            entry.source = round % 2 ? "client" : "server";
+            entry.category = s % 2 ? "LogNet" : "LogAI";
+            entry.verbosity = round % 5 ? Verbosity::Log : Verbosity::Error;
+            entry.message = "Round " + std::to_string(round) + " of session " + std::to_string(s);
+            entry.timestamp = 1000.0 + round;
+            entry.session_id = "session_" + std::to_string(s);
+            store.insert(entry);
+        }
+    }
+    REQUIRE(store.session_index_loads() == 0);
+
+    auto ids = [](const std::vector<LogEntry>& logs) {
+        std::vector<int64_t> result;
+        for (const auto& log : logs) result.push_back(log.id);
+        return result;
+    };
+    for (int s = 0; s < 6; s++) {
+        LogFilter filter;
+        filter.session_id = "session_" + std::to_string(s);
+        filter.limit = 1000;
+        REQUIRE(ids(store.query(filter)).size() == 50);
+        REQUIRE(ids(store.query(filter)) == ids(sql_store.query(filter)));
+        filter.min_verbosity = Verbosity::Error;
+        filter.source = "server";
+        REQUIRE(ids(store.query(filter)) == ids(sql_store.query(filter)));
+        REQUIRE(ids(store.search("session", filter)) == ids(sql_store.search("session", filter)));
+    }
+
+    std::filesystem::remove(db_path);
+}
+
+TEST_CASE("LogStore in-memory search matches FTS5", "[store][index][search]") {
+    std::string db_path = "/tmp/test_logs_search_index.db";
+    std::filesystem::remove(db_path);
+
+    const char* messages[] = {
+        "Player 7 took damage from Enemy",
+        "Player died, respawning",
+        "Playing montage Attack_01",
+        "Enemy spawned at (10, 20)",
+        "player_123 healed for 25 damage",
+        "Connection lost: timeout after 30s",
+    };
+
+    {
+        LogStore store(db_path);
+        for (int i = 0; i < 120; i++) {
+            LogEntry entry;
+            entry.source = i % 2 ? "server" : "client";
+            entry.category = i % 3 ? "LogCombat" : "LogNet";
+            entry.verbosity = i % 4 ? Verbosity::Log : Verbosity::Error;
+            entry.message = messages[i % 6];
+            entry.timestamp = 1000.0 + i;
+            entry.session_id = "live";
+            entry.instance_id = "inst";
+            store.insert(entry);
+        }
+    }
+
+    LogStore sql_store(db_path, {}, StoreRole::Archive);
+    LogStore indexed_store(db_path);
+    LogEntry extra;
+    extra.source = "client";
+    extra.category = "LogCombat";
+    extra.message = "Player damage check";
+    extra.timestamp = 5000.0;
+    extra.session_id = "live";
+    extra.instance_id = "inst";
+    indexed_store.insert(extra);
+
+    auto ids = [](const std::vector<LogEntry>& logs) {
+        std::vector<int64_t> result;
+        for (const auto& log : logs) result.push_back(log.id);
+        return result;
+    };
+
+    REQUIRE(indexed_store.search("play*", LogFilter{}).size() == 81);
+
+    const char* queries[] = {
+        "player", "PLAYER damage", "play*", "enemy AND spawned", "damage OR died",
+        "\"player died\"", "player_123", "nothingmatches", "30s",
+    };
+
+    for (const char* query : queries) {
+        LogFilter filter;
+        filter.limit = 500;
+        REQUIRE(ids(indexed_store.search(query, filter)) == ids(sql_store.search(query, filter)));
+
+        filter.source = "server";
+        filter.category = "LogCombat";
+        REQUIRE(ids(indexed_store.search(query, filter)) == ids(sql_store.search(query, filter)));
+
+        LogFilter errors;
+        errors.min_verbosity = Verbosity::Error;
+        errors.limit = 5;
+        errors.offset = 2;
+        REQUIRE(ids(indexed_store.search(query, errors)) == ids(sql_store.search(query, errors)));
+    }
+
+    std::filesystem::remove(db_path);
+}
+
+TEST_CASE("SubstringMatcher finds matches at every offset", "[grep]") {
+    // Long enough to cross several 16- and 32-byte SIMD blocks
+    std::string base(100, '.');
+    for (size_t pos = 0; pos + 6 <= base.size(); pos++) {
+        std::string hay = base;
+        hay.replace(pos, 6, "0xBeEf");
+        REQUIRE(SubstringMatcher("0xBeEf", false).find(hay) == pos);
+        REQUIRE(SubstringMatcher("0XBEEF", true).find(hay) == pos);
+        REQUIRE_FALSE(SubstringMatcher("0XBEEF", false).matches(hay));
+    }
+    REQUIRE(SubstringMatcher("a", false).find("bbba") == 3);
+    REQUIRE_FALSE(SubstringMatcher("longer than haystack", false).matches("short"));
+}
+
+TEST_CASE("LogStore grep scans messages with filters", "[store][grep]") {
+    std::string db_path = "/tmp/test_logs_grep.db";
+    std::filesystem::remove(db_path);
+
+    {
+        LogStore store(db_path);
+        for (int i = 0; i < 300; i++) {
+            LogEntry entry;
+            entry.source = "client";
+            entry.category = i % 2 ? "LogStreaming" : "LogNet";
+            entry.message = i % 10 == 0
+                ? "Loading /Game/Maps/Arena_" + std::to_string(i) + ".umap took 12ms"
+                : "Actor " + std::to_string(i) + " ticked";
+            entry.timestamp = 1000.0 + i;
+            entry.session_id = "grep_session";
+            entry.instance_id = "inst";
+            store.insert(entry);
+        }
+    }
+
+    // SQL path: an archive store keeps no session index
+    LogFilter filter;
+    filter.limit = 5;
+    ScanResult sql_result;
+    {
+        LogStore archive(db_path, {}, StoreRole::Archive);
+        sql_result = archive.grep("/game/maps/", true, filter);
+        REQUIRE(sql_result.logs.size() == 5);
+        REQUIRE(sql_result.matched == 30);
+        REQUIRE(sql_result.logs[0].message == "Loading /Game/Maps/Arena_290.umap took 12ms");
+        REQUIRE_FALSE(sql_result.truncated);
+        REQUIRE(archive.grep("/game/maps/", false, filter).matched == 0);
+    }
+
+    // Indexed path: same answers from a writable store, which indexes the
+    // latest session when it opens
+    LogStore sql_store(db_path);
+    LogEntry extra;
+    extra.source = "client";
+    extra.category = "LogNet";
+    extra.message = "unrelated";
+    extra.timestamp = 100.0;
+    extra.session_id = "grep_session";
+    extra.instance_id = "inst";
+    sql_store.insert(extra);
+
+    auto indexed = sql_store.grep("/Game/Maps/", false, filter);
+    REQUIRE(indexed.matched == 30);
+    REQUIRE(indexed.logs[0].id == sql_result.logs[0].id);
+
+    filter.category = "LogStreaming";
+    REQUIRE(sql_store.grep("Maps", false, filter).matched == 0);
+
+    // Scan cap
+    LogFilter capped;
+    auto partial = sql_store.grep("Arena", false, capped, 50);
+    REQUIRE(partial.scanned == 50);
+    REQUIRE(partial.truncated);
+
+    // Batches big enough to split across the scan pool, run more than once
+    std::vector<LogEntry> bulk;
+    for (int i = 0; i < 40000; i++) {
+        LogEntry entry;
+        entry.source = "server";
+        entry.category = "LogBulk";
+        entry.message = i % 7 == 0 ? "Bulk marker " + std::to_string(i) : "Bulk row " + std::to_string(i);
+        entry.timestamp = 5000.0 + i;
+        entry.session_id = "bulk_session";
+        entry.instance_id = "inst";
+        bulk.push_back(entry);
+    }
+    sql_store.insert_batch(bulk);
+    LogFilter bulk_filter;
+    bulk_filter.category = "LogBulk";
+    bulk_filter.limit = 10000;   // More than match, so every batch is scanned
+    for (int round = 0; round < 3; round++) {
+        auto scan = sql_store.grep("marker", false, bulk_filter, 100000);
+        REQUIRE(scan.scanned == 40000);
+        REQUIRE(scan.matched == 5715);
+    }
+
+    std::filesystem::remove(db_path);
+}
+
+TEST_CASE("RegexMatcher agrees with std::regex", "[regex]") {
+    const std::vector<std::string> patterns = {
+        "Player_\\d+", "^Loaded .*\\.umap$", "took \\d{2,3}ms", "(spawn|despawn)ed", "\\bhit\\b",
+        "a(b|c)*d", "x?y+z", "[A-F0-9]{6}", "[^a-z ]+", "(?:ab)+c", "^$", "colou?r", "\\s\\w+\\s",
+        "(a*)*b", "err(or)?\\b", "[-.]", "\\Bing", "a{3}", "a{2,}b", ".*", "(a|ab)(c|bcd)(d*)",
+    };
+    const std::vector<std::string> texts = {
+        "", "Player_42 died", "Player_ died", "Loaded /Game/Maps/Arena.umap", "Loaded Arena.umapx",
+        "took 12ms", "took 1ms", "took 1234ms", "spawned and despawned", "hit by hitter", "abcbcd",
+        "xyyz", "yz", "0xBEEF12", "BEEF1", "AbC-12", "abababc", "color colour", "a b c", "aaaaaa",
+        "aab", "errors error", "err", "a.b", "playing", "ping", "abcd",
+    };
+
+    for (const auto& pattern : patterns) {
+        RegexMatcher regex(pattern);
+        std::regex reference(pattern);
+        for (const auto& text : texts) {
+            INFO(pattern << " on '" << text << "'");
+            REQUIRE(regex.matches(text) == std::regex_search(text, reference));
+        }
+    }
+
+    REQUIRE(RegexMatcher("PLAYER_\\d", true).matches("player_7"));
+    REQUIRE(RegexMatcher("[a-c]+X", true).matches("ABCx"));
+    REQUIRE_FALSE(RegexMatcher("PLAYER_\\d", false).matches("player_7"));
+
+    // Pathological for backtracking engines, linear here
+    REQUIRE_FALSE(RegexMatcher("(a+)+b").matches(std::string(5000, 'a')));
+
+    for (const char* bad : {"(ab", "ab)", "[abc", "*a", "a{5,2}", "\\1", "(?=a)", "\\q", "a{2000}"}) {
+        INFO(bad);
+        REQUIRE_THROWS_AS(RegexMatcher(bad), std::runtime_error);
+    }
+
+    // Nesting is limited rather than recursing until the stack runs out
+    auto nested = [](int depth) { return std::string(depth, '(') + "a" + std::string(depth, ')'); };
+    REQUIRE(RegexMatcher(nested(50)).matches("a"));
+    REQUIRE_THROWS_AS(RegexMatcher(nested(100000)), std::runtime_error);
+    REQUIRE_THROWS_AS(RegexMatcher(std::string(100000, '(')), std::runtime_error);
+    std::string stacked = "a";
+    for (int i = 0; i < 200; i++) stacked += "{1}";
+    REQUIRE_THROWS_AS(RegexMatcher(stacked), std::runtime_error);
+    std::string alternatives = "(?:x";
+    for (int i = 0; i < 200; i++) alternatives += "|(?:b)c";
+    REQUIRE(RegexMatcher(alternatives + ")").matches("bc"));   // Wide, not deep
+}
+
+TEST_CASE("RegexMatcher extracts required literals", "[regex]") {
+    RegexMatcher damage("Player_\\d+ took \\d+ damage from (rocket|grenade)");
+    REQUIRE(damage.required_literal() == " damage from ");
+    REQUIRE(damage.index_terms() == std::vector<std::string>{"took", "damage", "from"});
+
+    RegexMatcher repeated("x(ab){2,3}y");
+    REQUIRE(repeated.required_literal() == "xabab");
+
+    RegexMatcher folded("Loading (/GAME/Maps)", true);
+    REQUIRE(folded.required_literal() == "loading /game/maps");
+    REQUIRE(folded.index_terms() == std::vector<std::string>{"game", "maps*"});
+
+    REQUIRE(RegexMatcher("\\d+|\\w+").required_literal().empty());
+    REQUIRE(RegexMatcher("a?b*").index_terms().empty());
+}
+
+TEST_CASE("LogStore regex search matches a full scan", "[store][regex]") {
+    std::string db_path = "/tmp/test_logs_regex.db";
+    std::filesystem::remove(db_path);
+
+    {
+        LogStore store(db_path);
+        for (int i = 0; i < 400; i++) {
+            LogEntry entry;
+            entry.source = i % 3 ? "server" : "client";
+            entry.category = "LogCombat";
+            entry.message = "Player_" + std::to_string(i % 7) + " took " + std::to_string(i) +
+                            " damage from " + (i % 2 ? "rocket" : "grenade");
+            entry.timestamp = 1000.0 + i;
+            entry.session_id = "regex_session";
+            entry.instance_id = "inst";
+            store.insert(entry);
+        }
+    }
+
+    const std::string pattern = "Player_[35] took \\d*7 damage from rocket";
+    std::regex reference(pattern);
+
+    LogStore store(db_path);
+    LogFilter everything;
+    everything.limit = -1;
+    int expected = 0;
+    for (const auto& log : store.query(everything)) {
+        if (std::regex_search(log.message, reference)) expected++;
+    }
+    REQUIRE(expected > 0);
+
+    LogFilter filter;
+    filter.limit = 3;
+    auto sql_result = store.regex_search(pattern, false, filter);
+    REQUIRE(sql_result.matched == expected);
+    REQUIRE(sql_result.logs.size() == 3);
+    REQUIRE(sql_result.scanned == 200);  // Only "rocket" rows come back from FTS5
+    for (const auto& log : sql_result.logs) {
+        REQUIRE(std::regex_search(log.message, reference));
+    }
+
+    // Indexed path once the session is live in this store
+    LogEntry extra;
+    extra.source = "client";
+    extra.category = "LogCombat";
+    extra.message = "unrelated";
+    extra.timestamp = 10.0;
+    extra.session_id = "regex_session";
+    extra.instance_id = "inst";
+    store.insert(extra);
+
+    auto indexed = store.regex_search(pattern, false, filter);
+    REQUIRE(indexed.matched == expected);
+    REQUIRE(indexed.logs[0].id == sql_result.logs[0].id);
+
+    // Combined with an FTS query and a field filter
+    filter.source = "client";
+    auto combined = store.regex_search(pattern, true, filter, 100000, "rocket");
+    for (const auto& log : combined.logs) {
+        REQUIRE(log.source == "client");
+        REQUIRE(log.message.find("rocket") != std::string::npos);
+    }
+
+    REQUIRE_THROWS_AS(store.regex_search("(unclosed", false, filter), std::runtime_error);
+
+    std::filesystem::remove(db_path);
+}
+
+TEST_CASE("LogStore sql_query is read-only and bounded", "[store][sql]") {
+    std::string db_path = "/tmp/test_logs_sql.db";
+    std::filesystem::remove(db_path);
+
+    LogStore store(db_path);
+    for (int i = 0; i < 50; i++) {
+        LogEntry entry;
+        entry.source = "server";
+        entry.category = i % 5 == 0 ? "LogNet" : "LogTemp";
+        entry.verbosity = i % 10 == 0 ? Verbosity::Error : Verbosity::Log;
+        entry.message = "Tick " + std::to_string(i);
+        entry.timestamp = 1000.0 + i;
+        entry.session_id = "sql_session";
+        entry.instance_id = "inst";
+        store.insert(entry);
+    }
+
+    SECTION("Aggregates") {
+        auto result = store.sql_query(
+            "SELECT category, COUNT(*) AS n FROM logs GROUP BY category ORDER BY n DESC");
+        REQUIRE(result.columns == std::vector<std::string>{"category", "n"});
+        REQUIRE(result.rows.size() == 2);
+        REQUIRE(result.rows[0][0] == "LogTemp");
+        REQUIRE(result.rows[0][1] == 40);
+        REQUIRE_FALSE(result.truncated);
+
+        auto fts = store.sql_query("SELECT COUNT(*) FROM logs_fts WHERE logs_fts MATCH 'tick'");
+        REQUIRE(fts.rows[0][0] == 50);
+
+        // Allowlisted functions: dates, JSON, windows and FTS5 helpers
+        auto helpers = store.sql_query(
+            "SELECT strftime('%Y', timestamp, 'unixepoch'), json_object('n', COUNT(*)), "
+            "upper(substr(MAX(message), 1, 4)) FROM logs");
+        REQUIRE(helpers.rows[0][0] == "1970");
+        REQUIRE(helpers.rows[0][1] == "{\"n\":50}");
+        REQUIRE(helpers.rows[0][2] == "TICK");
+        auto ranked = store.sql_query(
+            "SELECT bm25(logs_fts) < 0, highlight(logs_fts, 0, '[', ']') FROM logs_fts "
+            "WHERE logs_fts MATCH 'tick' ORDER BY bm25(logs_fts) LIMIT 1");
+        REQUIRE(ranked.rows[0][0] == 1);
+        REQUIRE(ranked.rows[0][1].get<std::string>().rfind("[Tick]", 0) == 0);
+        auto windowed = store.sql_query(
+            "SELECT id, row_number() OVER (PARTITION BY category ORDER BY id) FROM logs ORDER BY id LIMIT 1");
+        REQUIRE(windowed.rows[0][1] == 1);
+    }
+
+    SECTION("Sees rows inserted after it was opened") {
+        LogEntry entry;
+        entry.source = "client";
+        entry.message = "late";
+        entry.session_id = "sql_session";
+        store.insert(entry);
+        REQUIRE(store.sql_query("SELECT COUNT(*) FROM logs").rows[0][0] == 51);
+    }
+
+    SECTION("Row cap") {
+        SqlLimits limits;
+        limits.max_rows = 7;
+        auto result = store.sql_query("SELECT id FROM logs", limits);
+        REQUIRE(result.rows.size() == 7);
+        REQUIRE(result.truncated);
+    }
+
+    SECTION("Rejects anything but reads of approved tables") {
+        for (const char* sql : {
+                 "DELETE FROM logs",
+                 "UPDATE logs SET message = 'x'",
+                 "DROP TABLE logs",
+                 "CREATE TABLE t(x)",
+                 "PRAGMA table_info(logs)",
+                 "ATTACH DATABASE '/tmp/other.db' AS other",
+                 "SELECT * FROM sqlite_sequence",
+                 "SELECT 1; DELETE FROM logs",
+                 "SELECT load_extension('/tmp/evil.so')",
+                 "SELECT fts5_source_id()",
+                 "SELECT sqlite_version()",
+                 "SELECT * FROM pragma_table_info('logs')",
+                 "SELECT length(randomblob(900000000))",
+                 "SELECT length(zeroblob(900000000))",
+             }) {
+            INFO(sql);
+            REQUIRE_THROWS_AS(store.sql_query(sql), std::runtime_error);
+        }
+        REQUIRE(store.count() == 50);
+    }
+
+    SECTION("Values built by a statement are capped") {
+        auto started = std::chrono::steady_clock::now();
+        try {
+            store.sql_query("SELECT length(replace(printf('%.*c', 1000000, 'x'), 'x', 'xxxxxxxxxx'))");
+            FAIL("10MB string was allowed");
+        } catch (const std::runtime_error& e) {
+            REQUIRE(std::string(e.what()).find("too big") != std::string::npos);
+        }
+        REQUIRE(std::chrono::steady_clock::now() - started < std::chrono::seconds(1));
+        REQUIRE(store.sql_query("SELECT length(printf('%.*c', 100000, 'x'))").rows[0][0] == 100000);
+    }
+
+    SECTION("Deadline interrupts runaway queries") {
+        SqlLimits limits;
+        limits.timeout_ms = 50;
+        try {
+            store.sql_query("SELECT COUNT(*) FROM logs a, logs b, logs c, logs d, logs e, logs f", limits);
+            FAIL("15 billion row join finished");
+        } catch (const std::runtime_error& e) {
+            REQUIRE(std::string(e.what()).find("time limit") != std::string::npos);
+        }
+
+        // The connection is still usable afterwards
+        REQUIRE(store.sql_query("SELECT COUNT(*) FROM logs").rows[0][0] == 50);
+    }
+
+    std::filesystem::remove(db_path);
+}
+
+TEST_CASE("normalize_message replaces numbers and hex IDs", "[similar]") {
+    REQUIRE(normalize_message("Player_12 hit 0x7ff3 for 3.5") == "Player_<N> hit <HEX> for <N>.<N>");
+    REQUIRE(normalize_message("Actor42 spawned at 3F2504E0") == "Actor<N> spawned at <HEX>");
+    REQUIRE(normalize_message("dead beef cafe") == "dead beef cafe");
+    REQUIRE(normalize_message("") == "");
+    REQUIRE(template_hash(normalize_message("took 5ms")) == template_hash(normalize_message("took 1234ms")));
+}
+
+TEST_CASE("LogStore find_similar clusters near-duplicates across sessions", "[store][similar]") {
+    std::string db_path = "/tmp/test_logs_similar.db";
+    std::filesystem::remove(db_path);
+
+    LogStore store(db_path);
+    auto add = [&store](const std::string& session, const std::string& message) {
+        LogEntry entry;
+        entry.source = "server";
+        entry.category = "LogCombat";
+        entry.message = message;
+        entry.session_id = session;
+        return store.insert(entry);
+    };
+
+    for (int i = 0; i < 30; i++) {
+        add(i % 3 ? "session_a" : "session_b",
+            "Player_" + std::to_string(i) + " took " + std::to_string(i * 7) + " damage from rocket");
+        add("session_a", "Tick " + std::to_string(i));
+    }
+    add("session_b", "Player_99 took 12 damage from rocket launcher splash");
+    int64_t probe = add("session_c", "Player_5 took 40 damage from rocket");
+
+    auto clusters = store.find_similar("Player_1234 took 1 damage from rocket");
+    REQUIRE(clusters.size() >= 1);
+    REQUIRE(clusters[0].template_text == "Player_<N> took <N> damage from rocket");
+    REQUIRE(clusters[0].similarity == 1.0);
+    REQUIRE(clusters[0].count == 31);
+    REQUIRE(clusters[0].sessions[0] == std::make_pair(std::string("session_a"), int64_t(20)));
+    REQUIRE(clusters[0].example_id == probe);
+
+    // The longer variant is close but not identical; "Tick" is unrelated
+    bool found_variant = false;
+    for (const auto& cluster : clusters) {
+        REQUIRE(cluster.template_text.find("Tick") == std::string::npos);
+        if (cluster.template_text.find("splash") != std::string::npos) {
+            found_variant = true;
+            REQUIRE(cluster.similarity < 1.0);
+        }
+    }
+    REQUIRE(found_variant);
+
+    // Fed on insert once built
+    add("session_d", "Player_1 took 2 damage from rocket");
+    REQUIRE(store.find_similar("Player_0 took 0 damage from rocket", 0.9)[0].count == 32);
+
+    REQUIRE(store.get_log(probe)->session_id == "session_c");
+    REQUIRE_FALSE(store.get_log(999999).has_value());
+
+    // After a clear the index is rebuilt off the store lock, and rows
+    // inserted while it builds are counted exactly once
+    store.clear();
+    std::vector<LogEntry> batch(20000);
+    for (size_t i = 0; i < batch.size(); i++) {
+        batch[i].source = "server";
+        batch[i].message = "Shard " + std::to_string(i) + " rebalanced";
+        batch[i].session_id = "session_e";
+    }
+    store.insert_batch(batch);
+    std::atomic<bool> stop{false};
+    std::atomic<int> inserted{0};
+    std::thread writer([&] {
+        while (!stop) {
+            add("session_e", "Shard " + std::to_string(inserted.load()) + " rebalanced");
+            inserted++;
+        }
+    });
+    REQUIRE(store.find_similar("Shard 1 rebalanced", 0.9)[0].count >= 20000);
+    while (inserted < 10) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    stop = true;
+    writer.join();
+    REQUIRE(store.similarity_index_loaded());
+    REQUIRE(store.find_similar("Shard 1 rebalanced", 0.9)[0].count == 20000 + inserted.load());
+
+    std::filesystem::remove(db_path);
+}
+
+TEST_CASE("LogStore session digests are live, then finalized", "[store][digest]") {
+    std::string db_path = "/tmp/test_logs_digest.db";
+    std::filesystem::remove(db_path);
+
+    {
+        LogStore store(db_path);
+        for (int i = 0; i < 100; i++) {
+            LogEntry entry;
+            entry.source = i % 4 ? "server" : "client";
+            entry.category = i % 2 ? "LogNet" : "LogAI";
+            entry.verbosity = i == 10 || i == 70 ? Verbosity::Error
+                            : i % 25 == 0 ? Verbosity::Warning : Verbosity::Log;
+            entry.message = "Tick " + std::to_string(i);
+            entry.timestamp = i < 50 ? 100.0 + i : 200.0 + i;   // 50s silence halfway
+            entry.received_at = 5000.0;
+            entry.session_id = "digest_session";
+            entry.instance_id = i % 4 ? "server-1" : "client-1";
+            store.insert(entry);
+        }
+
+        auto live = store.get_session_digest("latest");
+        REQUIRE(live.has_value());
+        REQUIRE((*live)["session_id"] == "digest_session");
+        REQUIRE((*live)["final"] == false);
+        REQUIRE((*live)["log_count"] == 100);
+        REQUIRE((*live)["by_category"]["LogNet"] == 50);
+        REQUIRE((*live)["by_source"]["client"] == 25);
+        REQUIRE((*live)["error_count"] == 2);
+        REQUIRE((*live)["warning_count"] == 4);
+        REQUIRE((*live)["first_error"]["message"] == "Tick 10");
+        REQUIRE((*live)["last_error"]["message"] == "Tick 70");
+        REQUIRE((*live)["top_templates"][0]["template"] == "Tick <N>");
+        REQUIRE((*live)["top_templates"][0]["count"] == 100);
+
+        int64_t timeline_total = 0;
+        for (const auto& count : (*live)["timeline"]["counts"]) timeline_total += count.get<int64_t>();
+        REQUIRE(timeline_total == 100);
+
+        for (const auto& inst : (*live)["instances"]) {
+            if (inst["instance_id"] == "server-1") {
+                REQUIRE(inst["largest_gap"].get<double>() > 100.0);
+                REQUIRE(inst["largest_gap_at"].get<double>() == 149.0);
+            }
+        }
+
+        // Not idle yet, then idle
+        store.finalize_idle_digests(5000.0 + 10);
+        REQUIRE((*store.get_session_digest("digest_session"))["final"] == false);
+        store.finalize_idle_digests(5000.0 + LogStore::kDigestIdleSeconds + 1);
+        auto final_digest = store.get_session_digest("digest_session");
+        REQUIRE((*final_digest)["final"] == true);
+        REQUIRE((*final_digest)["log_count"] == 100);
+
+        REQUIRE_FALSE(store.get_session_digest("no_such_session").has_value());
+    }
+
+    // Survives a restart, and new logs reopen it with the old rows included
+    LogStore reopened(db_path);
+    REQUIRE((*reopened.get_session_digest("digest_session"))["final"] == true);
+
+    LogEntry late;
+    late.source = "server";
+    late.category = "LogNet";
+    late.message = "Tick 100";
+    late.timestamp = 400.0;
+    late.session_id = "digest_session";
+    late.instance_id = "server-1";
+    reopened.insert(late);
+
+    auto reopened_digest = reopened.get_session_digest("digest_session");
+    REQUIRE((*reopened_digest)["final"] == false);
+    REQUIRE((*reopened_digest)["log_count"] == 101);
+
+    std::filesystem::remove(db_path);
+}
+
+TEST_CASE("AnomalyDetector flags spikes, new error templates and quiet instances", "[anomaly]") {
+    std::string db_path = "/tmp/test_logs_anomaly.db";
+    std::filesystem::remove(db_path);
+
+    LogStore store(db_path);
+    AnomalyDetector detector(store);
+
+    auto insert = [&](const std::string& instance, const std::string& category, Verbosity verbosity,
+                      const std::string& message, double received_at) {
+        LogEntry entry;
+        entry.source = "server";
+        entry.category = category;
+        entry.verbosity = verbosity;
+        entry.message = message;
+        entry.timestamp = received_at;
+        entry.received_at = received_at;
+        entry.session_id = "anomaly_session";
+        entry.instance_id = instance;
+        return store.insert(entry);
+    };
+
+    // Steady 5 logs per 10s bucket, then a burst in bucket 12
+    for (int bucket = 0; bucket < 12; bucket++) {
+        for (int i = 0; i < 5; i++) {
+            insert("server-1", "LogNet", Verbosity::Log, "Replicated actor " + std::to_string(i),
+                   1000.0 + bucket * 10 + i * 2);
+        }
+    }
+    REQUIRE(detector.total() == 0);
+
+    for (int i = 0; i < 200; i++) {
+        insert("server-1", "LogNet", Verbosity::Log, "Replicated actor " + std::to_string(i),
+               1120.0 + i * 0.04);
+    }
+
+    auto spikes = detector.get(0, "spike", 10);
+    REQUIRE(spikes.size() == 1);                     // Once per bucket, not once per log
+    REQUIRE(spikes[0].category == "LogNet");
+    REQUIRE(spikes[0].instance_id == "server-1");
+    REQUIRE(spikes[0].observed == 20.0);             // Flagged as soon as it crossed the threshold
+    REQUIRE(spikes[0].expected == 5.0);
+    REQUIRE(spikes[0].score > 4.0);
+
+    // Numbers don't make an error template new; a different shape does
+    insert("client-1", "LogAsset", Verbosity::Error, "Failed to load asset 12", 1125.0);
+    insert("client-1", "LogAsset", Verbosity::Error, "Failed to load asset 99", 1125.5);
+    int64_t socket_id = insert("client-1", "LogNet", Verbosity::Error, "Socket closed by peer", 1126.0);
+    insert("client-1", "LogAsset", Verbosity::Warning, "Slow asset load", 1126.5);
+
+    auto templates = detector.get(0, "new_error_template", 10);
+    REQUIRE(templates.size() == 2);
+    REQUIRE(templates[0].example_id == socket_id);   // Newest first
+    REQUIRE(templates[1].detail.find("Failed to load asset <N>") != std::string::npos);
+
+    // server-1 stopped logging at ~1128; client-1 never had a rate worth watching
+    detector.tick(1160.0);
+    REQUIRE(detector.get(0, "quiet_instance", 10).empty());
+    detector.tick(1200.0);
+    detector.tick(1300.0);
+    auto quiet = detector.get(0, "quiet_instance", 10);
+    REQUIRE(quiet.size() == 1);
+    REQUIRE(quiet[0].instance_id == "server-1");
+    REQUIRE(quiet[0].observed >= 60.0);
+
+    // Paging
+    REQUIRE(detector.total() == 4);
+    REQUIRE(detector.get(0, "", 10).size() == 4);
+    REQUIRE(detector.get(quiet[0].id - 1, "", 10).size() == 1);
+    REQUIRE(detector.latest()->type == "quiet_instance");
+
+    // Logging again re-arms it
+    insert("server-1", "LogNet", Verbosity::Log, "Replicated actor 1", 1305.0);
+
+    // The background timer notices the silence without further logs or calls
+    std::atomic<double> now{1306.0};
+    detector.start_ticking(std::chrono::milliseconds(5), [&now] { return now.load(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    REQUIRE(detector.get(0, "quiet_instance", 10).size() == 1);
+    now = 1500.0;
+    for (int i = 0; i < 400 && detector.get(0, "quiet_instance", 10).size() < 2; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    detector.stop_ticking();
+    REQUIRE(detector.get(0, "quiet_instance", 10).size() == 2);
+
+    std::filesystem::remove(db_path);
+}
+
+TEST_CASE("RuleEngine fires on predicates and sliding windows", "[rules]") {
+    std::string db_path = "/tmp/test_logs_rules.db";
+    std::filesystem::remove(db_path);
+
+    LogStore store(db_path);
+    RuleEngine engine(store);
+
+    std::vector<RuleMatch> pushed;
+    engine.on_match([&pushed](const RuleMatch& match) { pushed.push_back(match); });
+
+    auto fatal = engine.add_rule(TriggerRule::from_json({{"name", "any fatal"}, {"verbosity", "Fatal"}}));
+    auto storm = engine.add_rule(TriggerRule::from_json({
+        {"verbosity", "Error"}, {"category", "LogNet"}, {"threshold", 5}, {"window_seconds", 10.0}
+    }));
+    auto ensure = engine.add_rule(TriggerRule::from_json({
+        {"regex", "ensure.*inventory_[0-9]+"}, {"ignore_case", true}, {"cooldown_seconds", 60.0}
+    }));
+    REQUIRE(fatal.id != storm.id);
+    REQUIRE(storm.name == storm.id);
+
+    auto insert = [&](Verbosity verbosity, const std::string& category, const std::string& message,
+                      double received_at) {
+        LogEntry entry;
+        entry.source = "server";
+        entry.category = category;
+        entry.verbosity = verbosity;
+        entry.message = message;
+        entry.timestamp = received_at;
+        entry.received_at = received_at;
+        entry.session_id = "rules_session";
+        entry.instance_id = "server-1";
+        return store.insert(entry);
+    };
+
+    // Errors 3s apart never put 5 inside a 10s window
+    for (int i = 0; i < 10; i++) insert(Verbosity::Error, "LogNet", "Timeout", 100.0 + i * 3);
+    REQUIRE(pushed.empty());
+
+    // A burst does, once per 5 matches; Fatal counts as Error too
+    for (int i = 0; i < 9; i++) insert(Verbosity::Error, "LogNet", "Timeout", 200.0 + i * 0.5);
+    int64_t fatal_id = insert(Verbosity::Fatal, "LogNet", "Assertion failed", 205.0);
+    REQUIRE(pushed.size() == 3);
+    REQUIRE(pushed[0].rule_id == storm.id);
+    REQUIRE(pushed[0].window_count == 5);
+    REQUIRE(pushed[1].rule_id == fatal.id);
+    REQUIRE(pushed[1].entry.id == fatal_id);
+    REQUIRE(pushed[2].rule_id == storm.id);   // 9 errors + the Fatal complete the second window
+
+    // Other categories and verbosities don't count
+    for (int i = 0; i < 10; i++) insert(Verbosity::Warning, "LogNet", "Slow", 300.0);
+    for (int i = 0; i < 10; i++) insert(Verbosity::Error, "LogAI", "Stuck", 300.0);
+    REQUIRE(pushed.size() == 3);
+
+    // Regex rule, with its cooldown suppressing the repeat
+    insert(Verbosity::Log, "LogGame", "Ensure condition failed: Inventory_12 != null", 400.0);
+    insert(Verbosity::Log, "LogGame", "Ensure condition failed: Inventory_13 != null", 410.0);
+    insert(Verbosity::Log, "LogGame", "Ensure condition failed: Inventory != null", 470.0);
+    insert(Verbosity::Log, "LogGame", "ENSURE condition failed: INVENTORY_14", 470.0);
+    REQUIRE(pushed.size() == 5);
+    REQUIRE(pushed[3].rule_id == ensure.id);
+    REQUIRE(pushed[4].fired_at == 470.0);
+
+    auto statuses = engine.rules();
+    REQUIRE(statuses.size() == 3);
+    REQUIRE(statuses[1].matched == 20);
+    REQUIRE(statuses[1].fired == 2);
+    REQUIRE(statuses[2].matched == 3);
+    REQUIRE(statuses[2].fired == 2);
+
+    // Polling API mirrors the pushes, newest first
+    auto recent = engine.matches(0, 100);
+    REQUIRE(recent.size() == 5);
+    REQUIRE(recent[0].id == pushed[4].id);
+    REQUIRE(engine.matches(pushed[3].id, 100).size() == 1);
+
+    REQUIRE(engine.remove_rule(fatal.id));
+    REQUIRE_FALSE(engine.remove_rule(fatal.id));
+    insert(Verbosity::Fatal, "LogCore", "Crash", 500.0);
+    REQUIRE(pushed.size() == 5);
+
+    // Invalid rules are rejected up front
+    REQUIRE_THROWS(TriggerRule::from_json({{"name", "no conditions"}}));
+    REQUIRE_THROWS(TriggerRule::from_json({{"verbosity", "Loud"}}));
+    REQUIRE_THROWS(TriggerRule::from_json({{"category", "LogNet"}, {"threshold", 0}}));
+    REQUIRE_THROWS(engine.add_rule(TriggerRule::from_json({{"regex", "(unclosed"}})));
+
+    // Regexes the prefilter can't narrow would run the NFA on every insert
+    try {
+        engine.add_rule(TriggerRule::from_json({{"regex", "[0-9]+"}, {"verbosity", "Error"}}));
+        FAIL("unnarrowed regex was accepted");
+    } catch (const std::runtime_error& e) {
+        REQUIRE(std::string(e.what()).find("literal") != std::string::npos);
+    }
+    REQUIRE_NOTHROW(engine.add_rule(TriggerRule::from_json({{"regex", "[0-9]+"}, {"category", "LogNet"}})));
+
+    // Compiled regex size is capped across rules, and removing a rule frees its share
+    std::vector<std::string> big_ids;
+    std::string big_regex = "Timeout (a|b|c|d)[0-9a-f]{1000}";
+    try {
+        for (size_t i = 0; i < RuleEngine::kMaxRules; i++) {
+            big_ids.push_back(engine.add_rule(TriggerRule::from_json({{"regex", big_regex}})).id);
+        }
+        FAIL("regex budget was never reached");
+    } catch (const std::runtime_error& e) {
+        REQUIRE(std::string(e.what()).find("too large in total") != std::string::npos);
+    }
+    REQUIRE_FALSE(big_ids.empty());
+    REQUIRE(big_ids.size() < 100);
+    REQUIRE(engine.remove_rule(big_ids.back()));
+    REQUIRE_NOTHROW(engine.add_rule(TriggerRule::from_json({{"regex", big_regex}})));
+
+    std::filesystem::remove(db_path);
+}
+
+TEST_CASE("QueryScheduler estimates cost and admits fairly", "[scheduler]") {
+    std::string db_path = "/tmp/test_logs_scheduler.db";
+    std::filesystem::remove(db_path);
+
+    LogStore store(db_path);
+    for (int i = 0; i < 300; i++) {
+        LogEntry entry;
+        entry.source = "server";
+        entry.category = "LogTemp";
+        entry.message = "Row " + std::to_string(i);
+        entry.timestamp = 1000.0 + i;
+        entry.session_id = i < 100 ? "old_session" : "new_session";
+        entry.instance_id = "server-1";
+        store.insert(entry);
+    }
+
+    LogFilter latest;
+    LogFilter all;
+    all.all_sessions = true;
+    LogFilter old_session;
+    old_session.session_id = "old_session";
+    REQUIRE(store.estimate_rows(latest) == 200);
+    REQUIRE(store.estimate_rows(all) == 300);
+    REQUIRE(store.estimate_rows(old_session) == 100);
+
+    QuerySchedulerOptions options;
+    options.heavy_slots = 1;
+    options.heavy_rows = 150;
+    options.max_queued_per_session = 2;
+    options.max_wait = std::chrono::milliseconds(5000);
+    QueryScheduler scheduler(store, options);
+
+    SECTION("Cost model") {
+        REQUIRE(scheduler.estimate("tail_logs", {{"count", 100}}).lane == QueryLane::Fast);
+        REQUIRE(scheduler.estimate("tail_logs", {{"count", 500}}).rows == 200);
+        REQUIRE(scheduler.estimate("query_logs", {{"all_sessions", true}}).lane == QueryLane::Fast);
+        REQUIRE(scheduler.estimate("query_logs", {{"all_sessions", true}, {"category", "LogTemp"}}).lane == QueryLane::Heavy);
+        REQUIRE(scheduler.estimate("grep_logs", {{"pattern", "Row"}}).lane == QueryLane::Heavy);
+        REQUIRE(scheduler.estimate("grep_logs", {{"pattern", "Row"}, {"max_scan", 50}}).lane == QueryLane::Fast);
+        REQUIRE(scheduler.estimate("grep_logs", {{"pattern", "Row"}, {"session_id", "old_session"}}).rows == 100);
+        REQUIRE(scheduler.estimate("search_logs", {{"query", "Row"}}).lane == QueryLane::Fast);
+        REQUIRE(scheduler.estimate("search_logs", {{"regex", "Row [0-9]+"}}).lane == QueryLane::Heavy);
+        REQUIRE(scheduler.estimate("sql_query", {{"sql", "SELECT 1"}}).lane == QueryLane::Heavy);
+        REQUIRE(scheduler.estimate("get_anomalies", nlohmann::json::object()).rows == 0);
+
+        // Cheap sub-requests can add up to a heavy multi_query
+        nlohmann::json requests = nlohmann::json::array({
+            {{"tool", "tail_logs"}, {"arguments", {{"count", 100}}}},
+            {{"tool", "grep_logs"}, {"arguments", {{"pattern", "Row"}, {"max_scan", 50}}}}
+        });
+        auto multi = scheduler.estimate("multi_query", {{"requests", requests}});
+        REQUIRE(multi.rows == 150);
+        REQUIRE(multi.lane == QueryLane::Heavy);
+
+        // Sub-requests multi_query would reject, nested ones included, cost nothing
+        nlohmann::json rejected = nlohmann::json::array({
+            {{"tool", "sql_query"}, {"arguments", {{"sql", "SELECT 1"}}}},
+            {{"tool", "multi_query"}, {"arguments", {{"requests", requests}}}},
+            {{"tool", "find_similar"}, {"arguments", {{"message", "Row 1"}}}},
+            {{"tool", "tail_logs"}, {"arguments", {{"count", 10}}}}
+        });
+        REQUIRE(scheduler.estimate("multi_query", {{"requests", rejected}}).rows == 10);
+
+        // Scans together cost no more than the batch's max_scan
+        nlohmann::json grep = {{"pattern", "Row"}, {"all_sessions", true}};
+        int64_t one_grep = scheduler.estimate("grep_logs", grep).rows;
+        REQUIRE(one_grep > 30);
+        nlohmann::json scans = nlohmann::json::array({
+            {{"tool", "grep_logs"}, {"arguments", grep}},
+            {{"tool", "search_logs"}, {"arguments", {{"regex", "Row [0-9]+"}, {"all_sessions", true}}}},
+            {{"tool", "tail_logs"}, {"arguments", {{"count", 10}}}}
+        });
+        REQUIRE(scheduler.estimate("multi_query", {{"requests", scans}, {"max_scan", 30}}).rows == 40);
+    }
+
+    SECTION("Heavy lane is capped, fast lane is not blocked, sessions take turns") {
+        auto hold = std::make_unique<QueryScheduler::Admission>(
+            scheduler.admit("agent_a", scheduler.estimate("sql_query", {{"sql", "SELECT 1"}})));
+        REQUIRE(scheduler.stats(QueryLane::Heavy).running == 1);
+
+        std::mutex order_mutex;
+        std::vector<std::string> order;
+        auto heavy = scheduler.estimate("grep_logs", {{"pattern", "Row"}, {"all_sessions", true}});
+        auto wait_queued = [&](size_t n) {
+            while (scheduler.stats(QueryLane::Heavy).queued < n) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        };
+
+        std::vector<std::thread> threads;
+        auto run = [&](const std::string& session, const std::string& label) {
+            threads.emplace_back([&, session, label] {
+                auto admission = scheduler.admit(session, heavy);
+                std::lock_guard<std::mutex> lock(order_mutex);
+                order.push_back(label);
+            });
+        };
+        run("agent_b", "b1");
+        wait_queued(1);
+        run("agent_b", "b2");
+        wait_queued(2);
+        run("agent_c", "c1");
+        wait_queued(3);
+
+        // agent_b already has two waiting
+        REQUIRE_THROWS(scheduler.admit("agent_b", heavy));
+
+        // Cheap calls go straight through
+        {
+            auto fast = scheduler.admit("agent_b", scheduler.estimate("tail_logs", nlohmann::json::object()));
+            REQUIRE(fast.lane() == QueryLane::Fast);
+            REQUIRE(fast.queue_seconds() == 0.0);
+        }
+
+        hold.reset();
+        for (auto& t : threads) t.join();
+
+        REQUIRE(order == std::vector<std::string>{"b1", "c1", "b2"});
+        auto heavy_stats = scheduler.stats(QueryLane::Heavy);
+        REQUIRE(heavy_stats.running == 0);
+        REQUIRE(heavy_stats.queued == 0);
+        REQUIRE(heavy_stats.admitted == 4);
+        REQUIRE(heavy_stats.rejected == 1);
+
+        std::string metrics = Metrics::render();
+        REQUIRE(metrics.find("mcp_query_queue_seconds_bucket{lane=\"heavy\",le=\"+Inf\"}") != std::string::npos);
+        REQUIRE(metrics.find("mcp_query_run_seconds_count{lane=\"heavy\",tool=\"grep_logs\"} 3") != std::string::npos);
+    }
+
+    SECTION("submit() queues calls without holding the caller") {
+        auto hold = std::make_unique<QueryScheduler::Admission>(
+            scheduler.admit("agent_a", scheduler.estimate("sql_query", {{"sql", "SELECT 1"}})));
+        auto heavy = scheduler.estimate("grep_logs", {{"pattern", "Row"}, {"all_sessions", true}});
+
+        std::vector<std::string> order;
+        std::vector<QueryScheduler::Admission> running;
+        std::vector<std::string> errors;
+        auto submit = [&](const std::string& session, const std::string& label) {
+            scheduler.submit(session, heavy,
+                [&, label](QueryScheduler::Admission admission) {
+                    order.push_back(label);
+                    running.push_back(std::move(admission));
+                },
+                [&](const std::string& error) { errors.push_back(error); });
+        };
+        submit("agent_b", "b1");
+        submit("agent_b", "b2");
+        submit("agent_b", "b3");   // Over max_queued_per_session
+        submit("agent_c", "c1");
+        REQUIRE(order.empty());
+        REQUIRE(errors.size() == 1);
+        REQUIRE(scheduler.stats(QueryLane::Heavy).queued == 3);
+
+        // Each freed slot goes to the next session in turn
+        auto finish = [&] {
+            auto done = std::move(running);   // Releasing grants the next call, which joins running
+            running.clear();
+            done.clear();
+        };
+        hold.reset();
+        REQUIRE(order == std::vector<std::string>{"b1"});
+        finish();
+        REQUIRE(order == std::vector<std::string>{"b1", "c1"});
+        finish();
+        REQUIRE(order == std::vector<std::string>{"b1", "c1", "b2"});
+        finish();
+        REQUIRE(scheduler.stats(QueryLane::Heavy).running == 0);
+    }
+
+    SECTION("Waiting too long is rejected") {
+        QuerySchedulerOptions quick = options;
+        quick.max_wait = std::chrono::milliseconds(20);
+        QueryScheduler impatient(store, quick);
+
+        auto cost = impatient.estimate("sql_query", {{"sql", "SELECT 1"}});
+        bool granted = false;
+        std::string error;
+        {
+            auto hold = impatient.admit("agent_a", cost);
+            REQUIRE_THROWS(impatient.admit("agent_b", cost));
+            REQUIRE(impatient.stats(QueryLane::Heavy).queued == 0);
+            REQUIRE(impatient.stats(QueryLane::Heavy).rejected == 1);
+
+            // Submitted calls are rejected once a release finds them expired
+            impatient.submit("agent_b", cost, [&](QueryScheduler::Admission) { granted = true; },
+                             [&](const std::string& e) { error = e; });
+            std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        }
+        REQUIRE_FALSE(granted);
+        REQUIRE(error.find("Timed out") != std::string::npos);
+        REQUIRE(impatient.stats(QueryLane::Heavy).queued == 0);
+        REQUIRE(impatient.stats(QueryLane::Heavy).rejected == 2);
+    }
+
+    std::filesystem::remove(db_path);
+}
+
+TEST_CASE("WorkStealingPool runs keyed tasks in order and spreads the rest", "[executor]") {
+    WorkStealingPool pool(4);
+    REQUIRE(pool.thread_count() == 4);
+
+    SECTION("Tasks with the same key run one at a time, in order") {
+        constexpr int kKeys = 8;
+        constexpr int kTasks = 200;
+        std::vector<std::vector<int>> seen(kKeys);
+        std::vector<std::atomic<int>> running(kKeys);
+        std::atomic<bool> overlapped{false};
+
+        for (int i = 0; i < kTasks; i++) {
+            for (int k = 0; k < kKeys; k++) {
+                pool.submit_ordered("session_" + std::to_string(k), [&, k, i] {
+                    if (running[k]++ != 0) overlapped = true;
+                    seen[k].push_back(i);
+                    running[k]--;
+                });
+            }
+        }
+        pool.wait_idle();
+
+        REQUIRE_FALSE(overlapped);
+        for (int k = 0; k < kKeys; k++) {
+            REQUIRE(seen[k].size() == static_cast<size_t>(kTasks));
+            REQUIRE(std::is_sorted(seen[k].begin(), seen[k].end()));
+        }
+    }
+
+    SECTION("Nested submits and stealing") {
+        std::atomic<int> done{0};
+        for (int i = 0; i < 500; i++) {
+            pool.submit([&] {
+                done++;
+                pool.submit([&] {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    done++;
+                });
+            });
+        }
+        pool.wait_idle();
+        REQUIRE(done == 1000);
+    }
+
+    SECTION("A throwing task doesn't stop its strand") {
+        std::vector<int> seen;
+        pool.submit_ordered("s", [] { throw std::runtime_error("boom"); });
+        pool.submit_ordered("s", [&] { seen.push_back(1); });
+        pool.wait_idle();
+        REQUIRE(seen == std::vector<int>{1});
+    }
+
+    SECTION("A key's queue is bounded when asked") {
+        std::mutex gate;
+        std::unique_lock<std::mutex> hold(gate);
+        std::atomic<int> ran{0};
+        auto task = [&] {
+            std::lock_guard<std::mutex> wait(gate);
+            ran++;
+        };
+        for (int i = 0; i < 3; i++) REQUIRE(pool.submit_ordered("busy", task, 3));   // One running, two queued
+        REQUIRE_FALSE(pool.submit_ordered("busy", task, 3));
+        REQUIRE(pool.submit_ordered("other", [&] { ran++; }, 3));   // Other keys are unaffected
+        hold.unlock();
+        pool.wait_idle();
+        REQUIRE(ran == 4);
+        REQUIRE(pool.submit_ordered("busy", task, 3));   // Drained, so accepted again
+        pool.wait_idle();
+    }
+
+    SECTION("wait_idle sees every task from concurrent producers") {
+        std::atomic<int> ran{0};
+        for (int round = 0; round < 20; round++) {
+            std::vector<std::thread> producers;
+            for (int p = 0; p < 4; p++) {
+                producers.emplace_back([&] {
+                    for (int i = 0; i < 250; i++) pool.submit([&] { ran++; });
+                });
+            }
+            for (auto& t : producers) t.join();
+            pool.wait_idle();
+            REQUIRE(ran == (round + 1) * 1000);
+        }
+    }
+}
+
+TEST_CASE("LogStore insert_batch commits in one transaction", "[store][batch]") {
+    std::string db_path = "/tmp/test_batch.db";
+    std::filesystem::remove(db_path);
+    LogStore store(db_path);
+
+    std::vector<int64_t> notified;
+    store.subscribe([&](const LogEntry& entry) { notified.push_back(entry.id); });
+
+    std::vector<LogEntry> batch;
+    for (int i = 0; i < 50; i++) {
+        LogEntry entry;
+        entry.category = i % 2 ? "LogNet" : "LogTemp";
+        entry.message = "Batched " + std::to_string(i);
+        entry.session_id = "batch";
+        batch.push_back(entry);
+    }
+
+    auto ids = store.insert_batch(batch);
+    REQUIRE(ids.size() == 50);
+    REQUIRE(std::is_sorted(ids.begin(), ids.end()));
+    REQUIRE(notified == ids);
+    REQUIRE(store.insert_batch({}).empty());
+
+    // Indexes see batched rows like single inserts
+    LogFilter filter;
+    filter.session_id = "batch";
+    filter.category = "LogNet";
+    filter.limit = 100;
+    REQUIRE(store.query(filter).size() == 25);
+    REQUIRE(store.estimate_rows(filter) == 50);
+
+    // The batch opens a new session: its digest counts every row once
+    auto digest = store.get_session_digest("batch");
+    REQUIRE(digest);
+    REQUIRE((*digest)["log_count"] == 50);
+
+    int64_t next = store.insert(batch[0]);
+    REQUIRE(next == ids.back() + 1);
+}
+
+#ifdef MCP_LOGS_COROUTINES
+TEST_CASE("IngestPipeline batches logs in order with backpressure", "[ingest]") {
+    std::string db_path = "/tmp/test_ingest.db";
+    std::filesystem::remove(db_path);
+    LogStore store(db_path);
+
+    std::vector<std::string> seen;
+    store.subscribe([&](const LogEntry& entry) { seen.push_back(entry.message); });
+
+    SECTION("Submitted entries") {
+        IngestPipelineOptions options;
+        options.queue_capacity = 16;   // Far below the load, so producers block
+        options.batch_size = 64;
+        IngestPipeline pipeline(store, options);
+        pipeline.start();
+
+        int rejected = 0;
+        std::thread producer([&] {
+            for (int i = 0; i < 2000; i++) {
+                LogEntry entry;
+                entry.category = "LogTemp";
+                entry.message = "Submitted " + std::to_string(i);
+                if (!pipeline.submit(entry)) rejected++;
+            }
+        });
+        producer.join();
+        pipeline.stop();
+
+        REQUIRE(rejected == 0);
+
+        auto stats = pipeline.stats();
+        REQUIRE(stats.committed == 2000);
+        REQUIRE(stats.batches < 2000);
+        REQUIRE(seen.size() == 2000);
+        REQUIRE(seen.front() == "Submitted 0");
+        REQUIRE(seen.back() == "Submitted 1999");
+        REQUIRE_FALSE(pipeline.submit(LogEntry{}));
+    }
+
+    SECTION("UDP datagrams") {
+        constexpr uint16_t kPort = 52987;
+        IngestPipeline pipeline(store);
+        pipeline.listen_udp(kPort);
+        pipeline.start();
+
+        asio::io_context io;
+        asio::ip::udp::socket sender(io, asio::ip::udp::v4());
+        asio::ip::udp::endpoint target(asio::ip::make_address("127.0.0.1"), kPort);
+        sender.send_to(asio::buffer(std::string("not json")), target);
+        for (int i = 0; i < 100; i++) {
+            nlohmann::json log = {{"category", "LogNet"}, {"verbosity", "Log"},
+                                  {"message", "Datagram " + std::to_string(i)}};
+            sender.send_to(asio::buffer(log.dump()), target);
+        }
+
+        for (int wait = 0; wait < 200 && pipeline.stats().committed < 100; wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        pipeline.stop();
+
+        REQUIRE(pipeline.stats().parse_errors == 1);
+        REQUIRE(pipeline.stats().committed == 100);
+        REQUIRE(seen.front() == "Datagram 0");
+        REQUIRE(seen.back() == "Datagram 99");
+    }
+}
+#endif
+
+TEST_CASE("Compressor negotiates and streams gzip", "[compression]") {
+    SECTION("Accept-Encoding negotiation") {
+        REQUIRE(negotiate_encoding("") == ContentEncoding::Identity);
+        REQUIRE(negotiate_encoding("br, deflate") == ContentEncoding::Identity);
+        REQUIRE(negotiate_encoding("gzip;q=0") == ContentEncoding::Identity);
+        REQUIRE(negotiate_encoding("x-gzip") == ContentEncoding::Gzip);
+        REQUIRE(negotiate_encoding("GZIP ; q=0.5, identity") == ContentEncoding::Gzip);
+        REQUIRE(negotiate_encoding("*;q=0") == ContentEncoding::Identity);
+
+        auto zstd_or_gzip = zstd_supported() ? ContentEncoding::Zstd : ContentEncoding::Gzip;
+        REQUIRE(negotiate_encoding("gzip, deflate, zstd") == zstd_or_gzip);
+        REQUIRE(negotiate_encoding("*") == zstd_or_gzip);
+        REQUIRE(negotiate_encoding("zstd;q=0.1, gzip") == ContentEncoding::Gzip);
+    }
+
+    // Inflate whatever has arrived so far, without waiting for the end of stream
+    z_stream zs{};
+    REQUIRE(inflateInit2(&zs, 15 + 32) == Z_OK);
+    auto inflate_some = [&zs](const std::string& in) {
+        std::string out;
+        char buffer[4096];
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+        zs.avail_in = static_cast<uInt>(in.size());
+        int rc;
+        do {
+            zs.next_out = reinterpret_cast<Bytef*>(buffer);
+            zs.avail_out = sizeof(buffer);
+            rc = inflate(&zs, Z_SYNC_FLUSH);
+            out.append(buffer, sizeof(buffer) - zs.avail_out);
+        } while (rc == Z_OK && (zs.avail_in > 0 || zs.avail_out == 0));
+        return out;
+    };
+
+    SECTION("flush() makes every SSE event decodable as soon as it's sent") {
+        Compressor compressor(ContentEncoding::Gzip);
+        size_t raw = 0, sent = 0;
+        for (int i = 0; i < 50; i++) {
+            std::string event = "event: message\ndata: {\"jsonrpc\":\"2.0\",\"id\":" +
+                                std::to_string(i) + ",\"result\":{\"logs\":[]}}\n\n";
+            std::string wire = compressor.flush(event);
+            REQUIRE(inflate_some(wire) == event);
+            raw += event.size();
+            sent += wire.size();
+        }
+        // The shared window pays off across events
+        REQUIRE(sent < raw / 2);
+    }
+
+    SECTION("compress() produces complete bodies and resets the context") {
+        Compressor compressor(ContentEncoding::Gzip);
+        std::string body(8192, 'x');
+        for (int i = 0; i < 3; i++) {
+            std::string encoded = compressor.compress(body);
+            REQUIRE(encoded.size() < body.size());
+            REQUIRE(inflate_some(encoded) == body);
+            REQUIRE(inflateReset(&zs) == Z_OK);
+        }
+    }
+
+    inflateEnd(&zs);
+}
+
+TEST_CASE("LogStore read_snapshot holds inserts until its reads finish", "[store][snapshot]") {
+    std::string db_path = "/tmp/test_snapshot.db";
+    std::filesystem::remove(db_path);
+    LogStore store(db_path);
+
+    auto make_entry = [](int i) {
+        LogEntry entry;
+        entry.category = "LogTemp";
+        entry.verbosity = i % 5 == 0 ? Verbosity::Error : Verbosity::Log;
+        entry.message = "Snapshot row " + std::to_string(i);
+        entry.session_id = "snap";
+        return entry;
+    };
+    for (int i = 0; i < 100; i++) store.insert(make_entry(i));
+
+    std::atomic<bool> inserted{false};
+    std::thread writer;
+    int64_t total_before = 0, total_after = 0;
+    size_t errors = 0, found = 0;
+
+    store.read_snapshot([&] {
+        total_before = store.get_stats().total_count;
+
+        // An insert from another thread waits for the snapshot to end
+        writer = std::thread([&] {
+            store.insert(make_entry(100));
+            inserted = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        LogFilter filter;
+        filter.min_verbosity = Verbosity::Error;
+        filter.limit = 1000;
+        errors = store.query(filter).size();
+        found = store.grep("Snapshot row", false, LogFilter{}, 0).matched;
+        store.read_snapshot([&] { total_after = store.count(); });   // Nesting is allowed
+        REQUIRE_FALSE(inserted);
+    });
+    writer.join();
+
+    REQUIRE(total_before == 100);
+    REQUIRE(total_after == 100);
+    REQUIRE(errors == 20);
+    REQUIRE(found == 100);
+    REQUIRE(inserted);
+    REQUIRE(store.count() == 101);
+
+    // A throwing reader still releases the store
+    REQUIRE_THROWS(store.read_snapshot([] { throw std::runtime_error("boom"); }));
+    REQUIRE(store.insert(make_entry(101)) > 0);
+}
+
+TEST_CASE("Storage profiles apply and autotune picks settings", "[storage]") {
+    std::string db_path = "/tmp/test_storage.db";
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(db_path + suffix);
+
+    REQUIRE_FALSE(storage_profile("huge"));
+    for (const auto& name : storage_profile_names()) {
+        REQUIRE(storage_profile(name));
+    }
+
+    SECTION("A new database gets the profile; an existing one keeps its page size") {
+        auto profile = *storage_profile("large-ssd");
+        {
+            LogStore store(db_path, profile);
+            const auto& applied = store.storage_settings();
+            REQUIRE(applied.profile == "large-ssd");
+            REQUIRE(applied.page_size == 8192);
+            REQUIRE(applied.cache_bytes == profile.cache_bytes);
+            REQUIRE(applied.temp_store_memory);
+            REQUIRE(applied.wal_autocheckpoint == 10000);
+            REQUIRE(applied.mmap_bytes <= profile.mmap_bytes);   // Clamped to SQLite's maximum
+
+            LogEntry entry;
+            entry.message = "Stored with large-ssd";
+            store.insert(entry);
+            REQUIRE(store.sql_query("SELECT count(*) FROM logs").rows[0][0] == 1);
+        }
+
+        LogStore reopened(db_path, *storage_profile("small"));
+        REQUIRE(reopened.storage_settings().page_size == 8192);
+        REQUIRE(reopened.storage_settings().cache_bytes == 8 * 1024 * 1024);
+        REQUIRE(reopened.storage_settings().mmap_bytes == 0);
+        REQUIRE(reopened.count() == 1);
+    }
+
+    SECTION("Autotune benchmarks next to the database and cleans up") {
+        auto result = autotune_storage(db_path);
+        const auto& s = result.settings;
+        REQUIRE(s.profile == "autotune");
+        REQUIRE((s.page_size == 4096 || s.page_size == 8192 || s.page_size == 16384));
+        REQUIRE(s.cache_bytes >= 16 * 1024 * 1024);
+        REQUIRE(s.wal_autocheckpoint >= 1000);
+        REQUIRE(s.wal_autocheckpoint <= 50000);
+        REQUIRE(result.insert_mb_per_sec > 0.0);
+        REQUIRE(result.commit_ms > 0.0);
+        REQUIRE_FALSE(std::filesystem::exists(db_path + ".autotune"));
+        REQUIRE_FALSE(std::filesystem::exists(db_path + ".autotune-wal"));
+
+        LogStore store(db_path, s);
+        REQUIRE(store.storage_settings().page_size == s.page_size);
+        REQUIRE(store.storage_settings().describe().rfind("autotune: page_size", 0) == 0);
+    }
+}
+
+TEST_CASE("ThreadPlacement splits CPUs by NUMA node and accounts CPU by role", "[placement]") {
+    REQUIRE(parse_cpu_list("0-3,8, 10-11\n") == std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+    REQUIRE(parse_cpu_list("").empty());
+    REQUIRE_THROWS(parse_cpu_list("3-1"));
+    REQUIRE_THROWS(parse_cpu_list("1-"));
+    REQUIRE_THROWS(parse_cpu_list("cpu0"));
+    REQUIRE(format_cpu_list({0, 1, 2, 3, 8, 10, 11}) == "0-3,8,10-11");
+    REQUIRE(thread_role_from_name("ingest") == ThreadRole::Ingest);
+    REQUIRE_FALSE(thread_role_from_name("writer"));
+
+    SECTION("Topology and the NIC's node come from sysfs") {
+        namespace fs = std::filesystem;
+        fs::path root = "/tmp/test_sysfs";
+        fs::remove_all(root);
+        auto write = [](const fs::path& path, const std::string& text) {
+            fs::create_directories(path.parent_path());
+            std::ofstream(path) << text << "\n";
+        };
+        write(root / "devices/system/node/node0/cpulist", "0-3");
+        write(root / "devices/system/node/node1/cpulist", "4-7");
+        write(root / "devices/system/node/has_cpu", "0-1");
+        write(root / "class/net/eth0/device/numa_node", "1");
+        write(root / "class/net/veth0/device/numa_node", "-1");
+
+        auto topology = read_numa_topology(root.string());
+        REQUIRE(topology.node_cpus.size() == 2);
+        REQUIRE(topology.node_cpus[1] == std::vector<int>{4, 5, 6, 7});
+        REQUIRE(nic_numa_node("eth0", root.string()) == 1);
+        REQUIRE_FALSE(nic_numa_node("veth0", root.string()));
+        REQUIRE_FALSE(nic_numa_node("lo", root.string()));
+
+        // Ingest next to the NIC, everything else on the other node
+        ThreadPlacement::configure_auto(topology, 1);
+        REQUIRE(ThreadPlacement::cpus(ThreadRole::Ingest) == std::vector<int>{4, 5, 6, 7});
+        REQUIRE(ThreadPlacement::cpus(ThreadRole::Tailer) == std::vector<int>{4, 5, 6, 7});
+        REQUIRE(ThreadPlacement::cpus(ThreadRole::Query) == std::vector<int>{0, 1, 2, 3});
+        REQUIRE(ThreadPlacement::cpus(ThreadRole::Ui) == std::vector<int>{0, 1, 2, 3});
+        REQUIRE(ThreadPlacement::describe().rfind("ingest 4-7, tailer 4-7, query 0-3", 0) == 0);
+
+        // One node: ingest keeps a quarter of it to itself
+        ThreadPlacement::reset();
+        ThreadPlacement::configure_auto(NumaTopology{{{0, 1, 2, 3, 4, 5, 6, 7}}}, 0);
+        REQUIRE(ThreadPlacement::cpus(ThreadRole::Ingest) == std::vector<int>{0, 1});
+        REQUIRE(ThreadPlacement::cpus(ThreadRole::Http) == std::vector<int>{2, 3, 4, 5, 6, 7});
+
+        // A single CPU can't be split
+        ThreadPlacement::reset();
+        ThreadPlacement::configure_auto(NumaTopology{{{0}}}, 0);
+        REQUIRE(ThreadPlacement::cpus(ThreadRole::Ingest).empty());
+        fs::remove_all(root);
+    }
+
+    SECTION("Threads are pinned and their CPU time lands under their role") {
+#ifdef __linux__
+        cpu_set_t allowed;
+        REQUIRE(sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+        int first = 0;
+        while (!CPU_ISSET(first, &allowed)) first++;
+        ThreadPlacement::set_cpus(ThreadRole::Tailer, {first});
+#endif
+        double before = ThreadPlacement::cpu_seconds()[static_cast<size_t>(ThreadRole::Tailer)];
+        int cpu_seen = -1;
+        std::thread worker([&] {
+            ThreadPlacement::adopt(ThreadRole::Tailer);
+            auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+            volatile uint64_t spin = 0;
+            while (std::chrono::steady_clock::now() < until) spin = spin + 1;
+#ifdef __linux__
+            cpu_seen = sched_getcpu();
+#endif
+        });
+        worker.join();
+        double after = ThreadPlacement::cpu_seconds()[static_cast<size_t>(ThreadRole::Tailer)];
+
+#ifdef __linux__
+        REQUIRE(cpu_seen == first);
+        REQUIRE(after - before >= 0.05);
+#else
+        (void)cpu_seen;
+        (void)after;
+        (void)before;
+#endif
+        ThreadPlacement::publish_metrics();
+        REQUIRE(Metrics::value("process_threads", {{"role", "tailer"}}) == 0.0);   // Exited
+    }
+
+    ThreadPlacement::reset();
+}
+
+TEST_CASE("ProfiledMutex records wait and hold times per call site", "[locks]") {
+    LockProfiler::reset();
+    ProfiledMutex mutex("TestMutex");
+    int counter = 0;
+    {
+        auto lock = mutex.acquire("holder");
+        std::thread waiter([&] {
+            auto inner = mutex.acquire("waiter");
+            counter++;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        counter++;
+        lock.unlock();
+        waiter.join();
+    }
+    for (int i = 0; i < 100; i++) {
+        std::lock_guard<ProfiledMutex> untagged(mutex);
+        counter++;
+    }
+    REQUIRE(counter == 102);
+
+    std::string db_path = "/tmp/test_locks.db";
+    std::filesystem::remove(db_path);
+    {
+        LogStore store(db_path);
+        LogEntry entry;
+        entry.category = "LogTemp";
+        entry.message = "Locked";
+        store.insert(entry);
+        REQUIRE(store.count() == 1);
+    }
+    std::filesystem::remove(db_path);
+
+    auto sites = LockProfiler::report();
+    if (!LockProfiler::enabled()) {
+        REQUIRE(sites.empty());
+        return;
+    }
+
+    auto find = [&sites](const std::string& mutex, const std::string& site) {
+        auto it = std::find_if(sites.begin(), sites.end(), [&](const LockSiteReport& s) {
+            return s.mutex == mutex && s.site == site;
+        });
+        REQUIRE(it != sites.end());
+        return *it;
+    };
+
+    auto waiter = find("TestMutex", "waiter");
+    REQUIRE(waiter.acquisitions == 1);
+    REQUIRE(waiter.contended == 1);
+    REQUIRE(waiter.wait_max >= 0.01);
+    REQUIRE(waiter.wait_p99 > 0.0);
+
+    auto holder = find("TestMutex", "holder");
+    REQUIRE(holder.contended == 0);
+    REQUIRE(holder.hold_max >= 0.01);
+    REQUIRE(holder.blocked_others_seconds >= 0.01);   // The waiter queued behind it
+
+    auto other = find("TestMutex", "other");
+    REQUIRE(other.acquisitions == 100);
+    REQUIRE(other.wait_p50 == 0.0);
+
+    REQUIRE(find("LogStore", "insert").acquisitions == 1);
+    REQUIRE(find("LogStore", "count").acquisitions == 1);
+    REQUIRE(sites.front().wait_seconds >= waiter.wait_seconds);   // Most contended first
+
+    LockProfiler::publish_metrics();
+    REQUIRE(Metrics::value("lock_contended", {{"mutex", "TestMutex"}, {"site", "waiter"}}) == 1.0);
+    REQUIRE(Metrics::value("lock_wait_seconds", {{"mutex", "TestMutex"}, {"site", "waiter"}, {"quantile", "1"}}) ==
+            waiter.wait_max);
+
+    LockProfiler::reset();
+    REQUIRE(LockProfiler::report().empty());
+}
+
+TEST_CASE("ProfiledMutex caches every site of a busy mutex once", "[locks]") {
+    LockProfiler::reset();
+    ProfiledMutex mutex("ManySites");
+    std::vector<std::string> names;
+    for (int i = 0; i < 40; i++) names.push_back("site-" + std::to_string(i));
+
+    // Every thread takes every site, so first uses of a site race
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&] {
+            for (int round = 0; round < 25; round++) {
+                for (const auto& name : names) mutex.acquire(name.c_str());
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    auto sites = LockProfiler::report();
+    if (!LockProfiler::enabled()) {
+        REQUIRE(sites.empty());
+        REQUIRE(mutex.cached_sites() == 0);
+        return;
+    }
+    REQUIRE(mutex.cached_sites() == names.size());   // Each site once, none left to the registry
+    REQUIRE(sites.size() == names.size());
+    for (const auto& site : sites) {
+        REQUIRE(site.mutex == "ManySites");
+        REQUIRE(site.acquisitions == 100);
+    }
+    LockProfiler::reset();
+}
+
+#ifdef __linux__
+// Not inlined, so the profiler test can find it by name in the stacks
+__attribute__((noinline)) void profiler_test_spin(const std::atomic<bool>& stop) {
+    volatile uint64_t spins = 0;
+    while (!stop.load(std::memory_order_relaxed)) spins = spins + 1;
+}
+
+TEST_CASE("CpuProfiler samples busy threads into collapsed stacks by role", "[profiler]") {
+    std::atomic<bool> stop{false};
+    std::thread busy([&stop] {
+        ThreadPlacement::adopt(ThreadRole::Query);
+        profiler_test_spin(stop);
+    });
+    std::thread labelled([&stop] {
+        ThreadPlacement::adopt(ThreadRole::Ingest);
+        CpuProfiler::set_thread_label("udp");
+        CpuProfiler::LabelScope label("writer");
+        profiler_test_spin(stop);
+    });
+
+    std::optional<std::string> second;
+    std::thread overlapping([&second] {
+        while (!CpuProfiler::running()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        second = CpuProfiler::profile(std::chrono::milliseconds(10));
+    });
+    auto stacks = CpuProfiler::profile(std::chrono::milliseconds(500), 199);
+    overlapping.join();
+    stop = true;
+    busy.join();
+    labelled.join();
+
+    REQUIRE(stacks);
+    REQUIRE_FALSE(second);   // One profile at a time
+
+    uint64_t total = 0, spinning = 0, writing = 0, unwound = 0;
+    std::istringstream lines(*stacks);
+    std::string line;
+    while (std::getline(lines, line)) {
+        size_t space = line.rfind(' ');
+        REQUIRE(space != std::string::npos);
+        uint64_t count = std::stoull(line.substr(space + 1));
+        total += count;
+        if (line.rfind("query;", 0) == 0 && line.find("profiler_test_spin") != std::string::npos) {
+            spinning += count;
+            // Frame pointers lead out of the spin to its callers
+            if (line.find("profiler_test_spin") > line.find(';') + 1) unwound += count;
+        }
+        if (line.rfind("writer;", 0) == 0 && line.find("profiler_test_spin") != std::string::npos) {
+            writing += count;
+        }
+        REQUIRE(line.rfind("ingest;", 0) != 0);   // The label replaces the role
+    }
+    // ~100 samples expected from half a second of one busy thread at 199 Hz
+    REQUIRE(spinning >= 30);
+    REQUIRE(writing >= 30);
+    REQUIRE(spinning + writing <= total);
+    REQUIRE(unwound >= spinning / 2);
+
+    // A cancelled profile returns early with what it has. cancel() before
+    // the profile starts does nothing, so wait until it's running.
+    REQUIRE_FALSE(CpuProfiler::running());
+    std::thread canceller([] {
+        while (!CpuProfiler::running()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        CpuProfiler::cancel();
+    });
+    auto started = std::chrono::steady_clock::now();
+    REQUIRE(CpuProfiler::profile(std::chrono::seconds(30)));
+    canceller.join();
+    REQUIRE(std::chrono::steady_clock::now() - started < std::chrono::seconds(5));
+}
+#endif
+
+TEST_CASE("AllocTracker charges allocations to the allocating subsystem", "[alloc]") {
+    auto find = [](AllocSubsystem subsystem) {
+        for (const auto& stats : AllocTracker::report()) {
+            if (stats.subsystem == alloc_subsystem_name(subsystem)) return stats;
+        }
+        return AllocStats{};
+    };
+
+    std::string db_path = "/tmp/test_alloc.db";
+    std::filesystem::remove(db_path);
+    {
+        LogStore store(db_path);
+        uint64_t rows_before = AllocTracker::rows_ingested();
+        store.insert_batch(std::vector<LogEntry>(9));
+        store.insert(LogEntry{});
+        REQUIRE(AllocTracker::rows_ingested() - rows_before == (AllocTracker::enabled() ? 10u : 0u));
+
+        // SQLite's allocations are reported separately
+        auto sqlite = store.sqlite_memory();
+        REQUIRE(sqlite.cache_bytes > 0);
+        REQUIRE(sqlite.schema_bytes > 0);
+        REQUIRE(sqlite.to_json().contains("connection"));
+        REQUIRE_FALSE(sqlite_memory_stats().to_json().contains("connection"));
+
+        if (AllocTracker::enabled()) {
+            auto before = find(AllocSubsystem::Results);
+            REQUIRE(store.query(LogFilter{}).size() == 10);
+            REQUIRE(find(AllocSubsystem::Results).allocations > before.allocations);
+        }
+    }
+    std::filesystem::remove(db_path);
+
+    if (!AllocTracker::enabled()) {
+        REQUIRE(AllocTracker::report().empty());
+        return;
+    }
+    REQUIRE(AllocTracker::report().size() == static_cast<size_t>(AllocSubsystem::Count));
+
+    // A scope overrides the thread's role, and frees are charged back to it
+    auto before = find(AllocSubsystem::Query);
+    char* volatile block = nullptr;
+    std::thread([&block] {
+        ThreadPlacement::adopt(ThreadRole::Ingest);
+        AllocScope scope(AllocSubsystem::Query);
+        block = new char[1000];
+    }).join();
+    auto during = find(AllocSubsystem::Query);
+    REQUIRE(during.allocations == before.allocations + 1);
+    REQUIRE(during.allocated_bytes == before.allocated_bytes + 1000);
+    REQUIRE(during.live_bytes == before.live_bytes + 1000);
+    delete[] block;
+    auto after = find(AllocSubsystem::Query);
+    REQUIRE(after.live_bytes == before.live_bytes);
+    REQUIRE(after.frees == before.frees + 1);
+    REQUIRE(after.allocations_per_row > 0.0);
+
+    // Without a scope, a thread's role decides
+    auto ui_before = find(AllocSubsystem::Ui);
+    std::thread([] {
+        ThreadPlacement::adopt(ThreadRole::Ui);
+        std::string* volatile text = new std::string(100, 'x');
+        delete text;
+    }).join();
+    REQUIRE(find(AllocSubsystem::Ui).allocated_bytes >= ui_before.allocated_bytes + 100);
+
+    // Over-aligned types still get their alignment
+    struct alignas(256) Wide {
+        char bytes[8];
+    };
+    auto wide = std::make_unique<Wide>();
+    REQUIRE(reinterpret_cast<uintptr_t>(wide.get()) % 256 == 0);
+}
+
+TEST_CASE("Datagram captures round-trip with their timing", "[capture]") {
+    std::string path = "/tmp/test_capture.cap";
+    std::filesystem::remove(path);
+
+    std::string big(40000, 'x');
+    {
+        CaptureWriter writer(path);
+        auto start = std::chrono::steady_clock::now();
+        REQUIRE(writer.write(R"({"category":"LogTemp","message":"first"})", start + std::chrono::milliseconds(5)));
+        REQUIRE(writer.write(big, start + std::chrono::milliseconds(1500)));
+        REQUIRE(writer.write("", start + std::chrono::milliseconds(1500)));
+        REQUIRE(writer.write("not json", start + std::chrono::milliseconds(1400)));   // Out of order: no gap
+        REQUIRE(writer.datagrams() == 4);
+    }
+
+    CaptureReader reader(path);
+    auto now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    REQUIRE(reader.started_at_us() <= now_us);
+    REQUIRE(reader.started_at_us() > now_us - 60 * 1000000LL);
+
+    std::vector<CapturedDatagram> read;
+    CapturedDatagram datagram;
+    while (reader.next(datagram)) read.push_back(datagram);
+    REQUIRE(read.size() == 4);
+    REQUIRE(read[0].data == R"({"category":"LogTemp","message":"first"})");
+    REQUIRE(read[1].data == big);
+    REQUIRE(read[2].data.empty());
+    REQUIRE(read[3].data == "not json");
+
+    // Offsets are relative to the writer's creation
+    REQUIRE(read[0].offset >= std::chrono::milliseconds(5));
+    REQUIRE(read[1].offset - read[0].offset == std::chrono::milliseconds(1495));
+    REQUIRE(read[2].offset == read[1].offset);
+    REQUIRE(read[3].offset == read[2].offset);
+    REQUIRE(std::filesystem::file_size(path) < 16 + 40000 + 100);   // Compact framing
+
+    // A torn final record is an error, not a silent short read
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+    CaptureReader torn(path);
+    size_t complete = 0;
+    REQUIRE_THROWS_AS([&] { while (torn.next(datagram)) complete++; }(), std::runtime_error);
+    REQUIRE(complete == 3);
+
+    {
+        std::ofstream other(path, std::ios::binary | std::ios::trunc);
+        other << "SQLite format 3";
+    }
+    REQUIRE_THROWS_AS(CaptureReader(path), std::runtime_error);
+    REQUIRE_THROWS_AS(CaptureReader("/tmp/does_not_exist.cap"), std::runtime_error);
+    REQUIRE_THROWS_AS(CaptureWriter("/nonexistent_dir/capture.cap"), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Exports stream selected logs to Arrow IPC files", "[export]") {
+    std::string db_path = "/tmp/test_export.db";
+    std::string out_path = "/tmp/test_export.arrow";
+    std::filesystem::remove(db_path);
+    std::filesystem::remove(out_path);
+
+    auto read_file = [](const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), {});
+    };
+    auto count = [](const std::string& haystack, const std::string& needle) {
+        size_t n = 0;
+        for (size_t pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1)) n++;
+        return n;
+    };
+
+    {
+        LogStore store(db_path);
+        std::vector<LogEntry> entries;
+        for (int i = 0; i < 300; i++) {
+            LogEntry entry;
+            entry.source = i % 2 ? "client" : "server";
+            entry.category = i % 3 ? "LogNetTraffic" : "LogTemp";
+            entry.message = "exported message " + std::to_string(i);
+            entry.timestamp = 1000.0 + i;
+            entry.session_id = i < 200 ? "session-a" : "session-b";
+            entry.instance_id = "instance-" + std::to_string(i % 4);
+            if (i % 5 == 0) entry.file = "Source/Game.cpp";
+            entries.push_back(entry);
+        }
+        store.insert_batch(entries);
+    }
+
+    SECTION("Rows are filtered and string columns dictionary encoded") {
+        ExportOptions options;
+        options.sessions = {"session-a"};
+        options.since = 1050.0;
+        options.source = "client";
+        options.compression = ContentEncoding::Identity;
+
+        std::vector<int64_t> reported;
+        auto result = export_logs(db_path, options, out_path, [&](const ExportProgress& progress) {
+            reported.push_back(progress.rows);
+            return true;
+        });
+        REQUIRE(result.rows == 75);    // Odd i in [50, 200)
+        REQUIRE(result.batches == 1);
+        REQUIRE(reported.back() == 75);
+        REQUIRE_FALSE(std::filesystem::exists(out_path + ".partial"));
+
+        std::string file = read_file(out_path);
+        REQUIRE(file.size() == result.bytes);
+        REQUIRE(file.compare(0, 6, "ARROW1") == 0);
+        REQUIRE(file.compare(file.size() - 6, 6, "ARROW1") == 0);
+        REQUIRE(count(file, "exported message 51") == 1);
+        REQUIRE(count(file, "exported message 49") == 0);
+        REQUIRE(count(file, "exported message 52") == 0);
+        REQUIRE(count(file, "LogNetTraffic") == 1);     // Once, in its dictionary
+        REQUIRE(count(file, "Source/Game.cpp") == 1);
+        REQUIRE(count(file, "session-b") == 0);
+    }
+
+    SECTION("Chunked reads export the same rows") {
+        ExportOptions options;
+        options.compression = ContentEncoding::Identity;
+        options.chunk_rows = 7;   // 300 rows: the last chunk is short
+        auto result = export_logs(db_path, options, out_path);
+        REQUIRE(result.rows == 300);
+        std::string file = read_file(out_path);
+        REQUIRE(count(file, "exported message 0") == 1);
+        REQUIRE(count(file, "exported message 299") == 1);
+
+        options.sessions = {"session-b"};
+        options.chunk_rows = 50;  // Exactly two chunks, then an empty one
+        REQUIRE(export_logs(db_path, options, out_path).rows == 100);
+    }
+
+    SECTION("Dictionaries grow by delta batches across record batches") {
+        std::ostringstream out;
+        ArrowLogWriter writer(out, ContentEncoding::Identity, 2);
+        LogEntry entry;
+        entry.source = "client";
+        entry.category = "LogTemp";
+        for (int i = 0; i < 5; i++) {
+            entry.id = i + 1;
+            entry.message = "row " + std::to_string(i);
+            entry.instance_id = "instance-" + std::to_string(i / 2);
+            writer.add(entry);
+        }
+        writer.finish();
+        REQUIRE(writer.rows() == 5);
+        REQUIRE(writer.batches() == 3);
+        REQUIRE(writer.bytes_written() == out.str().size());
+        REQUIRE(count(out.str(), "LogTemp") == 1);
+        REQUIRE(count(out.str(), "instance-1") == 1);
+        REQUIRE_THROWS_AS(writer.add(entry), std::runtime_error);
+    }
+
+    SECTION("An empty selection still writes a readable file") {
+        ExportOptions options;
+        options.sessions = {"no-such-session"};
+        auto result = export_logs(db_path, options, out_path);
+        REQUIRE(result.rows == 0);
+        REQUIRE(result.batches == 0);
+        REQUIRE(read_file(out_path).compare(0, 6, "ARROW1") == 0);
+    }
+
+    SECTION("Cancelling removes the partial file") {
+        std::filesystem::remove(out_path);
+        ExportOptions options;
+        REQUIRE_THROWS_AS(export_logs(db_path, options, out_path, [](const ExportProgress&) { return false; }),
+                          std::runtime_error);
+        REQUIRE_FALSE(std::filesystem::exists(out_path));
+        REQUIRE_FALSE(std::filesystem::exists(out_path + ".partial"));
+    }
+
+    SECTION("Background jobs write into the export directory") {
+        std::string dir = "/tmp/test_exports";
+        std::filesystem::remove_all(dir);
+        ExportJobs jobs(db_path, dir);
+        REQUIRE_THROWS_AS(jobs.start({}, "../escape.arrow"), std::runtime_error);
+        REQUIRE_THROWS_AS(jobs.start({}, ""), std::runtime_error);
+
+        ExportOptions options;
+        options.sessions = {"latest"};
+        std::string id = jobs.start(options, "latest.arrow");
+        nlohmann::json status;
+        for (int i = 0; i < 500; i++) {
+            status = *jobs.status(id);
+            if (status["state"] != "running") break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(status["state"] == "done");
+        REQUIRE(status["rows"] == 100);
+        REQUIRE(status["path"] == dir + "/latest.arrow");
+        REQUIRE(std::filesystem::file_size(dir + "/latest.arrow") == status["bytes"].get<uint64_t>());
+        REQUIRE_FALSE(jobs.cancel(id));
+        REQUIRE_FALSE(jobs.status("export-99"));
+        std::filesystem::remove_all(dir);
+    }
+
+    SECTION("Finished jobs are forgotten after the retention period") {
+        std::string dir = "/tmp/test_exports";
+        std::filesystem::remove_all(dir);
+        ExportJobs jobs(db_path, dir, std::chrono::seconds(0));
+        std::string id = jobs.start({}, "first.arrow");
+        for (int i = 0; i < 500 && jobs.status(id); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE_FALSE(jobs.status(id));
+        REQUIRE(std::filesystem::exists(dir + "/first.arrow"));   // Only the job is dropped
+        std::filesystem::remove_all(dir);
+    }
+
+    std::filesystem::remove(out_path);
+    std::filesystem::remove(db_path);
+}
+
+TEST_CASE("A follower store serves reads from the primary's database", "[follower]") {
+    std::string db_path = "/tmp/test_follower.db";
+    std::filesystem::remove(db_path);
+    std::filesystem::remove(db_path + "-wal");
+    std::filesystem::remove(db_path + "-shm");
+
+    REQUIRE_THROWS_AS(LogStore(db_path, {}, StoreRole::Follower), std::runtime_error);   // No database yet
+
+    auto make_entry = [](const std::string& session, int i) {
+        LogEntry entry;
+        entry.source = "server";
+        entry.category = i % 2 ? "LogNet" : "LogTemp";
+        entry.verbosity = i % 10 == 0 ? Verbosity::Error : Verbosity::Log;
+        entry.message = "follower row " + std::to_string(i);
+        entry.timestamp = 1000.0 + i;
+        entry.session_id = session;
+        entry.instance_id = "server-1";
+        return entry;
+    };
+
+    LogStore primary(db_path);
+    primary.insert(make_entry("old-session", 0));
+
+    LogStore follower(db_path, {}, StoreRole::Follower);
+    REQUIRE(follower.is_follower());
+    REQUIRE(follower.count() == 1);
+    REQUIRE(follower.get_latest_session() == "old-session");
+
+    std::vector<int64_t> notified;
+    follower.subscribe([&](const LogEntry& entry) { notified.push_back(entry.id); });
+
+    SECTION("New rows are applied in batches, as if inserted locally") {
+        std::vector<LogEntry> batch;
+        for (int i = 1; i <= 10; i++) batch.push_back(make_entry("new-session", i));
+        auto ids = primary.insert_batch(batch);
+
+        REQUIRE(follower.follow(4) == 4);
+        REQUIRE(follower.follow() == 6);
+        REQUIRE(follower.follow() == 0);
+        REQUIRE(notified == ids);
+
+        LogFilter filter;   // Latest session, from the follower's own index
+        filter.category = "LogNet";
+        auto logs = follower.query(filter);
+        REQUIRE(logs.size() == 5);
+        REQUIRE(logs.front().session_id == "new-session");
+
+        LogFilter scope;
+        scope.session_id = "new-session";
+        REQUIRE(follower.estimate_rows(scope) == 10);
+        auto digest = follower.get_session_digest("latest");
+        REQUIRE(digest);
+        REQUIRE((*digest)["log_count"] == 10);   // Built once, not double counted within the batch
+    }
+
+    SECTION("Writes are refused") {
+        REQUIRE_THROWS_AS(follower.insert(make_entry("x", 1)), std::runtime_error);
+        REQUIRE_THROWS_AS(follower.insert_batch({make_entry("x", 1)}), std::runtime_error);
+        REQUIRE_THROWS_AS(follower.clear(), std::runtime_error);
+        REQUIRE_THROWS_AS(primary.follow(), std::runtime_error);
+        REQUIRE(primary.count() == 1);
+    }
+
+    SECTION("A clear on the primary rebuilds the follower's state") {
+        primary.insert(make_entry("old-session", 1));
+        REQUIRE(follower.follow() == 1);
+
+        primary.clear();
+        primary.insert(make_entry("after-clear", 2));
+        REQUIRE(follower.follow() == 0);    // Rebuilt from the table rather than applied
+        REQUIRE(follower.get_latest_session() == "after-clear");
+        LogFilter all;
+        all.all_sessions = true;
+        REQUIRE(follower.estimate_rows(all) == 1);
+        REQUIRE(follower.query(all).size() == 1);
+
+        primary.insert(make_entry("after-clear", 3));
+        REQUIRE(follower.follow() == 1);
+        REQUIRE(follower.estimate_rows(all) == 2);
+    }
+
+    SECTION("A source-filtered clear of middle rows rebuilds the follower's state") {
+        std::vector<LogEntry> batch;
+        for (int i = 1; i <= 10; i++) {
+            batch.push_back(make_entry("new-session", i));
+            if (i >= 3 && i <= 7) batch.back().source = "client";
+        }
+        primary.insert_batch(batch);
+        REQUIRE(follower.follow() == 10);
+        LogFilter all;
+        all.all_sessions = true;
+        REQUIRE(follower.estimate_rows(all) == 11);
+
+        REQUIRE(primary.clear(std::string("client")) == 5);   // Oldest and newest IDs are unchanged
+        REQUIRE(follower.follow() == 0);
+        REQUIRE(follower.estimate_rows(all) == 6);
+        REQUIRE(follower.query(all).size() == 6);
+    }
+
+    SECTION("StoreFollower polls in the background") {
+        StoreFollower poller(follower, std::chrono::milliseconds(5));
+        poller.start();
+        primary.insert(make_entry("polled", 1));
+        for (int i = 0; i < 400 && poller.rows_followed() < 1; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        poller.stop();
+        REQUIRE(poller.rows_followed() == 1);
+        REQUIRE(notified.size() == 1);
+        REQUIRE(follower.get_latest_session() == "polled");
+    }
+}
+
+TEST_CASE("Archives fan reads out across attached databases", "[archive]") {
+    std::string dir = "/tmp/test_archives";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::string live_path = dir + "/live.db";
+
+    auto make_entry = [](const std::string& session, double timestamp, const std::string& message) {
+        LogEntry entry;
+        entry.source = "server";
+        entry.category = "LogTemp";
+        entry.verbosity = Verbosity::Log;
+        entry.message = message;
+        entry.timestamp = timestamp;
+        entry.session_id = session;
+        entry.instance_id = "server-1";
+        return entry;
+    };
+
+    // Two rotated databases, closed before they're attached
+    {
+        LogStore week1(dir + "/week1.db");
+        week1.insert(make_entry("w1", 100.0, "archived hitch 1"));
+        week1.insert(make_entry("w1", 101.0, "archived ok"));
+        LogStore week2(dir + "/week2.db");
+        week2.insert(make_entry("w2", 200.0, "archived hitch 2"));
+    }
+
+    LogStore live(live_path);
+    live.insert(make_entry("now", 300.0, "live hitch"));
+
+    LogArchives archives(dir, live_path);
+    REQUIRE(archives.names() == std::vector<std::string>{"week1.db", "week2.db"});
+
+    SECTION("Queries merge newest first and page the merged result") {
+        LogFilter filter;
+        filter.all_sessions = true;
+        auto logs = archives.query(live, filter).logs;
+        REQUIRE(logs.size() == 4);
+        REQUIRE(logs[0].archive.empty());
+        REQUIRE(logs[0].entry.message == "live hitch");
+        REQUIRE(logs[1].archive == "week2.db");
+        REQUIRE(logs[3].entry.message == "archived hitch 1");
+        REQUIRE(logs[1].to_json()["archive"] == "week2.db");
+        REQUIRE_FALSE(logs[0].to_json().contains("archive"));
+
+        filter.limit = 2;
+        filter.offset = 1;
+        logs = archives.query(live, filter).logs;
+        REQUIRE(logs.size() == 2);
+        REQUIRE(logs[0].entry.message == "archived hitch 2");
+        REQUIRE(logs[1].entry.message == "archived ok");
+
+        LogFilter all;
+        all.all_sessions = true;
+        auto scan = archives.grep(live, "hitch", false, all, 1000);
+        REQUIRE(scan.matched == 3);
+        REQUIRE(scan.logs.size() == 3);
+        REQUIRE(scan.logs[2].archive == "week1.db");
+        REQUIRE(scan.errors.empty());
+    }
+
+    SECTION("max_scan is one budget for all the stores") {
+        LogFilter all;
+        all.all_sessions = true;
+        auto scan = archives.grep(live, "archived", false, all, 3);   // 4 rows in all
+        REQUIRE(scan.scanned == 3);
+        REQUIRE(scan.truncated);
+
+        // Rows the one-row stores don't need go to week1's second row
+        scan = archives.grep(live, "archived", false, all, 4);
+        REQUIRE(scan.scanned == 4);
+        REQUIRE_FALSE(scan.truncated);
+        REQUIRE(scan.matched == 3);
+    }
+
+    SECTION("Scheduler costs include the archives a call reads") {
+        LogFilter all;
+        all.all_sessions = true;
+        archives.query(live, all);   // Opened, so their rows are counted rather than guessed
+        REQUIRE(archives.estimate_rows() == 3);
+
+        QueryScheduler scheduler(live, {}, &archives);
+        REQUIRE(scheduler.estimate("grep_logs", {{"pattern", "x"}, {"all_sessions", true}}).rows == 4);
+        REQUIRE(scheduler.estimate("grep_logs", {{"pattern", "x"}, {"all_sessions", true},
+                                                 {"include_archives", false}}).rows == 1);
+        REQUIRE(scheduler.estimate("grep_logs", {{"pattern", "x"}}).rows == 1);   // Latest session only
+        REQUIRE(scheduler.estimate("grep_logs", {{"pattern", "x"}, {"session_id", "w1"}}).rows == 3);   // Archived session
+        REQUIRE(scheduler.estimate("get_stats", nlohmann::json::object()).rows == 4);
+    }
+
+    SECTION("Stats sum across stores and are cached until an archive changes") {
+        auto stats = archives.get_stats(live);
+        REQUIRE(stats.total.total_count == 4);
+        REQUIRE(stats.total.session_count == 1);      // The live store's; "server-1" is in all three
+        REQUIRE(stats.total.instance_count == 1);
+        REQUIRE(stats.archives.size() == 2);
+        REQUIRE(stats.to_json()["archives"][0]["instance_count"] == 1);
+        REQUIRE(stats.errors.empty());
+        REQUIRE(archives.cache_misses() == 2);
+
+        stats = archives.get_stats(live, std::nullopt, 150.0);   // Not cached
+        REQUIRE(stats.total.total_count == 2);
+        REQUIRE(archives.cache_hits() + archives.cache_misses() == 2);
+
+        stats = archives.get_stats(live);
+        REQUIRE(stats.total.total_count == 4);
+        REQUIRE(archives.cache_hits() == 2);
+
+        {
+            LogStore week2(dir + "/week2.db");
+            week2.insert(make_entry("w2", 201.0, "late arrival"));
+        }
+        stats = archives.get_stats(live);
+        REQUIRE(stats.total.total_count == 5);
+        REQUIRE(archives.cache_hits() == 3);
+        REQUIRE(archives.cache_misses() == 3);
+
+        auto sessions = archives.get_sessions(live).sessions;   // By last received
+        REQUIRE(sessions.size() == 3);
+        REQUIRE(sessions[0].info.session_id == "w2");
+        REQUIRE(sessions[0].archive == "week2.db");
+        REQUIRE(sessions[1].info.session_id == "now");
+        REQUIRE(sessions[2].archive == "week1.db");
+
+        // A full cache drops its oldest key, not every key
+        for (int i = 0; i < 32; i++) archives.get_stats(live, "source" + std::to_string(i));
+        uint64_t hits = archives.cache_hits();
+        archives.get_stats(live, std::string("source1"));
+        archives.get_stats(live, std::string("source31"));
+        REQUIRE(archives.cache_hits() == hits + 4);
+        archives.get_stats(live);   // The oldest key, evicted
+        REQUIRE(archives.cache_hits() == hits + 4);
+    }
+
+    SECTION("Unreadable archives are reported, not fatal") {
+        std::ofstream(dir + "/broken.db") << "not a database";
+        auto stats = archives.get_stats(live);
+        REQUIRE(stats.total.total_count == 4);
+        REQUIRE(stats.errors.size() == 1);
+        REQUIRE(stats.errors[0].first == "broken.db");
+        REQUIRE(stats.to_json()["archive_errors"].size() == 1);
+
+        LogFilter all;
+        all.all_sessions = true;
+        auto logs = archives.query(live, all);
+        REQUIRE(logs.logs.size() == 4);
+        REQUIRE(logs.errors.size() == 1);
+        REQUIRE(archives.search(live, "hitch", all).errors.size() == 1);
+        auto scan = archives.grep(live, "hitch", false, all, 1000);
+        REQUIRE(scan.matched == 3);
+        REQUIRE(scan.errors[0].first == "broken.db");
+        REQUIRE(archive_errors_to_json(scan.errors)[0]["archive"] == "broken.db");
+
+        auto sessions = archives.get_sessions(live);
+        REQUIRE(sessions.sessions.size() == 3);
+        REQUIRE(sessions.errors.size() == 1);
+        REQUIRE(sessions.errors[0].first == "broken.db");
+    }
+
+    SECTION("Archive stores are read-only") {
+        LogStore archive(dir + "/week1.db", {}, StoreRole::Archive);
+        REQUIRE(archive.count() == 2);
+        REQUIRE_THROWS_AS(archive.insert(make_entry("x", 1.0, "x")), std::runtime_error);
+        REQUIRE_THROWS_AS(archive.clear(), std::runtime_error);
+        REQUIRE_THROWS_AS(archive.sql_query("SELECT COUNT(*) FROM logs"), std::runtime_error);   // No sandbox connection
+    }
+
+    REQUIRE_THROWS_AS(LogArchives("/tmp/test_archives_missing", live_path), std::runtime_error);
+}
+
+TEST_CASE("The log field table drives SQL, rows and JSON", "[schema]") {
+    std::string db_path = "/tmp/test_schema.db";
+    std::string old_path = "/tmp/test_schema_old.db";
+    for (const auto& path : {db_path, old_path}) {
+        std::filesystem::remove(path);
+        std::filesystem::remove(path + "-wal");
+        std::filesystem::remove(path + "-shm");
+    }
+
+    auto make_entry = [](const std::string& instance, double timestamp, double received_at,
+                         const std::string& message) {
+        LogEntry entry;
+        entry.source = "server";
+        entry.category = "LogNet";
+        entry.message = message;
+        entry.timestamp = timestamp;
+        entry.received_at = received_at;
+        entry.session_id = "schema-session";
+        entry.instance_id = instance;
+        return entry;
+    };
+
+    SECTION("Generated SQL covers every field") {
+        REQUIRE(LogSchema::kColumns == 16);
+        REQUIRE(LogSchema::create_table_sql().find("id INTEGER PRIMARY KEY AUTOINCREMENT") != std::string::npos);
+        REQUIRE(LogSchema::create_table_sql().find("frame INTEGER,") != std::string::npos);
+        REQUIRE(LogSchema::create_table_sql().find("template_id INTEGER NOT NULL DEFAULT 0") != std::string::npos);
+        REQUIRE(LogSchema::insert_sql().find("(source, ") != std::string::npos);
+        REQUIRE(std::count(LogSchema::insert_sql().begin(), LogSchema::insert_sql().end(), '?') == 15);
+        REQUIRE(LogSchema::select_columns("l.", {"seq", "norm_time"}) ==
+                "l.id, l.source, l.category, l.verbosity, l.message, l.timestamp, l.frame, l.file, l.line, "
+                "l.received_at, l.session_id, l.instance_id, NULL AS seq, l.attrs, l.template_id, 0 AS norm_time");
+    }
+
+    SECTION("JSON round-trips, with defaults for missing keys") {
+        LogEntry entry = make_entry("a", 10.0, 11.0, "hello");
+        entry.id = 42;
+        entry.verbosity = Verbosity::Warning;
+        entry.line = 7;
+        entry.seq = 99;
+        entry.attrs = R"({"map":"Arena","players":4})";
+        entry.template_id = -2;
+
+        auto j = entry.to_json();
+        REQUIRE(j["verbosity"] == "Warning");
+        REQUIRE(j["template_id"] == "fffffffffffffffe");
+        REQUIRE(j["attrs"]["map"] == "Arena");
+        REQUIRE_FALSE(j.contains("frame"));
+
+        LogEntry back = LogEntry::from_json(j);
+        REQUIRE(back.id == 42);
+        REQUIRE(back.verbosity == Verbosity::Warning);
+        REQUIRE(back.line == 7);
+        REQUIRE_FALSE(back.frame);
+        REQUIRE(back.seq == 99);
+        REQUIRE(nlohmann::json::parse(*back.attrs) == j["attrs"]);
+        REQUIRE(back.template_id == 0);     // Derived by the server, not taken from senders
+        back.template_id = entry.template_id;
+        REQUIRE(back.to_json() == j);
+
+        LogEntry defaults = LogEntry::from_json(nlohmann::json::object());
+        REQUIRE(defaults.source == "unknown");
+        REQUIRE(defaults.category == "LogTemp");
+        REQUIRE(defaults.verbosity == Verbosity::Log);
+        REQUIRE_FALSE(defaults.seq);
+    }
+
+    SECTION("Inserts derive template_id and norm_time, and every read path returns them") {
+        LogStore store(db_path);
+        LogEntry first = make_entry("ahead", 1100.0, 1000.0, "Player 12 joined");   // Clock 100s fast
+        first.seq = 1;
+        first.attrs = R"({"team":"red"})";
+        store.insert(first);
+        store.insert(make_entry("behind", 900.0, 1002.0, "Player 7 joined"));
+        store.insert(make_entry("ahead", 1105.0, 1006.0, "Player left"));       // Slower delivery
+
+        LogFilter filter;   // Latest session, through the session index
+        auto indexed = store.query(filter);
+        LogFilter all;
+        all.all_sessions = true;
+        auto scanned = store.query(all);
+        auto searched = store.search("joined", all);
+        REQUIRE(indexed.size() == 3);
+        REQUIRE(scanned.size() == 3);
+        REQUIRE(searched.size() == 2);
+
+        for (const auto* logs : {&indexed, &scanned}) {
+            std::map<std::string, LogEntry> by_message;
+            for (const auto& log : *logs) by_message[log.message] = log;
+            REQUIRE(by_message["Player 12 joined"].seq == 1);
+            REQUIRE(by_message["Player 12 joined"].attrs == first.attrs);
+            REQUIRE_FALSE(by_message["Player left"].seq);
+            REQUIRE(by_message["Player 12 joined"].template_id == message_template_id("Player 12 joined"));
+            REQUIRE(by_message["Player 12 joined"].template_id == by_message["Player 7 joined"].template_id);
+            REQUIRE(by_message["Player 12 joined"].template_id != by_message["Player left"].template_id);
+            REQUIRE(by_message["Player 12 joined"].norm_time == 1000.0);
+            REQUIRE(by_message["Player 7 joined"].norm_time == 1002.0);
+            REQUIRE(by_message["Player left"].norm_time == 1005.0);   // Shifted by the instance's offset
+        }
+        REQUIRE(searched[0].template_id == searched[1].template_id);
+
+        // Values a sender puts in the derived columns are replaced
+        LogEntry forged = LogEntry::from_json({{"message", "Player 3 joined"}, {"instance_id", "behind"},
+                                               {"timestamp", 901.0}, {"received_at", 1003.0},
+                                               {"template_id", "0000000000000001"}, {"norm_time", 5.0}});
+        forged.template_id = 1;
+        forged.norm_time = 5.0;
+        int64_t id = store.insert(forged);
+        auto stored = store.sql_query("SELECT template_id, norm_time FROM logs WHERE id = " + std::to_string(id));
+        REQUIRE(stored.rows[0][0] == message_template_id("Player 3 joined"));
+        REQUIRE(stored.rows[0][1] == 1003.0);
+    }
+
+    SECTION("norm_time never runs backwards within an instance, across restarts too") {
+        auto norm_time = [](LogStore& store, int64_t id) {
+            return store.sql_query("SELECT norm_time FROM logs WHERE id = " + std::to_string(id)).rows[0][0];
+        };
+        {
+            LogStore store(db_path);
+            REQUIRE(norm_time(store, store.insert(make_entry("game", 1100.0, 1010.0, "a"))) == 1010.0);
+            // A faster delivery second: the offset slews instead of jumping back to 1001
+            REQUIRE(norm_time(store, store.insert(make_entry("game", 1101.0, 1001.0, "b"))) == 1010.0);
+            REQUIRE(norm_time(store, store.insert(make_entry("game", 1200.0, 1101.0, "c"))) == 1100.0);
+        }
+        LogStore reopened(db_path);
+        REQUIRE(norm_time(reopened, reopened.insert(make_entry("game", 1201.0, 1200.0, "d"))) == 1101.0);
+    }
+
+    SECTION("Older databases are read as is, and migrated when opened as primary") {
+        sqlite3* db = nullptr;
+        REQUIRE(sqlite3_open(old_path.c_str(), &db) == SQLITE_OK);
+        REQUIRE(sqlite3_exec(db, R"(
+            CREATE TABLE logs (
+                id INTEGER PRIMARY KEY AUTOINCREMENT, source TEXT NOT NULL, category TEXT NOT NULL,
+                verbosity INTEGER NOT NULL, message TEXT NOT NULL, timestamp REAL NOT NULL, frame INTEGER,
+                file TEXT, line INTEGER, received_at REAL NOT NULL, session_id TEXT NOT NULL,
+                instance_id TEXT NOT NULL);
+            INSERT INTO logs (source, category, verbosity, message, timestamp, received_at, session_id, instance_id)
+                VALUES ('client', 'LogTemp', 5, 'Loaded 30 assets', 500.0, 501.0, 'old', 'client-1');
+        )", nullptr, nullptr, nullptr) == SQLITE_OK);
+        REQUIRE(LogSchema::missing_columns(db) ==
+                std::vector<std::string>{"seq", "attrs", "template_id", "norm_time"});
+        sqlite3_close(db);
+
+        LogFilter all;
+        all.all_sessions = true;
+        {
+            LogStore archive(old_path, {}, StoreRole::Archive);
+            auto logs = archive.query(all);
+            REQUIRE(logs.size() == 1);
+            REQUIRE(logs[0].template_id == message_template_id("Loaded 30 assets"));
+            REQUIRE(logs[0].norm_time == 500.0);
+            REQUIRE_FALSE(logs[0].seq);
+        }
+
+        LogStore primary(old_path);
+        LogEntry entry = make_entry("server-1", 600.0, 600.5, "Loaded 31 assets");
+        entry.seq = 5;
+        primary.insert(entry);
+        auto logs = primary.query(all);
+        REQUIRE(logs.size() == 2);
+        REQUIRE(logs[0].seq == 5);
+        REQUIRE(logs[0].template_id == logs[1].template_id);
+
+        auto stored = primary.sql_query("SELECT template_id, norm_time FROM logs ORDER BY id");
+        REQUIRE(stored.rows[0][0] == 0);      // Written before the column; derived on read
+        REQUIRE(stored.rows[1][0] == logs[0].template_id);
+    }
+}
+
+// Raw HTTP client for the asio server tests: every read gives up after 5 s
+// rather than hanging the suite
+struct TestHttpClient {
+    asio::io_context io;
+    asio::ip::tcp::socket socket{io};
+    std::string received;
+    bool closed = false;   // The server ended the connection
+
+    explicit TestHttpClient(uint16_t port) {
+        socket.connect(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), port));
+    }
+
+    void send(const std::string& data) { asio::write(socket, asio::buffer(data)); }
+
+    // Read until `text` has arrived, the server closes, or 5 s pass
+    bool read_until(const std::string& text) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        char buffer[4096];
+        while (received.find(text) == std::string::npos && !closed &&
+               std::chrono::steady_clock::now() < deadline) {
+            bool done = false;
+            socket.async_read_some(asio::buffer(buffer), [&](const asio::error_code& ec, size_t n) {
+                received.append(buffer, n);
+                closed = ec && ec != asio::error::operation_aborted;
+                done = true;
+            });
+            io.restart();
+            io.run_for(deadline - std::chrono::steady_clock::now());
+            if (!done) {
+                socket.cancel();
+                io.restart();
+                io.run();
+            }
+        }
+        return received.find(text) != std::string::npos;
+    }
+
+    bool read_to_close() {
+        read_until(std::string(1, '\0'));
+        return closed;
+    }
+};
+
+TEST_CASE("AsioHttpServer enforces request limits and streams MCP responses over SSE", "[http]") {
+    constexpr uint16_t kPort = 52988;
+    AsioHttpServer server(kPort, 1);
+    server.set_worker_threads(1);
+    server.set_message_handler([](const nlohmann::json& request, const std::string&) {
+        return nlohmann::json{{"echo", request["method"]}};
+    });
+    server.start();
+
+    auto status_of = [](const std::string& request) {
+        TestHttpClient client(kPort);
+        client.send(request);
+        client.read_until("\r\n");
+        return client.received.substr(0, client.received.find("\r\n"));
+    };
+
+    SECTION("Oversized, unframed and malformed requests are refused") {
+        std::string huge_header = "GET /health HTTP/1.1\r\nX-Filler: " +
+                                  std::string(AsioHttpServer::kMaxHeaderBytes + 1024, 'a');
+        REQUIRE(status_of(huge_header) == "HTTP/1.1 431 Request Header Fields Too Large");
+        REQUIRE(status_of("POST /messages?session_id=x HTTP/1.1\r\nContent-Length: " +
+                          std::to_string(AsioHttpServer::kMaxBodyBytes + 1) + "\r\n\r\n") ==
+                "HTTP/1.1 413 Payload Too Large");
+        REQUIRE(status_of("POST /messages?session_id=x HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n") ==
+                "HTTP/1.1 411 Length Required");
+        REQUIRE(status_of("NONSENSE\r\n\r\n") == "HTTP/1.1 400 Bad Request");
+        REQUIRE(status_of("POST /messages HTTP/1.1\r\nContent-Length: 12x\r\n\r\n") ==
+                "HTTP/1.1 400 Bad Request");
+        REQUIRE(status_of("GET /health HTTP/1.1\r\n\r\n") == "HTTP/1.1 200 OK");
+    }
+
+    SECTION("A POSTed message's response arrives on the session's stream") {
+        TestHttpClient stream(kPort);
+        stream.send("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        REQUIRE(stream.read_until("\n\n\r\n"));   // The endpoint event, in its chunk
+        REQUIRE(stream.received.find("Transfer-Encoding: chunked") != std::string::npos);
+        std::smatch match;
+        REQUIRE(std::regex_search(stream.received, match, std::regex("session_id=([^\\s]+)")));
+        std::string session_id = match[1];
+
+        std::string body = R"({"jsonrpc":"2.0","id":1,"method":"ping"})";
+        TestHttpClient post(kPort);
+        post.send("POST /messages?session_id=" + session_id + " HTTP/1.1\r\nContent-Length: " +
+                  std::to_string(body.size()) + "\r\n\r\n" + body);
+        REQUIRE(post.read_until("accepted"));
+        REQUIRE(post.received.rfind("HTTP/1.1 202 Accepted", 0) == 0);
+
+        REQUIRE(stream.read_until(R"({"echo":"ping"})"));
+        REQUIRE(stream.received.find("event: message") != std::string::npos);
+    }
+
+    SECTION("HTTP/1.0 clients get a close-delimited stream") {
+        TestHttpClient stream(kPort);
+        stream.send("GET / HTTP/1.0\r\n\r\n");
+        REQUIRE(stream.read_until("event: endpoint"));
+        REQUIRE(stream.received.find("Transfer-Encoding") == std::string::npos);
+        REQUIRE(stream.received.find("Connection: close") != std::string::npos);
+        // No chunk size line between the headers and the event
+        REQUIRE(stream.received.find("\r\n\r\nevent: endpoint") != std::string::npos);
+    }
+
+    SECTION("Closing a stream reports its session as disconnected") {
+        std::mutex mutex;
+        std::vector<std::string> disconnected;
+        server.set_disconnect_handler([&](const std::string& session_id) {
+            std::lock_guard<std::mutex> lock(mutex);
+            disconnected.push_back(session_id);
+        });
+        server.stop();
+        server.start();
+
+        std::string session_id;
+        {
+            TestHttpClient stream(kPort);
+            stream.send("GET / HTTP/1.1\r\n\r\n");
+            REQUIRE(stream.read_until("event: endpoint"));
+            std::smatch match;
+            REQUIRE(std::regex_search(stream.received, match, std::regex("session_id=([^\\s]+)")));
+            session_id = match[1];
+            REQUIRE(server.has_sse_client(session_id));
+        }
+
+        // The handler runs just after the stream is unregistered
+        auto reported = [&] {
+            std::lock_guard<std::mutex> lock(mutex);
+            return !disconnected.empty();
+        };
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!reported() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE_FALSE(server.has_sse_client(session_id));
+        std::lock_guard<std::mutex> lock(mutex);
+        REQUIRE(disconnected == std::vector<std::string>{session_id});
+    }
+
+    SECTION("stop() closes open streams") {
+        TestHttpClient first(kPort);
+        TestHttpClient second(kPort);
+        first.send("GET / HTTP/1.1\r\n\r\n");
+        second.send("GET / HTTP/1.1\r\n\r\n");
+        REQUIRE(first.read_until("event: endpoint"));
+        REQUIRE(second.read_until("event: endpoint"));
+        REQUIRE(server.sse_client_count() == 2);
+
+        auto started = std::chrono::steady_clock::now();
+        server.stop();
+        REQUIRE(std::chrono::steady_clock::now() - started < std::chrono::seconds(1));
+        REQUIRE(server.sse_client_count() == 0);
+        REQUIRE(first.read_to_close());
+        REQUIRE(second.read_to_close());
+
+        server.start();   // And it serves again afterwards
+        REQUIRE(status_of("GET /health HTTP/1.1\r\n\r\n") == "HTTP/1.1 200 OK");
+    }
+
+    server.stop();
+}
+
+TEST_CASE("Queued heavy tool calls don't hold up fast ones", "[http][scheduler]") {
+    constexpr uint16_t kPort = 52989;
+    std::string db_path = "/tmp/test_mcp_lanes.db";
+    std::filesystem::remove(db_path);
+
+    LogStore store(db_path);
+    for (int i = 0; i < 20; i++) {
+        LogEntry entry;
+        entry.source = "server";
+        entry.category = "LogTemp";
+        entry.message = "Lane row " + std::to_string(i);
+        entry.session_id = "lanes";
+        store.insert(entry);
+    }
+    AnomalyDetector anomalies(store);
+    RuleEngine rules(store);
+    SourceManager sources(store);
+    ExportJobs exports(db_path, "/tmp/test_mcp_lanes_exports");
+
+    AsioHttpServer server(kPort, 1);
+    server.set_worker_threads(4);
+    McpServer mcp(store, sources, server, anomalies, rules, exports);
+    server.start();
+
+    auto open_stream = [&](TestHttpClient& stream) {
+        stream.send("GET / HTTP/1.1\r\n\r\n");
+        REQUIRE(stream.read_until("event: endpoint"));
+        std::smatch match;
+        REQUIRE(std::regex_search(stream.received, match, std::regex("session_id=([^\\s]+)")));
+        return std::string(match[1]);
+    };
+    auto call = [&](const std::string& session_id, int id, const nlohmann::json& params) {
+        std::string body = nlohmann::json{{"jsonrpc", "2.0"}, {"id", id}, {"method", "tools/call"},
+                                          {"params", params}}.dump();
+        TestHttpClient post(kPort);
+        post.send("POST /messages?session_id=" + session_id + " HTTP/1.1\r\nContent-Length: " +
+                  std::to_string(body.size()) + "\r\n\r\n" + body);
+        REQUIRE(post.read_until("accepted"));
+    };
+
+    // More sessions with a heavy call each than the executor has threads:
+    // two run (sql_query is always heavy), the rest wait for the lane
+    std::vector<std::unique_ptr<TestHttpClient>> heavy;
+    for (int i = 0; i < 6; i++) {
+        heavy.push_back(std::make_unique<TestHttpClient>(kPort));
+        call(open_stream(*heavy.back()), i, {{"name", "sql_query"}, {"arguments", {
+            {"sql", "SELECT COUNT(*) FROM logs a, logs b, logs c, logs d, logs e, logs f, logs g"},
+            {"timeout_ms", 500}}}});
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    TestHttpClient fast(kPort);
+    std::string fast_session = open_stream(fast);
+    auto started = std::chrono::steady_clock::now();
+    call(fast_session, 99, {{"name", "tail_logs"}, {"arguments", {{"count", 5}}}});
+    REQUIRE(fast.read_until("\"id\":99"));
+    REQUIRE(std::chrono::steady_clock::now() - started < std::chrono::milliseconds(400));
+    REQUIRE(fast.received.find("Lane row 19") != std::string::npos);
+
+    // The heavy calls all finish (with their time limit error) in turn
+    for (auto& stream : heavy) {
+        REQUIRE(stream->read_until("time limit"));
+    }
+
+    // multi_query's scans share one max_scan; find_similar isn't batched
+    auto tool_result = [](const std::string& received, int id) {
+        std::string marker = "\"id\":" + std::to_string(id);
+        size_t at = received.find(marker);
+        size_t start = received.rfind("data: ", at) + 6;
+        auto response = nlohmann::json::parse(received.substr(start, received.find('\n', start) - start));
+        return nlohmann::json::parse(response["result"]["content"][0]["text"].get<std::string>());
+    };
+    nlohmann::json greps = nlohmann::json::array();
+    for (int i = 0; i < 3; i++) greps.push_back({{"tool", "grep_logs"}, {"arguments", {{"pattern", "Lane"}}}});
+    fast.received.clear();
+    call(fast_session, 100, {{"name", "multi_query"}, {"arguments", {{"requests", greps}, {"max_scan", 25}}}});
+    REQUIRE(fast.read_until("\"isError\":false}}"));   // The end of the response
+    auto batch = tool_result(fast.received, 100)["results"];
+    REQUIRE(batch[0]["result"]["scanned"] == 20);
+    REQUIRE(batch[1]["result"]["scanned"] == 5);
+    REQUIRE(batch[1]["result"]["truncated"] == true);
+    REQUIRE(batch[2]["error"].get<std::string>().find("used up") != std::string::npos);
+
+    call(fast_session, 101, {{"name", "multi_query"}, {"arguments", {{"requests", {
+        {{"tool", "find_similar"}, {"arguments", {{"message", "Lane row 1"}}}}}}}}});
+    REQUIRE(fast.read_until("can't run 'find_similar'"));
+
+    server.stop();
+    std::filesystem::remove(db_path);
+}